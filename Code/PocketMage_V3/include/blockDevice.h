@@ -0,0 +1,88 @@
+#ifndef BLOCKDEVICE_H
+#define BLOCKDEVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// BLOCK DEVICE
+// Sectors under USB mass storage (src/mscFunc.cpp). On the device it is the
+// SD card (USB.cpp). Native builds use FileBlockDevice, a disk image file
+// that also adds up what the same commands would cost on a card.
+class BlockDevice {
+public:
+  virtual ~BlockDevice() {}
+  virtual uint32_t sectorSize() const = 0;
+  virtual uint32_t sectorCount() const = 0;
+  // count sectors from lba, as one command
+  virtual bool read(uint32_t lba, uint32_t count, uint8_t* dst) = 0;
+  virtual bool write(uint32_t lba, uint32_t count, const uint8_t* src) = 0;
+};
+
+#ifdef NATIVE_TEST
+#include <stdio.h>
+
+// What a command costs on the card. The defaults are a 1-bit bus at 20 MHz,
+// as USB.cpp sets it up: 205 us to move a sector, plus the command itself,
+// and a write keeps the card busy programming.
+struct SdLatency {
+  uint32_t readCommandMicros  = 250;
+  uint32_t writeCommandMicros = 1000;
+  uint32_t sectorMicros       = 205;
+};
+
+class FileBlockDevice : public BlockDevice {
+public:
+  // Opens or creates the image at path, grown to sectors if it is smaller
+  FileBlockDevice(const char* path, uint32_t sectors, uint32_t sectorSize = 512, SdLatency latency = SdLatency())
+      : sectors(sectors), size(sectorSize), latency(latency) {
+    file = fopen(path, "r+b");
+    if (!file) file = fopen(path, "w+b");
+    if (file && fseek(file, (long)sectors * sectorSize - 1, SEEK_SET) == 0) {
+      int last = fgetc(file);
+      fseek(file, (long)sectors * sectorSize - 1, SEEK_SET);
+      fputc(last == EOF ? 0 : last, file);
+    }
+  }
+
+  ~FileBlockDevice() {
+    if (file) fclose(file);
+  }
+
+  bool ok() const { return file != nullptr; }
+  uint32_t sectorSize() const { return size; }
+  uint32_t sectorCount() const { return sectors; }
+
+  bool read(uint32_t lba, uint32_t count, uint8_t* dst) {
+    if (!file || count == 0 || lba + count > sectors) return false;
+    commands++;
+    sectorsRead += count;
+    busyMicros += latency.readCommandMicros + (uint64_t)count * latency.sectorMicros;
+    return fseek(file, (long)lba * size, SEEK_SET) == 0 && fread(dst, size, count, file) == count;
+  }
+
+  bool write(uint32_t lba, uint32_t count, const uint8_t* src) {
+    if (!file || count == 0 || lba + count > sectors) return false;
+    commands++;
+    sectorsWritten += count;
+    busyMicros += latency.writeCommandMicros + (uint64_t)count * latency.sectorMicros;
+    return fseek(file, (long)lba * size, SEEK_SET) == 0 && fwrite(src, size, count, file) == count;
+  }
+
+  void resetStats() {
+    commands = sectorsRead = sectorsWritten = busyMicros = 0;
+  }
+
+  uint64_t commands = 0;
+  uint64_t sectorsRead = 0;
+  uint64_t sectorsWritten = 0;
+  uint64_t busyMicros = 0;      // Modelled time the card would have spent
+
+private:
+  FILE*     file;
+  uint32_t  sectors;
+  uint32_t  size;
+  SdLatency latency;
+};
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef CIVILDATE_H
+#define CIVILDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CIVIL DATES
+// Proleptic Gregorian dates as serial day numbers (days since 1970-01-01) and
+// as packed YYYYMMDD integers, the same digits the apps store in their files.
+// Everything is constexpr and allocation free. Written as C++11 single-return
+// functions so it builds with the ESP32 toolchain defaults.
+// Based on Howard Hinnant's days_from_civil / civil_from_days.
+
+struct CivilDate {
+  int16_t year;
+  uint8_t month;  // 1-12
+  uint8_t day;    // 1-31
+  constexpr CivilDate(int y, unsigned m, unsigned d) : year(y), month(m), day(d) {}
+};
+
+constexpr bool isLeapYear(int y) {
+  return (y % 4 == 0) && (y % 100 != 0 || y % 400 == 0);
+}
+
+constexpr uint8_t daysInMonth(int year, int month) {
+  return month == 2 ? (isLeapYear(year) ? 29 : 28)
+       : (month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31;
+}
+
+constexpr bool isValidCivil(int y, int m, int d) {
+  return y >= 1 && y <= 9999 && m >= 1 && m <= 12 && d >= 1 && d <= daysInMonth(y, m);
+}
+
+// DAY NUMBERS
+constexpr int32_t civilEra(int32_t y) {
+  return (y >= 0 ? y : y - 399) / 400;
+}
+
+constexpr int32_t civilDayOfEra(int32_t yoe, unsigned m, unsigned d) {
+  return yoe * 365 + yoe / 4 - yoe / 100 + (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+}
+
+constexpr int32_t civilDaysShifted(int32_t y, unsigned m, unsigned d) {
+  return civilEra(y) * 146097 + civilDayOfEra(y - civilEra(y) * 400, m, d) - 719468;
+}
+
+// Days since 1970-01-01
+constexpr int32_t daysFromCivil(int y, unsigned m, unsigned d) {
+  return civilDaysShifted(y - (m <= 2), m, d);
+}
+
+constexpr unsigned civilMonthFromMp(unsigned mp) {
+  return mp < 10 ? mp + 3 : mp - 9;
+}
+
+constexpr CivilDate civilFromDoy(int32_t y, unsigned doy, unsigned mp) {
+  return CivilDate(y + (civilMonthFromMp(mp) <= 2), civilMonthFromMp(mp), doy - (153 * mp + 2) / 5 + 1);
+}
+
+constexpr CivilDate civilFromYoe(int32_t era, unsigned doe, unsigned yoe) {
+  return civilFromDoy(yoe + era * 400, doe - (365 * yoe + yoe / 4 - yoe / 100),
+                      (5 * (doe - (365 * yoe + yoe / 4 - yoe / 100)) + 2) / 153);
+}
+
+constexpr CivilDate civilFromDoe(int32_t era, unsigned doe) {
+  return civilFromYoe(era, doe, (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365);
+}
+
+constexpr int32_t civilEraFromDays(int32_t z) {
+  return (z >= 0 ? z : z - 146096) / 146097;
+}
+
+constexpr CivilDate civilFromShifted(int32_t z) {
+  return civilFromDoe(civilEraFromDays(z), z - civilEraFromDays(z) * 146097);
+}
+
+// Inverse of daysFromCivil
+constexpr CivilDate civilFromDays(int32_t days) {
+  return civilFromShifted(days + 719468);
+}
+
+// WEEKDAYS
+// 0 = Sunday, matching RTClib's dayOfTheWeek()
+constexpr uint8_t weekdayFromDays(int32_t days) {
+  return days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6;
+}
+
+constexpr uint8_t weekdayOf(int y, unsigned m, unsigned d) {
+  return weekdayFromDays(daysFromCivil(y, m, d));
+}
+
+// Day of the month of the nth (1-5) given weekday, may be past the month end
+constexpr uint8_t nthWeekdayDay(int y, unsigned m, unsigned weekday, unsigned nth) {
+  return 1 + (weekday + 7 - weekdayOf(y, m, 1)) % 7 + 7 * (nth - 1);
+}
+
+// 1 for days 1-7, 2 for days 8-14 ...
+constexpr uint8_t weekOfMonth(unsigned d) {
+  return (d - 1) / 7 + 1;
+}
+
+// PACKED YYYYMMDD
+constexpr uint32_t packDate(int y, unsigned m, unsigned d) {
+  return (uint32_t)y * 10000 + m * 100 + d;
+}
+
+constexpr int packedYear(uint32_t packed)  { return packed / 10000; }
+constexpr int packedMonth(uint32_t packed) { return packed / 100 % 100; }
+constexpr int packedDay(uint32_t packed)   { return packed % 100; }
+
+constexpr bool isValidPacked(uint32_t packed) {
+  return isValidCivil(packedYear(packed), packedMonth(packed), packedDay(packed));
+}
+
+constexpr int32_t daysFromPacked(uint32_t packed) {
+  return daysFromCivil(packedYear(packed), packedMonth(packed), packedDay(packed));
+}
+
+constexpr uint32_t packCivil(CivilDate c) {
+  return packDate(c.year, c.month, c.day);
+}
+
+constexpr uint32_t packedFromDays(int32_t days) {
+  return packCivil(civilFromDays(days));
+}
+
+// Reads n ASCII digits, -1 if any character is not a digit
+constexpr int32_t parseDigits(const char* s, size_t n, int32_t acc = 0) {
+  return n == 0 ? acc : (*s < '0' || *s > '9') ? -1 : parseDigits(s + 1, n - 1, acc * 10 + (*s - '0'));
+}
+
+// "YYYYMMDD" (further characters ignored) to packed form, 0 if invalid
+constexpr uint32_t parsePackedDate(const char* s, size_t len) {
+  return (len < 8 || parseDigits(s, 8) < 0 || !isValidPacked(parseDigits(s, 8))) ? 0 : (uint32_t)parseDigits(s, 8);
+}
+
+static_assert(daysFromCivil(1970, 1, 1) == 0, "civil epoch");
+static_assert(daysFromCivil(2000, 3, 1) == 11017, "civil leap day handling");
+static_assert(packedFromDays(daysFromCivil(2024, 2, 29)) == 20240229, "civil round trip");
+static_assert(weekdayOf(2025, 1, 1) == 3, "2025-01-01 is a Wednesday");
+static_assert(nthWeekdayDay(2025, 3, 3, 2) == 12, "2nd Wednesday of March 2025");
+
+#endif
@@ -12,7 +12,49 @@
 #define SET_CLOCK_ON_UPLOAD false               // Should system clock be set automatically on code upload?
 #define TOUCH_TIMEOUT_MS 1200                   // Delay after scrolling to return to typing mode (ms)
 #define SYS_METADATA_FILE "/sys/SDMMC_META.txt" // File path to the file system metadata file
+#define TASKS_FILE "/sys/tasks.txt"             // Task list
+#define EVENTS_FILE "/sys/events.txt"           // Calendar events
+#define STOOL_FILE "/sys/stool.txt"             // Stool log
+#define STOOL_DAYS_FILE "/sys/stool_days.txt"   // Stool counts per day and Bristol type, updated with every entry
+#define STOOL_WEEKS_FILE "/sys/stool_weeks.txt" // Same per week, weeks start on Sunday
+#define STOOL_RECENT 8                          // Latest stool entries listed (a-h)
+#define STOOL_TAIL_BYTES 2048                   // End of the stool log read for the latest entries
+#define STOOL_TREND_WEEKS 8                     // Weeks shown on the stool trends screen
 #define POWER_SAVE_FREQ 40                      // CPU freq for power save mode
+#define METADATA_PREVIEW_LEN 64                 // Chars of a file's first line kept in the metadata file
+#define SYS_INDEX_DIR "/sys/index"              // Folder holding the full-text search index
+#define INDEX_BUCKETS 64                        // Number of posting bucket files in the search index
+#define INDEX_MAX_TERM 24                       // Longest indexed word (longer words are truncated)
+#define INDEX_MAX_HITS 8                        // Line numbers kept per word per file
+#define INDEX_COMPACT_MIN 8                     // Dropped documents before the search index is compacted (and a quarter of the live ones)
+#define BACKGROUND_IDLE_MS 3000                 // Keyboard idle time before background SD work runs (ms)
+#define SYS_DIRTY_FILE "/sys/dirty.txt"         // Notes changed over USB that still need re-indexing
+#define RECONCILE_BATCH 32                      // Directory or metadata entries checked per background step
+#define FINDER_MAX_FILES 4096                   // Paths cached for the fuzzy file finder
+#define FINDER_TOP 3                            // Finder matches shown on the OLED
+#define FINDER_LOAD_BATCH 64                    // Directory entries the finder caches per step
+#define SYSFS_PARTITION "sysfs"                 // Flash partition holding hot /sys files (see partitions_16MB.csv)
+#define SYSFS_FLUSH_MS 5000                     // Time a changed /sys file waits in flash before it is written to SD (ms)
+#define SYS_ICS_LOG "/sys/ics_imported.txt"     // .ics files already imported into the calendar
+#define ICS_UTC_OFFSET 0                        // Minutes added to UTC times in imported .ics files (local time zone)
+#define EVENT_INDEX_DAYS 14                     // Days of event occurrences checked for overlaps and free slots
+#define FREE_SLOT_START (8 * 60)                // Free slot search window, minutes after midnight
+#define FREE_SLOT_END   (20 * 60)
+#define DICT_FILE "/dict/dict.pmd"              // Compiled dictionary image, built by tools/dictc from /dict/<Letter>.txt
+#define DICT_BLOCK_SIZE 512                     // Bytes of the dictionary image read at a time, two blocks are cached
+#define DICT_PARTITION "dict"                   // Flash partition a dictionary image can be written to (see partitions_16MB_dict.csv)
+#define DICT_SEARCH_RESULTS 12                  // Definitions a reverse lookup ("?small boat") pages through
+#define MSC_CACHE_SECTORS 64                    // Sectors of USB read-ahead, and of writes gathered into one command
+#define MSC_FLUSH_MS 250                        // Gathered USB writes go to the card once the host is quiet this long
+#define SYNC_POLL_MS 40                         // Longest loop() spends answering pmsync before the keyboard gets a turn (ms)
+#define SYNC_GAP_MS 5                           // Quiet time after a reply before loop() carries on (ms)
+#define SYNC_SESSION_MS 3000                    // A pmsync session is dropped after this long without a request (ms)
+#define SYNC_RX_BUFFER 4096                     // USB serial receive buffer, holds more than one sync frame
+#define REMOTE_KEY_QUEUE 64                     // Keys from tools/pmremote waiting for updateKeypress()
+#define EINK_PANEL_WIDTH 240                    // E-ink panel as wired, before display.setRotation(3)
+#define EINK_PANEL_HEIGHT 320
+#define OLED_WIDTH 256
+#define OLED_HEIGHT 32
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////|
 
 // PIN DEFINITION
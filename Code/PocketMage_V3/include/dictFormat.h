@@ -0,0 +1,197 @@
+#ifndef DICTFORMAT_H
+#define DICTFORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// COMPILED DICTIONARY IMAGE
+// tools/dictc turns the /dict/<Letter>.txt files into one image that the
+// Lexicon can search without scanning text. Everything is little-endian and
+// every section starts on a 4-byte boundary:
+//   DictHeader        magic, counts and a table of sections
+//   ENTRIES           one record per definition, sorted by folded headword:
+//                     u8 headLen, head, u16 defLen, definition
+//   OFFSETS           u32 offset of every record inside ENTRIES
+//   SPARSE            DictSparse for every sparseStride-th record, small
+//                     enough to keep in RAM and narrow a search to one stride
+//   TRIE              radix trie of the words, for completions (see below)
+//   FUZZY             delete index of the words, for "did you mean" (below)
+//   TERMS             sorted terms of the definitions, for reverse lookup
+//   POSTINGS          the records using each term (below)
+// A headword is the text up to and including the first ')' of a line, e.g.
+// "Abacus (n.)", and its word is the folded part before the '(': "abacus".
+// Folding is ASCII lowercase, other bytes compare as is.
+//
+// TRIE nodes, the root first and every subtree stored contiguously:
+//   u8 labelLen, label    folded bytes leading into this node
+//   u8 topCount           then topCount u32 offsets inside ENTRIES of the
+//                         first sense of the best words below this node, best
+//                         first. Words with more senses rank higher, then
+//                         shorter ones. Offsets save a read of OFFSETS.
+//   u16 childCount        then childCount x (u8 first label byte, u24 offset
+//                         of the child in the section), sorted by that byte
+// Completing a prefix reads one node per label it passes, then the headwords
+// stored at the node where it ends.
+//
+// FUZZY is a SymSpell index. The first DICT_FUZZY_PREFIX bytes of every word,
+// and every string made from them by deleting up to two bytes, are keys:
+//   u32 bucketCount       a power of two, keys go to dictHash(key) & (count-1)
+//   u32 start[count + 1]  first posting of every bucket, and the end
+//   u32 postings          top byte: dictHash(key) >> 24, to tell apart the
+//                         keys sharing a bucket. Low 24 bits: the record of
+//                         the word's first sense.
+// Two words within edit distance 2 always share a key, so a query reads the
+// buckets of its own keys, then checks the words it finds there.
+//
+// TERMS and POSTINGS are an inverted index of the definitions. Terms are the
+// runs of letters dictNextTerm() finds, folded, lightly stemmed and without
+// stop words, so a query is cut up the same way as the text was:
+//   u32 termCount
+//   u32 offset[termCount] of every term record, from the start of TERMS
+//   term records          u8 len, term, u32 count, u32 offset and u32 size of
+//                         its postings inside POSTINGS
+// A term's postings are count x (varint gap to the previous record, or the
+// record itself for the first, u8 weight), in record order. The weight is the
+// term's BM25 score in that definition, scaled so the best in the image is
+// 255, and adding up the weights of the query terms ranks a record.
+
+#define DICT_MAGIC "PMDX"
+static const uint16_t DICT_VERSION       = 1;
+static const uint16_t DICT_SPARSE_STRIDE = 128;
+static const uint8_t  DICT_SPARSE_KEY    = 12;   // Folded headword bytes kept per sparse record
+static const uint8_t  DICT_TRIE_TOP      = 3;    // Completions stored per trie node
+static const uint8_t  DICT_FUZZY_PREFIX  = 7;    // Word bytes the delete keys are made from
+static const uint8_t  DICT_FUZZY_KEYS    = 29;   // Most keys one word makes: 1 + 7 + 21
+static const uint8_t  DICT_FUZZY_BUCKET  = 32;   // Postings per bucket the compiler aims for
+static const uint8_t  DICT_TERM_MIN      = 2;    // Shorter runs of letters aren't terms
+static const uint8_t  DICT_TERM_MAX      = 20;   // Longer ones are cut
+
+enum DictSectionId {
+  DICT_SEC_ENTRIES,
+  DICT_SEC_OFFSETS,
+  DICT_SEC_SPARSE,
+  DICT_SEC_TRIE,
+  DICT_SEC_FUZZY,
+  DICT_SEC_TERMS,
+  DICT_SEC_POSTINGS,
+  DICT_SECTIONS = 14      // Room for later sections, readers skip empty ones
+};
+
+struct DictSection {
+  uint32_t offset;        // From the start of the image
+  uint32_t size;          // Bytes, 0 if the section isn't there
+};
+
+struct DictHeader {
+  char        magic[4];
+  uint16_t    version;
+  uint16_t    sparseStride;
+  uint32_t    entryCount;
+  uint32_t    checksum;     // FNV-1a of everything after the header, tells images apart
+  DictSection sections[DICT_SECTIONS];
+};
+
+struct DictSparse {
+  char     key[DICT_SPARSE_KEY];   // Folded, zero padded, not terminated
+  uint32_t entry;                  // Record number
+};
+
+static_assert(sizeof(DictHeader) == 128, "DictHeader is stored as is");
+static_assert(sizeof(DictSparse) == 16, "DictSparse is stored as is");
+
+inline char dictFold(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// Length of the headword in a dictionary text line, 0 if it has none
+inline size_t dictHeadLength(const char* line, size_t len) {
+  const char* close = (const char*)memchr(line, ')', len);
+  return close ? (size_t)(close - line) + 1 : 0;
+}
+
+// Length of the word at the start of a headword: up to the '(', less spaces
+inline size_t dictWordLength(const char* head, size_t len) {
+  const char* open = (const char*)memchr(head, '(', len);
+  size_t n = open ? (size_t)(open - head) : len;
+  while (n > 0 && (head[n - 1] == ' ' || head[n - 1] == ')')) n--;
+  return n;
+}
+
+// Compares folded a[0..aLen) with folded b[0..bLen) like memcmp, shorter first
+inline int dictCompare(const char* a, size_t aLen, const char* b, size_t bLen) {
+  size_t n = aLen < bLen ? aLen : bLen;
+  for (size_t i = 0; i < n; i++) {
+    unsigned char ca = (unsigned char)dictFold(a[i]);
+    unsigned char cb = (unsigned char)dictFold(b[i]);
+    if (ca != cb) return ca < cb ? -1 : 1;
+  }
+  return aLen == bLen ? 0 : (aLen < bLen ? -1 : 1);
+}
+
+// True if folded head starts with folded prefix
+inline bool dictHasPrefix(const char* head, size_t headLen, const char* prefix, size_t prefixLen) {
+  return headLen >= prefixLen && dictCompare(head, prefixLen, prefix, prefixLen) == 0;
+}
+
+// Words too common in definitions to tell them apart
+inline bool dictStopWord(const char* term, size_t len) {
+  static const char* const stop[] = {
+    "an", "and", "any", "are", "as", "at", "be", "by", "for", "from", "has", "in", "into",
+    "is", "it", "its", "of", "on", "one", "or", "that", "the", "to", "which", "with"
+  };
+  for (size_t i = 0; i < sizeof(stop) / sizeof(stop[0]); i++) {
+    if (strlen(stop[i]) == len && memcmp(stop[i], term, len) == 0) return true;
+  }
+  return false;
+}
+
+// Finds the next term in text from pos on. Copies it into term (room for
+// DICT_TERM_MAX) folded, with a plural 's' dropped, and returns its length.
+// Returns 0 at the end of text.
+inline size_t dictNextTerm(const char* text, size_t len, size_t& pos, char* term) {
+  while (pos < len) {
+    while (pos < len && !((text[pos] >= 'a' && text[pos] <= 'z') || (text[pos] >= 'A' && text[pos] <= 'Z'))) pos++;
+    size_t n = 0;
+    while (pos < len && ((text[pos] >= 'a' && text[pos] <= 'z') || (text[pos] >= 'A' && text[pos] <= 'Z'))) {
+      if (n < DICT_TERM_MAX) term[n++] = dictFold(text[pos]);
+      pos++;
+    }
+    if (n > 3 && term[n - 1] == 's' && term[n - 2] != 's') n--;
+    if (n >= DICT_TERM_MIN && !dictStopWord(term, n)) return n;
+  }
+  return 0;
+}
+
+// FNV-1a of the folded bytes
+inline uint32_t dictHash(const char* key, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) hash = (hash ^ (uint8_t)dictFold(key[i])) * 16777619u;
+  return hash;
+}
+
+// Hands onKey(key, len, deletes) the first DICT_FUZZY_PREFIX bytes of word
+// and every non-empty string made from them by deleting one or two bytes,
+// fewest deletes first. Repeated letters give the same key more than once.
+template <typename F>
+void dictForEachDelete(const char* word, size_t len, F onKey) {
+  char key[DICT_FUZZY_PREFIX];
+  if (len > DICT_FUZZY_PREFIX) len = DICT_FUZZY_PREFIX;
+  if (len == 0) return;
+  onKey(word, len, 0);
+
+  for (size_t i = 0; i < len && len > 1; i++) {
+    size_t n = 0;
+    for (size_t k = 0; k < len; k++) if (k != i) key[n++] = word[k];
+    onKey(key, n, 1);
+  }
+  for (size_t i = 0; i < len && len > 2; i++) {
+    for (size_t j = i + 1; j < len; j++) {
+      size_t n = 0;
+      for (size_t k = 0; k < len; k++) if (k != i && k != j) key[n++] = word[k];
+      onKey(key, n, 2);
+    }
+  }
+}
+
+#endif
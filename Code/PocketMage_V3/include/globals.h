@@ -11,6 +11,15 @@
 #include <cstdio>
 #include <chrono>
 #include <thread>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "civildate.h"
+#include "records.h"
+#include "dictFormat.h"
+#include "blockDevice.h"
+#include "syncProto.h"
+#include "remoteProto.h"
 
 // Mock String class with Arduino-like methods
 #ifndef NATIVE_TEST_STRING_DEFINED
@@ -36,6 +45,11 @@ public:
     size_t pos = find(s, from);
     return (pos == std::string::npos ? -1 : (int)pos);
   }
+
+  int lastIndexOf(char c) const {
+    size_t pos = rfind(c);
+    return (pos == std::string::npos ? -1 : (int)pos);
+  }
   
   void trim() {
     size_t start = find_first_not_of(" \t\n\r\f\v");
@@ -51,6 +65,9 @@ public:
     if (index < length()) erase(index, 1);
   }
   
+  using std::string::replace;
+  void replace(char from, char to) { std::replace(begin(), end(), from, to); }
+
   String& operator+=(const String& rhs) { append(rhs); return *this; }
   String& operator+=(const char* rhs) { append(rhs); return *this; }
   String& operator+=(char c) { push_back(c); return *this; }
@@ -64,6 +81,9 @@ public:
   bool startsWith(const String& prefix) const {
     return this->find(prefix) == 0;
   }
+  bool endsWith(const String& suffix) const {
+    return length() >= suffix.length() && compare(length() - suffix.length(), suffix.length(), suffix) == 0;
+  }
   bool equalsIgnoreCase(const String& other) const {
     if (length() != other.length()) return false;
     for (size_t i = 0; i < length(); ++i) {
@@ -82,6 +102,44 @@ public:
 #define GxEPD_BLACK 1
 #define TASKS_FILE "test_tasks.txt"
 #define STOOL_FILE "test_stool.txt"
+#define STOOL_DAYS_FILE "test_stool_days.txt"
+#define STOOL_WEEKS_FILE "test_stool_weeks.txt"
+#define STOOL_RECENT 8
+#define STOOL_TAIL_BYTES 2048
+#define STOOL_TREND_WEEKS 8
+#define ICS_UTC_OFFSET 0
+#define EVENT_INDEX_DAYS 14
+#define FREE_SLOT_START (8 * 60)
+#define FREE_SLOT_END   (20 * 60)
+#define DICT_FILE "test_dict.pmd"
+#define DICT_BLOCK_SIZE 512
+#define DICT_PARTITION "test_dict_flash.pmd"   // Mapped in place of the partition
+#define MSC_CACHE_SECTORS 64
+#define MSC_FLUSH_MS 250
+#define SYNC_POLL_MS 40
+#define SYNC_GAP_MS 5
+#define SYNC_SESSION_MS 3000
+#define REMOTE_KEY_QUEUE 64
+#define EINK_PANEL_WIDTH 240
+#define EINK_PANEL_HEIGHT 320
+#define OLED_WIDTH 256
+#define OLED_HEIGHT 32
+#define SYS_INDEX_DIR "/sys/index"
+#define INDEX_BUCKETS 64
+#define INDEX_MAX_TERM 24
+#define INDEX_MAX_HITS 8
+#define INDEX_COMPACT_MIN 8
+#define BACKGROUND_IDLE_MS 3000
+#define SYS_DIRTY_FILE "/sys/dirty.txt"
+#define RECONCILE_BATCH 32
+#define FINDER_MAX_FILES 4096
+#define FINDER_TOP 3
+#define FINDER_LOAD_BATCH 64
+#define SYS_METADATA_FILE "test_meta.txt"
+#define METADATA_PREVIEW_LEN 64
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
 #ifdef Serial
 #undef Serial
 #endif
@@ -92,7 +150,7 @@ enum KBState { NORMAL, SHIFT, FUNC };
 enum AppState { HOME, TXT, FILEWIZ, USB_APP, BT, SETTINGS, TASKS, CALENDAR, JOURNAL, LEXICON, STOOL };
 enum TasksState { TASKS0, TASKS0_NEWTASK, TASKS1, TASKS1_EDITTASK };
 enum HOMEState { HOME_HOME, NOWLATER };
-enum StoolState { STOOL0, STOOL1, STOOL1_EDIT };
+enum StoolState { STOOL0, STOOL1, STOOL1_EDIT, STOOL_TRENDS };
 
 #ifndef NATIVE_TEST_FILE_DEFINED
 #define NATIVE_TEST_FILE_DEFINED
@@ -111,6 +169,52 @@ public:
     std::getline(fs, result, delimiter);
     return result;
   }
+
+  size_t read(uint8_t* buf, size_t size) {
+    fs.read(reinterpret_cast<char*>(buf), size);
+    return fs.gcount();
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    fs.write(reinterpret_cast<const char*>(buf), size);
+    return fs.good() ? size : 0;
+  }
+
+  bool seek(size_t pos) {
+    fs.clear();
+    fs.seekg(pos);
+    fs.seekp(pos);
+    return fs.good();
+  }
+
+  size_t position() { return (size_t)fs.tellg(); }
+
+  size_t size() {
+    fs.clear();
+    std::streampos pos = fs.tellg();
+    fs.seekg(0, std::ios::end);
+    size_t end = (size_t)fs.tellg();
+    fs.seekg(pos);
+    return end;
+  }
+
+  size_t print(const char* s) {
+    fs << s;
+    return strlen(s);
+  }
+  size_t print(const String& s) {
+    fs << s;
+    return s.length();
+  }
+
+  size_t println(const String& s) {
+    fs << s << "\n";
+    return s.length() + 1;
+  }
+
+  bool isDirectory() { return false; }
+  time_t getLastWrite() { return lastWrite; }
+  time_t lastWrite = 0;
   
   void close() { fs.close(); }
 };
@@ -120,7 +224,7 @@ public:
 #define NATIVE_TEST_SDMMC_DEFINED
 // Mock SD_MMC
 struct MockSD_MMC {
-  File open(const String& path, const char* mode) {
+  File open(const String& path, const char* mode = "r") {
     std::fstream f;
     std::ios_base::openmode openmode = std::ios::in | std::ios::out;
     std::string spath = path;
@@ -158,6 +262,9 @@ struct MockSD_MMC {
 struct MockDisplay {
   void setRotation(int) {}
   void setFullWindow() {}
+  void setPartialWindow(int, int, int, int) {}
+  void displayWindow(int, int, int, int) {}
+  void hibernate() {}
   void fillScreen(int) {}
   void drawBitmap(int, int, const unsigned char*, int, int, int = 0) {}
   void setFont(const void*) {}
@@ -167,6 +274,12 @@ struct MockDisplay {
   void print(int i) {}
   void setTextColor(int) {}
   void fillRect(int, int, int, int, int) {}
+  void drawRect(int, int, int, int, int) {}
+  int width() { return 320; }
+  int height() { return 240; }
+  void getTextBounds(const String& s, int, int, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+    *x1 = 0; *y1 = 0; *w = s.length() * 11; *h = 12;
+  }
 };
 
 struct MockU8g2 {
@@ -174,8 +287,27 @@ struct MockU8g2 {
 };
 
 // Global variable declarations for native testing
-extern std::vector<std::vector<String>> tasks;
-extern std::vector<std::vector<String>> stoolEntries;
+struct Task {
+  String   name;
+  uint32_t due;          // Packed YYYYMMDD, 0 if unreadable
+  uint8_t  priority;
+  bool     completed;
+};
+// Tasks stay sorted by due date, so each bucket is a slice [start, next start)
+enum TaskBucket { TASKS_OVERDUE, TASKS_TODAY, TASKS_THIS_WEEK, TASKS_LATER, TASK_BUCKETS };
+extern std::vector<Task> tasks;
+extern uint16_t taskBucketStart[TASK_BUCKETS + 1];
+extern const char* const taskBucketNames[TASK_BUCKETS];
+struct TaskRow {               // One line of a grouped task list
+  uint8_t bucket;
+  int16_t task;                // -1 for the bucket heading
+};
+struct StoolEntry {
+  uint8_t  type;         // Bristol type 1-7
+  uint64_t time;         // YYYYMMDDhhmmss, 0 if unreadable
+  String   note;
+};
+extern std::vector<StoolEntry> stoolEntries;
 extern MockSD_MMC SD_MMC;
 extern MockDisplay display;
 extern MockU8g2 u8g2;
@@ -199,12 +331,15 @@ extern String newStoolNote;
 // Function prototypes for native testing (only those needed for tests)
 // TASKS.cpp functions
 void TASKS_INIT();
-void sortTasksByDueDate(std::vector<std::vector<String>> &tasks);
 void addTask(String taskName, String dueDate, String priority, String completed);
 void updateTaskArray();
+void updateTaskBuckets();
+uint8_t taskBucketOf(size_t index);
+uint8_t layoutTaskGroups(TaskRow* rows, uint8_t maxRows);
 void updateTasksFile();
 void deleteTask(int index);
 String convertDateFormat(String yyyymmdd);
+String formatDueDate(uint32_t due);
 void processKB_TASKS();
 
 // STOOL.cpp functions
@@ -212,17 +347,112 @@ void STOOL_INIT();
 void processKB_STOOL();
 void addStoolEntry(int type, String note);
 void updateStoolArray();
-void updateStoolFile();
+void editStoolNote(int index, String note);
 void deleteStoolEntry(int index);
 String getStoolTypeDescription(int type);
 String formatStoolTimestamp(String timestamp);
+String formatStoolTime(uint64_t time);
+
+// dictFunc.cpp functions
+extern bool noSD;
+bool dictBegin();
+void dictEnd();
+bool dictFind(const String& word, uint32_t& first, uint32_t& end);
+bool dictEntry(uint32_t index, String& head, String& def);
+uint8_t dictComplete(const String& prefix, String* words, uint8_t max);
+uint8_t dictSuggest(const String& word, String* words, uint8_t max);
+uint8_t dictSearch(const String& query, uint32_t* records, uint8_t max);
+extern uint32_t dictBlockLoads;
+
+// mscFunc.cpp functions
+void mscCacheBegin(BlockDevice* device);
+void mscCacheEnd();
+bool mscFlush();
+bool mscFlushIdle();
+bool mscRead(uint32_t lba, uint32_t count, uint8_t* dst);
+bool mscWrite(uint32_t lba, uint32_t count, const uint8_t* src);
+
+// syncFunc.cpp functions
+extern bool mscEnabled;
+extern String editingFile;
+void syncBegin(SyncPort* port);
+void syncPoll();
+void reconcileRequest();
+void syncReply(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len);
+
+// reconcileFunc.cpp functions
+void reconcileStep();
+
+// metaFunc.cpp functions
+void writeMetadata(const String& path, const String& text);
+void writeMetadata(const String& path, size_t fatSize, unsigned long fatTime, int charCount, int wordCount, String preview);
+String getMetadataField(const String& metaLine, uint8_t field);
+String getFileMetadata(String path);
+void loadFilesListMetadata();
+void deleteMetadata(String path);
+void renMetadata(String oldPath, String newPath);
+
+// indexFunc.cpp functions
+struct DirWalk {               // Tests fill paths with the notes of their card folder
+  std::vector<String> paths;
+  size_t next = 0;
+};
+extern bool indexResultsActive;
+extern int indexResultLines[MAX_FILES];
+extern String filesList[MAX_FILES];
+extern uint8_t fileIndex;
+void indexFile(String path, const String& text);
+void indexRemove(String path);
+void indexRename(String oldPath, String newPath);
+int  indexSearch(String query);
+void indexRequestRebuild();
+void indexRequestCompact();
+void indexBackgroundStep();
+String readFileQuiet(const String& path);
+void dirWalkBegin(DirWalk& walk, const String& root);
+bool dirWalkNext(DirWalk& walk, String& path, size_t& size, time_t& mtime);
+void dirWalkEnd(DirWalk& walk);
+
+// notesFunc.cpp functions
+bool isNoteFile(const String& path);
+uint32_t hashString(const String& str);
+
+// finderFunc.cpp functions
+extern String finderTop[FINDER_TOP];
+extern uint8_t finderTopCount;
+void finderAdd(String path);
+void finderRemove(String path);
+void finderInvalidate();
+bool finderStep();
+int  finderUpdate(String query);
+int  finderFinish(String query);
+void dirWalkEnd(DirWalk& walk);
+
+// remoteFunc.cpp functions
+void remoteHandle(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len);
+int  remoteTakeKey();
+void remoteKeyTaken();
+void remoteLoopBegin();
+void remoteLoopEnd();
+void remotePanelWrite(const uint8_t* bitmap, int16_t xPart, int16_t yPart, int16_t wBitmap, int16_t hBitmap,
+                      int16_t x, int16_t y, int16_t w, int16_t h, bool invert, bool mirrorY);
+void remoteEinkRefreshed(uint32_t us, bool partial);
+void remoteOledSent(const uint8_t* tiles, uint32_t us);
 
 // Mock functions that will be defined in test files
 void setCpuFrequencyMhz(int freq);
+File sysfsOpen(const String& path, const char* mode);
+bool sysfsWriteRecords(const String& path, size_t count, std::function<String(size_t)> record);
+bool sysfsUpgradeRecords(const String& path);
+bool sysfsRename(const String& pathFrom, const String& pathTo);
+uint32_t sysfsGeneration(const String& path);
+int icsImport(const String& path);
+int icsImportAll();
 void delay(int ms);
 void refresh();
 char updateKeypress();
 int millis();
+unsigned long micros();
 
 // Native implementation of stringToInt
 inline int stringToInt(const String& str) {
@@ -238,6 +468,7 @@ inline int stringToInt(const String& str) {
 #include <Adafruit_TCA8418.h>
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <Buzzer.h>
 #include <USB.h>
 #include <USBMSC.h>
@@ -252,6 +483,13 @@ inline int stringToInt(const String& str) {
 
 #include "assets.h"
 #include "config.h"
+#include "civildate.h"
+#include "records.h"
+#include "dictFormat.h"
+#include "blockDevice.h"
+#include "syncProto.h"
+#include "remoteProto.h"
+#include "screenTap.h"
 
 // FONTS
 // 9x7
@@ -272,8 +510,8 @@ inline int stringToInt(const String& str) {
 //u8g2_font_courR08_tf.h
 
 // Display
-extern GxEPD2_BW<GxEPD2_310_GDEQ031T10, GxEPD2_310_GDEQ031T10::HEIGHT> display;
-extern U8G2_SSD1326_ER_256X32_F_4W_HW_SPI u8g2;           // 256x32 SPI OLED
+extern GxEPD2_BW<EinkTap<GxEPD2_310_GDEQ031T10>, GxEPD2_310_GDEQ031T10::HEIGHT> display;
+extern OledTap<U8G2_SSD1326_ER_256X32_F_4W_HW_SPI> u8g2;  // 256x32 SPI OLED
 
 // Keypad
 extern Adafruit_TCA8418 keypad;
@@ -297,6 +535,13 @@ extern USBMSC msc;
 extern bool mscEnabled;
 extern sdmmc_card_t* card;
 
+// SD
+struct DirWalk {               // Resumable walk over the card, see dirWalkNext()
+  std::vector<String> pending; // Folders still to visit
+  File dir;                    // Folder currently being read
+  String dirPath;
+};
+
 // GENERAL
 
 // Settings editable on-device
@@ -357,6 +602,7 @@ extern int lines;
 extern String outLines[13];
 extern String lines_prev[13];
 extern String filesList[MAX_FILES];
+extern String filesListMeta[MAX_FILES];
 extern uint8_t fileIndex;
 extern String editingFile;
 extern String prevEditingFile;
@@ -380,7 +626,21 @@ extern int lastTouch;
 extern unsigned long lastTouchTime;
 
 // <TASKS.cpp>
-extern std::vector<std::vector<String>> tasks;
+struct Task {
+  String   name;
+  uint32_t due;          // Packed YYYYMMDD, 0 if unreadable
+  uint8_t  priority;
+  bool     completed;
+};
+// Tasks stay sorted by due date, so each bucket is a slice [start, next start)
+enum TaskBucket { TASKS_OVERDUE, TASKS_TODAY, TASKS_THIS_WEEK, TASKS_LATER, TASK_BUCKETS };
+extern std::vector<Task> tasks;
+extern uint16_t taskBucketStart[TASK_BUCKETS + 1];
+extern const char* const taskBucketNames[TASK_BUCKETS];
+struct TaskRow {               // One line of a grouped task list
+  uint8_t bucket;
+  int16_t task;                // -1 for the bucket heading
+};
 extern uint8_t selectedTask;
 enum TasksState { TASKS0, TASKS0_NEWTASK, TASKS1, TASKS1_EDITTASK };
 extern TasksState CurrentTasksState;
@@ -411,8 +671,13 @@ enum LexState {MENU, DEF};
 extern LexState CurrentLexState;
 
 // <STOOL.cpp>
-extern std::vector<std::vector<String>> stoolEntries;
-enum StoolState { STOOL0, STOOL1, STOOL1_EDIT };
+struct StoolEntry {
+  uint8_t  type;         // Bristol type 1-7
+  uint64_t time;         // YYYYMMDDhhmmss, 0 if unreadable
+  String   note;
+};
+extern std::vector<StoolEntry> stoolEntries;
+enum StoolState { STOOL0, STOOL1, STOOL1_EDIT, STOOL_TRENDS };
 extern StoolState CurrentStoolState;
 extern uint8_t selectedStoolEntry;
 extern String newStoolNote;
@@ -429,6 +694,11 @@ String vectorToString();
 void stringToVector(String inputText);
 void saveFile();
 void writeMetadata(const String& path);
+void writeMetadata(const String& path, const String& text);
+void writeMetadata(const String& path, size_t fatSize, unsigned long fatTime, int charCount, int wordCount, String preview);
+String getMetadataField(const String& metaLine, uint8_t field);
+String getFileMetadata(String path);
+void loadFilesListMetadata();
 void loadFile(bool showOLED = true);
 void delFile(String fileName);
 void deleteMetadata(String path);
@@ -453,11 +723,88 @@ void appendFile(fs::FS &fs, const char *path, const char *message);
 void renameFile(fs::FS &fs, const char *path1, const char *path2);
 void deleteFile(fs::FS &fs, const char *path);
 void setTimeFromString(String timeStr);
+String readFileQuiet(const String& path);
+void dirWalkBegin(DirWalk& walk, const String& root);
+bool dirWalkNext(DirWalk& walk, String& path, size_t& size, time_t& mtime);
+void dirWalkEnd(DirWalk& walk);
+
+// <notesFunc.cpp>
+bool isNoteFile(const String& path);
+uint32_t hashString(const String& str);
+
+// <indexFunc.cpp>
+extern bool indexResultsActive;
+extern int indexResultLines[MAX_FILES];
+void indexFile(String path, const String& text);
+void indexRemove(String path);
+void indexRename(String oldPath, String newPath);
+int  indexSearch(String query);
+void indexRequestRebuild();
+void indexRequestCompact();
+void indexBackgroundStep();
+
+// <dictFunc.cpp>
+bool dictBegin();
+void dictEnd();
+bool dictFind(const String& word, uint32_t& first, uint32_t& end);
+bool dictEntry(uint32_t index, String& head, String& def);
+uint8_t dictComplete(const String& prefix, String* words, uint8_t max);
+uint8_t dictSuggest(const String& word, String* words, uint8_t max);
+uint8_t dictSearch(const String& query, uint32_t* records, uint8_t max);
+extern uint32_t dictBlockLoads;
+
+// <mscFunc.cpp>
+void mscCacheBegin(BlockDevice* device);
+void mscCacheEnd();
+bool mscFlush();
+bool mscFlushIdle();
+bool mscRead(uint32_t lba, uint32_t count, uint8_t* dst);
+bool mscWrite(uint32_t lba, uint32_t count, const uint8_t* src);
+
+// <syncFunc.cpp>
+void syncBegin();
+void syncBegin(SyncPort* port);
+void syncPoll();
+void syncReply(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len);
+
+// <remoteFunc.cpp>
+void remoteHandle(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len);
+int  remoteTakeKey();
+void remoteKeyTaken();
+void remoteLoopBegin();
+void remoteLoopEnd();
+
+// <sysfsFunc.cpp>
+bool sysfsBegin();
+void sysfsSyncFromSD();
+File sysfsOpen(const String& path, const char* mode = FILE_READ);
+bool sysfsWriteRecords(const String& path, size_t count, std::function<String(size_t)> record);
+bool sysfsUpgradeRecords(const String& path);
+bool sysfsRename(const String& pathFrom, const String& pathTo);
+uint32_t sysfsGeneration(const String& path);
+void sysfsFlushStep();
+void sysfsFlushAll();
+
+// <finderFunc.cpp>
+extern String finderTop[FINDER_TOP];
+extern uint8_t finderTopCount;
+void finderAdd(String path);
+void finderRemove(String path);
+void finderInvalidate();
+bool finderStep();
+int  finderUpdate(String query);
+int  finderFinish(String query);
+
+// <reconcileFunc.cpp>
+void reconcileRequest();
+void reconcileStep();
 
 // <OLEDFunc.cpp>
 void oledWord(String word, bool allowLarge = false, bool showInfo = true);
 void oledLine(String line, bool doProgressBar = true);
 void oledScroll();
+void oledFinder(const String& line);
+void oledSuggest(const String& line, const String* words, uint8_t count);
 void infoBar();
 
 // <einkFunc.cpp>
@@ -477,6 +824,7 @@ void multiPassRefesh(int passes);
 void FILEWIZ_INIT();
 void processKB_FILEWIZ();
 void einkHandler_FILEWIZ();
+void drawFileDetails(const String& meta);
 
 // <TXT.cpp>
 void TXT_INIT();
@@ -497,12 +845,15 @@ void drawHome();
 
 // <TASKS.cpp>
 void TASKS_INIT();
-void sortTasksByDueDate(std::vector<std::vector<String>> &tasks);
 void addTask(String taskName, String dueDate, String priority, String completed);
 void updateTaskArray();
+void updateTaskBuckets();
+uint8_t taskBucketOf(size_t index);
+uint8_t layoutTaskGroups(TaskRow* rows, uint8_t maxRows);
 void updateTasksFile();
 void deleteTask(int index);
 String convertDateFormat(String yyyymmdd);
+String formatDueDate(uint32_t due);
 void einkHandler_TASKS();
 void processKB_TASKS();
 
@@ -526,6 +877,12 @@ void USBAppSetup();
 void CALENDAR_INIT();
 void processKB_CALENDAR();
 void einkHandler_CALENDAR();
+void invalidateEventCache();
+String getMonthName(int month);
+
+// <icsFunc.cpp>
+int icsImport(const String& path);
+int icsImportAll();
 
 // <LEXICON.cpp>
 void LEXICON_INIT();
@@ -538,10 +895,11 @@ void processKB_STOOL();
 void einkHandler_STOOL();
 void addStoolEntry(int type, String note);
 void updateStoolArray();
-void updateStoolFile();
+void editStoolNote(int index, String note);
 void deleteStoolEntry(int index);
 String getStoolTypeDescription(int type);
 String formatStoolTimestamp(String timestamp);
+String formatStoolTime(uint64_t time);
 
 // <PocketMage>
 void applicationEinkHandler();
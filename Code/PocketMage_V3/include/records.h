@@ -0,0 +1,257 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "civildate.h"
+
+// DELIMITED RECORDS
+// The /sys files hold one record per line, fields separated by '|':
+//   Buy milk|20250120|0|0
+// splitRecord() cuts a line into FieldSpans that point into the line buffer
+// itself, so decoding a record allocates nothing until a text field is copied
+// into a String. Text fields escape '|' as "\|", '\' as "\\" and line breaks
+// as "\n".
+// Files with escaped text start with a RECORD_HEADER line. Files without one
+// were written before escaping and read back verbatim, so a note that held a
+// literal "\n" keeps it; '|' past the last expected field stays part of that
+// field in both.
+
+struct FieldSpan {
+  const char* ptr;    // NUL terminated, inside the line buffer
+  uint32_t    len;
+};
+
+static const char    RECORD_HEADER[]   = "#records 1";
+static const uint8_t RECORD_MAX_FIELDS = 8;
+static const size_t  RECORD_LINE_MAX   = 256;   // Longer lines move to the heap
+static const size_t  RECORD_READ_BUF   = 128;
+
+// Splits line[0..len) in place, unescaping text unless the file predates
+// escaping. line needs room for len + 1 bytes. Returns the number of fields,
+// at most maxFields.
+inline uint8_t splitRecord(char* line, size_t len, FieldSpan* fields, uint8_t maxFields, bool escaped = true) {
+  uint8_t count = 0;
+  char* out = line;
+  char* fieldStart = line;
+
+  for (size_t i = 0; i < len; i++) {
+    char c = line[i];
+    if (escaped && c == '\\' && i + 1 < len) {
+      char next = line[i + 1];
+      if (next == '|' || next == '\\' || next == 'n') {
+        *out++ = (next == 'n') ? '\n' : next;
+        i++;
+        continue;
+      }
+    }
+    if (c == '|' && count + 1 < maxFields) {
+      fields[count].ptr = fieldStart;
+      fields[count].len = out - fieldStart;
+      count++;
+      *out++ = '\0';
+      fieldStart = out;
+      continue;
+    }
+    *out++ = c;
+  }
+
+  fields[count].ptr = fieldStart;
+  fields[count].len = out - fieldStart;
+  *out = '\0';
+  return count + 1;
+}
+
+// FIELD DECODING
+// Optional '-' then digits, fallback if empty or anything else
+inline int32_t fieldInt(const FieldSpan& field, int32_t fallback) {
+  if (field.len == 0) return fallback;
+  bool negative = field.ptr[0] == '-';
+  size_t start = negative ? 1 : 0;
+  if (start == field.len || field.len - start > 9) return fallback;
+  int32_t value = parseDigits(field.ptr + start, field.len - start);
+  if (value < 0) return fallback;
+  return negative ? -value : value;
+}
+
+// Packed YYYYMMDD from the first 8 characters, 0 if unreadable
+inline uint32_t fieldDate(const FieldSpan& field) {
+  return parsePackedDate(field.ptr, field.len);
+}
+
+inline bool fieldEquals(const FieldSpan& field, const char* text) {
+  for (uint32_t i = 0; i < field.len; i++) {
+    if (text[i] != field.ptr[i]) return false;
+  }
+  return text[field.len] == '\0';
+}
+
+// FIELD ENCODING
+inline bool needsEscape(char c) {
+  return c == '|' || c == '\\' || c == '\n';
+}
+
+// Text as it goes into a record, returned as is when nothing needs escaping
+template <typename StringT>
+StringT escapeField(const StringT& text) {
+  size_t n = text.length();
+  size_t i = 0;
+  while (i < n && !needsEscape(text[i])) i++;
+  if (i == n) return text;
+
+  StringT out = text.substring(0, i);
+  for (; i < n; i++) {
+    char c = text[i];
+    if (c == '\n') out += "\\n";
+    else {
+      if (needsEscape(c)) out += '\\';
+      out += c;
+    }
+  }
+  return out;
+}
+
+// A raw line of a file without RECORD_HEADER, re-encoded so it reads back the
+// same under one. Older files had no escapes, only '\' needs doubling.
+template <typename StringT>
+StringT escapeLegacyLine(const char* line) {
+  StringT out = "";
+  for (const char* c = line; *c; c++) {
+    if (*c == '\\') out += '\\';
+    out += *c;
+  }
+  return out;
+}
+
+// True if the file starts with RECORD_HEADER. Leaves the file at its start.
+template <typename FileT>
+bool hasRecordHeader(FileT& file) {
+  const size_t len = sizeof(RECORD_HEADER) - 1;
+  char head[sizeof(RECORD_HEADER) + 1];
+  file.seek(0);
+  size_t got = file.read((uint8_t*)head, len + 1);
+  file.seek(0);
+  if (got < len || memcmp(head, RECORD_HEADER, len) != 0) return false;
+  return got == len || head[len] == '\n' || head[len] == '\r';
+}
+
+// LINE READER
+// Reads a file through a small chunk buffer into a reusable line buffer, so a
+// whole file is parsed without one String per line. Blank lines are skipped
+// and surrounding whitespace is trimmed, like String::trim(). Lines longer than
+// RECORD_LINE_MAX are read whole into a heap buffer, never cut, so rewriting a
+// file line by line keeps every record intact.
+// A RECORD_HEADER first line is skipped and sets escaped. Readers that start
+// mid-file set escaped themselves (hasRecordHeader()).
+template <typename FileT>
+struct RecordReader {
+  FileT&    file;
+  char      chunk[RECORD_READ_BUF];
+  size_t    chunkLen = 0;
+  size_t    chunkPos = 0;
+  size_t    consumed = 0;            // Bytes of the file used so far
+  char*     line;                    // lineBuf, or longLine for long lines
+  size_t    lineLen = 0;
+  FieldSpan fields[RECORD_MAX_FIELDS];
+  uint8_t   count = 0;
+  bool      escaped = false;         // Text fields are escaped (RECORD_HEADER seen)
+  bool      firstLine = true;
+  char      lineBuf[RECORD_LINE_MAX + 1];
+  std::vector<char> longLine;
+
+  explicit RecordReader(FileT& f) : file(f), line(lineBuf) {}
+  RecordReader(const RecordReader&) = delete;
+
+  // Next non-blank line into line/lineLen, false at the end of the file
+  bool nextLine() {
+    while (true) {
+      lineLen = 0;
+      line = lineBuf;
+      bool ended = false;
+      bool gotAny = false;
+
+      while (!ended) {
+        if (chunkPos == chunkLen) {
+          chunkLen = file.read((uint8_t*)chunk, sizeof(chunk));
+          chunkPos = 0;
+          if (chunkLen == 0) break;
+        }
+        gotAny = true;
+        char c = chunk[chunkPos++];
+        consumed++;
+        if (c == '\n') ended = true;
+        else append(c);
+      }
+      if (!gotAny) return false;
+
+      // Trim
+      size_t start = 0;
+      while (start < lineLen && isSpace(line[start])) start++;
+      while (lineLen > start && isSpace(line[lineLen - 1])) lineLen--;
+      if (lineLen == start) continue;
+      if (start > 0) {
+        memmove(line, line + start, lineLen - start);
+        lineLen -= start;
+      }
+      line[lineLen] = '\0';
+
+      bool header = firstLine && strcmp(line, RECORD_HEADER) == 0;
+      firstLine = false;
+      if (header) {
+        escaped = true;
+        continue;
+      }
+      return true;
+    }
+  }
+
+  // Next non-blank line split into fields[0..count), false at the end of the file
+  bool next(uint8_t maxFields = RECORD_MAX_FIELDS) {
+    if (!nextLine()) return false;
+    count = splitRecord(line, lineLen, fields, maxFields < RECORD_MAX_FIELDS ? maxFields : RECORD_MAX_FIELDS, escaped);
+    return true;
+  }
+
+  // Carries on reading from byte pos, which should be a line start
+  void seek(size_t pos) {
+    file.seek(pos);
+    chunkLen = chunkPos = 0;
+    consumed = pos;
+    firstLine = pos == 0;
+  }
+
+  // Drops everything up to and including the next newline, blank or not
+  void skipLine() {
+    while (true) {
+      if (chunkPos == chunkLen) {
+        chunkLen = file.read((uint8_t*)chunk, sizeof(chunk));
+        chunkPos = 0;
+        if (chunkLen == 0) return;
+      }
+      consumed++;
+      if (chunk[chunkPos++] == '\n') return;
+    }
+  }
+
+  void append(char c) {
+    if (line == lineBuf && lineLen == RECORD_LINE_MAX) {
+      // Moves to the heap, the buffer is kept for the next long line
+      if (longLine.size() < 2 * RECORD_LINE_MAX + 1) longLine.resize(2 * RECORD_LINE_MAX + 1);
+      memcpy(longLine.data(), lineBuf, lineLen);
+      line = longLine.data();
+    }
+    else if (line != lineBuf && lineLen + 1 == longLine.size()) {
+      longLine.resize(2 * longLine.size());
+      line = longLine.data();
+    }
+    line[lineLen++] = c;
+  }
+
+  static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+  }
+};
+
+#endif
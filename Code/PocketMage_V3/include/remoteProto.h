@@ -0,0 +1,122 @@
+#ifndef REMOTEPROTO_H
+#define REMOTEPROTO_H
+
+#include "syncProto.h"
+
+// REMOTE CONTROL
+// Lets tools/pmremote type on the device and watch what it does, to time the
+// UI without a person at the keyboard or a camera on the panel. It rides on
+// the sync frames (syncProto.h) over the same port, with types of its own,
+// and works without a sync session or a card (src/remoteFunc.cpp).
+//
+// Requests and their reply payloads:
+//   HELLO  empty                        empty
+//          Opens every run, so its requests aren't taken for repeats of the
+//          last run's (see syncProto.h)
+//   KEYS   u8 kind, keys                u16 keys taken, u16 room left
+//          REMOTE_CHARS: characters as updateKeypress() hands them out, so
+//          8 is backspace, 13 enter, 17 shift, 18 FN and so on
+//          REMOTE_MATRIX: key numbers, row * 10 + column, read through the
+//          shift or FN layer the device is in, like a real press. Numbers
+//          off the matrix are dropped, but count as taken.
+//   SNAP   u8 screen, u32 offset        u8 screen, u8 rotation, u16 width,
+//                                       u16 height, u32 frame, u32 total,
+//                                       u32 offset, bytes
+//          A screen as last sent to it: rows from the top, 1 bit a pixel, MSB
+//          first, 1 for ink (black on the e-ink, lit on the OLED), in the
+//          panel's own orientation. rotation is the Adafruit GFX rotation the
+//          firmware draws with. The picture is packed with remotePack() into
+//          total bytes. Offset 0 takes a new picture, later offsets page
+//          through it. frame counts the updates of that screen.
+//   STATS  u8 reset                     u8 count, count x u32, see RemoteStat.
+//                                       Counters restart after a read with reset.
+
+enum RemoteType {
+  REMOTE_KEYS = 0x20,
+  REMOTE_SNAP,
+  REMOTE_STATS,
+  REMOTE_HELLO,
+  REMOTE_LAST = 0x3F       // Types up to here go to remoteFunc.cpp
+};
+
+enum RemoteKeyKind { REMOTE_CHARS, REMOTE_MATRIX };
+enum RemoteScreen { REMOTE_EINK, REMOTE_OLED };
+
+static const uint8_t REMOTE_SNAP_HEADER = 20;
+
+enum RemoteStat {
+  REMOTE_APP,              // CurrentAppState
+  REMOTE_KEYS_WAITING,     // Sent, not taken by an app yet
+  REMOTE_LOOPS,            // Passes through loop()
+  REMOTE_LOOP_US,          // Spent in them, less the sleep at the end
+  REMOTE_LOOP_MAX_US,
+  REMOTE_KEYS_TAKEN,       // Keys handed to the apps, typed or sent
+  REMOTE_OLED_FRAMES,
+  REMOTE_OLED_US,          // Spent sending them
+  REMOTE_EINK_REFRESHES,
+  REMOTE_EINK_PARTIAL,     // Of those, partial window refreshes
+  REMOTE_EINK_US,          // Spent refreshing
+  REMOTE_EINK_MAX_US,
+  REMOTE_KEY_TO_OLED_US,   // From the last key taken to the end of the next OLED frame
+  REMOTE_KEY_TO_EINK_US,   // ... and of the next e-ink refresh
+  REMOTE_STAT_COUNT
+};
+
+inline const char* remoteStatName(uint8_t stat) {
+  static const char* const names[REMOTE_STAT_COUNT] = {
+    "app", "keys_waiting", "loops", "loop_us", "loop_max_us", "keys_taken", "oled_frames", "oled_us",
+    "eink_refreshes", "eink_partial", "eink_us", "eink_max_us", "key_to_oled_us", "key_to_eink_us"
+  };
+  return stat < REMOTE_STAT_COUNT ? names[stat] : "unknown";
+}
+
+// PACKING
+// PackBits: a control byte n below 128 is followed by n + 1 bytes as they
+// are, one above 128 by a byte that repeats 257 - n times. Screens are mostly
+// white, so they shrink a lot. out needs len + len / 128 + 1 bytes.
+inline size_t remotePack(const uint8_t* in, size_t len, uint8_t* out) {
+  size_t o = 0, i = 0;
+  while (i < len) {
+    size_t run = 1;
+    while (i + run < len && run < 128 && in[i + run] == in[i]) run++;
+    if (run >= 2) {
+      out[o++] = (uint8_t)(257 - run);
+      out[o++] = in[i];
+      i += run;
+      continue;
+    }
+    // Literals up to the next run of 3, where a run starts to pay
+    size_t start = i, n = 0;
+    while (i < len && n < 128) {
+      if (i + 2 < len && in[i] == in[i + 1] && in[i] == in[i + 2]) break;
+      i++;
+      n++;
+    }
+    out[o++] = (uint8_t)(n - 1);
+    memcpy(out + o, in + start, n);
+    o += n;
+  }
+  return o;
+}
+
+// False if in doesn't unpack to exactly outLen bytes
+inline bool remoteUnpack(const uint8_t* in, size_t len, uint8_t* out, size_t outLen) {
+  size_t o = 0, i = 0;
+  while (i < len) {
+    uint8_t n = in[i++];
+    if (n < 128) {
+      if (i + n + 1 > len || o + n + 1 > outLen) return false;
+      memcpy(out + o, in + i, n + 1);
+      i += n + 1;
+      o += n + 1;
+    }
+    else if (n > 128) {
+      if (i >= len || o + (257 - n) > outLen) return false;
+      memset(out + o, in[i++], 257 - n);
+      o += 257 - n;
+    }
+  }
+  return o == outLen;
+}
+
+#endif
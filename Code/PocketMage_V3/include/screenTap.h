@@ -0,0 +1,70 @@
+#ifndef SCREENTAP_H
+#define SCREENTAP_H
+
+// SCREEN TAPS
+// Wrap the display drivers so remoteFunc.cpp sees each frame the panels are
+// sent, and how long it took, without touching the libraries. GxEPD2_BW keeps
+// its buffer to itself but reaches the panel only through its driver, so the
+// e-ink tap stands in for the driver. u8g2 goes through sendBuffer().
+
+void remotePanelWrite(const uint8_t* bitmap, int16_t xPart, int16_t yPart, int16_t wBitmap, int16_t hBitmap,
+                      int16_t x, int16_t y, int16_t w, int16_t h, bool invert, bool mirrorY);
+void remoteEinkRefreshed(uint32_t us, bool partial);
+void remoteOledSent(const uint8_t* tiles, uint32_t us);
+
+// The GxEPD2 driver under GxEPD2_BW, e.g. GxEPD2_BW<EinkTap<Driver>, Driver::HEIGHT>
+template <typename Epd>
+class EinkTap : public Epd {
+public:
+  EinkTap(int16_t cs, int16_t dc, int16_t rst, int16_t busy) : Epd(cs, dc, rst, busy) {}
+
+  using Epd::writeImage;
+  using Epd::writeImagePart;
+
+  void writeImage(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                  bool invert = false, bool mirror_y = false, bool pgm = false) {
+    remotePanelWrite(bitmap, 0, 0, w, h, x, y, w, h, invert, mirror_y);
+    Epd::writeImage(bitmap, x, y, w, h, invert, mirror_y, pgm);
+  }
+
+  void writeImageForFullRefresh(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                                bool invert = false, bool mirror_y = false, bool pgm = false) {
+    remotePanelWrite(bitmap, 0, 0, w, h, x, y, w, h, invert, mirror_y);
+    Epd::writeImageForFullRefresh(bitmap, x, y, w, h, invert, mirror_y, pgm);
+  }
+
+  void writeImagePart(const uint8_t bitmap[], int16_t x_part, int16_t y_part, int16_t w_bitmap, int16_t h_bitmap,
+                      int16_t x, int16_t y, int16_t w, int16_t h,
+                      bool invert = false, bool mirror_y = false, bool pgm = false) {
+    remotePanelWrite(bitmap, x_part, y_part, w_bitmap, h_bitmap, x, y, w, h, invert, mirror_y);
+    Epd::writeImagePart(bitmap, x_part, y_part, w_bitmap, h_bitmap, x, y, w, h, invert, mirror_y, pgm);
+  }
+
+  // Refreshes wait for the panel, so this is how long it was busy
+  void refresh(bool partial_update_mode = false) {
+    unsigned long start = micros();
+    Epd::refresh(partial_update_mode);
+    remoteEinkRefreshed(micros() - start, partial_update_mode);
+  }
+
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h) {
+    unsigned long start = micros();
+    Epd::refresh(x, y, w, h);
+    remoteEinkRefreshed(micros() - start, true);
+  }
+};
+
+// The u8g2 display class, e.g. OledTap<U8G2_SSD1326_ER_256X32_F_4W_HW_SPI>
+template <typename U8>
+class OledTap : public U8 {
+public:
+  using U8::U8;
+
+  void sendBuffer() {
+    unsigned long start = micros();
+    U8::sendBuffer();
+    remoteOledSent(this->getBufferPtr(), micros() - start);
+  }
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef SYNCPROTO_H
+#define SYNCPROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// USB SERIAL SYNC
+// tools/pmsync pushes notes to the device over the USB CDC serial port while
+// it keeps running (src/syncFunc.cpp), sending only what changed, rsync style:
+//   SIG    the device hands back a weak (rolling) and a strong checksum of
+//          every SYNC_BLOCK bytes of its copy, the last block may be short
+//   BEGIN  the host rolls the weak checksum over its copy to find those
+//          blocks anywhere in it, then sends the new file as COPY (blocks of
+//          the old file) and DATA (literal bytes)
+//   END    the device checks the size and hash of what it wrote and puts it
+//          in place of the old file
+// The port also carries the device's debug prints, so every message is a
+// frame the reader can find its way back to:
+//   u8 0xA5, u8 0x5A, u8 type, u8 seq, u16 len, payload, u32 check
+// where check is FNV-1a of type through payload. Everything is little-endian.
+// One request is in flight at a time. The reply has the request's type with
+// SYNC_REPLY set, or SYNC_ERR and a message. A request repeated with the same
+// seq gets the same reply again without being redone, so the host can resend
+// after a frame got lost. A HELLO is never taken for a repeat: it starts a
+// run, so the request after it isn't mistaken for the last one of an earlier
+// run. Hosts start counting seq from a random value too.
+//
+// Requests and their reply payloads:
+//   HELLO  u16 version                      u16 version, u16 block, u16 payloadMax
+//   SIG    u32 firstBlock, path             u32 fileSize, u32 firstBlock, u16 count,
+//                                           count x (u32 weak, u32 strong). fileSize
+//                                           is SYNC_MISSING if there's no such note
+//   BEGIN  u32 size, u64 hash, path         empty
+//   COPY   u32 block, u16 count             empty
+//   DATA   bytes                            empty
+//   END    empty                            empty
+//   BYE    empty                            empty
+
+static const uint16_t SYNC_VERSION     = 1;
+static const uint16_t SYNC_BLOCK       = 512;    // Bytes per checksummed block
+static const uint16_t SYNC_PAYLOAD_MAX = 1024;   // Largest payload either side sends
+static const uint8_t  SYNC_SIGS        = 64;     // Block checksums per SIG reply
+static const uint8_t  SYNC_COPY_MAX    = 16;     // Blocks per COPY
+static const uint8_t  SYNC_HEADER      = 6;
+static const size_t   SYNC_FRAME_MAX   = SYNC_HEADER + SYNC_PAYLOAD_MAX + 4;
+static const uint32_t SYNC_MISSING     = 0xFFFFFFFF;
+
+enum SyncType {
+  SYNC_HELLO = 1,
+  SYNC_SIG,
+  SYNC_BEGIN,
+  SYNC_COPY,
+  SYNC_DATA,
+  SYNC_END,
+  SYNC_BYE,
+  SYNC_REPLY = 0x80,
+  SYNC_ERR   = 0xFF
+};
+
+inline void syncPut16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+inline void syncPut32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+inline void syncPut64(uint8_t* p, uint64_t v) {
+  for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+inline uint16_t syncGet16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t syncGet32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint64_t syncGet64(const uint8_t* p) {
+  return (uint64_t)syncGet32(p) | ((uint64_t)syncGet32(p + 4) << 32);
+}
+
+// CHECKSUMS
+// FNV-1a, carried on from hash for data read in pieces
+inline uint32_t syncStrong(const uint8_t* data, size_t len, uint32_t hash = 2166136261u) {
+  for (size_t i = 0; i < len; i++) hash = (hash ^ data[i]) * 16777619u;
+  return hash;
+}
+
+inline uint64_t syncHash64(const uint8_t* data, size_t len, uint64_t hash = 14695981039346656037ull) {
+  for (size_t i = 0; i < len; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+  return hash;
+}
+
+// rsync's weak checksum: a is the sum of the bytes, b the sum of the running
+// values of a, both mod 2^16. Sliding the window a byte costs two adds.
+struct SyncRolling {
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint32_t len = 0;
+
+  void reset(const uint8_t* data, uint32_t n) {
+    a = b = 0;
+    len = n;
+    for (uint32_t i = 0; i < n; i++) {
+      a += data[i];
+      b += (n - i) * data[i];
+    }
+  }
+
+  // Drops out from the front of the window and takes in at the back
+  void roll(uint8_t out, uint8_t in) {
+    a += in - out;
+    b += a - len * out;
+  }
+
+  uint32_t value() const { return (a & 0xFFFF) | (b << 16); }
+};
+
+inline uint32_t syncWeak(const uint8_t* data, uint32_t len) {
+  SyncRolling r;
+  r.reset(data, len);
+  return r.value();
+}
+
+// FRAMES
+// Writes a frame into out (room for SYNC_FRAME_MAX), returns its length
+inline size_t syncFrame(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len, uint8_t* out) {
+  out[0] = 0xA5;
+  out[1] = 0x5A;
+  out[2] = type;
+  out[3] = seq;
+  syncPut16(out + 4, len);
+  if (len) memcpy(out + SYNC_HEADER, payload, len);
+  syncPut32(out + SYNC_HEADER + len, syncStrong(out + 2, SYNC_HEADER - 2 + len));
+  return SYNC_HEADER + len + 4;
+}
+
+// Picks frames out of a byte stream, skipping whatever is between them
+class SyncParser {
+public:
+  // True once b completes a frame, which stays readable until the next call
+  bool feed(uint8_t b) {
+    if (have == 0 && b != 0xA5) return false;
+    if (have == 1 && b != 0x5A) {
+      have = b == 0xA5 ? 1 : 0;
+      return false;
+    }
+    buf[have++] = b;
+    if (have == SYNC_HEADER && syncGet16(buf + 4) > SYNC_PAYLOAD_MAX) {
+      have = 0;
+      return false;
+    }
+    if (have < SYNC_HEADER || have < SYNC_HEADER + (size_t)length() + 4) return false;
+
+    have = 0;
+    return syncGet32(buf + SYNC_HEADER + length()) == syncStrong(buf + 2, SYNC_HEADER - 2 + length());
+  }
+
+  void reset() { have = 0; }
+
+  uint8_t type() const { return buf[2]; }
+  uint8_t seq() const { return buf[3]; }
+  uint16_t length() const { return syncGet16(buf + 4); }
+  const uint8_t* payload() const { return buf + SYNC_HEADER; }
+
+private:
+  uint8_t buf[SYNC_FRAME_MAX];
+  size_t  have = 0;
+};
+
+// PORT
+// The serial link. read() never waits; it returns what has already arrived.
+class SyncPort {
+public:
+  virtual ~SyncPort() {}
+  virtual size_t read(uint8_t* dst, size_t max) = 0;
+  virtual bool write(const uint8_t* src, size_t len) = 0;
+};
+
+#ifndef ARDUINO
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <vector>
+
+// A tty, or one end of a pty, on the host: tools/pmsync and native tests
+class FdSyncPort : public SyncPort {
+public:
+  explicit FdSyncPort(int fd) : fd(fd) {}
+
+  // Opens path raw, no echo or line editing. -1 on failure.
+  static int openTty(const char* path) {
+    int fd = ::open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+    makeRaw(fd);
+    return fd;
+  }
+
+  static void makeRaw(int fd) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) return;
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN]  = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+
+  size_t read(uint8_t* dst, size_t max) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (::poll(&p, 1, 0) <= 0 || !(p.revents & POLLIN)) return 0;
+    ssize_t n = ::read(fd, dst, max);
+    return n > 0 ? (size_t)n : 0;
+  }
+
+  bool write(const uint8_t* src, size_t len) {
+    while (len > 0) {
+      ssize_t n = ::write(fd, src, len);
+      if (n <= 0) return false;
+      src += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  // Waits up to ms for something to read
+  bool wait(int ms) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    return ::poll(&p, 1, ms) > 0 && (p.revents & POLLIN);
+  }
+
+  int fd;
+};
+
+// The host's end: sends a request and waits for its reply, resending it if
+// none comes. Anything else on the port, like the device's debug prints, is
+// skipped.
+class SyncLink {
+public:
+  explicit SyncLink(FdSyncPort& port, int timeoutMs = 1000, int tries = 4)
+      : port(port), timeoutMs(timeoutMs), tries(tries) {}
+
+  // reply gets the reply's payload, error the message of a SYNC_ERR
+  bool request(uint8_t type, const uint8_t* payload, size_t len, std::vector<uint8_t>* reply) {
+    uint8_t frame[SYNC_FRAME_MAX];
+    size_t frameLen = syncFrame(type, ++seq, payload, (uint16_t)len, frame);
+
+    for (int attempt = 0; attempt < tries; attempt++) {
+      if (attempt > 0) resends++;
+      if (!port.write(frame, frameLen)) {
+        error = "can't write to the port";
+        return false;
+      }
+      wireBytes += frameLen;
+
+      while (port.wait(timeoutMs)) {
+        uint8_t buf[256];
+        size_t n = port.read(buf, sizeof(buf));
+        if (n == 0) {
+          error = "port closed";
+          return false;
+        }
+        for (size_t i = 0; i < n; i++) {
+          if (!in.feed(buf[i]) || in.seq() != seq) continue;
+          wireBytes += SYNC_HEADER + in.length() + 4;
+          if (in.type() == SYNC_ERR) {
+            error = std::string((const char*)in.payload(), in.length());
+            return false;
+          }
+          if (in.type() != (type | SYNC_REPLY)) {
+            error = "unexpected reply";
+            return false;
+          }
+          if (reply) reply->assign(in.payload(), in.payload() + in.length());
+          return true;
+        }
+      }
+    }
+    error = "no reply from the device";
+    return false;
+  }
+
+  std::string error;
+  size_t wireBytes = 0;      // Frames sent and received
+  size_t resends = 0;
+
+private:
+  FdSyncPort& port;
+  SyncParser in;
+  uint8_t seq = (uint8_t)std::random_device()();
+  int timeoutMs;
+  int tries;
+};
+#endif
+
+#endif
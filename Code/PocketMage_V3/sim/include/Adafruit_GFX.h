@@ -0,0 +1,131 @@
+// Adafruit_GFX subset: a 1bpp framebuffer with glyph-width text metrics.
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+typedef struct {
+  uint16_t bitmapOffset;
+  uint8_t width;
+  uint8_t height;
+  uint8_t xAdvance;
+  int8_t xOffset;
+  int8_t yOffset;
+} GFXglyph;
+
+typedef struct {
+  uint8_t *bitmap;
+  GFXglyph *glyph;
+  uint16_t first;
+  uint16_t last;
+  uint8_t yAdvance;
+} GFXfont;
+
+// Host fonts carry only metrics: every glyph advances by a fixed width.
+#define SIM_GFX_FONT(name, advance, yadv)                                         \
+  static GFXglyph name##Glyphs[1] = {{0, advance, (uint8_t)(yadv * 3 / 4), advance, 0, (int8_t)-(yadv * 3 / 4)}}; \
+  const GFXfont name = {nullptr, name##Glyphs, 0x20, 0x7E, yadv};
+
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  void setRotation(uint8_t r) {
+    rotation = r & 3;
+    _width = (rotation & 1) ? HEIGHT : WIDTH;
+    _height = (rotation & 1) ? WIDTH : HEIGHT;
+  }
+  uint8_t getRotation() const { return rotation; }
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  int16_t getCursorX() const { return cursor_x; }
+  int16_t getCursorY() const { return cursor_y; }
+  void setTextColor(uint16_t c) { textcolor = c; }
+  void setTextColor(uint16_t c, uint16_t) { textcolor = c; }
+  void setTextWrap(bool w) { wrap = w; }
+  void setTextSize(uint8_t) {}
+  void setFont(const GFXfont *f) { gfxFont = f; }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, color); }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { for (int16_t i = 0; i < h; i++) drawPixel(x, y + i, color); }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1, dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1, err = dx + dy;
+    for (;;) {
+      drawPixel(x0, y0, color);
+      if (x0 == x1 && y0 == y1) break;
+      int16_t e2 = 2 * err;
+      if (e2 >= dy) { err += dy; x0 += sx; }
+      if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+  }
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    drawFastHLine(x, y, w, color); drawFastHLine(x, y + h - 1, w, color);
+    drawFastVLine(x, y, h, color); drawFastVLine(x + w - 1, y, h, color);
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { for (int16_t j = 0; j < h; j++) drawFastHLine(x, y + j, w, color); }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t, uint16_t color) { drawRect(x, y, w, h, color); }
+  void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t, uint16_t color) { fillRect(x, y, w, h, color); }
+  void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+  void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+    for (int16_t y = -r; y <= r; y++) for (int16_t x = -r; x <= r; x++) {
+      int d = x * x + y * y;
+      if (d <= r * r && d > (r - 1) * (r - 1)) drawPixel(x0 + x, y0 + y, color);
+    }
+  }
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+    for (int16_t y = -r; y <= r; y++) for (int16_t x = -r; x <= r; x++)
+      if (x * x + y * y <= r * r) drawPixel(x0 + x, y0 + y, color);
+  }
+  void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color) {
+    int16_t byteWidth = (w + 7) / 8;
+    for (int16_t j = 0; j < h; j++)
+      for (int16_t i = 0; i < w; i++)
+        if (bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7))) drawPixel(x + i, y + j, color);
+  }
+  void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+    int16_t byteWidth = (w + 7) / 8;
+    for (int16_t j = 0; j < h; j++)
+      for (int16_t i = 0; i < w; i++)
+        drawPixel(x + i, y + j, (bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7))) ? color : bg);
+  }
+
+  void getTextBounds(const char *str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) {
+    uint8_t adv = gfxFont ? gfxFont->glyph[0].xAdvance : 6;
+    uint8_t yadv = gfxFont ? gfxFont->yAdvance : 8;
+    size_t n = strlen(str);
+    *x1 = x;
+    *y1 = gfxFont ? y - yadv * 3 / 4 : y;
+    *w = (uint16_t)(n * adv);
+    *h = n ? (uint16_t)(gfxFont ? yadv * 3 / 4 : 8) : 0;
+  }
+  void getTextBounds(const String &str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) {
+    getTextBounds(str.c_str(), x, y, x1, y1, w, h);
+  }
+
+  // Glyphs are drawn as solid blocks: enough to see layout in snapshots.
+  size_t write(uint8_t c) override {
+    uint8_t adv = gfxFont ? gfxFont->glyph[0].xAdvance : 6;
+    uint8_t yadv = gfxFont ? gfxFont->yAdvance : 8;
+    if (c == '\n') { cursor_x = 0; cursor_y += yadv; return 1; }
+    if (c == '\r') return 1;
+    if (c != ' ') {
+      int16_t gh = gfxFont ? yadv / 2 : 6;
+      int16_t top = gfxFont ? cursor_y - gh : cursor_y + 1;
+      fillRect(cursor_x + 1, top, adv > 2 ? adv - 2 : 1, gh, textcolor);
+    }
+    cursor_x += adv;
+    return 1;
+  }
+  using Print::write;
+
+protected:
+  const int16_t WIDTH, HEIGHT;
+  int16_t _width, _height;
+  int16_t cursor_x = 0, cursor_y = 0;
+  uint16_t textcolor = 0;
+  uint8_t rotation = 0;
+  bool wrap = true;
+  const GFXfont *gfxFont = nullptr;
+};
@@ -0,0 +1,10 @@
+// MPR121 touch controller: the pads touched are whatever the simulator sets.
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+class Adafruit_MPR121 {
+public:
+  bool begin(uint8_t i2caddr = 0x5A, TwoWire *theWire = &Wire) { (void)i2caddr; (void)theWire; return true; }
+  uint16_t touched() { return touchMask; }
+  uint16_t touchMask = 0;
+};
@@ -0,0 +1,49 @@
+// TCA8418 keypad controller: a queue of key events the simulator fills.
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+#include <deque>
+#include "sim.h"
+
+#define TCA8418_DEFAULT_ADDR 0x34
+#define TCA8418_REG_CFG 0x01
+#define TCA8418_REG_INT_STAT 0x02
+#define TCA8418_REG_KEY_LCK_EC 0x03
+
+class Adafruit_TCA8418 {
+public:
+  bool begin(uint8_t address = TCA8418_DEFAULT_ADDR, TwoWire *wire = &Wire) { (void)address; (void)wire; return true; }
+  bool matrix(uint8_t rows, uint8_t columns) { (void)rows; (void)columns; return true; }
+  void flush() { events.clear(); }
+  uint8_t available() { return (uint8_t)std::min<size_t>(events.size(), 10); }
+  uint8_t getEvent() {
+    if (events.empty()) return 0;
+    uint8_t e = events.front();
+    events.pop_front();
+    if (simOnKeyEvent) simOnKeyEvent(e);
+    return e;
+  }
+  void enableInterrupts() { interrupts = true; }
+  void disableInterrupts() { interrupts = false; }
+  // INT_STAT stays set while events are queued, and so does the INT pin
+  uint8_t readRegister(uint8_t reg) {
+    if (reg == TCA8418_REG_KEY_LCK_EC) return available();
+    if (reg == TCA8418_REG_INT_STAT) return events.empty() ? 0 : 1;
+    return 0;
+  }
+  void writeRegister(uint8_t reg, uint8_t value) {
+    if (reg == TCA8418_REG_INT_STAT && (value & 1) && events.empty() && irqPin >= 0) simSetPin(irqPin, HIGH);
+  }
+
+  // Simulator side: key event 0x80 | (row * 10 + column + 1) for a press,
+  // without 0x80 for the release. Pulls INT low.
+  void simPush(uint8_t event) {
+    events.push_back(event);
+    if (interrupts && irqPin >= 0) simSetPin(irqPin, LOW);
+  }
+  bool interrupts = false;
+  int irqPin = -1;
+
+private:
+  std::deque<uint8_t> events;
+};
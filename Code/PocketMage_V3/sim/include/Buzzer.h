@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+#define NOTE_A8 7040
+#define NOTE_B8 7902
+#define NOTE_C8 4186
+#define NOTE_D8 4699
+#define NOTE_E8 5274
+#define NOTE_F8 5588
+#define NOTE_G8 6272
+class Buzzer {
+public:
+  Buzzer(int pin, int ledPin = -1) { (void)pin; (void)ledPin; }
+  void begin(int bpm) { (void)bpm; }
+  void end(int duration) { delay(duration); }
+  void sound(int note, int duration) { (void)note; delay(duration); }
+};
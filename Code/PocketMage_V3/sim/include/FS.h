@@ -0,0 +1,83 @@
+// Arduino FS subset mapped onto a host directory. Work on the card is
+// charged to the clock (sim.h), the flash is taken as free.
+#pragma once
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+
+class File : public Print {
+public:
+  File(FileImplPtr p = FileImplPtr()) : _p(p) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  int available();
+  int read();
+  int peek();
+  void flush() override;
+  size_t read(uint8_t *buf, size_t size);
+  size_t readBytes(char *buffer, size_t length) { return read((uint8_t *)buffer, length); }
+  String readStringUntil(char terminator);
+  String readString();
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  time_t getLastWrite();
+  const char *path() const;
+  const char *name() const;
+  bool isDirectory(void);
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory(void);
+
+private:
+  FileImplPtr _p;
+};
+
+class FS {
+public:
+  FS(std::string hostRoot = "") : root(hostRoot) {}
+  File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+  File open(const String &path, const char *mode = FILE_READ, const bool create = false) { return open(path.c_str(), mode, create); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *pathFrom, const char *pathTo);
+  bool rename(const String &pathFrom, const String &pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+  bool rmdir(const char *path);
+  bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+  void setHostRoot(const std::string &r) { root = r; }
+  const std::string &hostRoot() const { return root; }
+  std::string hostPath(const char *path) const;
+  bool mounted = false;
+  bool card = false;
+
+protected:
+  std::string root;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
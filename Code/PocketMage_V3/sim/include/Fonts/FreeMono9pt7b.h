@@ -0,0 +1,3 @@
+#pragma once
+#include <Adafruit_GFX.h>
+SIM_GFX_FONT(FreeMono9pt7b, 11, 18)
@@ -0,0 +1,3 @@
+#pragma once
+#include <Adafruit_GFX.h>
+SIM_GFX_FONT(FreeSans12pt7b, 12, 29)
@@ -0,0 +1,204 @@
+// GxEPD2 for the host simulator. GxEPD2_BW keeps the buffer and reaches the
+// panel only through its driver, as in GxEPD2 1.6, so the firmware's EinkTap
+// (include/screenTap.h) sits where it does on the device. The driver holds
+// the panel RAM and charges the SPI writes and refresh waits to the clock.
+#pragma once
+#include <Adafruit_GFX.h>
+#include <GxEPD2.h>
+#include <SPI.h>
+#include <vector>
+#include "sim.h"
+
+class GxEPD2_310_GDEQ031T10 {
+public:
+  static const uint16_t WIDTH = 240;
+  static const uint16_t HEIGHT = 320;
+  static const bool hasFastPartialUpdate = true;
+  static volatile bool useFastFullUpdate;
+
+  GxEPD2_310_GDEQ031T10(int16_t cs, int16_t dc, int16_t rst, int16_t busy) : ram(WIDTH * HEIGHT / 8, 0xFF) {
+    (void)cs; (void)dc; (void)rst; (void)busy;
+  }
+
+  void init(uint32_t serial_diag_bitrate = 0) { (void)serial_diag_bitrate; }
+
+  // bitmap is wBitmap wide, 1 = white; x and w go to whole bytes
+  void writeImage(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                  bool invert = false, bool mirror_y = false, bool pgm = false) {
+    writeImagePart(bitmap, 0, 0, w, h, x, y, w, h, invert, mirror_y, pgm);
+  }
+  void writeImageForFullRefresh(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                                bool invert = false, bool mirror_y = false, bool pgm = false) {
+    writeImagePart(bitmap, 0, 0, w, h, x, y, w, h, invert, mirror_y, pgm);
+    spi(rows(w, h));                       // And again to the previous frame RAM
+  }
+  void writeImageAgain(const uint8_t bitmap[], int16_t x, int16_t y, int16_t w, int16_t h,
+                       bool invert = false, bool mirror_y = false, bool pgm = false) {
+    (void)bitmap; (void)x; (void)y; (void)invert; (void)mirror_y; (void)pgm;
+    spi(rows(w, h));
+  }
+  void writeImagePart(const uint8_t bitmap[], int16_t x_part, int16_t y_part, int16_t w_bitmap, int16_t h_bitmap,
+                      int16_t x, int16_t y, int16_t w, int16_t h,
+                      bool invert = false, bool mirror_y = false, bool pgm = false) {
+    (void)pgm;
+    wake();
+    int16_t wbBitmap = (w_bitmap + 7) / 8;
+    x_part -= x_part % 8;
+    x -= x % 8;
+    int16_t wb = (w + 7) / 8;
+    for (int16_t row = 0; row < h; row++) {
+      int16_t py = y + row, by = y_part + row;
+      if (py < 0 || py >= HEIGHT || by < 0 || by >= h_bitmap) continue;
+      if (mirror_y) by = h_bitmap - 1 - by;
+      for (int16_t col = 0; col < wb; col++) {
+        int16_t px = x / 8 + col, bx = x_part / 8 + col;
+        if (px < 0 || px >= WIDTH / 8 || bx >= wbBitmap) continue;
+        uint8_t data = bitmap[by * wbBitmap + bx];
+        ram[py * (WIDTH / 8) + px] = invert ? (uint8_t)~data : data;
+      }
+    }
+    spi(rows(w, h));
+  }
+  void writeImagePartAgain(const uint8_t bitmap[], int16_t x_part, int16_t y_part, int16_t w_bitmap, int16_t h_bitmap,
+                           int16_t x, int16_t y, int16_t w, int16_t h,
+                           bool invert = false, bool mirror_y = false, bool pgm = false) {
+    (void)bitmap; (void)x_part; (void)y_part; (void)w_bitmap; (void)h_bitmap;
+    (void)x; (void)y; (void)invert; (void)mirror_y; (void)pgm;
+    spi(rows(w, h));
+  }
+
+  // The library waits on BUSY with delay(), so a refresh is a sleep
+  void refresh(bool partial_update_mode = false) {
+    wake();
+    uint32_t us = partial_update_mode ? simCosts.einkPartialUs : useFastFullUpdate ? simCosts.einkFastUs : simCosts.einkFullUs;
+    if (partial_update_mode) simStats.einkPartial++;
+    else if (useFastFullUpdate) simStats.einkFast++;
+    else simStats.einkFull++;
+    spi(8);
+    simStats.einkBusyUs += us;
+    simSleep(us);
+    shown = ram;
+    if (simOnEinkRefresh) simOnEinkRefresh(partial_update_mode);
+  }
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h) {
+    (void)x; (void)y; (void)w; (void)h;
+    refresh(true);
+  }
+  void powerOff() {}
+  void hibernate() { asleep = true; }
+
+  // What the panel shows, rows of WIDTH, 1 = white
+  const uint8_t *panel() const { return shown.empty() ? ram.data() : shown.data(); }
+
+private:
+  static uint32_t rows(int16_t w, int16_t h) { return (uint32_t)((w + 7) / 8) * (h > 0 ? h : 0) + 12; }
+  void spi(uint32_t bytes) {
+    simStats.einkSpiBytes += bytes;
+    simSpend(bytes * 8 * 1e6 / simCosts.einkSpiHz);
+  }
+  void wake() {
+    if (!asleep) return;
+    asleep = false;
+    simSleep(simCosts.einkWakeUs);
+  }
+
+  std::vector<uint8_t> ram;
+  std::vector<uint8_t> shown;
+  bool asleep = true;
+};
+
+template <typename GxEPD2_Type, const uint16_t page_height>
+class GxEPD2_BW : public Adafruit_GFX {
+public:
+  GxEPD2_Type epd2;
+  GxEPD2_BW(GxEPD2_Type epd2_instance)
+      : Adafruit_GFX(GxEPD2_Type::WIDTH, GxEPD2_Type::HEIGHT), epd2(epd2_instance),
+        _buffer(GxEPD2_Type::WIDTH * page_height / 8, 0xFF) {
+    setFullWindow();
+  }
+
+  void init(uint32_t serial_diag_bitrate = 0) { epd2.init(serial_diag_bitrate); }
+  void hibernate() { epd2.hibernate(); }
+  void powerOff() { epd2.powerOff(); }
+
+  // Relative to the window, like the library: a pixel outside it is dropped
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (x < 0 || y < 0 || x >= _width || y >= _height) return;
+    switch (rotation) {
+      case 1: std::swap(x, y); x = WIDTH - x - 1; break;
+      case 2: x = WIDTH - x - 1; y = HEIGHT - y - 1; break;
+      case 3: std::swap(x, y); y = HEIGHT - y - 1; break;
+    }
+    x -= _pw_x;
+    y -= _pw_y;
+    if (x < 0 || y < 0 || x >= (int16_t)_pw_w || y >= (int16_t)_pw_h) return;
+    uint32_t i = (uint32_t)x / 8 + (uint32_t)y * (_pw_w / 8);
+    if (color == GxEPD_WHITE) _buffer[i] |= (0x80 >> (x & 7));
+    else _buffer[i] &= ~(0x80 >> (x & 7));
+  }
+  void fillScreen(uint16_t color) { std::fill(_buffer.begin(), _buffer.end(), color == GxEPD_WHITE ? 0xFF : 0x00); }
+
+  void setFullWindow() {
+    _using_partial_mode = false;
+    _pw_x = 0;
+    _pw_y = 0;
+    _pw_w = GxEPD2_Type::WIDTH;
+    _pw_h = GxEPD2_Type::HEIGHT;
+  }
+  void setPartialWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    _pw_x = std::min<int16_t>(x, width());
+    _pw_y = std::min<int16_t>(y, height());
+    _pw_w = std::min<int16_t>(w, width() - _pw_x);
+    _pw_h = std::min<int16_t>(h, height() - _pw_y);
+    _rotate(_pw_x, _pw_y, _pw_w, _pw_h);
+    _using_partial_mode = true;
+    _pw_w += _pw_x % 8;
+    if (_pw_w % 8 > 0) _pw_w += 8 - _pw_w % 8;
+    _pw_x -= _pw_x % 8;
+  }
+  void firstPage() { fillScreen(GxEPD_WHITE); }
+  bool nextPage() {
+    if (_using_partial_mode) {
+      epd2.writeImage(_buffer.data(), _pw_x, _pw_y, _pw_w, _pw_h);
+      epd2.refresh(_pw_x, _pw_y, _pw_w, _pw_h);
+      epd2.writeImageAgain(_buffer.data(), _pw_x, _pw_y, _pw_w, _pw_h);
+    }
+    else {
+      epd2.writeImageForFullRefresh(_buffer.data(), 0, 0, GxEPD2_Type::WIDTH, GxEPD2_Type::HEIGHT);
+      epd2.refresh(false);
+      epd2.writeImageAgain(_buffer.data(), 0, 0, GxEPD2_Type::WIDTH, GxEPD2_Type::HEIGHT);
+      epd2.powerOff();
+    }
+    return false;
+  }
+  void display(bool partial_update_mode = false) {
+    if (partial_update_mode) epd2.writeImage(_buffer.data(), 0, 0, GxEPD2_Type::WIDTH, page_height);
+    else epd2.writeImageForFullRefresh(_buffer.data(), 0, 0, GxEPD2_Type::WIDTH, page_height);
+    epd2.refresh(partial_update_mode);
+    epd2.writeImageAgain(_buffer.data(), 0, 0, GxEPD2_Type::WIDTH, page_height);
+    if (!partial_update_mode) epd2.powerOff();
+  }
+  void displayWindow(int16_t x, int16_t y, int16_t w, int16_t h) {
+    x = std::min<int16_t>(x, width());
+    y = std::min<int16_t>(y, height());
+    w = std::min<int16_t>(w, width() - x);
+    h = std::min<int16_t>(h, height() - y);
+    _rotate(x, y, w, h);
+    epd2.writeImagePart(_buffer.data(), x, y, GxEPD2_Type::WIDTH, page_height, x, y, w, h);
+    epd2.refresh(x, y, w, h);
+    epd2.writeImagePartAgain(_buffer.data(), x, y, GxEPD2_Type::WIDTH, page_height, x, y, w, h);
+  }
+
+private:
+  void _rotate(int16_t &x, int16_t &y, int16_t &w, int16_t &h) {
+    switch (rotation) {
+      case 1: std::swap(x, y); std::swap(w, h); x = WIDTH - x - w; break;
+      case 2: x = WIDTH - x - w; y = HEIGHT - y - h; break;
+      case 3: std::swap(x, y); std::swap(w, h); y = HEIGHT - y - h; break;
+    }
+  }
+
+  std::vector<uint8_t> _buffer;
+  bool _using_partial_mode = false;
+  int16_t _pw_x = 0, _pw_y = 0, _pw_w = 0, _pw_h = 0;
+};
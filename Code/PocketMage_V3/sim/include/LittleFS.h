@@ -0,0 +1,16 @@
+#pragma once
+#include <FS.h>
+
+namespace fs {
+class LittleFSFS : public FS {
+public:
+  LittleFSFS() : FS("") {}
+  bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char *partitionLabel = "spiffs");
+  void end() { mounted = false; }
+  size_t totalBytes() { return 2 * 1024 * 1024; }
+  size_t usedBytes() { return 0; }
+};
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
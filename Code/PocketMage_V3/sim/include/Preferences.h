@@ -0,0 +1,30 @@
+// Preferences backed by an in-memory map (persisted by the simulator if desired).
+#pragma once
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false) { ns = name; (void)readOnly; return true; }
+  void end() {}
+  bool clear() { store().erase(ns); return true; }
+  bool remove(const char *key) { return store()[ns].erase(key) > 0; }
+  bool isKey(const char *key) { return store()[ns].count(key) > 0; }
+  size_t putInt(const char *key, int32_t value) { store()[ns][key] = std::to_string(value); return 4; }
+  size_t putUInt(const char *key, uint32_t value) { store()[ns][key] = std::to_string(value); return 4; }
+  size_t putBool(const char *key, bool value) { store()[ns][key] = value ? "1" : "0"; return 1; }
+  size_t putString(const char *key, const String &value) { store()[ns][key] = value.c_str(); return value.length(); }
+  size_t putString(const char *key, const char *value) { store()[ns][key] = value; return strlen(value); }
+  int32_t getInt(const char *key, int32_t defaultValue = 0) { return isKey(key) ? atol(store()[ns][key].c_str()) : defaultValue; }
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return isKey(key) ? strtoul(store()[ns][key].c_str(), nullptr, 10) : defaultValue; }
+  bool getBool(const char *key, bool defaultValue = false) { return isKey(key) ? store()[ns][key] == "1" : defaultValue; }
+  String getString(const char *key, const String defaultValue = String()) { return isKey(key) ? String(store()[ns][key].c_str()) : defaultValue; }
+
+  static std::map<std::string, std::map<std::string, std::string>> &store() {
+    static std::map<std::string, std::map<std::string, std::string>> s;
+    return s;
+  }
+private:
+  std::string ns;
+};
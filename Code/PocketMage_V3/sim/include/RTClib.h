@@ -0,0 +1,120 @@
+// RTClib subset; the simulated RTC runs off the virtual millis() clock.
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+class TimeSpan {
+public:
+  TimeSpan(int32_t seconds = 0) : _seconds(seconds) {}
+  TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+      : _seconds((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+  int16_t days() const { return _seconds / 86400L; }
+  int8_t hours() const { return _seconds / 3600 % 24; }
+  int8_t minutes() const { return _seconds / 60 % 60; }
+  int8_t seconds() const { return _seconds % 60; }
+  int32_t totalseconds() const { return _seconds; }
+  TimeSpan operator+(const TimeSpan &right) const { return TimeSpan(_seconds + right._seconds); }
+  TimeSpan operator-(const TimeSpan &right) const { return TimeSpan(_seconds - right._seconds); }
+private:
+  int32_t _seconds;
+};
+
+class DateTime {
+public:
+  DateTime(uint32_t t = 946684800) {
+    t -= 946684800;  // seconds since 2000-01-01
+    ss = t % 60; t /= 60;
+    mm = t % 60; t /= 60;
+    hh = t % 24;
+    uint16_t days = t / 24;
+    uint8_t leap;
+    for (yOff = 0;; ++yOff) {
+      leap = yOff % 4 == 0;
+      if (days < 365U + leap) break;
+      days -= 365 + leap;
+    }
+    for (m = 1; m < 12; ++m) {
+      uint8_t dim = daysInMonthTable[m - 1];
+      if (leap && m == 2) ++dim;
+      if (days < dim) break;
+      days -= dim;
+    }
+    d = days + 1;
+  }
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0) {
+    if (year >= 2000U) year -= 2000U;
+    yOff = year; m = month; d = day; hh = hour; mm = min; ss = sec;
+  }
+  DateTime(const char *date, const char *time) {
+    // "Apr 22 2025", "12:34:56"
+    yOff = conv2d(date + 9);
+    switch (date[0]) {
+      case 'J': m = (date[1] == 'a') ? 1 : ((date[2] == 'n') ? 6 : 7); break;
+      case 'F': m = 2; break;
+      case 'A': m = date[2] == 'r' ? 4 : 8; break;
+      case 'M': m = date[2] == 'r' ? 3 : 5; break;
+      case 'S': m = 9; break;
+      case 'O': m = 10; break;
+      case 'N': m = 11; break;
+      case 'D': m = 12; break;
+      default: m = 1;
+    }
+    d = conv2d(date + 4);
+    hh = conv2d(time);
+    mm = conv2d(time + 3);
+    ss = conv2d(time + 6);
+  }
+  DateTime(const __FlashStringHelper *date, const __FlashStringHelper *time)
+      : DateTime(reinterpret_cast<const char *>(date), reinterpret_cast<const char *>(time)) {}
+
+  uint16_t year() const { return 2000U + yOff; }
+  uint8_t month() const { return m; }
+  uint8_t day() const { return d; }
+  uint8_t hour() const { return hh; }
+  uint8_t minute() const { return mm; }
+  uint8_t second() const { return ss; }
+  uint8_t dayOfTheWeek() const { return (date2days() + 6) % 7; }  // Jan 1, 2000 is a Saturday
+  uint32_t unixtime() const { return (uint32_t)date2days() * 86400UL + hh * 3600UL + mm * 60UL + ss + 946684800UL; }
+  uint32_t secondstime() const { return unixtime() - 946684800UL; }
+  bool isValid() const { return m >= 1 && m <= 12 && d >= 1 && d <= 31; }
+
+  DateTime operator+(const TimeSpan &span) const { return DateTime(unixtime() + span.totalseconds()); }
+  DateTime operator-(const TimeSpan &span) const { return DateTime(unixtime() - span.totalseconds()); }
+  TimeSpan operator-(const DateTime &right) const { return TimeSpan((int32_t)(unixtime() - right.unixtime())); }
+  bool operator<(const DateTime &right) const { return unixtime() < right.unixtime(); }
+  bool operator>(const DateTime &right) const { return right < *this; }
+  bool operator==(const DateTime &right) const { return unixtime() == right.unixtime(); }
+  bool operator!=(const DateTime &right) const { return !(*this == right); }
+
+private:
+  static constexpr uint8_t daysInMonthTable[11] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30};
+  static uint8_t conv2d(const char *p) {
+    uint8_t v = 0;
+    if ('0' <= *p && *p <= '9') v = *p - '0';
+    return 10 * v + *++p - '0';
+  }
+  // Day count since 2000-01-01; months past the end roll into the next year.
+  uint32_t date2days() const {
+    uint16_t y = yOff;
+    uint8_t mo = m;
+    while (mo > 12) { mo -= 12; y++; }
+    uint32_t days = d;
+    for (uint8_t i = 1; i < mo; ++i) days += daysInMonthTable[i - 1];
+    if (mo > 2 && y % 4 == 0) ++days;
+    return days + 365 * y + (y + 3) / 4 - 1;
+  }
+  uint8_t yOff, m, d, hh, mm, ss;
+};
+
+class RTC_PCF8563 {
+public:
+  bool begin(TwoWire *wireInstance = &Wire) { (void)wireInstance; return true; }
+  void adjust(const DateTime &dt) { base = dt.unixtime(); baseMillis = millis(); }
+  bool lostPower() { return false; }
+  void start() {}
+  void stop() {}
+  DateTime now() { return DateTime((uint32_t)(base + (millis() - baseMillis) / 1000)); }
+private:
+  uint32_t base = 1745280000UL;  // 2025-04-22 00:00:00
+  unsigned long baseMillis = 0;
+};
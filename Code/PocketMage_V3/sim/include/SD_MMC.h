@@ -0,0 +1,23 @@
+#pragma once
+#include <FS.h>
+#include "driver/sdmmc_types.h"
+
+typedef enum { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+namespace fs {
+class SDMMCFS : public FS {
+public:
+  SDMMCFS() : FS("") { card = true; }
+  bool setPins(int clk, int cmd, int d0) { (void)clk; (void)cmd; (void)d0; return true; }
+  bool begin(const char *mountpoint = "/sdcard", bool mode1bit = false, bool format_if_mount_failed = false,
+             int sdmmc_frequency = 20000, uint8_t maxOpenFiles = 5);
+  void end() { mounted = false; }
+  sdcard_type_t cardType() { return mounted ? CARD_SDHC : CARD_NONE; }
+  uint64_t cardSize() { return 16ULL * 1024 * 1024 * 1024; }
+  uint64_t totalBytes() { return cardSize(); }
+  uint64_t usedBytes() { return 0; }
+  bool present = true;
+};
+}  // namespace fs
+
+extern fs::SDMMCFS SD_MMC;
@@ -0,0 +1,108 @@
+// U8g2 subset for the host simulator: a 1 bit buffer in u8g2's tile order.
+// sendBuffer() charges what the SSD1326 takes at 4 bits a pixel to the clock.
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "sim.h"
+
+// Host fonts are {advance, ascent} pairs.
+#define SIM_U8G2_FONT(name, adv, asc) static const uint8_t name[2] = {adv, asc};
+SIM_U8G2_FONT(u8g2_font_4x6_mf, 4, 5)
+SIM_U8G2_FONT(u8g2_font_4x6_tf, 4, 5)
+SIM_U8G2_FONT(u8g2_font_5x7_tf, 5, 6)
+SIM_U8G2_FONT(u8g2_font_5x7_mf, 5, 6)
+SIM_U8G2_FONT(u8g2_font_u8glib_4_tf, 4, 4)
+SIM_U8G2_FONT(u8g2_font_ncenB08_tr, 6, 8)
+SIM_U8G2_FONT(u8g2_font_ncenB10_tr, 8, 10)
+SIM_U8G2_FONT(u8g2_font_ncenB12_tr, 9, 12)
+SIM_U8G2_FONT(u8g2_font_ncenB14_tr, 11, 14)
+SIM_U8G2_FONT(u8g2_font_ncenB18_tr, 14, 18)
+SIM_U8G2_FONT(u8g2_font_ncenB24_tr, 18, 24)
+
+typedef const void *u8g2_cb_t;
+static const u8g2_cb_t U8G2_R0 = (u8g2_cb_t)0;
+static const u8g2_cb_t U8G2_R2 = (u8g2_cb_t)2;
+#define U8X8_PIN_NONE 255
+
+class U8G2 : public Print {
+public:
+  U8G2(int w, int h) : W(w), H(h), buf(w * h / 8, 0) {}
+  bool begin() { return true; }
+  void setBusClock(uint32_t clock_speed) { busClock = clock_speed; }
+  void setPowerSave(uint8_t is_enable) { powerSave = is_enable; }
+  void setContrast(uint8_t value) { contrast = value; }
+  void clearBuffer() { std::fill(buf.begin(), buf.end(), 0); }
+  void sendBuffer() {
+    uint32_t bytes = W * H / 2 + (H / 8) * 6;   // Pixels, and a window per tile row
+    simStats.oledFrames++;
+    simStats.oledSpiBytes += bytes;
+    simSpend(bytes * 8 * 1e6 / busClock);
+    if (simOnOledFrame) simOnOledFrame();
+  }
+  uint8_t *getBufferPtr() { return buf.data(); }
+  uint16_t getDisplayWidth() const { return W; }
+  uint16_t getDisplayHeight() const { return H; }
+
+  void setFont(const uint8_t *f) { font = f; }
+  void setDrawColor(uint8_t c) { color = c; }
+  int8_t getAscent() const { return font ? font[1] : 8; }
+  int8_t getMaxCharHeight() const { return font ? font[1] + 2 : 10; }
+  uint16_t getStrWidth(const char *s) const { return (uint16_t)(strlen(s) * (font ? font[0] : 6)); }
+  uint16_t getUTF8Width(const char *s) const { return getStrWidth(s); }
+
+  void drawPixel(int x, int y) {
+    if (x < 0 || y < 0 || x >= W || y >= H) return;
+    uint8_t &b = buf[(y / 8) * W + x];
+    if (color == 1) b |= (1 << (y & 7));
+    else if (color == 0) b &= ~(1 << (y & 7));
+    else b ^= (1 << (y & 7));
+  }
+  void drawHLine(int x, int y, int w) { for (int i = 0; i < w; i++) drawPixel(x + i, y); }
+  void drawVLine(int x, int y, int h) { for (int i = 0; i < h; i++) drawPixel(x, y + i); }
+  void drawLine(int x0, int y0, int x1, int y1) {
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1, dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1, err = dx + dy;
+    for (;;) {
+      drawPixel(x0, y0);
+      if (x0 == x1 && y0 == y1) break;
+      int e2 = 2 * err;
+      if (e2 >= dy) { err += dy; x0 += sx; }
+      if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+  }
+  void drawBox(int x, int y, int w, int h) { for (int j = 0; j < h; j++) drawHLine(x, y + j, w); }
+  void drawFrame(int x, int y, int w, int h) { drawHLine(x, y, w); drawHLine(x, y + h - 1, w); drawVLine(x, y, h); drawVLine(x + w - 1, y, h); }
+  void drawXBMP(int x, int y, int w, int h, const uint8_t *bitmap) {
+    int bw = (w + 7) / 8;
+    for (int j = 0; j < h; j++)
+      for (int i = 0; i < w; i++)
+        if (bitmap[j * bw + i / 8] & (1 << (i & 7))) drawPixel(x + i, y + j);
+  }
+  // Glyphs are drawn as solid blocks sitting on the baseline.
+  int drawStr(int x, int y, const char *s) {
+    int adv = font ? font[0] : 6, asc = font ? font[1] : 8;
+    for (const char *p = s; *p; p++, x += adv)
+      if (*p != ' ') drawBox(x + 1, y - asc / 2, adv > 2 ? adv - 2 : 1, asc / 2);
+    return (int)strlen(s) * adv;
+  }
+  int drawUTF8(int x, int y, const char *s) { return drawStr(x, y, s); }
+  void setCursor(int x, int y) { cx = x; cy = y; }
+  size_t write(uint8_t c) override { char s[2] = {(char)c, 0}; cx += drawStr(cx, cy, s); return 1; }
+  using Print::write;
+
+  uint8_t powerSave = 0;
+  uint32_t busClock = 1000000;
+  uint8_t contrast = 255;
+
+private:
+  int W, H;
+  std::vector<uint8_t> buf;
+  const uint8_t *font = nullptr;
+  uint8_t color = 1;
+  int cx = 0, cy = 0;
+};
+
+class U8G2_SSD1326_ER_256X32_F_4W_HW_SPI : public U8G2 {
+public:
+  U8G2_SSD1326_ER_256X32_F_4W_HW_SPI(u8g2_cb_t rotation, uint8_t cs, uint8_t dc, uint8_t reset = U8X8_PIN_NONE)
+      : U8G2(256, 32) { (void)rotation; (void)cs; (void)dc; (void)reset; }
+};
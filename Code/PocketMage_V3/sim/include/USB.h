@@ -0,0 +1,28 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_event.h>
+
+extern esp_event_base_t ARDUINO_USB_EVENTS;
+typedef enum {
+  ARDUINO_USB_ANY_EVENT = -1,
+  ARDUINO_USB_STARTED_EVENT = 0,
+  ARDUINO_USB_STOPPED_EVENT,
+  ARDUINO_USB_SUSPEND_EVENT,
+  ARDUINO_USB_RESUME_EVENT,
+  ARDUINO_USB_MAX_EVENT,
+} arduino_usb_event_t;
+
+typedef union {
+  struct { bool remote_wakeup_en; } suspend;
+} arduino_usb_event_data_t;
+
+class ESPUSB {
+public:
+  bool begin() { started = true; return true; }
+  void onEvent(esp_event_handler_t callback) { handler = callback; }
+  void onEvent(arduino_usb_event_t event, esp_event_handler_t callback) { (void)event; handler = callback; }
+  operator bool() const { return started; }
+  bool started = false;
+  esp_event_handler_t handler = nullptr;
+};
+extern ESPUSB USB;
@@ -0,0 +1,28 @@
+#pragma once
+#include <Arduino.h>
+
+typedef int32_t (*msc_read_cb)(uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize);
+typedef int32_t (*msc_write_cb)(uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize);
+typedef bool (*msc_start_stop_cb)(uint8_t power_condition, bool start, bool load_eject);
+
+// The simulator plays the USB host by calling the registered callbacks.
+class USBMSC {
+public:
+  bool begin(uint32_t block_count, uint16_t block_size) { blocks = block_count; blockSize = block_size; running = true; return true; }
+  void end() { running = false; }
+  void vendorID(const char *vid) { (void)vid; }
+  void productID(const char *pid) { (void)pid; }
+  void productRevision(const char *ver) { (void)ver; }
+  void mediaPresent(bool media_present) { present = media_present; }
+  void onStartStop(msc_start_stop_cb cb) { startStopCb = cb; }
+  void onRead(msc_read_cb cb) { readCb = cb; }
+  void onWrite(msc_write_cb cb) { writeCb = cb; }
+
+  msc_read_cb readCb = nullptr;
+  msc_write_cb writeCb = nullptr;
+  msc_start_stop_cb startStopCb = nullptr;
+  uint32_t blocks = 0;
+  uint16_t blockSize = 0;
+  bool present = false;
+  bool running = false;
+};
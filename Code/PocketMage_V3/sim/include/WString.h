@@ -0,0 +1,154 @@
+// Arduino String implementation for the host simulator.
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String {
+public:
+  String() {}
+  String(const char *cstr) : s_(cstr ? cstr : "") {}
+  String(const String &str) = default;
+  String(String &&str) = default;
+  String(const __FlashStringHelper *str) : s_(reinterpret_cast<const char *>(str)) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10) : s_(fmt((unsigned long)value, base)) {}
+  explicit String(int value, unsigned char base = 10) : s_(base == 10 ? std::to_string(value) : fmt((unsigned long)(unsigned)value, base)) {}
+  explicit String(unsigned int value, unsigned char base = 10) : s_(fmt((unsigned long)value, base)) {}
+  explicit String(long value, unsigned char base = 10) : s_(base == 10 ? std::to_string(value) : fmt((unsigned long)value, base)) {}
+  explicit String(unsigned long value, unsigned char base = 10) : s_(fmt(value, base)) {}
+  explicit String(long long value) : s_(std::to_string(value)) {}
+  explicit String(unsigned long long value) : s_(std::to_string(value)) {}
+  explicit String(float value, unsigned char decimalPlaces = 2) : s_(fmtf(value, decimalPlaces)) {}
+  explicit String(double value, unsigned char decimalPlaces = 2) : s_(fmtf(value, decimalPlaces)) {}
+
+  String &operator=(const String &rhs) = default;
+  String &operator=(String &&rhs) = default;
+  String &operator=(const char *cstr) { s_ = cstr ? cstr : ""; return *this; }
+
+  bool reserve(unsigned int size) { s_.reserve(size); return true; }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  const char *c_str() const { return s_.c_str(); }
+
+  bool concat(const String &str) { s_ += str.s_; return true; }
+  bool concat(const char *cstr) { if (cstr) s_ += cstr; return true; }
+  bool concat(char c) { s_ += c; return true; }
+  bool concat(unsigned char num) { s_ += std::to_string(num); return true; }
+  bool concat(int num) { s_ += std::to_string(num); return true; }
+  bool concat(unsigned int num) { s_ += std::to_string(num); return true; }
+  bool concat(long num) { s_ += std::to_string(num); return true; }
+  bool concat(unsigned long num) { s_ += std::to_string(num); return true; }
+  bool concat(long long num) { s_ += std::to_string(num); return true; }
+  bool concat(unsigned long long num) { s_ += std::to_string(num); return true; }
+  bool concat(float num) { s_ += fmtf(num, 2); return true; }
+  bool concat(double num) { s_ += fmtf(num, 2); return true; }
+
+  template <typename T> String &operator+=(const T &rhs) { concat(rhs); return *this; }
+
+  int compareTo(const String &s) const { return s_.compare(s.s_); }
+  bool equals(const String &s) const { return s_ == s.s_; }
+  bool equals(const char *cstr) const { return s_ == (cstr ? cstr : ""); }
+  bool operator==(const String &rhs) const { return s_ == rhs.s_; }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return s_ != rhs.s_; }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &rhs) const { return s_ < rhs.s_; }
+  bool operator>(const String &rhs) const { return s_ > rhs.s_; }
+  bool operator<=(const String &rhs) const { return s_ <= rhs.s_; }
+  bool operator>=(const String &rhs) const { return s_ >= rhs.s_; }
+  bool equalsIgnoreCase(const String &s) const {
+    if (s_.size() != s.s_.size()) return false;
+    for (size_t i = 0; i < s_.size(); i++) if (tolower((unsigned char)s_[i]) != tolower((unsigned char)s.s_[i])) return false;
+    return true;
+  }
+  bool startsWith(const String &prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0 && s_.size() >= prefix.s_.size(); }
+  bool startsWith(const String &prefix, unsigned int offset) const { return offset <= s_.size() && s_.compare(offset, prefix.s_.size(), prefix.s_) == 0 && s_.size() - offset >= prefix.s_.size(); }
+  bool endsWith(const String &suffix) const { return s_.size() >= suffix.s_.size() && s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0; }
+
+  char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+  void setCharAt(unsigned int index, char c) { if (index < s_.size()) s_[index] = c; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { static char dummy; if (index >= s_.size()) { dummy = 0; return dummy; } return s_[index]; }
+  void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const { toCharArray((char *)buf, bufsize, index); }
+  void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const {
+    if (!bufsize || !buf) return;
+    if (index >= s_.size()) { buf[0] = 0; return; }
+    size_t n = std::min<size_t>(bufsize - 1, s_.size() - index);
+    memcpy(buf, s_.data() + index, n); buf[n] = 0;
+  }
+  const char *begin() const { return s_.data(); }
+  const char *end() const { return s_.data() + s_.size(); }
+
+  int indexOf(char ch) const { return indexOf(ch, 0); }
+  int indexOf(char ch, unsigned int fromIndex) const { size_t p = s_.find(ch, fromIndex); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String &str) const { return indexOf(str, 0); }
+  int indexOf(const String &str, unsigned int fromIndex) const { size_t p = s_.find(str.s_, fromIndex); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(char ch) const { size_t p = s_.rfind(ch); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(char ch, unsigned int fromIndex) const { size_t p = s_.rfind(ch, fromIndex); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(const String &str) const { size_t p = s_.rfind(str.s_); return p == std::string::npos ? -1 : (int)p; }
+
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, length()); }
+  String substring(unsigned int left, unsigned int right) const {
+    if (left > right) std::swap(left, right);
+    if (left >= s_.size()) return String();
+    if (right > s_.size()) right = (unsigned int)s_.size();
+    return String(s_.substr(left, right - left).c_str());
+  }
+
+  void replace(char find, char replace) { for (auto &c : s_) if (c == find) c = replace; }
+  void replace(const String &find, const String &replace) {
+    if (find.s_.empty()) return;
+    size_t pos = 0;
+    while ((pos = s_.find(find.s_, pos)) != std::string::npos) { s_.replace(pos, find.s_.size(), replace.s_); pos += replace.s_.size(); }
+  }
+  void remove(unsigned int index) { if (index < s_.size()) s_.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s_.size()) s_.erase(index, count); }
+  void toLowerCase() { for (auto &c : s_) c = (char)tolower((unsigned char)c); }
+  void toUpperCase() { for (auto &c : s_) c = (char)toupper((unsigned char)c); }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\n\r\f\v");
+    if (a == std::string::npos) { s_.clear(); return; }
+    size_t b = s_.find_last_not_of(" \t\n\r\f\v");
+    s_ = s_.substr(a, b - a + 1);
+  }
+  long toInt() const { return atol(s_.c_str()); }
+  float toFloat() const { return (float)atof(s_.c_str()); }
+  double toDouble() const { return atof(s_.c_str()); }
+
+  const std::string &std_str() const { return s_; }
+
+private:
+  static std::string fmt(unsigned long v, unsigned char base) {
+    if (base < 2) base = 10;
+    if (v == 0) return "0";
+    std::string out;
+    while (v) { int d = v % base; out += (char)(d < 10 ? '0' + d : 'a' + d - 10); v /= base; }
+    std::reverse(out.begin(), out.end());
+    return out;
+  }
+  static std::string fmtf(double v, unsigned char places) {
+    char buf[64]; snprintf(buf, sizeof(buf), "%.*f", (int)places, v); return buf;
+  }
+  std::string s_;
+};
+
+inline String operator+(const String &lhs, const String &rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, const char *rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const char *lhs, const String &rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, char rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(char lhs, const String &rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, int rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, unsigned int rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, long rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, unsigned long rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, float rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const String &lhs, double rhs) { String r(lhs); r.concat(rhs); return r; }
+inline bool operator==(const char *lhs, const String &rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char *lhs, const String &rhs) { return !rhs.equals(lhs); }
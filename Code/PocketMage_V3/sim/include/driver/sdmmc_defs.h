@@ -0,0 +1,2 @@
+#pragma once
+#include "sdmmc_types.h"
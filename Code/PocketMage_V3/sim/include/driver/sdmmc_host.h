@@ -0,0 +1,5 @@
+#pragma once
+#include "sdmmc_types.h"
+esp_err_t sdmmc_host_init(void);
+esp_err_t sdmmc_host_init_slot(int slot, const sdmmc_slot_config_t *slot_config);
+esp_err_t sdmmc_host_deinit(void);
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include "esp_system_sim.h"
+
+typedef struct {
+  int capacity;
+  int sector_size;
+  int read_block_len;
+} sdmmc_csd_t;
+
+typedef struct {
+  int slot;
+  int max_freq_khz;
+} sdmmc_host_t;
+
+typedef struct {
+  gpio_num_t clk, cmd, d0, d1, d2, d3, d4, d5, d6, d7, cd, wp;
+  uint8_t width;
+  uint32_t flags;
+} sdmmc_slot_config_t;
+
+typedef struct {
+  sdmmc_host_t host;
+  sdmmc_csd_t csd;
+  uint32_t ocr;
+} sdmmc_card_t;
+
+#define SDMMC_HOST_SLOT_0 0
+#define SDMMC_HOST_SLOT_1 1
+#define SDMMC_HOST_DEFAULT() sdmmc_host_t{SDMMC_HOST_SLOT_1, 20000}
+#define SDMMC_SLOT_CONFIG_DEFAULT() sdmmc_slot_config_t{}
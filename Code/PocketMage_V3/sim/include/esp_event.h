@@ -0,0 +1,4 @@
+#pragma once
+#include <cstdint>
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
@@ -0,0 +1,31 @@
+// Mutexes for cooperative tasks: a task that finds one taken sleeps a tick
+// and looks again, so the holder gets to run and give it back.
+#pragma once
+#include "FreeRTOS.h"
+#include "sim.h"
+
+struct SimMutex {
+  void *owner = nullptr;
+  int depth = 0;
+};
+typedef SimMutex *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new SimMutex(); }
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new SimMutex(); }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  for (TickType_t waited = 0; s->owner && s->owner != simTaskSelf(); waited++) {
+    if (ticks != portMAX_DELAY && waited >= ticks) return pdFALSE;
+    simSleep(portTICK_PERIOD_MS * 1000);
+  }
+  s->owner = simTaskSelf();
+  s->depth++;
+  return pdTRUE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  if (s->owner != simTaskSelf() || s->depth == 0) return pdFALSE;
+  if (--s->depth == 0) s->owner = nullptr;
+  return pdTRUE;
+}
+#define xSemaphoreTakeRecursive xSemaphoreTake
+#define xSemaphoreGiveRecursive xSemaphoreGive
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
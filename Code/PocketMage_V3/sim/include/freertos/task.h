@@ -0,0 +1,10 @@
+#pragma once
+#include "FreeRTOS.h"
+typedef void (*TaskFunction_t)(void *);
+typedef struct SimTask *TaskHandle_t;
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *param,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t handle);
+void vTaskSuspend(TaskHandle_t handle);
+void vTaskResume(TaskHandle_t handle);
@@ -0,0 +1,77 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// SIMULATOR
+// The firmware built for the host (env:sim) against the headers in this
+// folder. Time is virtual: it only moves when a task sleeps, waits on a
+// device or reads the clock, so a run is the same every time. The tasks are
+// cooperative (sim/src/simCore.cpp): loop() on one, einkHandler on another,
+// the replay script on a third, like the two cores plus a typist.
+
+// What the devices cost, in microseconds unless named otherwise. The panel
+// times are guesses for the GDEQ031T10 and the e-ink bus rate is the
+// library's; the OLED runs at what the firmware passes to setBusClock().
+// Change them with --cost name=value.
+struct SimCosts {
+  uint32_t einkSpiHz       = 4000000;   // GxEPD2's SPISettings
+  uint32_t einkFullUs      = 2000000;   // Slow full refresh
+  uint32_t einkFastUs      = 1000000;   // useFastFullUpdate
+  uint32_t einkPartialUs   = 400000;
+  uint32_t einkWakeUs      = 20000;     // Reset and init after hibernate()
+  uint32_t sdOpenUs        = 1000;      // Open, close, exists, mkdir
+  uint32_t sdSectorUs      = 250;       // Each 512 bytes read or written
+  uint32_t sdMetaUs        = 3000;      // Remove, rename
+  uint32_t clockReadUs     = 1;         // millis(), micros(), so spins move time
+};
+extern SimCosts simCosts;
+bool simSetCost(const std::string& name, uint32_t value);
+
+// Counters, all since the start of the run
+struct SimStats {
+  uint32_t einkFull = 0;
+  uint32_t einkFast = 0;
+  uint32_t einkPartial = 0;
+  uint64_t einkBusyUs = 0;              // Refreshing, not counting the writes
+  uint64_t einkSpiBytes = 0;
+  uint32_t oledFrames = 0;
+  uint64_t oledSpiBytes = 0;
+  uint32_t sdOps = 0;                   // Opens, removes, renames, mkdirs
+  uint64_t sdBytesRead = 0;
+  uint64_t sdBytesWritten = 0;
+  uint64_t sdBusyUs = 0;
+};
+extern SimStats simStats;
+
+// Called when the firmware reads a key event off the keypad, after the panel
+// finished a refresh and after an OLED frame went out
+extern void (*simOnKeyEvent)(uint8_t event);
+extern void (*simOnEinkRefresh)(bool partial);
+extern void (*simOnOledFrame)();
+
+// CLOCK AND TASKS
+uint64_t simNow();
+void simSleep(uint64_t us);                     // The calling task waits
+void simSpend(double us);                       // Busy for us, fractions add up
+typedef void (*SimTaskFn)(void*);
+void* simSpawn(SimTaskFn fn, void* param, const char* name);
+void* simTaskSelf();
+void simRun();                                  // Until simStop() or no task is left
+void simStop(const char* why);
+const char* simStopReason();
+void simRealTime(bool on);                      // Keep virtual time behind the wall clock
+
+// PINS
+void simSetPin(uint8_t pin, int level);         // Fires what attachInterrupt() set up
+
+// SERIAL: printed to log, and read from and written to fd when it is set
+void simSerialLog(FILE* log);
+void simSerialFd(int fd);
+
+// STORAGE
+void simStorage(const std::string& card, const std::string& flash, const std::string& dict);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SIMREPLAY_H
+#define SIMREPLAY_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sim.h"
+
+// KEYSTROKE REPLAY
+// Scripts for the simulator take tools/pmremote's commands, one a line,
+// plus some of their own:
+//   type <text>              Characters, typed on the keypad. Shift and FN
+//                            are pressed first when the key is on a layer
+//                            the firmware isn't in. \r \n \b \t \\ \xNN
+//   key <n> [n...]           Keys by number, row * 10 + column
+//   wait <ms>
+//   pace <ms>                From one key press to the next, 150 at first
+//   touch <mask>             Pads held on the slider, 0 lets go
+//   power                    Presses the power button
+//   snap eink|oled <file>    The screen as the user sees it, as a PBM
+//   stats [reset]            Prints the counters of sim.h
+// Blank lines and lines starting with # are skipped.
+
+struct SimCommand {
+  enum Kind { TYPE, KEY, WAIT, PACE, TOUCH, POWER, SNAP, STATS } kind;
+  int line;
+  std::string text;          // TYPE: the characters, SNAP: the file
+  std::vector<int> keys;     // KEY
+  uint32_t value;            // WAIT, PACE: ms, TOUCH: mask, SNAP: screen, STATS: reset
+};
+
+// False with error set, naming the line, on the first bad one
+bool simParseScript(std::istream& in, std::vector<SimCommand>& commands, std::string& error);
+
+// A key press and what came of it. Times are from the start of the run, 0
+// for never. The counters are where sim.h's stood at the press, so the
+// press's own share is up to the next one's.
+struct SimKeystroke {
+  std::string label;
+  uint64_t at = 0;
+  uint64_t taken = 0;        // The firmware read the press off the keypad
+  uint64_t oled = 0;         // Then the first OLED frame went out
+  uint64_t eink = 0;         // ... and the first e-ink refresh finished
+  SimStats before;
+};
+
+extern std::vector<SimKeystroke> simKeys;
+extern uint64_t simBooted;   // setup() returned
+
+// Boots the firmware and runs commands, stats going to out. False if a
+// command failed, with error set.
+bool simReplay(const std::vector<SimCommand>& commands, std::ostream& out, std::string& error);
+
+// Boots the firmware with nothing to type, for a serial port
+void simServe();
+
+// A line per key press, then totals
+void simReport(std::ostream& out);
+
+#endif
@@ -0,0 +1,552 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <SD_MMC.h>
+#include <LittleFS.h>
+#include <USB.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <GxEPD2_BW.h>
+#include "freertos/task.h"
+#include "sdmmc_cmd.h"
+#include "driver/sdmmc_host.h"
+#include "esp_partition.h"
+#include "sim.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+// SIMULATOR RUNTIME
+// The Arduino, FreeRTOS and ESP-IDF calls the firmware makes, for the host.
+// Tasks are coroutines with a wake time each. The one due first runs until
+// it waits (delay(), a refresh, the card, a clock read), which moves the
+// clock to the next task's wake time. Nothing here looks at the wall clock
+// unless simRealTime() asks for it, so a run replays exactly.
+
+namespace stdfs = std::filesystem;
+
+SimCosts simCosts;
+SimStats simStats;
+void (*simOnKeyEvent)(uint8_t) = nullptr;
+void (*simOnEinkRefresh)(bool) = nullptr;
+void (*simOnOledFrame)() = nullptr;
+
+bool simSetCost(const std::string& name, uint32_t value) {
+  struct { const char* name; uint32_t* cost; } costs[] = {
+    {"einkSpiHz", &simCosts.einkSpiHz},   {"einkFullUs", &simCosts.einkFullUs},
+    {"einkFastUs", &simCosts.einkFastUs}, {"einkPartialUs", &simCosts.einkPartialUs},
+    {"einkWakeUs", &simCosts.einkWakeUs}, {"sdOpenUs", &simCosts.sdOpenUs},
+    {"sdSectorUs", &simCosts.sdSectorUs}, {"sdMetaUs", &simCosts.sdMetaUs},
+    {"clockReadUs", &simCosts.clockReadUs},
+  };
+  for (auto& c : costs) {
+    if (name != c.name) continue;
+    if (value == 0 && c.cost == &simCosts.einkSpiHz) return false;
+    *c.cost = value;
+    return true;
+  }
+  return false;
+}
+
+// TASKS
+struct SimTask {
+  ucontext_t  ctx;
+  std::vector<char> stack;
+  SimTaskFn   fn;
+  void*       param;
+  std::string name;
+  uint64_t    wake = 0;
+  double      owed = 0;          // Busy time under a microsecond, not charged yet
+  bool        alive = true;
+  bool        suspended = false;
+};
+
+static const size_t SIM_STACK = 1024 * 1024;
+static std::vector<SimTask*> simTasks;
+static SimTask*    simCurrent = nullptr;  // Null on the host's own stack
+static ucontext_t  simHost;
+static uint64_t    simClock = 0;
+static double      simHostOwed = 0;
+static const char* simStopped = nullptr;
+static bool        simWall = false;
+static struct timespec simWallStart;
+
+static void simAdvance(uint64_t to) {
+  if (to <= simClock) return;
+  simClock = to;
+  if (!simWall) return;
+  struct timespec at = simWallStart;
+  at.tv_sec += to / 1000000;
+  at.tv_nsec += (to % 1000000) * 1000;
+  if (at.tv_nsec >= 1000000000) {
+    at.tv_sec++;
+    at.tv_nsec -= 1000000000;
+  }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, nullptr) == EINTR);
+}
+
+// The task due first, the one made first on a tie
+static SimTask* simNext() {
+  SimTask* next = nullptr;
+  for (SimTask* t : simTasks) {
+    if (!t->alive || t->suspended) continue;
+    if (!next || t->wake < next->wake) next = t;
+  }
+  return next;
+}
+
+static void simSwitch() {
+  SimTask* from = simCurrent;
+  SimTask* to = simStopped ? nullptr : simNext();
+  if (to) simAdvance(to->wake);
+  if (to == from) return;
+  simCurrent = to;
+  swapcontext(from ? &from->ctx : &simHost, to ? &to->ctx : &simHost);
+}
+
+static void simEntry() {
+  SimTask* self = simCurrent;
+  self->fn(self->param);
+  self->alive = false;
+  simSwitch();
+}
+
+void* simSpawn(SimTaskFn fn, void* param, const char* name) {
+  SimTask* t = new SimTask();
+  t->stack.resize(SIM_STACK);
+  t->fn = fn;
+  t->param = param;
+  t->name = name ? name : "";
+  t->wake = simClock;
+  getcontext(&t->ctx);
+  t->ctx.uc_stack.ss_sp = t->stack.data();
+  t->ctx.uc_stack.ss_size = t->stack.size();
+  t->ctx.uc_link = nullptr;
+  makecontext(&t->ctx, simEntry, 0);
+  simTasks.push_back(t);
+  return t;
+}
+
+void* simTaskSelf() { return simCurrent; }
+
+void simRun() {
+  if (!simCurrent) simSwitch();
+}
+
+void simStop(const char* why) {
+  if (!simStopped) simStopped = why;
+  if (simCurrent) simSwitch();
+}
+
+const char* simStopReason() { return simStopped; }
+
+void simRealTime(bool on) {
+  simWall = on;
+  clock_gettime(CLOCK_MONOTONIC, &simWallStart);
+  simWallStart.tv_sec -= simClock / 1000000;
+  simWallStart.tv_nsec -= (simClock % 1000000) * 1000;
+  if (simWallStart.tv_nsec < 0) {
+    simWallStart.tv_sec--;
+    simWallStart.tv_nsec += 1000000000;
+  }
+}
+
+// CLOCK
+uint64_t simNow() { return simClock; }
+
+void simSleep(uint64_t us) {
+  if (!simCurrent) {
+    simAdvance(simClock + us);
+    return;
+  }
+  simCurrent->wake = simClock + us;
+  simSwitch();
+}
+
+void simSpend(double us) {
+  double& owed = simCurrent ? simCurrent->owed : simHostOwed;
+  owed += us;
+  if (owed < 1) return;
+  uint64_t whole = (uint64_t)owed;
+  owed -= whole;
+  simSleep(whole);
+}
+
+unsigned long millis() {
+  simSpend(simCosts.clockReadUs);
+  return (unsigned long)(simClock / 1000);
+}
+unsigned long micros() {
+  simSpend(simCosts.clockReadUs);
+  return (unsigned long)simClock;
+}
+void delay(uint32_t ms) { simSleep((uint64_t)ms * 1000); }
+void delayMicroseconds(uint32_t us) { simSleep(us); }
+void yield() { simSleep(0); }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t, void *param, UBaseType_t, TaskHandle_t *handle, BaseType_t) {
+  void* t = simSpawn(fn, param, name);
+  if (handle) *handle = (TaskHandle_t)t;
+  return pdPASS;
+}
+void vTaskDelay(TickType_t ticks) { simSleep((uint64_t)ticks * portTICK_PERIOD_MS * 1000); }
+void vTaskDelete(TaskHandle_t handle) {
+  SimTask* t = handle ? handle : simCurrent;
+  if (!t) return;
+  t->alive = false;
+  if (t == simCurrent) simSwitch();
+}
+void vTaskSuspend(TaskHandle_t handle) {
+  SimTask* t = handle ? handle : simCurrent;
+  if (!t) return;
+  t->suspended = true;
+  if (t == simCurrent) simSwitch();
+}
+void vTaskResume(TaskHandle_t handle) {
+  if (handle) handle->suspended = false;
+}
+
+// PINS
+static int  simPins[64];
+static void (*simIsr[64])(void);
+static int  simIsrMode[64];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < 64 && mode == INPUT_PULLUP) simPins[pin] = HIGH;
+}
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < 64) simPins[pin] = val;
+}
+int digitalRead(uint8_t pin) { return pin < 64 ? simPins[pin] : 0; }
+uint16_t analogRead(uint8_t) { return 2400; }       // About 4.07 V on BAT_SENS
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (pin >= 64) return;
+  simIsr[pin] = handler;
+  simIsrMode[pin] = mode;
+}
+void detachInterrupt(uint8_t pin) {
+  if (pin < 64) simIsr[pin] = nullptr;
+}
+
+void simSetPin(uint8_t pin, int level) {
+  if (pin >= 64) return;
+  int was = simPins[pin];
+  simPins[pin] = level;
+  if (!simIsr[pin] || was == level) return;
+  int mode = simIsrMode[pin];
+  if (mode == CHANGE || (mode == FALLING && !level) || (mode == RISING && level)) simIsr[pin]();
+}
+
+// SYSTEM
+static std::mt19937 simRng(1);
+long random(long max) { return max > 0 ? (long)(simRng() % (unsigned long)max) : 0; }
+long random(long min, long max) { return max > min ? min + random(max - min) : min; }
+void randomSeed(unsigned long seed) { simRng.seed(seed); }
+uint32_t esp_random(void) { return simRng(); }
+
+static uint32_t simCpuMhz = 240;
+bool setCpuFrequencyMhz(uint32_t mhz) { simCpuMhz = mhz; return true; }
+uint32_t getCpuFrequencyMhz() { return simCpuMhz; }
+
+const char *esp_err_to_name(esp_err_t code) { return code == ESP_OK ? "ESP_OK" : "ESP_FAIL"; }
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t, int) { return ESP_OK; }
+void esp_deep_sleep_start(void) {
+  simStop("deep sleep");
+  abort();                                          // Only reached from the host's stack
+}
+void esp_restart(void) {
+  simStop("restart");
+  abort();
+}
+
+// SERIAL
+static FILE* simLog = nullptr;
+static int   simSerial = -1;
+
+void simSerialLog(FILE* log) { simLog = log; }
+void simSerialFd(int fd) { simSerial = fd; }
+
+HardwareSerial Serial;
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+size_t HardwareSerial::write(const uint8_t *b, size_t n) {
+  if (simLog) fwrite(b, 1, n, simLog);
+  // Dropped when nothing reads it, like the USB port without a host
+  for (size_t done = 0; simSerial >= 0 && done < n;) {
+    ssize_t w = ::write(simSerial, b + done, n - done);
+    if (w <= 0) break;
+    done += w;
+  }
+  return n;
+}
+void HardwareSerial::flush() {
+  if (simLog) fflush(simLog);
+}
+
+static std::vector<uint8_t> simSerialIn;
+
+static void simSerialFill() {
+  if (simSerial < 0) return;
+  uint8_t buf[512];
+  ssize_t n = ::read(simSerial, buf, sizeof(buf));
+  if (n > 0) simSerialIn.insert(simSerialIn.end(), buf, buf + n);
+}
+int HardwareSerial::available() {
+  simSerialFill();
+  return (int)simSerialIn.size();
+}
+int HardwareSerial::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+size_t HardwareSerial::read(uint8_t* buffer, size_t size) {
+  if (simSerialIn.empty()) simSerialFill();
+  size_t n = std::min(size, simSerialIn.size());
+  memcpy(buffer, simSerialIn.data(), n);
+  simSerialIn.erase(simSerialIn.begin(), simSerialIn.begin() + n);
+  return n;
+}
+
+TwoWire Wire;
+SPIClass SPI;
+
+// USB
+esp_event_base_t ARDUINO_USB_EVENTS = "ARDUINO_USB_EVENTS";
+ESPUSB USB;
+
+// FILESYSTEM
+// The card's time is charged to the task using it: a fixed cost to find a
+// file, then a share of a sector's for each byte moved.
+static void simCardOp(const fs::FS* fs, uint32_t us) {
+  if (!fs->card) return;
+  simStats.sdOps++;
+  simStats.sdBusyUs += us;
+  simSleep(us);
+}
+
+static void simCardBytes(const fs::FS* fs, size_t bytes, bool written) {
+  if (!fs->card || bytes == 0) return;
+  if (written) simStats.sdBytesWritten += bytes;
+  else simStats.sdBytesRead += bytes;
+  double us = (double)bytes * simCosts.sdSectorUs / 512;
+  simStats.sdBusyUs += (uint64_t)us;
+  simSpend(us);
+}
+
+namespace fs {
+
+class FileImpl {
+public:
+  FS*         fs = nullptr;
+  std::string vpath;     // Path as the firmware sees it
+  std::string hpath;     // Path on the host
+  FILE*       fp = nullptr;
+  bool        dir = false;
+  std::vector<std::string> entries;
+  size_t      nextEntry = 0;
+  ~FileImpl() { if (fp) fclose(fp); }
+};
+
+std::string FS::hostPath(const char *path) const {
+  std::string p = path ? path : "/";
+  if (p.empty() || p[0] != '/') p = "/" + p;
+  return root + p;
+}
+
+File FS::open(const char *path, const char *mode, const bool create) {
+  (void)create;
+  if (!mounted) return File();
+  simCardOp(this, simCosts.sdOpenUs);
+  auto impl = std::make_shared<FileImpl>();
+  impl->fs = this;
+  impl->vpath = path;
+  if (impl->vpath.empty() || impl->vpath[0] != '/') impl->vpath = "/" + impl->vpath;
+  impl->hpath = hostPath(path);
+
+  struct stat st;
+  bool exists = stat(impl->hpath.c_str(), &st) == 0;
+  if (exists && S_ISDIR(st.st_mode)) {
+    if (mode[0] != 'r') return File();
+    impl->dir = true;
+    for (auto &e : stdfs::directory_iterator(impl->hpath)) impl->entries.push_back(e.path().filename().string());
+    std::sort(impl->entries.begin(), impl->entries.end());
+    return File(impl);
+  }
+  if (mode[0] == 'r' && !exists) return File();
+  const char *m = mode[0] == 'r' ? (mode[1] == '+' ? "r+b" : "rb") : mode[0] == 'w' ? (mode[1] == '+' ? "w+b" : "wb") : "ab";
+  impl->fp = fopen(impl->hpath.c_str(), m);
+  if (!impl->fp) return File();
+  return File(impl);
+}
+
+bool FS::exists(const char *path) {
+  if (!mounted) return false;
+  simCardOp(this, simCosts.sdOpenUs);
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+bool FS::remove(const char *path) {
+  if (!mounted) return false;
+  simCardOp(this, simCosts.sdMetaUs);
+  return ::unlink(hostPath(path).c_str()) == 0;
+}
+bool FS::rename(const char *a, const char *b) {
+  // FAT refuses to rename over a file
+  if (!mounted || exists(b)) return false;
+  simCardOp(this, simCosts.sdMetaUs);
+  return ::rename(hostPath(a).c_str(), hostPath(b).c_str()) == 0;
+}
+bool FS::mkdir(const char *path) {
+  if (!mounted) return false;
+  simCardOp(this, simCosts.sdOpenUs);
+  return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+bool FS::rmdir(const char *path) {
+  if (!mounted) return false;
+  simCardOp(this, simCosts.sdMetaUs);
+  return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+size_t File::write(const uint8_t *buf, size_t size) {
+  if (!_p || !_p->fp) return 0;
+  size_t n = fwrite(buf, 1, size, _p->fp);
+  simCardBytes(_p->fs, n, true);
+  return n;
+}
+int File::available() {
+  if (!_p || !_p->fp) return 0;
+  long pos = ftell(_p->fp);
+  fseek(_p->fp, 0, SEEK_END);
+  long end = ftell(_p->fp);
+  fseek(_p->fp, pos, SEEK_SET);
+  return (int)std::max(0L, end - pos);
+}
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+int File::peek() {
+  if (!_p || !_p->fp) return -1;
+  int c = fgetc(_p->fp);
+  if (c != EOF) ungetc(c, _p->fp);
+  return c == EOF ? -1 : c;
+}
+void File::flush() { if (_p && _p->fp) fflush(_p->fp); }
+size_t File::read(uint8_t *buf, size_t size) {
+  if (!_p || !_p->fp) return 0;
+  size_t n = fread(buf, 1, size, _p->fp);
+  simCardBytes(_p->fs, n, false);
+  return n;
+}
+String File::readStringUntil(char terminator) {
+  std::string out;
+  int c;
+  while ((c = read()) >= 0 && c != terminator) out += (char)c;
+  return String(out.c_str());
+}
+String File::readString() {
+  std::string out;
+  int c;
+  while ((c = read()) >= 0) out += (char)c;
+  return String(out.c_str());
+}
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!_p || !_p->fp) return false;
+  return fseek(_p->fp, pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+}
+size_t File::position() const { return (_p && _p->fp) ? ftell(_p->fp) : 0; }
+size_t File::size() const {
+  if (!_p) return 0;
+  if (_p->fp) fflush(_p->fp);
+  struct stat st;
+  return stat(_p->hpath.c_str(), &st) == 0 ? st.st_size : 0;
+}
+void File::close() { _p.reset(); }
+File::operator bool() const { return (bool)_p; }
+time_t File::getLastWrite() {
+  struct stat st;
+  return (_p && stat(_p->hpath.c_str(), &st) == 0) ? st.st_mtime : 0;
+}
+const char *File::path() const { return _p ? _p->vpath.c_str() : nullptr; }
+const char *File::name() const {
+  if (!_p) return nullptr;
+  size_t slash = _p->vpath.find_last_of('/');
+  return _p->vpath.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+bool File::isDirectory(void) { return _p && _p->dir; }
+File File::openNextFile(const char *mode) {
+  if (!_p || !_p->dir || _p->nextEntry >= _p->entries.size()) return File();
+  const std::string& entry = _p->entries[_p->nextEntry++];
+  std::string child = _p->vpath == "/" ? "/" + entry : _p->vpath + "/" + entry;
+  return _p->fs->open(child.c_str(), mode);
+}
+void File::rewindDirectory(void) { if (_p) _p->nextEntry = 0; }
+
+bool SDMMCFS::begin(const char *, bool, bool, int, uint8_t) {
+  if (!present || root.empty()) return false;
+  stdfs::create_directories(root);
+  mounted = true;
+  return true;
+}
+
+bool LittleFSFS::begin(bool, const char *, uint8_t, const char *) {
+  if (root.empty()) return false;
+  stdfs::create_directories(root);
+  mounted = true;
+  return true;
+}
+
+}  // namespace fs
+
+fs::LittleFSFS LittleFS;
+fs::SDMMCFS SD_MMC;
+
+// STORAGE
+static std::string simDictPath;
+static std::vector<uint8_t> simDict;
+static esp_partition_t simDictPart;
+
+void simStorage(const std::string& card, const std::string& flash, const std::string& dict) {
+  SD_MMC.setHostRoot(card);
+  SD_MMC.present = !card.empty();
+  LittleFS.setHostRoot(flash);
+  simDictPath = dict;
+}
+
+// The dictionary partition is the file given to simStorage(), if any
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t, const char* label) {
+  if (simDictPath.empty() || type != ESP_PARTITION_TYPE_DATA) return nullptr;
+  if (simDict.empty()) {
+    std::ifstream in(simDictPath, std::ios::binary);
+    simDict.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (simDict.empty()) return nullptr;
+  }
+  simDictPart.type = type;
+  simDictPart.size = simDict.size();
+  snprintf(simDictPart.label, sizeof(simDictPart.label), "%s", label ? label : "");
+  return &simDictPart;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size, spi_flash_mmap_memory_t,
+                             const void** out_ptr, spi_flash_mmap_handle_t* out_handle) {
+  if (partition != &simDictPart || offset > simDict.size() || size > simDict.size() - offset) return ESP_FAIL;
+  *out_ptr = simDict.data() + offset;
+  *out_handle = 0;
+  return ESP_OK;
+}
+
+// RAW CARD ACCESS
+// Only USB mass storage goes under the filesystem, and the simulator has no
+// USB host, so there is no raw card to find
+esp_err_t sdmmc_host_init(void) { return ESP_OK; }
+esp_err_t sdmmc_host_init_slot(int, const sdmmc_slot_config_t *) { return ESP_OK; }
+esp_err_t sdmmc_host_deinit(void) { return ESP_OK; }
+esp_err_t sdmmc_card_init(const sdmmc_host_t *, sdmmc_card_t *) { return ESP_FAIL; }
+esp_err_t sdmmc_read_sectors(sdmmc_card_t *, void *, size_t, size_t) { return ESP_FAIL; }
+esp_err_t sdmmc_write_sectors(sdmmc_card_t *, const void *, size_t, size_t) { return ESP_FAIL; }
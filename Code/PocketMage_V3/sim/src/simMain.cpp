@@ -0,0 +1,158 @@
+// UI SIMULATOR
+// The whole firmware on the host (see sim/include/sim.h), typing a script
+// from the file or stdin (sim/include/simReplay.h) and printing, for each key
+// press, how long the firmware took to read it, to send the next OLED frame
+// and to finish the next e-ink refresh, with the refreshes, SPI bytes and card
+// work up to the next press. Builds with PlatformIO:
+//   pio run -e sim && .pio/build/sim/program sim/scripts/txt.txt
+// or without it, from Code/PocketMage_V3:
+//   g++ -std=gnu++17 -O2 -Isim/include -Iinclude src/*.cpp sim/src/*.cpp -o pmsim
+//   ./pmsim [options] [script]
+// Options:
+//   --card <dir>        The card starts as a copy of dir, else empty
+//   --flash <dir>       The same for the flash filesystem
+//   --dict <file>       A compiled dictionary (tools/dictc) as the partition
+//   --cost <name>=<n>   Changes one of SimCosts
+//   --log <file>        Where Serial output goes, else nowhere
+//   --keep              Leaves the card and flash copies, and says where
+//   --serial            Runs on the wall clock with Serial on a pseudo
+//                       terminal, for tools/pmsync and tools/pmremote,
+//                       instead of a script
+// Runs repeat exactly: the card and flash start from the same files, the
+// clock from the same time and random() from the same seed.
+#include "simReplay.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+
+namespace stdfs = std::filesystem;
+
+#ifndef PIO_UNIT_TESTING
+static int usage() {
+  std::cerr << "Usage: pmsim [--card <dir>] [--flash <dir>] [--dict <file>] [--cost <name>=<n>]\n"
+               "             [--log <file>] [--keep] [--serial | script, default stdin]" << std::endl;
+  return 1;
+}
+
+// Serial on the master side of a new pseudo terminal, false if there is none
+static bool openSerial(std::string& name) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return false;
+  name = ptsname(master);
+
+  // Held open and raw, so output waits for the tool instead of being echoed
+  int slave = open(name.c_str(), O_RDWR | O_NOCTTY);
+  if (slave < 0) return false;
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  simSerialFd(master);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  std::string card, flash, dict, log, scriptPath;
+  bool keep = false, serial = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool more = i + 1 < argc;
+    if (arg == "--card" && more) card = argv[++i];
+    else if (arg == "--flash" && more) flash = argv[++i];
+    else if (arg == "--dict" && more) dict = argv[++i];
+    else if (arg == "--log" && more) log = argv[++i];
+    else if (arg == "--keep") keep = true;
+    else if (arg == "--serial") serial = true;
+    else if (arg == "--cost" && more) {
+      std::string cost = argv[++i];
+      size_t eq = cost.find('=');
+      char* end = nullptr;
+      unsigned long value = eq == std::string::npos ? 0 : strtoul(cost.c_str() + eq + 1, &end, 10);
+      if (!end || *end || !simSetCost(cost.substr(0, eq), value)) {
+        std::cerr << "Bad cost " << cost << std::endl;
+        return 1;
+      }
+    }
+    else if (arg[0] != '-' && scriptPath.empty()) scriptPath = arg;
+    else return usage();
+  }
+  if (serial && !scriptPath.empty()) return usage();
+
+  std::vector<SimCommand> commands;
+  if (!serial) {
+    std::string error;
+    bool ok;
+    if (scriptPath.empty()) ok = simParseScript(std::cin, commands, error);
+    else {
+      std::ifstream script(scriptPath);
+      if (!script) {
+        std::cerr << "Can't open " << scriptPath << std::endl;
+        return 1;
+      }
+      ok = simParseScript(script, commands, error);
+    }
+    if (!ok) {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+  }
+
+  // Fresh copies, so the run changes nothing it was given
+  char temp[] = "/tmp/pmsim.XXXXXX";
+  if (!mkdtemp(temp)) {
+    std::cerr << "Can't make a folder in /tmp" << std::endl;
+    return 1;
+  }
+  std::string root = temp;
+  std::error_code err;
+  const std::pair<std::string, std::string> copies[] = { { card, "/card" }, { flash, "/flash" } };
+  for (const auto& c : copies) {
+    stdfs::create_directories(root + c.second);
+    if (!c.first.empty()) stdfs::copy(c.first, root + c.second, stdfs::copy_options::recursive, err);
+    if (err) {
+      std::cerr << "Can't copy " << c.first << ": " << err.message() << std::endl;
+      return 1;
+    }
+  }
+  simStorage(root + "/card", root + "/flash", dict);
+
+  FILE* logFile = nullptr;
+  if (!log.empty()) {
+    logFile = fopen(log.c_str(), "w");
+    if (!logFile) {
+      std::cerr << "Can't write " << log << std::endl;
+      return 1;
+    }
+    simSerialLog(logFile);
+  }
+
+  bool ok = true;
+  if (serial) {
+    std::string port;
+    if (!openSerial(port)) {
+      std::cerr << "Can't open a pseudo terminal" << std::endl;
+      return 1;
+    }
+    std::cerr << "Serial on " << port << std::endl;
+    simRealTime(true);
+    simServe();
+    std::cerr << "Stopped by " << simStopReason() << std::endl;
+  }
+  else {
+    std::string error;
+    ok = simReplay(commands, std::cout, error);
+    simReport(std::cout);
+    if (!ok) std::cerr << error << std::endl;
+  }
+
+  if (logFile) fclose(logFile);
+  if (keep) std::cerr << "Card and flash left in " << root << std::endl;
+  else stdfs::remove_all(root, err);
+  return ok ? 0 : 1;
+}
+#endif
@@ -0,0 +1,389 @@
+#include "globals.h"
+#include "simReplay.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// KEYSTROKE REPLAY
+// The script is a task of its own next to the firmware's, pressing keys on
+// the simulated keypad at the pace it is given. Each press is followed until
+// the firmware reads it, then to the next OLED frame and e-ink refresh.
+
+std::vector<SimKeystroke> simKeys;
+uint64_t simBooted = 0;
+
+static const int SIM_SHIFT_KEY = 31;
+static const int SIM_FN_KEY = 32;
+
+static size_t simNextTaken = 0;              // First press not read yet
+static size_t simNextOled = 0;               // First read press without its frame
+static size_t simNextEink = 0;
+static std::vector<uint8_t> simOledShown;    // Last frame sent
+
+// HOOKS
+static void onKeyEvent(uint8_t event) {
+  if (!(event & 0x80) || simNextTaken >= simKeys.size()) return;
+  simKeys[simNextTaken++].taken = simNow();
+}
+
+static void onOledFrame() {
+  const uint8_t* tiles = u8g2.getBufferPtr();
+  simOledShown.assign(tiles, tiles + u8g2.getDisplayWidth() * u8g2.getDisplayHeight() / 8);
+  for (; simNextOled < simNextTaken; simNextOled++) simKeys[simNextOled].oled = simNow();
+}
+
+static void onEinkRefresh(bool) {
+  for (; simNextEink < simNextTaken; simNextEink++) simKeys[simNextEink].eink = simNow();
+}
+
+// BOOT
+static void firmwareTask(void*) {
+  setup();
+  simBooted = simNow();
+  while (true) loop();
+}
+
+static void boot() {
+  keypad.irqPin = KB_IRQ;
+  simSetPin(KB_IRQ, HIGH);                   // INT is active low
+  simOnKeyEvent = onKeyEvent;
+  simOnOledFrame = onOledFrame;
+  simOnEinkRefresh = onEinkRefresh;
+  simSpawn(firmwareTask, nullptr, "loopTask");
+}
+
+void simServe() {
+  boot();
+  simRun();
+}
+
+// SCRIPTS
+// The characters of a type command, false on a bad escape
+static bool unescape(const std::string& text, std::string& keys) {
+  keys.clear();
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] != '\\') {
+      keys += text[i];
+      continue;
+    }
+    if (++i >= text.size()) return false;
+    switch (text[i]) {
+      case 'r':  keys += '\r'; break;
+      case 'n':  keys += '\r'; break;        // Enter is 13 on the device
+      case 'b':  keys += '\b'; break;
+      case 't':  keys += '\t'; break;
+      case '\\': keys += '\\'; break;
+      case 'x':
+        if (i + 2 >= text.size() || !isxdigit((unsigned char)text[i + 1]) || !isxdigit((unsigned char)text[i + 2])) return false;
+        keys += (char)std::stoi(text.substr(i + 1, 2), nullptr, 16);
+        i += 2;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+bool simParseScript(std::istream& in, std::vector<SimCommand>& commands, std::string& error) {
+  std::string line;
+  int number = 0;
+  while (std::getline(in, line)) {
+    number++;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    std::istringstream words(line);
+    std::string word;
+    if (!(words >> word) || word[0] == '#') continue;
+
+    SimCommand c;
+    c.line = number;
+    c.value = 0;
+    std::string problem;
+    long value;
+    if (word == "type") {
+      c.kind = SimCommand::TYPE;
+      size_t at = line.find("type") + 5;     // Everything after one space
+      if (!unescape(at < line.size() ? line.substr(at) : "", c.text)) problem = "bad escape";
+    }
+    else if (word == "key") {
+      c.kind = SimCommand::KEY;
+      int key;
+      while (words >> key && key >= 0 && key < 40) c.keys.push_back(key);
+      if (c.keys.empty() || !words.eof()) problem = "keys are 0 to 39";
+    }
+    else if (word == "wait" || word == "pace") {
+      c.kind = word == "wait" ? SimCommand::WAIT : SimCommand::PACE;
+      if (!(words >> value) || value < 0) problem = word + " needs milliseconds";
+      else c.value = value;
+    }
+    else if (word == "touch") {
+      c.kind = SimCommand::TOUCH;
+      std::string mask;
+      words >> mask;
+      char* end = nullptr;
+      value = mask.empty() ? -1 : strtol(mask.c_str(), &end, 0);
+      if (value < 0 || value > 0xFFF || *end) problem = "touch needs a pad mask, 0 to 0xFFF";
+      else c.value = value;
+    }
+    else if (word == "power") {
+      c.kind = SimCommand::POWER;
+    }
+    else if (word == "snap") {
+      c.kind = SimCommand::SNAP;
+      std::string screen;
+      words >> screen >> c.text;
+      if ((screen != "eink" && screen != "oled") || c.text.empty()) problem = "snap eink|oled <file>";
+      c.value = screen == "eink" ? REMOTE_EINK : REMOTE_OLED;
+    }
+    else if (word == "stats") {
+      c.kind = SimCommand::STATS;
+      std::string reset;
+      words >> reset;
+      c.value = reset == "reset";
+    }
+    else {
+      problem = "unknown command " + word;
+    }
+
+    if (!problem.empty()) {
+      error = "line " + std::to_string(number) + ": " + problem;
+      return false;
+    }
+    commands.push_back(c);
+  }
+  return true;
+}
+
+// REPLAY
+static const std::vector<SimCommand>* simScript = nullptr;
+static std::ostream* simOut = nullptr;
+static std::string simError;
+static uint32_t simPaceMs = 150;
+static SimStats simStatsZero;                // Where "stats reset" put the counters
+
+// Presses and lets go of key, then waits out the pace
+static void press(int key, const std::string& label) {
+  SimKeystroke k;
+  k.label = label;
+  k.at = simNow();
+  k.before = simStats;
+  simKeys.push_back(k);
+
+  uint32_t hold = std::min<uint32_t>(60, simPaceMs / 2);
+  keypad.simPush(0x80 | (key + 1));
+  simSleep((uint64_t)hold * 1000);
+  keypad.simPush(key + 1);
+  simSleep((uint64_t)(simPaceMs - hold) * 1000);
+}
+
+// The layer the firmware has to be in to type c, and its key, or false
+static bool findKey(char c, KBState& layer, int& key) {
+  const char (*layers[3])[10] = { keysArray, keysArraySHFT, keysArrayFN };
+  const KBState states[3] = { NORMAL, SHIFT, FUNC };
+  for (int l = 0; l < 3; l++) {
+    for (int k = 0; k < 40; k++) {
+      if (layers[l][k / 10][k % 10] == c && k != SIM_SHIFT_KEY && k != SIM_FN_KEY) {
+        layer = states[l];
+        key = k;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static std::string keyLabel(char c) {
+  switch (c) {
+    case ' ':  return "space";
+    case '\b': return "bksp";
+    case '\r': return "enter";
+    case '\t': return "tab";
+  }
+  if (isprint((unsigned char)c)) return std::string(1, c);
+  char hex[8];
+  snprintf(hex, sizeof(hex), "\\x%02x", (unsigned char)c);
+  return hex;
+}
+
+static bool type(const std::string& text) {
+  for (char c : text) {
+    KBState layer;
+    int key;
+    if (!findKey(c, layer, key)) {
+      simError = "no key types " + keyLabel(c);
+      return false;
+    }
+    // The last press has to be read before the layer it left is known
+    for (int waited = 0; simNextTaken < simKeys.size(); waited++) {
+      if (waited == 10000) {
+        simError = "firmware isn't reading keys";
+        return false;
+      }
+      simSleep(1000);
+    }
+    // Shift and FN toggle their layer: one press goes to it from the others,
+    // or from it back to NORMAL
+    if (CurrentKBState != layer) {
+      KBState toggle = layer == NORMAL ? CurrentKBState : layer;
+      press(toggle == SHIFT ? SIM_SHIFT_KEY : SIM_FN_KEY, toggle == SHIFT ? "shift" : "fn");
+    }
+    press(key, keyLabel(c));
+  }
+  return true;
+}
+
+// Binary PBM, 1 is black, so the OLED's lit pixels come out black too
+static bool writePbm(const std::string& path, int width, int height, const std::vector<uint8_t>& rows) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+  out << "P4\n" << width << " " << height << "\n";
+  out.write((const char*)rows.data(), rows.size());
+  return out.good();
+}
+
+// As the firmware draws on them: the e-ink turned by setRotation(3), the
+// OLED buffer already upright
+static bool snap(uint8_t screen, const std::string& path) {
+  if (screen == REMOTE_EINK) {
+    const uint8_t* panel = display.epd2.panel();
+    int width = EINK_PANEL_HEIGHT, height = EINK_PANEL_WIDTH, stride = (width + 7) / 8;
+    std::vector<uint8_t> rows((size_t)stride * height, 0);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        int px = y, py = EINK_PANEL_HEIGHT - 1 - x;
+        bool white = panel[py * (EINK_PANEL_WIDTH / 8) + px / 8] & (0x80 >> (px % 8));
+        if (!white) rows[(size_t)y * stride + x / 8] |= 0x80 >> (x % 8);
+      }
+    }
+    return writePbm(path, width, height, rows);
+  }
+
+  std::vector<uint8_t> rows(OLED_WIDTH * OLED_HEIGHT / 8, 0);
+  for (size_t y = 0; y < OLED_HEIGHT && !simOledShown.empty(); y++) {
+    for (size_t x = 0; x < OLED_WIDTH; x++) {
+      if (simOledShown[(y / 8) * OLED_WIDTH + x] & (1 << (y % 8))) rows[y * (OLED_WIDTH / 8) + x / 8] |= 0x80 >> (x % 8);
+    }
+  }
+  return writePbm(path, OLED_WIDTH, OLED_HEIGHT, rows);
+}
+
+static void printStats(std::ostream& out, const SimStats& s, const SimStats& from) {
+  out << "eink_full " << s.einkFull - from.einkFull << "\n"
+      << "eink_fast " << s.einkFast - from.einkFast << "\n"
+      << "eink_partial " << s.einkPartial - from.einkPartial << "\n"
+      << "eink_busy_us " << s.einkBusyUs - from.einkBusyUs << "\n"
+      << "eink_spi_bytes " << s.einkSpiBytes - from.einkSpiBytes << "\n"
+      << "oled_frames " << s.oledFrames - from.oledFrames << "\n"
+      << "oled_spi_bytes " << s.oledSpiBytes - from.oledSpiBytes << "\n"
+      << "sd_ops " << s.sdOps - from.sdOps << "\n"
+      << "sd_bytes_read " << s.sdBytesRead - from.sdBytesRead << "\n"
+      << "sd_bytes_written " << s.sdBytesWritten - from.sdBytesWritten << "\n"
+      << "sd_busy_us " << s.sdBusyUs - from.sdBusyUs << std::endl;
+}
+
+static bool run(const SimCommand& c) {
+  switch (c.kind) {
+    case SimCommand::TYPE:
+      return type(c.text);
+    case SimCommand::KEY:
+      for (int key : c.keys) press(key, "key " + std::to_string(key));
+      return true;
+    case SimCommand::WAIT:
+      simSleep((uint64_t)c.value * 1000);
+      return true;
+    case SimCommand::PACE:
+      simPaceMs = c.value;
+      return true;
+    case SimCommand::TOUCH:
+      cap.touchMask = c.value;
+      return true;
+    case SimCommand::POWER:
+      simSetPin(PWR_BTN, LOW);
+      simSleep(100000);
+      simSetPin(PWR_BTN, HIGH);
+      return true;
+    case SimCommand::SNAP:
+      if (snap(c.value, c.text)) return true;
+      simError = "can't write " + c.text;
+      return false;
+    case SimCommand::STATS:
+      printStats(*simOut, simStats, simStatsZero);
+      if (c.value) simStatsZero = simStats;
+      return true;
+  }
+  return false;
+}
+
+static void scriptTask(void*) {
+  while (!simBooted) simSleep(1000);
+  for (const SimCommand& c : *simScript) {
+    if (!run(c)) {
+      simError = "line " + std::to_string(c.line) + ": " + simError;
+      simStop("script failed");
+    }
+  }
+  simStop("end of script");
+}
+
+bool simReplay(const std::vector<SimCommand>& commands, std::ostream& out, std::string& error) {
+  simScript = &commands;
+  simOut = &out;
+  boot();
+  simSpawn(scriptTask, nullptr, "script");
+  simRun();
+  error = simError;
+  return simError.empty();
+}
+
+// REPORT
+static std::string ms(uint64_t from, uint64_t to) {
+  if (!to) return "-";
+  std::ostringstream s;
+  s << std::fixed << std::setprecision(1) << (to - from) / 1000.0;
+  return s.str();
+}
+
+// Nearest rank, of latencies in us
+static std::string rank(std::vector<uint64_t> v, int percent) {
+  if (v.empty()) return "-";
+  std::sort(v.begin(), v.end());
+  size_t i = (v.size() * percent + 99) / 100;
+  return ms(0, v[i ? i - 1 : 0]);
+}
+
+void simReport(std::ostream& out) {
+  const char* why = simStopReason();
+  out << "# boot " << ms(0, simBooted) << " ms, ran " << ms(0, simNow()) << " ms, stopped by "
+      << (why ? why : "nothing") << "\n";
+  out << "# key        at_ms  taken_ms  oled_ms   eink_ms  full fast part  eink_spi  oled_spi  sd_ops  sd_bytes\n";
+
+  std::vector<uint64_t> taken, oled, eink;
+  for (size_t i = 0; i < simKeys.size(); i++) {
+    const SimKeystroke& k = simKeys[i];
+    const SimStats& a = k.before;
+    const SimStats& b = i + 1 < simKeys.size() ? simKeys[i + 1].before : simStats;
+    if (k.taken) taken.push_back(k.taken - k.at);
+    if (k.oled) oled.push_back(k.oled - k.at);
+    if (k.eink) eink.push_back(k.eink - k.at);
+
+    char line[200];
+    snprintf(line, sizeof(line), "%-8s %9s %9s %8s %9s %5u %4u %4u %9llu %9llu %7u %9llu\n",
+             k.label.c_str(), ms(0, k.at).c_str(), ms(k.at, k.taken).c_str(), ms(k.at, k.oled).c_str(),
+             ms(k.at, k.eink).c_str(), b.einkFull - a.einkFull, b.einkFast - a.einkFast, b.einkPartial - a.einkPartial,
+             (unsigned long long)(b.einkSpiBytes - a.einkSpiBytes), (unsigned long long)(b.oledSpiBytes - a.oledSpiBytes),
+             b.sdOps - a.sdOps, (unsigned long long)(b.sdBytesRead - a.sdBytesRead + b.sdBytesWritten - a.sdBytesWritten));
+    out << line;
+  }
+
+  const SimStats& s = simStats;
+  out << "# keys " << simKeys.size() << ", taken " << taken.size() << "\n"
+      << "# taken_ms p50 " << rank(taken, 50) << " p95 " << rank(taken, 95) << " max " << rank(taken, 100) << "\n"
+      << "# oled_ms  p50 " << rank(oled, 50) << " p95 " << rank(oled, 95) << " max " << rank(oled, 100) << "\n"
+      << "# eink_ms  p50 " << rank(eink, 50) << " p95 " << rank(eink, 95) << " max " << rank(eink, 100) << "\n"
+      << "# eink refreshes " << s.einkFull << " full, " << s.einkFast << " fast, " << s.einkPartial << " partial, "
+      << ms(0, s.einkBusyUs) << " ms busy, " << s.einkSpiBytes << " SPI bytes\n"
+      << "# oled frames " << s.oledFrames << ", " << s.oledSpiBytes << " SPI bytes\n"
+      << "# sd ops " << s.sdOps << ", " << s.sdBytesRead << " bytes read, " << s.sdBytesWritten << " written, "
+      << ms(0, s.sdBusyUs) << " ms busy" << std::endl;
+}
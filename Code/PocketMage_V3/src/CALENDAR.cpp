@@ -6,8 +6,53 @@ int weekOffsetCount = 0;
 int currentMonth = 0;
 int currentYear = 0;
 
-std::vector<std::vector<String>> dayEvents;
-std::vector<std::vector<String>> calendarEvents;
+// One line of EVENTS_FILE: name|YYYYMMDD|HHMM|minutes|repeat|note
+struct CalendarEvent {
+  String   name;
+  uint32_t date;      // YYYYMMDD, 0 if unreadable
+  int16_t  time;      // HHMM, -1 for all-day events
+  int32_t  duration;  // Minutes, -1 if not given
+  String   repeat;    // Repeat code, see REPEAT RULES
+  String   note;
+};
+
+std::vector<CalendarEvent> dayEvents;
+std::vector<CalendarEvent> calendarEvents;
+
+// calendarEvents mirrors EVENTS_FILE once loaded, so drawing never re-parses it
+static bool eventsCached = false;
+
+// Repeat codes compiled from calendarEvents, same order (see REPEAT RULES)
+enum RepeatKind : uint8_t { REPEAT_NONE, REPEAT_DAILY, REPEAT_WEEKLY, REPEAT_MONTHLY_DAY, REPEAT_MONTHLY_NTH, REPEAT_YEARLY };
+
+struct EventRule {
+  uint32_t date;      // Start date as YYYYMMDD, 0 if unreadable
+  uint8_t  kind;      // RepeatKind
+  uint8_t  weekdays;  // WEEKLY / MONTHLY_NTH weekday mask, bit 0 = Sunday
+  uint8_t  nth;       // MONTHLY_NTH week of the month, 1-5
+  uint8_t  month;     // YEARLY month
+  uint8_t  day;       // MONTHLY_DAY / YEARLY day of the month
+};
+
+static std::vector<EventRule> eventRules;
+static bool rulesCompiled = false;
+static uint16_t rulesGeneration = 0;     // Bumped on every recompile, keys the week layout
+
+// Week view layout, rebuilt only when the week or the events change
+static const uint8_t WEEK_SLOTS = 6;     // Event boxes per day in the week background
+
+struct WeekLayout {
+  int32_t  firstDay;                     // Day number of the week's Sunday (civildate.h)
+  uint16_t generation;                   // rulesGeneration it was built from
+  bool     valid;
+  uint8_t  count[7];                     // Events on each day, may exceed WEEK_SLOTS
+  uint16_t slots[7][WEEK_SLOTS];         // calendarEvents indices, earliest first
+  int16_t  times[7][WEEK_SLOTS];         // Start time HHMM, -1 if none
+};
+
+static WeekLayout weekLayout;
+static int8_t  weekSelectedDay = -1;     // Highlighted column, 0 = Sunday
+static uint8_t weekRedrawMask = 0;       // Columns to redraw without a full refresh
 
 void CALENDAR_INIT() {
   currentLine = "";
@@ -20,12 +65,45 @@ void CALENDAR_INIT() {
 }
 
 // Event Data Management
+// "HHMM" as a number, -1 if there's no valid time
+static int16_t parseEventTime(const char* text, size_t len) {
+  if (len < 4) return -1;
+  int32_t hhmm = parseDigits(text, 4);
+  if (hhmm < 0 || hhmm / 100 > 23 || hhmm % 100 > 59) return -1;
+  return hhmm;
+}
+
+static CalendarEvent decodeEvent(const FieldSpan* fields) {
+  CalendarEvent event;
+  event.name     = fields[0].ptr;
+  event.date     = fieldDate(fields[1]);
+  event.time     = parseEventTime(fields[2].ptr, fields[2].len);
+  event.duration = fieldInt(fields[3], -1);
+  event.repeat   = fields[4].ptr;
+  event.note     = fields[5].ptr;
+  return event;
+}
+
+int stringToPositiveInt(String input);
+
+static CalendarEvent makeEvent(const String& name, const String& startDate, const String& startTime,
+                               const String& duration, const String& repeat, const String& note) {
+  CalendarEvent event;
+  event.name     = name;
+  event.date     = parsePackedDate(startDate.c_str(), startDate.length());
+  event.time     = parseEventTime(startTime.c_str(), startTime.length());
+  event.duration = stringToPositiveInt(duration);
+  event.repeat   = repeat;
+  event.note     = note;
+  return event;
+}
+
 void updateEventArray() {
   SDActive = true;
   setCpuFrequencyMhz(240);
   delay(50);
 
-  File file = SD_MMC.open(EVENTS_FILE, "r"); // Open the text file in read mode
+  File file = sysfsOpen(EVENTS_FILE, "r"); // Open the text file in read mode
   if (!file) {
     Serial.println("Failed to open file for reading");
     return;
@@ -33,43 +111,34 @@ void updateEventArray() {
 
   calendarEvents.clear(); // Clear the existing vector before loading the new data
 
-  // Loop through the file, line by line
-  while (file.available()) {
-    String line = file.readStringUntil('\n');  // Read a line from the file
-    line.trim();  // Remove any extra spaces or newlines
-    
-    // Skip empty lines
-    if (line.length() == 0) {
-      continue;
-    }
-
-    // Split the line into individual parts using the delimiter '|'
-    uint8_t delimiterPos1 = line.indexOf('|');
-    uint8_t delimiterPos2 = line.indexOf('|', delimiterPos1 + 1);
-    uint8_t delimiterPos3 = line.indexOf('|', delimiterPos2 + 1);
-    uint8_t delimiterPos4 = line.indexOf('|', delimiterPos3 + 1);
-    uint8_t delimiterPos5 = line.indexOf('|', delimiterPos4 + 1);
-
-    String eventName  = line.substring(0, delimiterPos1);
-    String startDate   = line.substring(delimiterPos1 + 1, delimiterPos2);
-    String startTime  = line.substring(delimiterPos2 + 1, delimiterPos3);
-    String duration = line.substring(delimiterPos3 + 1, delimiterPos4);
-    String repeat = line.substring(delimiterPos4 + 1, delimiterPos5);
-    String note = line.substring(delimiterPos5 + 1);
-
-    // Add the event to the vector
-    calendarEvents.push_back({eventName, startDate, startTime, duration, repeat, note});
+  // name|YYYYMMDD|HHMM|minutes|repeat|note
+  RecordReader<File> reader(file);
+  while (reader.next(6)) {
+    if (reader.count < 6) continue;
+    calendarEvents.push_back(decodeEvent(reader.fields));
   }
 
   file.close();  // Close the file
+  eventsCached = true;
+  rulesCompiled = false;
 
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
   SDActive = false;
 }
 
-void sortEventsByDate(std::vector<std::vector<String>> &calendarEvents) {
-  std::sort(calendarEvents.begin(), calendarEvents.end(), [](const std::vector<String> &a, const std::vector<String> &b) {
-    return a[1] < b[1]; // Compare dueDate strings
+void ensureEventsLoaded() {
+  if (!eventsCached) updateEventArray();
+}
+
+// Events file changed behind our back (USB)
+void invalidateEventCache() {
+  eventsCached = false;
+}
+
+void sortEventsByDate(std::vector<CalendarEvent> &calendarEvents) {
+  std::stable_sort(calendarEvents.begin(), calendarEvents.end(), [](const CalendarEvent &a, const CalendarEvent &b) {
+    // Unreadable dates are 0 and sort first
+    return a.date < b.date;
   });
 }
 
@@ -77,33 +146,51 @@ void updateEventsFile() {
   SDActive = true;
   setCpuFrequencyMhz(240);
   delay(50);
-  // Clear the existing calendarEvents file first
-  delFile(EVENTS_FILE);
-
-  // Iterate through the calendarEvents vector and append each task to the file
-  for (size_t i = 0; i < calendarEvents.size(); i++) {
-    // Create a string from the task's attributes with "|" delimiter
-    String eventInfo = calendarEvents[i][0] + "|" + calendarEvents[i][1] + "|" + calendarEvents[i][2] + "|" + calendarEvents[i][3]+ "|" + calendarEvents[i][4]+ "|" + calendarEvents[i][5];
-    
-    // Append the task info to the file
-    appendToFile(EVENTS_FILE, eventInfo);
-  }
+  // One pass into a temp file that replaces the old one
+  sysfsWriteRecords(EVENTS_FILE, calendarEvents.size() + 1, [](size_t i) -> String {
+    if (i == 0) return String(RECORD_HEADER);
+    const CalendarEvent& event = calendarEvents[i - 1];
+    char date[9] = "";
+    char time[5] = "";
+    // Out of range values are saved empty rather than cut
+    if (event.date && event.date <= 99999999) snprintf(date, sizeof(date), "%08lu", (unsigned long)event.date % 100000000);
+    if (event.time >= 0 && event.time <= 9999) snprintf(time, sizeof(time), "%04u", (unsigned)event.time % 10000);
+    return escapeField(event.name) + "|" + date + "|" + time + "|" +
+           (event.duration >= 0 ? String(event.duration) : String("")) + "|" +
+           escapeField(event.repeat) + "|" + escapeField(event.note);
+  });
+  eventsCached = true;
+  rulesCompiled = false;
 
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
   SDActive = false;
 }
 
+static int eventConflicts(const CalendarEvent& event, int* firstConflict);
+
 void addEvent(String eventName, String startDate, String startTime , String duration, String repeat, String note) {
-  String eventInfo = eventName+"|"+startDate+"|"+startTime +"|"+duration+"|"+repeat+"|"+note;
-  updateEventArray();
-  calendarEvents.push_back({eventName, startDate, startTime , duration, repeat, note});
+  ensureEventsLoaded();
+  CalendarEvent event = makeEvent(eventName, startDate, startTime, duration, repeat, note);
+
+  // Warn about overlaps, the event is still added
+  int conflict = -1;
+  String conflictName = "";
+  if (eventConflicts(event, &conflict) > 0) conflictName = calendarEvents[conflict].name;
+
+  calendarEvents.push_back(event);
   sortEventsByDate(calendarEvents);
   updateEventsFile();
+
+  if (conflictName != "") {
+    oledWord("Overlaps " + conflictName);
+    delay(1000);
+  }
 }
 
 void deleteEvent(int index) {
-  if (index >= 0 && index < calendarEvents.size()) {
+  if (index >= 0 && (size_t)index < calendarEvents.size()) {
     calendarEvents.erase(calendarEvents.begin() + index);
+    rulesCompiled = false;
   }
 }
 
@@ -130,27 +217,437 @@ int stringToPositiveInt(String input) {
   input.trim();
   if (input.length() == 0) return -1;
 
-  for (int i = 0; i < input.length(); i++) {
+  for (size_t i = 0; i < input.length(); i++) {
     if (!isDigit(input[i])) return -1;
   }
 
   return input.toInt();
 }
 
-int daysInMonth(int year, int month) {
-  if (month == 2) {
-    // Leap year
-    return (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) ? 29 : 28;
-  } else if (month == 4 || month == 6 || month == 9 || month == 11) {
-    return 30;
-  } else {
-    return 31;
+// REPEAT RULES
+// Repeat Codes:
+// DAILY (every day)
+// WEEKLY Mo (every monday) or WEEKLY MoWeFr (every Mon, Wed, and Fri) or WEEKLY TuTh or WEEKLY_SaSu
+// MONTHLY 23 (23rd of each month) or MONTHLY 1Tu or MONTHLY 2We (first Tues or 2nd Wed, etc.)
+// YEARLY APR22 or YEARLY 0422 (yearly on Apr 22nd)
+// Each code is parsed once into an EventRule, so asking whether an event
+// lands on a day is a handful of integer compares.
+static int weekdayFromCode(const String& code) {
+  const char* daysOfWeek[] = { "Su", "Mo", "Tu", "We", "Th", "Fr", "Sa" };
+  for (int i = 0; i < 7; i++) {
+    if (code.equalsIgnoreCase(daysOfWeek[i])) return i;
+  }
+  return -1;
+}
+
+static EventRule compileRepeat(uint32_t startDate, String repeatCode) {
+  EventRule rule = { 0, REPEAT_NONE, 0, 0, 0, 0 };
+  rule.date = startDate;
+
+  repeatCode.trim();
+  int sep = repeatCode.indexOf(' ');
+  if (sep == -1) sep = repeatCode.indexOf('_');
+  String kind = (sep == -1) ? repeatCode : repeatCode.substring(0, sep);
+  String arg  = (sep == -1) ? String("") : repeatCode.substring(sep + 1);
+  arg.trim();
+
+  if (kind.equalsIgnoreCase("DAILY")) {
+    rule.kind = REPEAT_DAILY;
+  }
+  else if (kind.equalsIgnoreCase("WEEKLY")) {
+    for (size_t i = 0; i + 1 < arg.length(); i += 2) {
+      int wd = weekdayFromCode(arg.substring(i, i + 2));
+      if (wd >= 0) rule.weekdays |= 1 << wd;
+    }
+    if (rule.weekdays) rule.kind = REPEAT_WEEKLY;
+  }
+  else if (kind.equalsIgnoreCase("MONTHLY")) {
+    int dayNum = stringToPositiveInt(arg);
+    if (dayNum >= 1 && dayNum <= 31) {
+      rule.kind = REPEAT_MONTHLY_DAY;
+      rule.day  = dayNum;
+    }
+    else if (arg.length() == 3 && arg.charAt(0) >= '1' && arg.charAt(0) <= '5') {
+      int wd = weekdayFromCode(arg.substring(1));
+      if (wd >= 0) {
+        rule.kind     = REPEAT_MONTHLY_NTH;
+        rule.nth      = arg.charAt(0) - '0';
+        rule.weekdays = 1 << wd;
+      }
+    }
+  }
+  else if (kind.equalsIgnoreCase("YEARLY") && arg.length() >= 4) {
+    int month = 0;
+    int dayNum = -1;
+    if (arg.length() == 5) {
+      // APR22
+      for (int m = 1; m <= 12; m++) {
+        if (arg.substring(0, 3).equalsIgnoreCase(getMonthName(m))) month = m;
+      }
+      dayNum = stringToPositiveInt(arg.substring(3));
+    }
+    else if (arg.length() == 4) {
+      // 0422
+      month  = stringToPositiveInt(arg.substring(0, 2));
+      dayNum = stringToPositiveInt(arg.substring(2));
+    }
+    if (month >= 1 && month <= 12 && dayNum >= 1 && dayNum <= 31) {
+      rule.kind  = REPEAT_YEARLY;
+      rule.month = month;
+      rule.day   = dayNum;
+    }
+  }
+
+  return rule;
+}
+
+static void ensureRulesCompiled() {
+  if (rulesCompiled && eventRules.size() == calendarEvents.size()) return;
+  eventRules.clear();
+  eventRules.reserve(calendarEvents.size());
+  for (size_t i = 0; i < calendarEvents.size(); i++) {
+    eventRules.push_back(compileRepeat(calendarEvents[i].date, calendarEvents[i].repeat));
+  }
+  rulesCompiled = true;
+  rulesGeneration++;
+}
+
+// weekday: 0 = Sunday
+static bool eventOccursOn(const EventRule& rule, int year, int month, int day, int weekday) {
+  if (rule.date == (uint32_t)(year * 10000 + month * 100 + day)) return true;
+
+  switch (rule.kind) {
+    case REPEAT_DAILY:       return true;
+    case REPEAT_WEEKLY:      return rule.weekdays & (1 << weekday);
+    case REPEAT_MONTHLY_DAY: return rule.day == day;
+    case REPEAT_MONTHLY_NTH: return (rule.weekdays & (1 << weekday)) && rule.nth == (day - 1) / 7 + 1;
+    case REPEAT_YEARLY:      return rule.month == month && rule.day == day;
+    default:                 return false;
+  }
+}
+
+// Days of the month the event lands on, bit n set = day n.
+// firstWeekday is the weekday of the 1st (0 = Sunday).
+static uint32_t expandRuleInMonth(const EventRule& rule, int year, int month, int firstWeekday, int monthDays) {
+  uint32_t allDays = (monthDays >= 31) ? 0xFFFFFFFEUL : (((1UL << (monthDays + 1)) - 1) & ~1UL);
+  uint32_t days = 0;
+
+  if (rule.date / 100 == (uint32_t)(year * 100 + month) && rule.date % 100 <= 31) days |= 1UL << (rule.date % 100);
+
+  switch (rule.kind) {
+    case REPEAT_DAILY:
+      days |= allDays;
+      break;
+    case REPEAT_WEEKLY:
+      for (int wd = 0; wd < 7; wd++) {
+        if (!(rule.weekdays & (1 << wd))) continue;
+        for (int d = 1 + (wd - firstWeekday + 7) % 7; d <= monthDays; d += 7) days |= 1UL << d;
+      }
+      break;
+    case REPEAT_MONTHLY_DAY:
+      days |= 1UL << rule.day;
+      break;
+    case REPEAT_MONTHLY_NTH:
+      for (int wd = 0; wd < 7; wd++) {
+        if (!(rule.weekdays & (1 << wd))) continue;
+        int d = 1 + (wd - firstWeekday + 7) % 7 + 7 * (rule.nth - 1);
+        if (d <= monthDays) days |= 1UL << d;
+      }
+      break;
+    case REPEAT_YEARLY:
+      if (rule.month == month) days |= 1UL << rule.day;
+      break;
+  }
+
+  return days & allDays;
+}
+
+// INTERVAL INDEX
+// Timed occurrences expanded over twice EVENT_INDEX_DAYS from the first day
+// asked for (plus the day before, for events running past midnight), sorted
+// by start. Queries within the first half reuse it without rebuilding. maxEnd[i] is the latest end among intervals 0..i, so
+// an overlap scan can stop as soon as nothing earlier reaches the query.
+// All-day events and zero-length events (deadlines) don't take up time.
+struct EventInterval {
+  int32_t  start;        // Minutes since 1970-01-01, local time
+  int32_t  end;
+  uint16_t event;        // calendarEvents index
+};
+
+static std::vector<EventInterval> intervals;
+static std::vector<int32_t> intervalMaxEnd;
+static int32_t  intervalFirstDay = 0;
+static uint16_t intervalGeneration = 0;
+static bool     intervalsValid = false;
+
+// Start in minutes after midnight, -1 for all-day events
+static int16_t eventStartMinutes(const CalendarEvent& event) {
+  if (event.time < 0) return -1;
+  return event.time / 100 * 60 + event.time % 100;
+}
+
+static void ensureIntervalIndex(int32_t firstDay) {
+  ensureEventsLoaded();
+  ensureRulesCompiled();
+  if (intervalsValid && intervalGeneration == rulesGeneration &&
+      firstDay >= intervalFirstDay && firstDay <= intervalFirstDay + EVENT_INDEX_DAYS) return;
+
+  std::vector<int16_t> starts(calendarEvents.size());
+  std::vector<int32_t> durations(calendarEvents.size());
+  for (size_t i = 0; i < calendarEvents.size(); i++) {
+    starts[i]    = eventStartMinutes(calendarEvents[i]);
+    durations[i] = calendarEvents[i].duration;
+  }
+
+  intervals.clear();
+  for (int32_t day = firstDay - 1; day < firstDay + 2 * EVENT_INDEX_DAYS; day++) {
+    CivilDate date = civilFromDays(day);
+    uint8_t weekday = weekdayFromDays(day);
+    for (size_t i = 0; i < eventRules.size(); i++) {
+      if (starts[i] < 0 || durations[i] <= 0) continue;
+      if (!eventOccursOn(eventRules[i], date.year, date.month, date.day, weekday)) continue;
+      int32_t start = day * 1440 + starts[i];
+      intervals.push_back({ start, start + durations[i], (uint16_t)i });
+    }
+  }
+  std::sort(intervals.begin(), intervals.end(), [](const EventInterval& a, const EventInterval& b) {
+    return a.start < b.start;
+  });
+
+  intervalMaxEnd.resize(intervals.size());
+  int32_t maxEnd = INT32_MIN;
+  for (size_t i = 0; i < intervals.size(); i++) {
+    if (intervals[i].end > maxEnd) maxEnd = intervals[i].end;
+    intervalMaxEnd[i] = maxEnd;
+  }
+
+  intervalFirstDay   = firstDay;
+  intervalGeneration = rulesGeneration;
+  intervalsValid     = true;
+}
+
+// Intervals overlapping [from, to). Returns how many, the first is stored in firstHit.
+static int overlappingIntervals(int32_t from, int32_t to, int* firstHit) {
+  // Nothing starting at or after `to` can overlap
+  size_t hi = std::lower_bound(intervals.begin(), intervals.end(), to, [](const EventInterval& a, int32_t t) {
+    return a.start < t;
+  }) - intervals.begin();
+
+  int count = 0;
+  for (size_t i = hi; i-- > 0; ) {
+    if (intervalMaxEnd[i] <= from) break;
+    if (intervals[i].end > from) {
+      if (firstHit) *firstHit = intervals[i].event;
+      count++;
+    }
+  }
+  return count;
+}
+
+// Occurrences of existing events that overlap a new event's occurrences
+// within EVENT_INDEX_DAYS of its start (or of today, for older repeating events)
+static int eventConflicts(const CalendarEvent& event, int* firstConflict) {
+  int16_t start = eventStartMinutes(event);
+  int32_t length = event.duration;
+  EventRule rule = compileRepeat(event.date, event.repeat);
+  if (start < 0 || length <= 0 || rule.date == 0) return 0;
+
+  DateTime now = rtc.now();
+  int32_t firstDay = daysFromPacked(rule.date);
+  int32_t today = daysFromCivil(now.year(), now.month(), now.day());
+  if (rule.kind != REPEAT_NONE && firstDay < today) firstDay = today;
+  ensureIntervalIndex(firstDay);
+
+  int count = 0;
+  for (int32_t day = firstDay; day < firstDay + EVENT_INDEX_DAYS; day++) {
+    CivilDate date = civilFromDays(day);
+    if (!eventOccursOn(rule, date.year, date.month, date.day, weekdayFromDays(day))) continue;
+    int32_t from = day * 1440 + start;
+    count += overlappingIntervals(from, from + length, firstConflict);
+  }
+  return count;
+}
+
+// Start of the first gap of at least `minutes` between FREE_SLOT_START and
+// FREE_SLOT_END on any day, at or after `from` (minutes since 1970-01-01).
+// Returns -1 if there is none within EVENT_INDEX_DAYS.
+static int32_t findFreeSlot(int32_t from, int32_t minutes) {
+  int32_t firstDay = from / 1440;
+  ensureIntervalIndex(firstDay);
+
+  // maxEnd only grows, so everything before i ended before `from`
+  size_t i = std::upper_bound(intervalMaxEnd.begin(), intervalMaxEnd.end(), from) - intervalMaxEnd.begin();
+  int32_t t = from;
+
+  while (true) {
+    int32_t day = t / 1440;
+    if (day >= firstDay + EVENT_INDEX_DAYS) return -1;
+
+    int32_t dayStart = day * 1440 + FREE_SLOT_START;
+    int32_t dayEnd   = day * 1440 + FREE_SLOT_END;
+    if (t < dayStart) t = dayStart;
+    if (t + minutes > dayEnd) {
+      t = (day + 1) * 1440;
+      continue;
+    }
+
+    while (i < intervals.size() && intervals[i].end <= t) i++;
+    if (i == intervals.size() || intervals[i].start >= t + minutes) return t;
+    t = intervals[i].end;
+    i++;
+  }
+}
+
+// Days of the week starting at firstDay (a Sunday) the event lands on, bit 0 = Sunday
+static uint8_t expandRuleInWeek(const EventRule& rule, const int years[7], const int months[7], const int days[7]) {
+  uint8_t mask = 0;
+  for (int wd = 0; wd < 7; wd++) {
+    if (eventOccursOn(rule, years[wd], months[wd], days[wd], wd)) mask |= 1 << wd;
+  }
+  return mask;
+}
+
+static void buildWeekLayout(int32_t firstDay) {
+  ensureEventsLoaded();
+  ensureRulesCompiled();
+
+  memset(&weekLayout, 0, sizeof(weekLayout));
+  weekLayout.firstDay   = firstDay;
+  weekLayout.generation = rulesGeneration;
+  weekLayout.valid      = true;
+
+  int years[7], months[7], days[7];
+  for (int wd = 0; wd < 7; wd++) {
+    CivilDate c = civilFromDays(firstDay + wd);
+    years[wd]  = c.year;
+    months[wd] = c.month;
+    days[wd]   = c.day;
+  }
+
+  for (size_t i = 0; i < eventRules.size(); i++) {
+    uint8_t mask = expandRuleInWeek(eventRules[i], years, months, days);
+    if (mask == 0) continue;
+
+    int16_t time = calendarEvents[i].time;
+
+    for (int wd = 0; wd < 7; wd++) {
+      if (!(mask & (1 << wd))) continue;
+
+      // Keep the earliest WEEK_SLOTS events in time order
+      int filled = weekLayout.count[wd] < WEEK_SLOTS ? weekLayout.count[wd] : WEEK_SLOTS;
+      int pos = filled;
+      while (pos > 0 && weekLayout.times[wd][pos - 1] > time) pos--;
+      if (pos < WEEK_SLOTS) {
+        for (int k = (filled < WEEK_SLOTS ? filled : WEEK_SLOTS - 1); k > pos; k--) {
+          weekLayout.slots[wd][k] = weekLayout.slots[wd][k - 1];
+          weekLayout.times[wd][k] = weekLayout.times[wd][k - 1];
+        }
+        weekLayout.slots[wd][pos] = i;
+        weekLayout.times[wd][pos] = time;
+      }
+      if (weekLayout.count[wd] < 255) weekLayout.count[wd]++;
+    }
+  }
+}
+
+// Day number of the Sunday weekOffset weeks from this one
+static int32_t weekStartDay(int weekOffset) {
+  DateTime now = rtc.now();
+  int32_t today = daysFromCivil(now.year(), now.month(), now.day());
+  return today - weekdayFromDays(today) + 7 * weekOffset;
+}
+
+// Switches to the week containing the given date with that day highlighted
+static void openWeekOf(int year, int month, int day) {
+  int32_t target = daysFromCivil(year, month, day);
+  weekSelectedDay = weekdayFromDays(target);
+  weekOffsetCount = (target - weekSelectedDay - weekStartDay(0)) / 7;
+  CurrentCalendarState = WEEK;
+  CurrentKBState = NORMAL;
+  newState = true;
+}
+
+// Commands available in both the month and week views. Returns true if handled.
+static bool commandCalendarCommon(String command) {
+  command.toLowerCase();
+
+  // "import" pulls in every new .ics file on the card, "import name" just one
+  if (command.startsWith("import")) {
+    String file = command.substring(6);
+    file.trim();
+    int count;
+    if (file.length() == 0) count = icsImportAll();
+    else {
+      if (!file.startsWith("/")) file = "/" + file;
+      if (!file.endsWith(".ics")) file += ".ics";
+      count = icsImport(file);
+    }
+
+    if (count < 0) oledWord("Import failed");
+    else oledWord("Imported " + String(count) + " events");
+    delay(1000);
+    newState = true;
+    return true;
   }
+
+  // "free 45" finds the next free 45 minutes
+  if (command.startsWith("free")) {
+    int minutes = stringToPositiveInt(command.substring(4));
+    if (minutes <= 0 || minutes > FREE_SLOT_END - FREE_SLOT_START) {
+      oledWord("Invalid");
+      delay(500);
+      return true;
+    }
+
+    // Search from now, rounded up to the next quarter hour
+    DateTime now = rtc.now();
+    int32_t from = daysFromCivil(now.year(), now.month(), now.day()) * 1440 + now.hour() * 60 + now.minute();
+    from = (from + 14) / 15 * 15;
+
+    int32_t slot = findFreeSlot(from, minutes);
+    if (slot < 0) oledWord("No free slot");
+    else {
+      CivilDate date = civilFromDays(slot / 1440);
+      char when[24];
+      snprintf(when, sizeof(when), "%s %d %02d:%02d", getMonthName(date.month).c_str(), date.day, slot % 1440 / 60, slot % 60);
+      oledWord("Free " + String(when));
+    }
+    delay(2000);
+    return true;
+  }
+
+  return false;
+}
+
+void commandSelectWeek(String command) {
+  command.trim();
+  if (commandCalendarCommon(command)) return;
+  const char* daysOfWeek[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+  int selected = -1;
+  if (command.length() >= 2) {
+    for (int wd = 0; wd < 7; wd++) {
+      if (command.equalsIgnoreCase(String(daysOfWeek[wd]).substring(0, command.length() < 3 ? command.length() : 3))) selected = wd;
+    }
+  }
+
+  if (selected == -1) {
+    oledWord("Invalid");
+    delay(500);
+    return;
+  }
+
+  // The layout is cached, so only the old and new columns need redrawing
+  if (weekSelectedDay >= 0) weekRedrawMask |= 1 << weekSelectedDay;
+  weekRedrawMask |= 1 << selected;
+  weekSelectedDay = selected;
 }
 
 void commandSelectMonth(String command) {
   command.toLowerCase();
 
+  if (commandCalendarCommon(command)) return;
+
   const char* monthNames[] = {
     "jan", "feb", "mar", "apr", "may", "jun",
     "jul", "aug", "sep", "oct", "nov", "dec"
@@ -187,14 +684,13 @@ void commandSelectMonth(String command) {
   }
   else {
     int intDay = stringToPositiveInt(command);
-    DateTime now = rtc.now();
-    if (intDay == -1 || intDay > daysInMonth(currentMonth, currentYear)) {
+    if (intDay < 1 || intDay > daysInMonth(currentYear, currentMonth)) {
       oledWord("Invalid");
       delay(500);
       return;
     }
     else {
-      // go to day
+      openWeekOf(currentYear, currentMonth, intDay);
     }
   }
 }
@@ -202,120 +698,58 @@ void commandSelectMonth(String command) {
 int checkEvents(String YYYYMMDD, bool countOnly = false) {
   int eventCount = 0;
 
-  // Load events array from file
-  updateEventArray();
+  // Load events array from file if needed
+  ensureEventsLoaded();
 
   // Validate date string format
   if (YYYYMMDD.length() != 8) return -1;
+  uint32_t date = parsePackedDate(YYYYMMDD.c_str(), YYYYMMDD.length());
+  if (date == 0) return -1;
 
   // Extrapolate the year, month, and day.
-  int year  = YYYYMMDD.substring(0, 4).toInt();
-  int month = YYYYMMDD.substring(4, 6).toInt();
-  int day   = YYYYMMDD.substring(6, 8).toInt();
-
-  // Determine day of the week
-  DateTime dt(year, month, day); // from RTClib
-  const char* daysOfWeek[] = { "Su", "Mo", "Tu", "We", "Th", "Fr", "Sa" };
-  const char* monthNames[] = {
-    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
-    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
-  };
-  String weekday   = String(daysOfWeek[dt.dayOfTheWeek()]);
-  String dayStr    = String(day);
-  String monthName = String(monthNames[month - 1]);
-  String dateCode  = monthName + (day < 10 ? "0" + dayStr : dayStr);  // e.g., "Apr05"
-
-  // Determine nth weekday in the month (e.g., 1st Mon, 2nd Tue)
-  int weekdayIndex = dt.dayOfTheWeek(); // 0 = Sunday
-  int nthWeekday = ((day - 1) / 7) + 1;  // 1-based week count
+  int year    = packedYear(date);
+  int month   = packedMonth(date);
+  int day     = packedDay(date);
+  int weekday = weekdayOf(year, month, day); // 0 = Sunday
 
   dayEvents.clear(); // Clear previous day's events
 
-  // Check whether any repeat events happen on this day
-  // Repeat Codes:
-  // DAILY (every day)
-  // WEEKLY Mo (every monday) or WEEKLY MoWeFr (every Mon, Wed, and Fri) or WEEKLY TuTh or WEEKLY_SaSu
-  // MONTHLY 23 (23rd of each month) or MONTHLY 1Tu or MONTHLY 2We (first Tues or 2nd Wed, etc.)
-  // YEARLY APR22 (yearly on Apr 22nd)
-
+  ensureRulesCompiled();
   for (size_t i = 0; i < calendarEvents.size(); i++) {
-    String dateCode = calendarEvents[i][1];
-    String repeatCode = calendarEvents[i][4];
-
-    // Exact match for this date
-    if (dateCode == YYYYMMDD) {
-      if (!countOnly) dayEvents.push_back(calendarEvents[i]);
-      eventCount++;
-      continue;
-    }
-
-    // DAILY (every day)
-    // Add all daily events
-    if (repeatCode == "DAILY") {
-      if (!countOnly) dayEvents.push_back(calendarEvents[i]);
-      eventCount++;
-      continue;
-    }
-
-    // WEEKLY [weekday]
-    // Add weekly event if it occurs on the same day as current day
-    if (repeatCode.startsWith("WEEKLY ") && repeatCode.indexOf(weekday) != -1) {
-      if (!countOnly) dayEvents.push_back(calendarEvents[i]);
-      eventCount++;
-      continue;
-    }
-
-    // MONTHLY [date] or 1Tu, 2We etc.
-    // Add monthly event if it occurs on the same date or ordinal weekday
-    if (repeatCode.startsWith("MONTHLY ")) {
-      String monthlyCode = repeatCode.substring(8); // Remove "MONTHLY "
-
-      // Match numeric date only (e.g., "23")
-      if (monthlyCode == dayStr) {
-        if (!countOnly) dayEvents.push_back(calendarEvents[i]);
-        eventCount++;
-        continue;
-      }
-
-      // Match ordinal weekday (e.g., "1Mo", "2Tu", etc.)
-      if (monthlyCode.length() == 3) {
-        char nthChar = monthlyCode.charAt(0);
-        String codeWeekday = monthlyCode.substring(1);
-
-        if (nthChar >= '1' && nthChar <= '5') {
-          int nth = nthChar - '0';
-          if (nth == nthWeekday && codeWeekday == weekday) {
-            if (!countOnly) dayEvents.push_back(calendarEvents[i]);
-            eventCount++;
-            continue;
-          }
-        }
-      }
-    }
-
-    // YEARLY [month][date]
-    // Add yearly event if it occurs on the same date as current date
-    if (repeatCode.startsWith("YEARLY ")) {
-      String yearlyCode = repeatCode.substring(7); // Remove "YEARLY "
-      if (yearlyCode.equalsIgnoreCase(dateCode)) {
-        if (!countOnly) dayEvents.push_back(calendarEvents[i]);
-        eventCount++;
-        continue;
-      }
-    }
+    if (!eventOccursOn(eventRules[i], year, month, day, weekday)) continue;
+    if (!countOnly) dayEvents.push_back(calendarEvents[i]);
+    eventCount++;
   }
 
   // Sort events by time if required
   if (!countOnly) {
-    std::sort(dayEvents.begin(), dayEvents.end(), [](const std::vector<String>& a, const std::vector<String>& b) {
-      // Time is stored in index 2 as "HHMM"
-      return a[2] < b[2];
+    std::stable_sort(dayEvents.begin(), dayEvents.end(), [](const CalendarEvent& a, const CalendarEvent& b) {
+      // All-day events (-1) first
+      return a.time < b.time;
     });
   }
 
   return eventCount;
 }
 
+// Fills counts[day] with the number of events on each day of the month, in
+// one pass over the compiled repeat rules.
+void countMonthEvents(int year, int month, uint8_t counts[32]) {
+  ensureEventsLoaded();
+  ensureRulesCompiled();
+  memset(counts, 0, 32);
+
+  int monthDays    = daysInMonth(year, month);
+  int firstWeekday = weekdayOf(year, month, 1); // 0 = Sunday
+
+  for (size_t i = 0; i < eventRules.size(); i++) {
+    uint32_t days = expandRuleInMonth(eventRules[i], year, month, firstWeekday, monthDays);
+    for (int d = 1; d <= monthDays; d++) {
+      if ((days & (1UL << d)) && counts[d] < 255) counts[d]++;
+    }
+  }
+}
+
 void drawCalendarMonth(int monthOffset) {
   int GRID_X =  7;     // X offset of first cell
   int GRID_Y = 49;     // Y offset of first row
@@ -338,11 +772,10 @@ void drawCalendarMonth(int monthOffset) {
   display.drawBitmap(0, 0, calendar_allArray[1], 320, 218, GxEPD_BLACK);
 
   // Step 2: Day of the week for the 1st of the month (0 = Sun, 6 = Sat)
-  DateTime firstDay(year, month, 1);
-  int startDay = firstDay.dayOfTheWeek();  // 0–6, Sun to Sat
+  int startDay = weekdayOf(year, month, 1);  // 0–6, Sun to Sat
 
   // Step 3: Number of days in the month
-  int daysInMonth = (DateTime(year, month + 1, 1) - DateTime(year, month, 1)).days();
+  int monthDays = daysInMonth(year, month);
 
   // Step 4: Blank out leading days
   for (int i = 0; i < startDay; ++i) {
@@ -353,7 +786,7 @@ void drawCalendarMonth(int monthOffset) {
 
   // Step 5: Blank out trailing days
   int totalBoxes = 42;  // 7x6 grid
-  int trailingStart = startDay + daysInMonth;
+  int trailingStart = startDay + monthDays;
   for (int i = trailingStart; i < totalBoxes; ++i) {
     int row = i / 7;
     int col = i % 7;
@@ -363,7 +796,10 @@ void drawCalendarMonth(int monthOffset) {
   }
 
   // Step 6: Draw day numbers and events
-  for (int i = 0; i < daysInMonth; ++i) {
+  uint8_t eventCounts[32];
+  countMonthEvents(year, month, eventCounts);
+
+  for (int i = 0; i < monthDays; ++i) {
     int dayIndex = i + startDay;     // total box index in the 7x6 grid
     int row = dayIndex / 7;
     int col = dayIndex % 7;
@@ -384,8 +820,7 @@ void drawCalendarMonth(int monthOffset) {
     display.print(dayNum);
 
     // Draw icon if there are events on day
-    String YYYYMMDD = String(year) + String(month) + String(dayNum);
-    int numEvents = checkEvents(YYYYMMDD, true);
+    int numEvents = eventCounts[dayNum];
     // Events found
     if (numEvents > 1) {
       // More than 1 event
@@ -398,12 +833,71 @@ void drawCalendarMonth(int monthOffset) {
   }
 }
 
-void drawCalendarWeek(int weekOffset) {
-  drawStatusBar("Type a Day: (Mon,Tue,etc)");
+// Draws the week grid from the cached layout. Selecting a day redraws the
+// whole grid in RAM but only pushes the changed columns to the panel.
+static void drawWeekPanel() {
+  int COL_X  =  7;     // X offset of the first column
+  int COL_W  = 44;     // Width of each column
+  int DATE_Y = 47;     // Top of the date box
+  int SLOT_Y = 67;     // Top of the first event box
+  int SLOT_H = 23;     // Event box pitch
+
   display.drawBitmap(0, 0, calendar_allArray[0], 320, 218, GxEPD_BLACK);
 
-  
-  
+  DateTime now = rtc.now();
+  int32_t today = daysFromCivil(now.year(), now.month(), now.day());
+
+  display.setFont(NULL);
+  for (int wd = 0; wd < 7; wd++) {
+    int x = COL_X + wd * COL_W;
+    CivilDate date = civilFromDays(weekLayout.firstDay + wd);
+
+    // Date box: selected day inverted, today outlined
+    uint16_t textColor = GxEPD_BLACK;
+    if (wd == weekSelectedDay) {
+      display.fillRect(x + 3, DATE_Y, COL_W - 6, 12, GxEPD_BLACK);
+      textColor = GxEPD_WHITE;
+    }
+    else if (weekLayout.firstDay + wd == today) {
+      display.drawRect(x + 3, DATE_Y, COL_W - 6, 12, GxEPD_BLACK);
+    }
+    display.setTextColor(textColor);
+    display.setCursor(x + (date.day < 10 ? 19 : 16), DATE_Y + 2);
+    display.print((int)date.day);
+
+    // Event boxes, the last one turns into "+N" when the day overflows
+    display.setTextColor(GxEPD_BLACK);
+    uint8_t shown = weekLayout.count[wd] < WEEK_SLOTS ? weekLayout.count[wd] : WEEK_SLOTS;
+    for (int k = 0; k < shown; k++) {
+      int y = SLOT_Y + k * SLOT_H;
+      if (k == WEEK_SLOTS - 1 && weekLayout.count[wd] > WEEK_SLOTS) {
+        display.setCursor(x + 10, y + 4);
+        display.print(("+" + String(weekLayout.count[wd] - (WEEK_SLOTS - 1))).c_str());
+        display.setCursor(x + 10, y + 12);
+        display.print("more");
+        break;
+      }
+
+      const CalendarEvent& event = calendarEvents[weekLayout.slots[wd][k]];
+      char time[5] = "All";
+      if (event.time >= 0 && event.time <= 9999) snprintf(time, sizeof(time), "%04u", (unsigned)event.time % 10000);
+      display.setCursor(x + 10, y + 4);
+      display.print(time);
+      display.setCursor(x + 10, y + 12);
+      display.print(event.name.substring(0, 5).c_str());
+    }
+  }
+}
+
+void drawCalendarWeek(int weekOffset) {
+  int32_t firstDay = weekStartDay(weekOffset);
+  if (!weekLayout.valid || weekLayout.firstDay != firstDay || !rulesCompiled || weekLayout.generation != rulesGeneration) {
+    buildWeekLayout(firstDay);
+  }
+
+  CivilDate first = civilFromDays(firstDay);
+  drawStatusBar(getMonthName(first.month) + " " + String(first.day) + " | Type a Day:");
+  drawWeekPanel();
 }
 
 // Loops
@@ -462,9 +956,8 @@ void processKB_CALENDAR() {
         }
         // CENTER Recieved
         else if (inchar == 20 || inchar == 7) {
-          CurrentCalendarState = WEEK;
-          CurrentKBState  = NORMAL;
-          newState = true;
+          if (monthOffsetCount == 0) openWeekOf(now.year(), now.month(), now.day());
+          else openWeekOf(currentYear, currentMonth, 1);
           delay(200);
           break;
         }
@@ -499,7 +992,7 @@ void processKB_CALENDAR() {
         }  
         //CR Recieved
         else if (inchar == 13) {                          
-          commandSelectMonth(currentLine);
+          commandSelectWeek(currentLine);
           currentLine = "";
         }                                      
         //SHIFT Recieved
@@ -525,11 +1018,13 @@ void processKB_CALENDAR() {
         // LEFT Recieved
         else if (inchar == 19) {
           weekOffsetCount--;
+          weekSelectedDay = -1;
           newState = true;
         }
         // RIGHT Recieved
         else if (inchar == 21) {
           weekOffsetCount++;
+          weekSelectedDay = -1;
           newState = true;
         }
         // CENTER Recieved
@@ -574,6 +1069,23 @@ void einkHandler_CALENDAR() {
         forceSlowFullUpdate = true;
         refresh();
         //multiPassRefesh(2);
+        weekRedrawMask = 0;
+      }
+      else if (weekRedrawMask) {
+        // Same week, only the changed columns
+        int firstCol = 0, lastCol = 6;
+        while (!(weekRedrawMask & (1 << firstCol))) firstCol++;
+        while (!(weekRedrawMask & (1 << lastCol))) lastCol--;
+        weekRedrawMask = 0;
+
+        display.setRotation(3);
+        display.setFullWindow();
+        display.fillScreen(GxEPD_WHITE);
+        drawWeekPanel();
+        display.displayWindow(7 + 44 * firstCol, 27, 44 * (lastCol - firstCol + 1), 184);
+
+        display.fillScreen(GxEPD_WHITE);
+        display.hibernate();
       }
       break;
     case MONTH:
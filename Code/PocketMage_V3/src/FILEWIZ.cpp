@@ -34,6 +34,7 @@ void processKB_FILEWIZ() {
         if (inchar == 0);
         //BKSP Recieved
         else if (inchar == 127 || inchar == 8 || inchar == 12) {
+          indexResultsActive = false;
           CurrentAppState = HOME;
           currentLine     = "";
           CurrentKBState  = NORMAL;
@@ -129,6 +130,7 @@ void processKB_FILEWIZ() {
         else if (inchar == 'y' || inchar == 'Y') {
           // DELETE FILE
           delFile(workingFile);
+          indexResultsActive = false;
           
           // RETURN TO FILE WIZ HOME
           CurrentFileWizState = WIZ0_;
@@ -197,6 +199,7 @@ void processKB_FILEWIZ() {
           // RENAME FILE                    
           String newName = "/" + currentWord + ".txt";
           renFile(workingFile, newName);
+          indexResultsActive = false;
 
           // RETURN TO WIZ0
           CurrentFileWizState = WIZ0_;
@@ -268,6 +271,7 @@ void processKB_FILEWIZ() {
           // RENAME FILE                    
           String newName = "/" + currentWord + ".txt";
           copyFile(workingFile, newName);
+          indexResultsActive = false;
 
           // RETURN TO WIZ0
           CurrentFileWizState = WIZ0_;
@@ -298,6 +302,48 @@ void processKB_FILEWIZ() {
   }
 }
 
+// Fills the picture panel of WIZ1_ with the file's date, size and first line
+void drawFileDetails(const String& meta) {
+  if (meta == "") return;
+
+  const int panelX = 201, panelY = 33, panelW = 102, panelH = 137;
+  const int maxChars = 9;
+  display.fillRect(panelX, panelY, panelW, panelH, GxEPD_WHITE);
+
+  String stamp = getMetadataField(meta, 1);  // YYYYMMDD-HHMM
+  String bytes = getMetadataField(meta, 2);
+  String words = getMetadataField(meta, 4);
+  long size = bytes.toInt();
+
+  std::vector<String> details;
+  details.push_back(stamp.substring(4, 6) + "/" + stamp.substring(6, 8) + "/" + stamp.substring(2, 4));
+  details.push_back(stamp.substring(9, 11) + ":" + stamp.substring(11, 13));
+  if (words != "") details.push_back(words.substring(0, words.indexOf(' ')) + " wds");
+  if (size < 1024) details.push_back(String((int)size) + " B");
+  else             details.push_back(String((int)(size / 1024)) + " KB");
+
+  for (size_t i = 0; i < details.size(); i++) {
+    display.setCursor(panelX + 3, panelY + 15 + (17 * i));
+    display.print(details[i]);
+  }
+
+  // FIRST LINE, WRAPPED TO THE PANEL
+  String preview = getMetadataField(meta, 6);
+  int line = details.size();
+  display.drawRect(panelX + 3, panelY + 8 + (17 * line), panelW - 6, 1, GxEPD_BLACK);
+  while (preview.length() > 0 && line < 7) {
+    String chunk = preview.substring(0, maxChars);
+    int lastSpace = chunk.lastIndexOf(' ');
+    if (preview.length() > maxChars && lastSpace > 0) chunk = chunk.substring(0, lastSpace);
+    preview = preview.substring(chunk.length());
+    preview.trim();
+    if (line == 6 && preview.length() > 0) chunk = chunk.substring(0, maxChars - 2) + "..";
+    display.setCursor(panelX + 3, panelY + 27 + (17 * line));
+    display.print(chunk);
+    line++;
+  }
+}
+
 void einkHandler_FILEWIZ() {
   switch (CurrentFileWizState) {
     case WIZ0_:
@@ -308,17 +354,51 @@ void einkHandler_FILEWIZ() {
         display.fillScreen(GxEPD_WHITE);
 
         // DRAW APP
-        drawStatusBar("Select a File (0-9)");
+        if (indexResultsActive) drawStatusBar("Search Results (0-9)");
+        else                    drawStatusBar("Select a File (0-9)");
         display.drawBitmap(0, 0, fileWizardallArray[0], 320, 218, GxEPD_BLACK);
 
-        // DRAW FILE LIST
-        keypad.disableInterrupts();
-        listDir(SD_MMC, "/");
-        keypad.enableInterrupts();
+        // DRAW FILE LIST (SEARCH RESULTS ARE ALREADY IN filesList)
+        if (!indexResultsActive) {
+          keypad.disableInterrupts();
+          listDir(SD_MMC, "/");
+          keypad.enableInterrupts();
+        }
+
+        // FILE STATS COME FROM ONE PASS OVER THE METADATA FILE
+        loadFilesListMetadata();
 
         for (int i = 0; i < MAX_FILES; i++) {
+          String name = filesList[i];
+          if (indexResultsActive && name != "-") name += " L" + String(indexResultLines[i] + 1);
+
+          // WORD COUNT AND DATE (MM/DD)
+          String stats = "";
+          if (filesListMeta[i] != "") {
+            String stamp = getMetadataField(filesListMeta[i], 1);
+            String words = getMetadataField(filesListMeta[i], 4);
+            if (words != "") stats = words.substring(0, words.indexOf(' ')) + "w ";
+            stats += stamp.substring(4, 6) + "/" + stamp.substring(6, 8);
+          }
+
+          int16_t x1, y1;
+          uint16_t statsWidth = 0, nameWidth, textHeight;
+          if (stats != "") display.getTextBounds(stats, 0, 0, &x1, &y1, &statsWidth, &textHeight);
+          int statsX = display.width() - 8 - statsWidth;
+
+          // Shorten long names so they don't run into the stats
+          display.getTextBounds(name, 0, 0, &x1, &y1, &nameWidth, &textHeight);
+          while (name.length() > 1 && 30 + nameWidth > statsX - 6) {
+            name.remove(name.length() - 1);
+            display.getTextBounds(name, 0, 0, &x1, &y1, &nameWidth, &textHeight);
+          }
+
           display.setCursor(30, 54+(17*i));
-          display.print(filesList[i]);
+          display.print(name);
+          if (stats != "") {
+            display.setCursor(statsX, 54+(17*i));
+            display.print(stats);
+          }
         }
 
         refresh();
@@ -335,6 +415,9 @@ void einkHandler_FILEWIZ() {
         drawStatusBar("- " + workingFile);
         display.drawBitmap(0, 0, fileWizardallArray[1], 320, 218, GxEPD_BLACK);
 
+        // FILE DETAILS AND PREVIEW FROM METADATA
+        drawFileDetails(getFileMetadata(workingFile));
+
         refresh();
       }
       break;
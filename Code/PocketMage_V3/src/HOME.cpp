@@ -10,49 +10,65 @@
 void commandSelect(String command) {
   command.toLowerCase();
 
-  // OPEN IN FILE WIZARD
-  if (command.startsWith("-")) {
-    command = removeChar(command, ' ');
-    command = removeChar(command, '-');
+  // OPEN BEST FUZZY MATCH ("-name" in file wizard, "/name" in editor)
+  if (command.startsWith("-") || command.startsWith("/")) {
     keypad.disableInterrupts();
-    listDir(SD_MMC, "/");
+    int matches = finderFinish(command.substring(1));
     keypad.enableInterrupts();
 
-    for (uint8_t i = 0; i < (sizeof(filesList) / sizeof(filesList[0])); i++) {
-      String lowerFileName = filesList[i]; 
-      lowerFileName.toLowerCase();
-      if (command == lowerFileName || (command+".txt") == lowerFileName || ("/"+command+".txt") == lowerFileName) {
-        workingFile = filesList[i];
-        CurrentAppState = FILEWIZ;
-        CurrentFileWizState = WIZ1_;
-        CurrentKBState  = FUNC;
-        newState = true;
-        return;
-      }
+    if (matches == 0) {
+      oledWord("No Matching File");
+      delay(1000);
+      return;
+    }
+
+    if (command.startsWith("-")) {
+      workingFile = finderTop[0].substring(1);
+      CurrentAppState = FILEWIZ;
+      CurrentFileWizState = WIZ1_;
+      CurrentKBState  = FUNC;
+      newState = true;
+    }
+    else {
+      editingFile = finderTop[0];
+      loadFile();
+      CurrentAppState = TXT;
+      CurrentTXTState = TXT_;
+      CurrentKBState  = NORMAL;
+      newLineAdded = true;
     }
+    return;
   }
 
-  // OPEN IN TXT EDITOR
-  if (command.startsWith("/")) {
-    command = removeChar(command, ' ');
-    command = removeChar(command, '/');
+  // FULL-TEXT SEARCH
+  if (command.startsWith("?") || command.startsWith("find ") || command.startsWith("search ")) {
+    String query = command.substring(command.indexOf(command.startsWith("?") ? '?' : ' ') + 1);
+    query.trim();
+    if (query.length() == 0) return;
+
+    oledWord("Searching: " + query);
     keypad.disableInterrupts();
-    listDir(SD_MMC, "/");
+    int hits = indexSearch(query);
     keypad.enableInterrupts();
 
-    for (uint8_t i = 0; i < (sizeof(filesList) / sizeof(filesList[0])); i++) {
-      String lowerFileName = filesList[i]; 
-      lowerFileName.toLowerCase();
-      if (command == lowerFileName || (command+".txt") == lowerFileName || ("/"+command+".txt") == lowerFileName) {
-        editingFile = filesList[i];
-        loadFile();
-        CurrentAppState = TXT;
-        CurrentTXTState = TXT_;
-        CurrentKBState  = NORMAL;
-        newLineAdded = true;
-        return;
-      }
+    if (hits == 0) {
+      oledWord("No Matches");
+      delay(1000);
+      return;
     }
+
+    CurrentAppState = FILEWIZ;
+    CurrentFileWizState = WIZ0_;
+    CurrentKBState  = FUNC;
+    newState = true;
+    return;
+  }
+
+  if (command == "reindex") {
+    indexRequestRebuild();
+    oledWord("Rebuilding Search Index");
+    delay(1000);
+    return;
   }
 
   if (command.startsWith("timeset")) {
@@ -101,6 +117,9 @@ void commandSelect(String command) {
   else if (command == "lex" || command == "lexicon" || command == "dict" || command == "dictionary" || command == "9") {
     LEXICON_INIT();
   }
+  else if (command == "stool" || command == "bristol" || command == "8") {
+    STOOL_INIT();
+  }
   /////////////////////////////
   else if (command == "i farted") {
     oledWord("That smells");
@@ -144,7 +163,10 @@ void processKB_HOME() {
         char inchar = updateKeypress();
         // HANDLE INPUTS
         //No char recieved
-        if (inchar == 0);   
+        if (inchar == 0) {
+          // Matches grow while the finder is still reading the card
+          if (finderStep() && (currentLine.startsWith("/") || currentLine.startsWith("-"))) oledFinder(currentLine);
+        }
         //CR Recieved
         else if (inchar == 13) {                          
           commandSelect(currentLine);
@@ -186,7 +208,12 @@ void processKB_HOME() {
         //Make sure oled only updates at OLED_MAX_FPS
         if (currentMillis - OLEDFPSMillis >= (1000/OLED_MAX_FPS)) {
           OLEDFPSMillis = currentMillis;
-          oledLine(currentLine, false);
+          // Live file matches while typing "/name" or "-name"
+          if (currentLine.startsWith("/") || currentLine.startsWith("-")) {
+            finderUpdate(currentLine.substring(1));
+            oledFinder(currentLine);
+          }
+          else oledLine(currentLine, false);
         }
       }
       break;
@@ -253,12 +280,21 @@ void einkHandler_HOME() {
         if (!tasks.empty()) {
           if (DEBUG_VERBOSE) Serial.println("Printing Tasks");
 
-          int loopCount = std::min((int)tasks.size(), 7);
-          for (int i = 0; i < loopCount; i++) {
-            display.setFont(&FreeSerif9pt7b);
-            // PRINT TASK NAME
+          // Grouped by due bucket, overdue first
+          TaskRow rows[7];
+          uint8_t rowCount = layoutTaskGroups(rows, 7);
+          for (int i = 0; i < rowCount; i++) {
             display.setCursor(151, 68 + (25 * i));
-            display.print(tasks[i][0].c_str());
+            if (rows[i].task < 0) {
+              // PRINT GROUP HEADING
+              display.setFont(&FreeMonoBold9pt7b);
+              display.print(taskBucketNames[rows[i].bucket]);
+            }
+            else {
+              // PRINT TASK NAME
+              display.setFont(&FreeSerif9pt7b);
+              display.print(tasks[rows[i].task].name.c_str());
+            }
           }
         }
 
@@ -1,8 +1,26 @@
 #include "globals.h"
 
-// Vector to hold the definitions
+// Matches of the last lookup. With the compiled dictionary they stay on the
+// card as records [lexFirst, lexEnd), or the ranked records in lexHits for a
+// reverse lookup ("?small boat"), and only the one on screen is read.
+// Without it the text files are scanned and the matches kept in defList.
 std::vector<std::pair<String, String>> defList;
 int definitionIndex = 0;
+static bool     lexCompiled = false;
+static uint32_t lexFirst = 0;
+static uint32_t lexEnd = 0;
+static bool     lexSearching = false;
+static uint32_t lexHits[DICT_SEARCH_RESULTS];
+static uint8_t  lexHitCount = 0;
+static String   lexHead = "";
+static String   lexDef = "";
+
+// Completions of the line being typed, from the dictionary's trie
+static String   lexSuggest[DICT_TRIE_TOP];
+static uint8_t  lexSuggestCount = 0;
+static String   lexSuggestQuery = "";
+static bool     lexSuggestReady = false;       // An image was there to ask
+static bool     lexGuessed = false;            // They are "did you mean" guesses for a miss
 
 void LEXICON_INIT() {
   // OPEN SETTINGS
@@ -14,18 +32,33 @@ void LEXICON_INIT() {
   definitionIndex = 0;
 }
 
-void loadDefinitions(String word) {
-  oledWord("Loading Definitions");
-  SDActive = true;
-  setCpuFrequencyMhz(240);
-  delay(50);
+static int lexMatchCount() {
+  if (!lexCompiled) return (int)defList.size();
+  return lexSearching ? (int)lexHitCount : (int)(lexEnd - lexFirst);
+}
 
-  defList.clear();  // Clear previous results
+// Loads match definitionIndex into lexHead and lexDef
+static void showDefinition() {
+  if (!lexCompiled) {
+    lexHead = defList[definitionIndex].first;
+    lexDef  = defList[definitionIndex].second;
+    return;
+  }
 
-  if (word.length() == 0 || noSD) return;
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+  if (dictBegin()) {
+    dictEntry(lexSearching ? lexHits[definitionIndex] : lexFirst + definitionIndex, lexHead, lexDef);
+    dictEnd();
+  }
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+}
 
+// Fallback for cards without DICT_FILE: scan /dict/<Letter>.txt
+static bool scanDefinitionText(String word) {
   char firstChar = tolower(word[0]);
-  if (firstChar < 'a' || firstChar > 'z') return;
+  if (firstChar < 'a' || firstChar > 'z') return true;
 
   String filePath = "/dict/" + String((char)toupper(firstChar)) + ".txt";
 
@@ -33,7 +66,7 @@ void loadDefinitions(String word) {
   if (!file) {
     oledWord("Missing Dictionary!");
     delay(2000);
-    return;
+    return false;
   }
 
   word.toLowerCase();
@@ -64,15 +97,92 @@ void loadDefinitions(String word) {
   }
 
   file.close();
+  return true;
+}
 
-  if (defList.empty()) {
-    oledWord("No definitions found");
-    delay(2000);
+// Only asks the card again when the line changed since the last frame
+static void updateSuggestions() {
+  if (currentLine == lexSuggestQuery) return;
+  lexSuggestQuery = currentLine;
+  lexSuggestCount = 0;
+  lexGuessed = false;
+  if (currentLine.length() == 0 || currentLine[0] == '?') return;
+
+  unsigned long start = millis();
+  uint32_t loads = dictBlockLoads;
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+  lexSuggestReady = dictBegin();
+  if (lexSuggestReady) {
+    lexSuggestCount = dictComplete(currentLine, lexSuggest, DICT_TRIE_TOP);
+    dictEnd();
+  }
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+
+  if (DEBUG_VERBOSE) {
+    Serial.println("Completions: " + String(millis() - start) + " ms, " + String(dictBlockLoads - loads) + " blocks");
+  }
+}
+
+// A word starting with '?' looks for the rest inside the definitions. A miss
+// the dictionary has near words for leaves them in the completions, with the
+// word kept on the line for TAB to replace.
+void loadDefinitions(String word) {
+  oledWord("Loading Definitions");
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+  delay(50);
+
+  defList.clear();  // Clear previous results
+  lexCompiled = false;
+  lexSearching = false;
+  definitionIndex = 0;
+  bool searched = false;
+  lexGuessed = false;
+
+  // The image may be in flash, so no card is needed for it
+  if (word.length() > 0) {
+    if (dictBegin()) {
+      if (word[0] == '?') {
+        lexHitCount  = dictSearch(word.substring(1), lexHits, DICT_SEARCH_RESULTS);
+        lexCompiled  = lexHitCount > 0;
+        lexSearching = lexCompiled;
+        if (lexCompiled) dictEntry(lexHits[0], lexHead, lexDef);
+      }
+      else {
+        lexCompiled = dictFind(word, lexFirst, lexEnd);
+        if (lexCompiled) dictEntry(lexFirst, lexHead, lexDef);
+        else {
+          lexSuggestCount = dictSuggest(word, lexSuggest, DICT_TRIE_TOP);
+          lexSuggestQuery = word;
+          lexSuggestReady = true;
+          lexGuessed = lexSuggestCount > 0;
+        }
+      }
+      dictEnd();
+      searched = true;
+    }
+    else if (!noSD) {
+      searched = scanDefinitionText(word);
+      if (!defList.empty()) showDefinition();
+    }
+  }
+
+  if (lexGuessed) {
+    CurrentLexState = MENU;
+    CurrentKBState  = NORMAL;
+    newState = true;
+  }
+  else if (lexMatchCount() == 0) {
+    if (searched) {
+      oledWord("No definitions found");
+      delay(2000);
+    }
   }
   else {
     CurrentLexState = DEF;
     CurrentKBState  = NORMAL;
-    definitionIndex = 0;
     newState = true;
   }
 
@@ -93,8 +203,12 @@ void processKB_LEXICON() {
         //CR Recieved
         else if (inchar == 13) {                          
           loadDefinitions(currentLine);
-          currentLine = "";
+          if (!lexGuessed) currentLine = "";
         }                                      
+        //TAB Recieved - take the best completion
+        else if (inchar == 9) {
+          if (lexSuggestCount > 0) currentLine = lexSuggest[0];
+        }
         //SHIFT Recieved
         else if (inchar == 17) {                                  
           if (CurrentKBState == SHIFT) CurrentKBState = NORMAL;
@@ -138,7 +252,9 @@ void processKB_LEXICON() {
         //Make sure oled only updates at OLED_MAX_FPS
         if (currentMillis - OLEDFPSMillis >= (1000/OLED_MAX_FPS)) {
           OLEDFPSMillis = currentMillis;
-          oledLine(currentLine, false);
+          updateSuggestions();
+          if (lexSuggestReady) oledSuggest(currentLine, lexSuggest, lexSuggestCount);
+          else oledLine(currentLine, false);
         }
       }
       break;
@@ -152,7 +268,7 @@ void processKB_LEXICON() {
         //CR Recieved
         else if (inchar == 13) {                          
           loadDefinitions(currentLine);
-          currentLine = "";
+          if (!lexGuessed) currentLine = "";
         }                                      
         //SHIFT Recieved
         else if (inchar == 17) {                                  
@@ -188,15 +304,19 @@ void processKB_LEXICON() {
 
         // LEFT Recieved
         else if (inchar == 19) {
-          definitionIndex--;
-          if (definitionIndex < 0) definitionIndex = 0;
-          newState = true;
+          if (definitionIndex > 0) {
+            definitionIndex--;
+            showDefinition();
+            newState = true;
+          }
         }
         // RIGHT Received
         else if (inchar == 21) {
-          definitionIndex++;
-          if (definitionIndex >= defList.size()) definitionIndex = defList.size() - 1;
-          newState = true;
+          if (definitionIndex + 1 < lexMatchCount()) {
+            definitionIndex++;
+            showDefinition();
+            newState = true;
+          }
         }
 
         else {
@@ -226,7 +346,8 @@ void einkHandler_LEXICON() {
 
         display.drawBitmap(0, 0, _lex0, 320, 218, GxEPD_BLACK);
 
-        drawStatusBar("Type a Word:");
+        if (lexGuessed) drawStatusBar("Not found. TAB: " + lexSuggest[0]);
+        else drawStatusBar("Type a Word, or ?meaning:");
 
         multiPassRefesh(2);
       }
@@ -242,15 +363,15 @@ void einkHandler_LEXICON() {
         // Draw Word
         display.setFont(&FreeSerif12pt7b);
         display.setCursor(12, 50);
-        display.print(defList[definitionIndex].first);
+        display.print(lexHead);
 
         // Draw Definition
         display.setFont(&FreeSerif9pt7b);
         display.setCursor(8, 87);
         // ADD WORD WRAP
-        display.print(defList[definitionIndex].second);
+        display.print(lexDef);
 
-        drawStatusBar("Type a New Word:");
+        drawStatusBar("Type a New Word: (" + String(definitionIndex + 1) + "/" + String(lexMatchCount()) + ")");
 
         forceSlowFullUpdate = true;
         refresh();
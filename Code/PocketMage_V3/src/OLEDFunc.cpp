@@ -120,6 +120,49 @@ void oledLine(String line, bool doProgressBar) {
   u8g2.sendBuffer();
 }
 
+// Typed line on the left, up to FINDER_TOP picks on the right, the first one
+// marked. keepEnd shortens long items from the front instead of the back.
+static void oledPicks(const String& line, const String* items, uint8_t count, bool keepEnd) {
+  u8g2.clearBuffer();
+  infoBar();
+
+  u8g2.setFont(u8g2_font_ncenB12_tr);
+  int lineX = 0;
+  if (u8g2.getStrWidth(line.c_str()) > 96) lineX = 96 - u8g2.getStrWidth(line.c_str());
+  u8g2.drawStr(lineX, 16, line.c_str());
+  u8g2.setDrawColor(0);
+  u8g2.drawBox(100, 0, u8g2.getDisplayWidth() - 100, 24);
+  u8g2.setDrawColor(1);
+
+  u8g2.setFont(u8g2_font_5x7_tf);
+  if (count == 0 && line.length() > 1) {
+    u8g2.drawStr(104, 15, "No match");
+  }
+  for (int i = 0; i < count && i < FINDER_TOP; i++) {
+    String item = items[i];
+    int maxChars = (u8g2.getDisplayWidth() - 110) / 5;
+    if ((int)item.length() > maxChars) {
+      if (keepEnd) item = "..." + item.substring(item.length() - maxChars + 3);
+      else item = item.substring(0, maxChars - 3) + "...";
+    }
+    if (i == 0) u8g2.drawStr(104, 7, ">");
+    u8g2.drawStr(110, 7 + 8 * i, item.c_str());
+  }
+
+  u8g2.sendBuffer();
+}
+
+// Command line on the left, best finder matches on the right
+void oledFinder(const String& line) {
+  // Keep the end of long paths, the file name matters most
+  oledPicks(line, finderTop, finderTopCount, true);
+}
+
+// Lexicon input on the left, completions on the right
+void oledSuggest(const String& line, const String* words, uint8_t count) {
+  oledPicks(line, words, count, false);
+}
+
 void infoBar() {
   int infoWidth = 16;
 
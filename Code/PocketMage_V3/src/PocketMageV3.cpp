@@ -45,6 +45,9 @@ void applicationEinkHandler() {
     case LEXICON:
       einkHandler_LEXICON();
       break;
+    case STOOL:
+      einkHandler_STOOL();
+      break;
     // ADD APP CASES HERE
     default:
       einkHandler_HOME();
@@ -86,6 +89,9 @@ void processKB() {
     case LEXICON:
       processKB_LEXICON();
       break;
+    case STOOL:
+      processKB_STOOL();
+      break;
     // ADD APP CASES HERE
     default:
       processKB_HOME();
@@ -104,6 +110,7 @@ void processKB() {
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////|
 // SETUP
 void setup() {
+  Serial.setRxBufferSize(SYNC_RX_BUFFER);
   Serial.begin(115200);
   Wire.begin(I2C_SDA, I2C_SCL);
   SPI.begin(SPI_SCK, -1, SPI_MOSI, -1);
@@ -181,9 +188,15 @@ void setup() {
     File f = SD_MMC.open("/sys/SDMMC_META.txt", FILE_WRITE);
     if (f) f.close();
   }
+
+  // FLASH SYSTEM STORE SETUP
+  sysfsBegin();
  
   loadState();
 
+  // USB SERIAL SYNC (tools/pmsync, tools/pmremote)
+  syncBegin();
+
   // EINK HANDLER SETUP
   display.init(115200);
   display.setRotation(3);
@@ -235,11 +248,19 @@ void setup() {
 }
 
 void loop() {
+  remoteLoopBegin();
   if (!noTimeout)  checkTimeout();
   if (DEBUG_VERBOSE) printDebug();
 
   updateBattState();
   processKB();
+  syncPoll();
+
+  // Background SD work
+  sysfsFlushStep();
+  reconcileStep();
+  indexBackgroundStep();
+  remoteLoopEnd();
 
   // Yield to watchdog
   vTaskDelay(50 / portTICK_PERIOD_MS);
@@ -14,11 +14,13 @@
 #endif
 
 // Bristol Stool Chart App Implementation
-// Storage format: type|timestamp|note
+// Storage format: type|timestamp|note, appended in time order
 // Example: 4|20250115143000|Normal consistency
+// Only the latest STOOL_RECENT entries are loaded, read from the end of the
+// log. Counts per day and week live in rollup files next to it (see ROLLUPS).
 
 // Global variables
-std::vector<std::vector<String>> stoolEntries;
+std::vector<StoolEntry> stoolEntries;
 StoolState CurrentStoolState = STOOL0;
 uint8_t selectedStoolEntry = 0;
 String newStoolNote = "";
@@ -30,6 +32,7 @@ void STOOL_INIT() {
   newState = true;
   selectedStoolEntry = 0;
   newStoolNote = "";
+  CurrentKBState = FUNC;
   updateStoolArray();
 }
 
@@ -59,27 +62,360 @@ String getCurrentTimestamp() {
   // Mock timestamp for testing - increment to ensure different timestamps
   static int mockSeconds = 0;
   mockSeconds++;
-  String baseTime = "2025011514300";
+  String baseTime = "202501151430";
   String seconds = String(mockSeconds % 60);
   if (seconds.length() == 1) seconds = "0" + seconds;
   return baseTime + seconds;
   #endif
 }
 
-String formatStoolTimestamp(String timestamp) {
-  if (timestamp.length() != 14) {
+// YYYYMMDDhhmmss as one comparable integer, 0 if unreadable
+static uint64_t stoolTimestampKey(const char* timestamp, size_t len) {
+  if (len != 14) return 0;
+  uint32_t date = parsePackedDate(timestamp, len);
+  int32_t time = parseDigits(timestamp + 8, 6);
+  if (date == 0 || time < 0) return 0;
+  return (uint64_t)date * 1000000 + time;
+}
+
+static uint64_t stoolTimestampKey(const String& timestamp) {
+  return stoolTimestampKey(timestamp.c_str(), timestamp.length());
+}
+
+String formatStoolTime(uint64_t time) {
+  if (time == 0) {
     return "Invalid";
   }
-  
-  String month = timestamp.substring(4, 6);
-  String day = timestamp.substring(6, 8);
-  String year = timestamp.substring(2, 4);
-  String hour = timestamp.substring(8, 10);
-  String minute = timestamp.substring(10, 12);
-  
-  return month + "/" + day + "/" + year + " " + hour + ":" + minute;
+
+  uint32_t date = time / 1000000;
+  uint32_t clock = time % 1000000;
+  if (!isValidPacked(date)) return "Invalid";
+  char formatted[15];
+  snprintf(formatted, sizeof(formatted), "%02u/%02u/%02u %02u:%02u",
+           (unsigned)packedMonth(date) % 100, (unsigned)packedDay(date) % 100, (unsigned)packedYear(date) % 100,
+           (unsigned)(clock / 10000), (unsigned)(clock / 100 % 100));
+  return String(formatted);
+}
+
+String formatStoolTimestamp(String timestamp) {
+  return formatStoolTime(stoolTimestampKey(timestamp));
+}
+
+static bool stoolNewerFirst(const StoolEntry& a, const StoolEntry& b) {
+  return a.time > b.time;
+}
+
+// The stamp is always YYYYMMDDhhmmss or empty, a date past 8 digits is dropped
+static String encodeStoolEntry(const StoolEntry& entry) {
+  char stamp[15] = "";
+  uint64_t date = entry.time / 1000000;
+  if (entry.time && date <= 99999999) snprintf(stamp, sizeof(stamp), "%08lu%06lu", (unsigned long)(date % 100000000), (unsigned long)(entry.time % 1000000));
+  return String(entry.type) + "|" + stamp + "|" + escapeField(entry.note);
+}
+
+static bool decodeStoolEntry(RecordReader<File>& reader, StoolEntry& entry) {
+  if (reader.count < 3) return false;
+  entry.type = (uint8_t)fieldInt(reader.fields[0], 0);
+  entry.time = stoolTimestampKey(reader.fields[1].ptr, reader.fields[1].len);
+  entry.note = String(reader.fields[2].ptr);
+  return true;
+}
+
+// ROLLUPS
+// Counts per Bristol type for every day (STOOL_DAYS_FILE) and week
+// (STOOL_WEEKS_FILE) with entries, oldest first, in fixed-width lines so one
+// record can be rewritten in place:
+//   #0000004096                              <- log bytes these counts cover
+//   20250115|000|001|000|002|000|000|000
+// Adding or deleting an entry touches one day and one week record (almost
+// always the last one). A header that doesn't match the log's size means the
+// log was changed elsewhere (USB), and both files are rebuilt from the log.
+static const size_t ROLLUP_HEADER_LEN = 12;
+static const size_t ROLLUP_RECORD_LEN = 37;
+
+struct StoolRollup {
+  uint32_t key;          // YYYYMMDD of the day, or of the week's Sunday
+  uint16_t counts[7];    // Entries per Bristol type 1-7
+};
+
+static uint32_t stoolWeekOf(uint32_t day) {
+  int32_t days = daysFromPacked(day);
+  return packedFromDays(days - weekdayFromDays(days));
+}
+
+// Always exactly ROLLUP_RECORD_LEN bytes, the binary search depends on it.
+// Counts are clamped to 999 like countInto(), a key past 8 digits reads as 0.
+static unsigned rollupCount(uint16_t count) {
+  return count < 999 ? count : 999;
 }
 
+static void formatRollup(char* out, const StoolRollup& rollup) {
+  unsigned long key = rollup.key <= 99999999 ? rollup.key : 0;
+  snprintf(out, ROLLUP_RECORD_LEN + 1, "%08lu|%03u|%03u|%03u|%03u|%03u|%03u|%03u\n", key % 100000000,
+           rollupCount(rollup.counts[0]) % 1000, rollupCount(rollup.counts[1]) % 1000, rollupCount(rollup.counts[2]) % 1000,
+           rollupCount(rollup.counts[3]) % 1000, rollupCount(rollup.counts[4]) % 1000, rollupCount(rollup.counts[5]) % 1000,
+           rollupCount(rollup.counts[6]) % 1000);
+}
+
+static bool readRollupAt(File& file, size_t index, StoolRollup& rollup) {
+  char line[ROLLUP_RECORD_LEN + 1];
+  if (!file.seek(ROLLUP_HEADER_LEN + index * ROLLUP_RECORD_LEN)) return false;
+  if (file.read((uint8_t*)line, ROLLUP_RECORD_LEN) != ROLLUP_RECORD_LEN || line[ROLLUP_RECORD_LEN - 1] != '\n') return false;
+
+  FieldSpan fields[8];
+  if (splitRecord(line, ROLLUP_RECORD_LEN - 1, fields, 8) != 8) return false;
+  rollup.key = fieldDate(fields[0]);
+  for (int i = 0; i < 7; i++) rollup.counts[i] = fieldInt(fields[i + 1], 0);
+  return rollup.key != 0;
+}
+
+static bool writeRollupAt(File& file, size_t index, const StoolRollup& rollup) {
+  char line[ROLLUP_RECORD_LEN + 1];
+  formatRollup(line, rollup);
+  if (!file.seek(ROLLUP_HEADER_LEN + index * ROLLUP_RECORD_LEN)) return false;
+  return file.write((const uint8_t*)line, ROLLUP_RECORD_LEN) == ROLLUP_RECORD_LEN;
+}
+
+// Log bytes the file covers, -1 if it's missing or damaged
+static int32_t rollupCoverage(File& file) {
+  if (!file) return -1;
+  size_t size = file.size();
+  if (size < ROLLUP_HEADER_LEN || (size - ROLLUP_HEADER_LEN) % ROLLUP_RECORD_LEN != 0) return -1;
+
+  char header[ROLLUP_HEADER_LEN];
+  if (!file.seek(0) || file.read((uint8_t*)header, ROLLUP_HEADER_LEN) != ROLLUP_HEADER_LEN) return -1;
+  if (header[0] != '#' || header[ROLLUP_HEADER_LEN - 1] != '\n') return -1;
+  return parseDigits(header + 1, ROLLUP_HEADER_LEN - 2);
+}
+
+static bool writeRollupCoverage(File& file, uint32_t logBytes) {
+  char header[ROLLUP_HEADER_LEN + 1];
+  snprintf(header, sizeof(header), "#%010lu\n", (unsigned long)logBytes);
+  return file.seek(0) && file.write((const uint8_t*)header, ROLLUP_HEADER_LEN) == ROLLUP_HEADER_LEN;
+}
+
+// Adds delta to one type's count in the record for key. Returns false if the
+// file doesn't cover logBefore or the record would have to be inserted in the
+// middle; the caller then rebuilds.
+static bool bumpRollup(const char* path, uint32_t key, uint8_t type, int delta, uint32_t logBefore, uint32_t logAfter) {
+  if (key == 0 || type < 1 || type > 7) return false;
+  File file = sysfsOpen(path, "r+");
+  if (!file) return false;
+  if (rollupCoverage(file) != (int32_t)logBefore) {
+    file.close();
+    return false;
+  }
+
+  size_t count = (file.size() - ROLLUP_HEADER_LEN) / ROLLUP_RECORD_LEN;
+  StoolRollup rollup;
+  bool ok = true;
+
+  // Entries come in time order, so check the newest record before searching
+  size_t lo = 0, hi = count;
+  if (count > 0) {
+    if (!readRollupAt(file, count - 1, rollup)) ok = false;
+    else if (rollup.key == key) lo = hi = count - 1;
+    else if (rollup.key < key) lo = hi = count;
+  }
+  while (ok && lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (!readRollupAt(file, mid, rollup)) ok = false;
+    else if (rollup.key < key) lo = mid + 1;
+    else hi = mid;
+  }
+
+  if (ok && lo < count && readRollupAt(file, lo, rollup) && rollup.key == key) {
+    int value = rollup.counts[type - 1] + delta;
+    rollup.counts[type - 1] = value < 0 ? 0 : (value > 999 ? 999 : value);
+    ok = writeRollupAt(file, lo, rollup);
+  }
+  else if (ok && lo == count && delta >= 0) {
+    memset(&rollup, 0, sizeof(rollup));
+    rollup.key = key;
+    rollup.counts[type - 1] = delta;
+    ok = writeRollupAt(file, count, rollup);
+  }
+  else ok = false;
+
+  if (ok) ok = writeRollupCoverage(file, logAfter);
+  file.close();
+  return ok;
+}
+
+static void countInto(std::vector<StoolRollup>& rollups, uint32_t key, uint8_t type) {
+  // Mostly appends, the log is in time order
+  std::vector<StoolRollup>::iterator it = rollups.end();
+  if (rollups.empty() || rollups.back().key < key) {
+    StoolRollup rollup;
+    memset(&rollup, 0, sizeof(rollup));
+    rollup.key = key;
+    rollups.push_back(rollup);
+    it = rollups.end() - 1;
+  }
+  else {
+    it = std::lower_bound(rollups.begin(), rollups.end(), key, [](const StoolRollup& r, uint32_t k) { return r.key < k; });
+    if (it == rollups.end() || it->key != key) {
+      StoolRollup rollup;
+      memset(&rollup, 0, sizeof(rollup));
+      rollup.key = key;
+      it = rollups.insert(it, rollup);
+    }
+  }
+  if (it->counts[type - 1] < 999) it->counts[type - 1]++;
+}
+
+static bool writeRollups(const char* path, const std::vector<StoolRollup>& rollups, uint32_t logBytes) {
+  return sysfsWriteRecords(path, rollups.size() + 1, [&rollups, logBytes](size_t i) {
+    char line[ROLLUP_RECORD_LEN + 1];
+    if (i == 0) snprintf(line, sizeof(line), "#%010lu", (unsigned long)logBytes);
+    else {
+      formatRollup(line, rollups[i - 1]);
+      line[ROLLUP_RECORD_LEN - 1] = '\0';   // The writer adds the newline
+    }
+    return String(line);
+  });
+}
+
+// One pass over the whole log, only when the rollups are missing or stale
+static void rebuildStoolRollups() {
+  std::vector<StoolRollup> days, weeks;
+  uint32_t logBytes = 0;
+
+  File file = sysfsOpen(STOOL_FILE, "r");
+  if (file) {
+    RecordReader<File> reader(file);
+    StoolEntry entry;
+    while (reader.next(3)) {
+      if (!decodeStoolEntry(reader, entry) || entry.time == 0 || entry.type < 1 || entry.type > 7) continue;
+      uint32_t day = entry.time / 1000000;
+      countInto(days, day, entry.type);
+      countInto(weeks, stoolWeekOf(day), entry.type);
+    }
+    logBytes = reader.consumed;
+    file.close();
+  }
+
+  if (!writeRollups(STOOL_DAYS_FILE, days, logBytes) || !writeRollups(STOOL_WEEKS_FILE, weeks, logBytes)) {
+    #ifndef NATIVE_TEST
+    Serial.println("Failed to write stool rollups");
+    #else
+    std::cout << "Failed to write stool rollups" << std::endl;
+    #endif
+  }
+}
+
+static uint32_t stoolLogBytes() {
+  File file = sysfsOpen(STOOL_FILE, "r");
+  if (!file) return 0;
+  uint32_t size = file.size();
+  file.close();
+  return size;
+}
+
+static void ensureStoolRollups() {
+  uint32_t logBytes = stoolLogBytes();
+  File days  = sysfsOpen(STOOL_DAYS_FILE, "r");
+  File weeks = sysfsOpen(STOOL_WEEKS_FILE, "r");
+  bool current = rollupCoverage(days) == (int32_t)logBytes && rollupCoverage(weeks) == (int32_t)logBytes;
+  if (days) days.close();
+  if (weeks) weeks.close();
+  if (!current) rebuildStoolRollups();
+}
+
+static void updateStoolRollups(const StoolEntry& entry, int delta, uint32_t logBefore, uint32_t logAfter) {
+  uint32_t day = entry.time / 1000000;
+  if (!bumpRollup(STOOL_DAYS_FILE, day, entry.type, delta, logBefore, logAfter) ||
+      !bumpRollup(STOOL_WEEKS_FILE, day ? stoolWeekOf(day) : 0, entry.type, delta, logBefore, logAfter)) {
+    rebuildStoolRollups();
+  }
+}
+
+// Last `max` records of a rollup file, oldest first
+static void readRollupTail(const char* path, size_t max, std::vector<StoolRollup>& out) {
+  out.clear();
+  File file = sysfsOpen(path, "r");
+  if (rollupCoverage(file) < 0) {
+    if (file) file.close();
+    return;
+  }
+
+  size_t count = (file.size() - ROLLUP_HEADER_LEN) / ROLLUP_RECORD_LEN;
+  StoolRollup rollup;
+  for (size_t i = count > max ? count - max : 0; i < count; i++) {
+    if (readRollupAt(file, i, rollup)) out.push_back(rollup);
+  }
+  file.close();
+}
+
+// TRENDS
+struct StoolTrends {
+  uint16_t typeCounts[7];                        // Last 30 days
+  float    perDay7, perDay30;                    // Entries a day
+  float    avgType7, avgType30;                  // Mean Bristol type, 0 if no entries
+  uint32_t weekStart[STOOL_TREND_WEEKS];         // Oldest first, the last is this week
+  uint16_t weekCount[STOOL_TREND_WEEKS];
+  float    weekAvgType[STOOL_TREND_WEEKS];
+  float    weekRolling[STOOL_TREND_WEEKS];       // Entries a day over the 4 weeks ending here
+};
+
+static float meanType(const uint16_t counts[7], uint32_t* total) {
+  uint32_t n = 0, sum = 0;
+  for (int i = 0; i < 7; i++) {
+    n   += counts[i];
+    sum += counts[i] * (i + 1);
+  }
+  if (total) *total = n;
+  return n ? (float)sum / n : 0;
+}
+
+// Everything comes from the tails of the rollup files, never the log
+static void computeStoolTrends(uint32_t today, StoolTrends& trends) {
+  memset(&trends, 0, sizeof(trends));
+  int32_t todayDays = daysFromPacked(today);
+  std::vector<StoolRollup> rollups;
+
+  // Days: at most one record per day, so the last 30 records cover 30 days
+  uint16_t week[7] = { 0 };
+  readRollupTail(STOOL_DAYS_FILE, 30, rollups);
+  for (size_t r = 0; r < rollups.size(); r++) {
+    int32_t age = todayDays - daysFromPacked(rollups[r].key);
+    if (age < 0 || age >= 30) continue;
+    for (int i = 0; i < 7; i++) {
+      trends.typeCounts[i] += rollups[r].counts[i];
+      if (age < 7) week[i] += rollups[r].counts[i];
+    }
+  }
+  uint32_t n7, n30;
+  trends.avgType7  = meanType(week, &n7);
+  trends.avgType30 = meanType(trends.typeCounts, &n30);
+  trends.perDay7   = n7 / 7.0f;
+  trends.perDay30  = n30 / 30.0f;
+
+  // Weeks: 3 more than shown for the rolling average of the oldest rows
+  const int WEEKS = STOOL_TREND_WEEKS + 3;
+  uint16_t totals[WEEKS] = { 0 };
+  int32_t thisWeek = daysFromPacked(stoolWeekOf(today));
+  readRollupTail(STOOL_WEEKS_FILE, WEEKS, rollups);
+  for (size_t r = 0; r < rollups.size(); r++) {
+    int32_t back = (thisWeek - daysFromPacked(rollups[r].key)) / 7;
+    if (back < 0 || back >= WEEKS) continue;
+    int slot = WEEKS - 1 - back;
+    float avg = meanType(rollups[r].counts, NULL);
+    uint32_t n;
+    meanType(rollups[r].counts, &n);
+    totals[slot] = n;
+    if (slot >= 3) trends.weekAvgType[slot - 3] = avg;
+  }
+
+  for (int w = 0; w < STOOL_TREND_WEEKS; w++) {
+    int slot = w + 3;
+    trends.weekStart[w] = packedFromDays(thisWeek - 7 * (STOOL_TREND_WEEKS - 1 - w));
+    trends.weekCount[w] = totals[slot];
+    trends.weekRolling[w] = (totals[slot] + totals[slot - 1] + totals[slot - 2] + totals[slot - 3]) / 28.0f;
+  }
+}
+
+// LOG
 void addStoolEntry(int type, String note) {
   if (type < 1 || type > 7) {
     #ifndef NATIVE_TEST
@@ -90,80 +426,167 @@ void addStoolEntry(int type, String note) {
     return;
   }
   
-  String timestamp = getCurrentTimestamp();
-  updateStoolArray();
-  stoolEntries.push_back({String(type), timestamp, note});
-  
-  // Sort by timestamp (most recent first)
-  std::sort(stoolEntries.begin(), stoolEntries.end(), 
-    [](const std::vector<String> &a, const std::vector<String> &b) {
-      return a[1] > b[1]; // Compare timestamp strings (descending)
-    });
-  
-  updateStoolFile();
+  StoolEntry entry;
+  entry.type = type;
+  entry.time = stoolTimestampKey(getCurrentTimestamp());
+  entry.note = note;
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  // Append only, the log is never read back to add to it. A log from older
+  // firmware is upgraded to escaped records once.
+  File file = sysfsUpgradeRecords(STOOL_FILE) ? sysfsOpen(STOOL_FILE, "a") : File();
+  if (!file) {
+    #ifndef NATIVE_TEST
+    Serial.println("Failed to open stool file for appending");
+    #else
+    std::cout << "Failed to open stool file for appending" << std::endl;
+    #endif
+    if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+    SDActive = false;
+    return;
+  }
+  uint32_t logBefore = file.size();
+  String line = encodeStoolEntry(entry) + "\n";
+  file.print(line.c_str());
+  file.close();
+
+  updateStoolRollups(entry, 1, logBefore, logBefore + line.length());
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+
+  // Newest first, only the latest few are kept in RAM
+  stoolEntries.insert(std::upper_bound(stoolEntries.begin(), stoolEntries.end(), entry, stoolNewerFirst), entry);
+  if (stoolEntries.size() > STOOL_RECENT) stoolEntries.resize(STOOL_RECENT);
 }
 
+// Loads the latest entries from the end of the log
 void updateStoolArray() {
   SDActive = true;
   setCpuFrequencyMhz(240);
   delay(50);
   
-  File file = SD_MMC.open(STOOL_FILE, "r");
+  ensureStoolRollups();
+
+  File file = sysfsOpen(STOOL_FILE, "r");
   if (!file) {
     #ifndef NATIVE_TEST
     Serial.println("Failed to open stool file for reading");
     #else
     std::cout << "Failed to open stool file for reading" << std::endl;
     #endif
+    stoolEntries.clear();
+    if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+    SDActive = false;
     return;
   }
 
   stoolEntries.clear();
 
-  while (file.available()) {
-    String line = file.readStringUntil('\n');
-    line.trim();
-    
-    if (line.length() == 0) {
-      continue;
-    }
-
-    int delimiterPos1 = line.indexOf('|');
-    int delimiterPos2 = line.indexOf('|', delimiterPos1 + 1);
-
-    if (delimiterPos1 == -1 || delimiterPos2 == -1) {
-      continue; // Skip malformed lines
-    }
-
-    String type = line.substring(0, delimiterPos1);
-    String timestamp = line.substring(delimiterPos1 + 1, delimiterPos2);
-    String note = line.substring(delimiterPos2 + 1);
+  // Start mid-file and drop the first line unless it starts right there
+  bool escaped = hasRecordHeader(file);
+  size_t size = file.size();
+  size_t start = size > STOOL_TAIL_BYTES ? size - STOOL_TAIL_BYTES : 0;
+  bool partial = false;
+  if (start > 0) {
+    uint8_t before = 0;
+    file.seek(start - 1);
+    file.read(&before, 1);
+    partial = before != '\n';
+  }
+  file.seek(start);
 
-    stoolEntries.push_back({type, timestamp, note});
+  RecordReader<File> reader(file);
+  reader.escaped = escaped;
+  if (partial) reader.nextLine();
+  StoolEntry entry;
+  while (reader.next(3)) {
+    if (!decodeStoolEntry(reader, entry)) continue; // Skip malformed lines
+    stoolEntries.push_back(std::move(entry));
   }
 
   file.close();
 
   // Sort by timestamp (most recent first)
-  std::sort(stoolEntries.begin(), stoolEntries.end(), 
-    [](const std::vector<String> &a, const std::vector<String> &b) {
-      return a[1] > b[1]; // Compare timestamp strings (descending)
-    });
+  std::stable_sort(stoolEntries.begin(), stoolEntries.end(), stoolNewerFirst);
+  if (stoolEntries.size() > STOOL_RECENT) stoolEntries.resize(STOOL_RECENT);
 
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
   SDActive = false;
 }
 
-void updateStoolFile() {
+// Streams the log through a temp file, replacing (or with NULL, dropping) the
+// first record equal to match. Edits and deletes are rare, adds never do this.
+// Lines are copied whole, however long; a log from older firmware comes out
+// re-encoded under RECORD_HEADER.
+static bool rewriteStoolLog(const StoolEntry& match, const StoolEntry* replacement, uint32_t& logBefore, uint32_t& logAfter) {
+  String tmpPath = String(STOOL_FILE) + ".tmp";
+  File in  = sysfsOpen(STOOL_FILE, "r");
+  File out = sysfsOpen(tmpPath, "w");
+  if (!in || !out) {
+    if (in) in.close();
+    if (out) out.close();
+    return false;
+  }
+
+  bool escaped = hasRecordHeader(in);
+  RecordReader<File> reader(in);
+  std::vector<char> copy;
+  FieldSpan fields[3];
+  bool found = false;
+
+  String header = String(RECORD_HEADER) + "\n";
+  out.print(header.c_str());
+  logAfter = header.length();
+
+  while (reader.nextLine()) {
+    if (!found) {
+      copy.assign(reader.line, reader.line + reader.lineLen + 1);
+      if (splitRecord(copy.data(), reader.lineLen, fields, 3, escaped) == 3 && fieldInt(fields[0], 0) == match.type &&
+          stoolTimestampKey(fields[1].ptr, fields[1].len) == match.time && match.note == fields[2].ptr) {
+        found = true;
+        if (replacement) {
+          String line = encodeStoolEntry(*replacement) + "\n";
+          out.print(line.c_str());
+          logAfter += line.length();
+        }
+        continue;
+      }
+    }
+    if (escaped) {
+      out.print(reader.line);
+      out.print("\n");
+      logAfter += reader.lineLen + 1;
+    }
+    else {
+      String line = escapeLegacyLine<String>(reader.line) + "\n";
+      out.print(line.c_str());
+      logAfter += line.length();
+    }
+  }
+  logBefore = reader.consumed;
+  in.close();
+  out.close();
+
+  // The temp file is left for the next rewrite to overwrite
+  return found && sysfsRename(tmpPath, STOOL_FILE);
+}
+
+void editStoolNote(int index, String note) {
+  if (index < 0 || index >= (int)stoolEntries.size()) return;
+
   SDActive = true;
   setCpuFrequencyMhz(240);
-  delay(50);
-  
-  delFile(STOOL_FILE);
 
-  for (size_t i = 0; i < stoolEntries.size(); i++) {
-    String entryInfo = stoolEntries[i][0] + "|" + stoolEntries[i][1] + "|" + stoolEntries[i][2];
-    appendToFile(STOOL_FILE, entryInfo);
+  StoolEntry edited = stoolEntries[index];
+  edited.note = note;
+  uint32_t logBefore, logAfter;
+  if (rewriteStoolLog(stoolEntries[index], &edited, logBefore, logAfter)) {
+    stoolEntries[index] = edited;
+    // Counts don't change, only the log size the rollups cover
+    updateStoolRollups(edited, 0, logBefore, logAfter);
   }
 
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
@@ -171,10 +594,22 @@ void updateStoolFile() {
 }
 
 void deleteStoolEntry(int index) {
-  if (index >= 0 && index < (int)stoolEntries.size()) {
-    stoolEntries.erase(stoolEntries.begin() + index);
-    updateStoolFile();
+  if (index < 0 || index >= (int)stoolEntries.size()) return;
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  StoolEntry removed = stoolEntries[index];
+  uint32_t logBefore, logAfter;
+  if (rewriteStoolLog(removed, NULL, logBefore, logAfter)) {
+    updateStoolRollups(removed, -1, logBefore, logAfter);
   }
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+
+  // Refill the list from the log
+  updateStoolArray();
 }
 
 #ifndef NATIVE_TEST
@@ -196,12 +631,17 @@ void processKB_STOOL() {
 
   switch (CurrentStoolState) {
     case STOOL0:
-      CurrentKBState = FUNC;
       //Make keyboard only updates after cooldown
       if (currentMillis - KBBounceMillis >= KB_COOLDOWN) {  
         inchar = updateKeypress();
         //No char received
         if (inchar == 0);
+        //FN Received - letters select entries, numbers add them
+        else if (inchar == 18) {
+          if (CurrentKBState == FUNC) CurrentKBState = NORMAL;
+          else CurrentKBState = FUNC;
+          KBBounceMillis = currentMillis;
+        }
         //BKSP Received - go back to home
         else if (inchar == 127 || inchar == 8 || inchar == 12) {
           CurrentAppState = HOME;
@@ -218,8 +658,15 @@ void processKB_STOOL() {
           forceSlowFullUpdate = true;
           KBBounceMillis = currentMillis;
         }
+        //Trends
+        else if (inchar == '8') {
+          CurrentStoolState = STOOL_TRENDS;
+          newState = true;
+          forceSlowFullUpdate = true;
+          KBBounceMillis = currentMillis;
+        }
         //View/edit entries
-        else if (inchar >= 'a' && inchar <= 'z') {
+        else if (inchar >= 'a' && inchar < 'a' + STOOL_RECENT) {
           int entryIndex = inchar - 'a';
           if (entryIndex < (int)stoolEntries.size()) {
             selectedStoolEntry = entryIndex;
@@ -232,6 +679,20 @@ void processKB_STOOL() {
       }
       break;
 
+    case STOOL_TRENDS:
+      if (currentMillis - KBBounceMillis >= KB_COOLDOWN) {
+        inchar = updateKeypress();
+        if (inchar == 0);
+        //Go back to main view
+        else if (inchar == 127 || inchar == 8 || inchar == 12 || inchar == '8') {
+          CurrentStoolState = STOOL0;
+          newState = true;
+          forceSlowFullUpdate = true;
+          KBBounceMillis = currentMillis;
+        }
+      }
+      break;
+
     case STOOL1:
       CurrentKBState = NORMAL;
       if (currentMillis - KBBounceMillis >= KB_COOLDOWN) {
@@ -240,6 +701,7 @@ void processKB_STOOL() {
         //Go back to main view
         else if (inchar == 127 || inchar == 8) {
           CurrentStoolState = STOOL0;
+          CurrentKBState = FUNC;
           newState = true;
           forceSlowFullUpdate = true;
           KBBounceMillis = currentMillis;
@@ -248,6 +710,7 @@ void processKB_STOOL() {
         else if (inchar == 'd' || inchar == 'D') {
           deleteStoolEntry(selectedStoolEntry);
           CurrentStoolState = STOOL0;
+          CurrentKBState = FUNC;
           newState = true;
           forceSlowFullUpdate = true;
           KBBounceMillis = currentMillis;
@@ -255,7 +718,7 @@ void processKB_STOOL() {
         //Edit note
         else if (inchar == 'e' || inchar == 'E') {
           if (selectedStoolEntry < stoolEntries.size()) {
-            newStoolNote = stoolEntries[selectedStoolEntry][2];
+            newStoolNote = stoolEntries[selectedStoolEntry].note;
             CurrentStoolState = STOOL1_EDIT;
             newState = true;
             forceSlowFullUpdate = true;
@@ -272,10 +735,7 @@ void processKB_STOOL() {
         if (inchar == 0);
         //Save changes
         else if (inchar == 13) { // Enter key
-          if (selectedStoolEntry < stoolEntries.size()) {
-            stoolEntries[selectedStoolEntry][2] = newStoolNote;
-            updateStoolFile();
-          }
+          editStoolNote(selectedStoolEntry, newStoolNote);
           CurrentStoolState = STOOL1;
           newState = true;
           forceSlowFullUpdate = true;
@@ -304,11 +764,55 @@ void processKB_STOOL() {
 }
 
 #ifndef NATIVE_TEST
+static void drawStoolTrends() {
+  DateTime now = rtc.now();
+  StoolTrends trends;
+  computeStoolTrends(packDate(now.year(), now.month(), now.day()), trends);
+
+  display.setFont(&FreeSerif9pt7b);
+  display.setCursor(10, 18);
+  display.print("Stool Trends");
+
+  display.setFont(&FreeMonoBold9pt7b);
+  char line[48];
+  snprintf(line, sizeof(line), "7d  %.1f/day  type %.1f", trends.perDay7, trends.avgType7);
+  display.setCursor(10, 36);
+  display.print(line);
+  snprintf(line, sizeof(line), "30d %.1f/day  type %.1f", trends.perDay30, trends.avgType30);
+  display.setCursor(10, 50);
+  display.print(line);
+
+  // Types over 30 days as bars
+  display.setFont(NULL);
+  uint16_t most = 1;
+  for (int i = 0; i < 7; i++) if (trends.typeCounts[i] > most) most = trends.typeCounts[i];
+  for (int i = 0; i < 7; i++) {
+    int y = 58 + i * 9;
+    display.setCursor(10, y);
+    display.print(String(i + 1));
+    display.drawRect(22, y, 200, 7, GxEPD_BLACK);
+    display.fillRect(22, y, 200 * trends.typeCounts[i] / most, 7, GxEPD_BLACK);
+    display.setCursor(228, y);
+    display.print(String(trends.typeCounts[i]));
+  }
+
+  // Weekly table, newest at the bottom
+  display.setCursor(10, 126);
+  display.print("Week of   Count  Type  4wk/day");
+  for (int w = 0; w < STOOL_TREND_WEEKS; w++) {
+    uint32_t start = trends.weekStart[w];
+    snprintf(line, sizeof(line), "%02d/%02d     %5u  %4.1f  %5.1f", packedMonth(start), packedDay(start),
+             trends.weekCount[w], trends.weekAvgType[w], trends.weekRolling[w]);
+    display.setCursor(10, 138 + w * 10);
+    display.print(line);
+  }
+}
+
 // Display handler for ESP32
 void einkHandler_STOOL() {
   if (!newState) return;
   
-  display.setRotation(0);
+  display.setRotation(3);
   display.setFullWindow();
   display.fillScreen(GxEPD_WHITE);
   display.setFont(&FreeSerif9pt7b);
@@ -317,28 +821,34 @@ void einkHandler_STOOL() {
   switch (CurrentStoolState) {
     case STOOL0:
       // Main stool tracking view
-      display.setCursor(10, 25);
+      display.setCursor(10, 18);
       display.print("Bristol Stool Chart");
       
-      display.setCursor(10, 50);
-      display.print("Enter type (1-7):");
-      
-      // Show stool type descriptions
+      // Stool type descriptions in two columns
+      display.setFont(NULL);
       for (int i = 1; i <= 7; i++) {
-        display.setCursor(10, 50 + (i * 20));
+        display.setCursor(i <= 4 ? 10 : 165, 28 + ((i - 1) % 4) * 12);
         display.print(String(i) + ": " + getStoolTypeDescription(i));
       }
       
       // Show recent entries
-      display.setCursor(10, 210);
-      display.print("Recent entries (a-z to view):");
+      display.setFont(&FreeSerif9pt7b);
+      display.setCursor(10, 96);
+      display.print("Recent entries:");
       
-      for (size_t i = 0; i < stoolEntries.size() && i < 5; i++) {
-        display.setCursor(10, 230 + (i * 15));
+      display.setFont(&FreeMonoBold9pt7b);
+      for (size_t i = 0; i < stoolEntries.size() && i < STOOL_RECENT; i++) {
+        display.setCursor(10, 114 + (i * 14));
         char label = 'a' + i;
-        display.print(String(label) + ": Type " + stoolEntries[i][0] + 
-                     " " + formatStoolTimestamp(stoolEntries[i][1]));
+        display.print(String(label) + ": " + String(stoolEntries[i].type) + 
+                     " " + formatStoolTime(stoolEntries[i].time));
       }
+      drawStatusBar("1-7 Add  a-h View  8 Trends");
+      break;
+
+    case STOOL_TRENDS:
+      drawStoolTrends();
+      drawStatusBar("Bksp: Back");
       break;
       
     case STOOL1:
@@ -348,18 +858,16 @@ void einkHandler_STOOL() {
         display.print("Stool Entry Details");
         
         display.setCursor(10, 55);
-        display.print("Type: " + stoolEntries[selectedStoolEntry][0] + 
-                     " (" + getStoolTypeDescription(stoolEntries[selectedStoolEntry][0].toInt()) + ")");
+        display.print("Type: " + String(stoolEntries[selectedStoolEntry].type) + 
+                     " (" + getStoolTypeDescription(stoolEntries[selectedStoolEntry].type) + ")");
         
         display.setCursor(10, 80);
-        display.print("Time: " + formatStoolTimestamp(stoolEntries[selectedStoolEntry][1]));
+        display.print("Time: " + formatStoolTime(stoolEntries[selectedStoolEntry].time));
         
         display.setCursor(10, 105);
-        display.print("Note: " + stoolEntries[selectedStoolEntry][2]);
-        
-        display.setCursor(10, 280);
-        display.print("E: Edit  D: Delete  Bksp: Back");
+        display.print("Note: " + stoolEntries[selectedStoolEntry].note);
       }
+      drawStatusBar("E: Edit  D: Delete  Bksp: Back");
       break;
       
     case STOOL1_EDIT:
@@ -368,18 +876,16 @@ void einkHandler_STOOL() {
       display.print("Edit Note");
       
       display.setCursor(10, 55);
-      display.print("Type: " + stoolEntries[selectedStoolEntry][0]);
+      display.print("Type: " + String(stoolEntries[selectedStoolEntry].type));
       
       display.setCursor(10, 80);
       display.print("Note: " + newStoolNote + "_");
       
-      display.setCursor(10, 280);
-      display.print("Enter: Save  Bksp: Cancel");
+      drawStatusBar("Enter: Save  Bksp: Cancel");
       break;
   }
   
-  statusBar("STOOL");
   refresh();
   newState = false;
 }
-#endif 
\ No newline at end of file
+#endif
@@ -21,62 +21,125 @@ void TASKS_INIT() {
   newState = true;
 }
 
-void sortTasksByDueDate(std::vector<std::vector<String>> &tasks) {
-  std::sort(tasks.begin(), tasks.end(), [](const std::vector<String> &a, const std::vector<String> &b) {
-    return a[1] < b[1]; // Compare dueDate strings
-  });
+// TASK LIST
+// Tasks are parsed once and kept sorted by due date. The file is only re-read
+// when its sysfs generation moves (a sync from the card or a write elsewhere).
+uint16_t taskBucketStart[TASK_BUCKETS + 1] = { 0 };
+const char* const taskBucketNames[TASK_BUCKETS] = { "Overdue", "Today", "This Week", "Later" };
+static uint32_t tasksGeneration = 0;    // 0 = never loaded
+static uint32_t taskBucketsDay = 0;     // Packed date the buckets were split on
+
+// Tasks without a readable due date go last, they are never overdue
+static bool taskDueBefore(const Task& a, const Task& b) {
+  return (a.due ? a.due : UINT32_MAX) < (b.due ? b.due : UINT32_MAX);
+}
+
+// Splits the sorted list into overdue / today / rest of the week / later.
+// Weeks start on Sunday, so on a Saturday nothing is left for this week.
+void updateTaskBuckets() {
+  DateTime now = rtc.now();
+  int32_t today = daysFromCivil(now.year(), now.month(), now.day());
+  int32_t nextSunday = today + 7 - weekdayFromDays(today);
+  uint32_t limits[TASK_BUCKETS - 1] = { packedFromDays(today), packedFromDays(today + 1), packedFromDays(nextSunday) };
+
+  taskBucketStart[TASKS_OVERDUE] = 0;
+  size_t i = 0;
+  for (uint8_t b = 0; b < TASK_BUCKETS - 1; b++) {
+    while (i < tasks.size() && tasks[i].due != 0 && tasks[i].due < limits[b]) i++;
+    taskBucketStart[b + 1] = i;
+  }
+  taskBucketStart[TASK_BUCKETS] = tasks.size();
+  taskBucketsDay = limits[0];
+}
+
+uint8_t taskBucketOf(size_t index) {
+  uint8_t b = TASKS_OVERDUE;
+  while (b < TASKS_LATER && index >= taskBucketStart[b + 1]) b++;
+  return b;
+}
+
+// Lays out up to maxRows lines: each non-empty bucket gets a heading followed
+// by its tasks. A heading is never left without a task under it.
+uint8_t layoutTaskGroups(TaskRow* rows, uint8_t maxRows) {
+  uint8_t count = 0;
+  for (uint8_t b = 0; b < TASK_BUCKETS; b++) {
+    uint16_t first = taskBucketStart[b];
+    uint16_t end   = taskBucketStart[b + 1];
+    if (first == end) continue;
+    if (count + 2 > maxRows) break;
+
+    rows[count++] = { b, -1 };
+    for (uint16_t i = first; i < end && count < maxRows; i++) rows[count++] = { b, (int16_t)i };
+  }
+  return count;
+}
+
+static Task parseTask(const String& taskName, const String& dueDate, const String& priority, const String& completed) {
+  Task task;
+  task.name      = taskName;
+  task.due       = parsePackedDate(dueDate.c_str(), dueDate.length());
+  task.priority  = (uint8_t)priority.toInt();
+  task.completed = completed == "1";
+  return task;
 }
 
 void addTask(String taskName, String dueDate, String priority, String completed) {
   updateTaskArray();
-  tasks.push_back({taskName, dueDate, priority, completed});
-  sortTasksByDueDate(tasks);
+
+  // Sorted insert, after any tasks due the same day
+  Task task = parseTask(taskName, dueDate, priority, completed);
+  tasks.insert(std::upper_bound(tasks.begin(), tasks.end(), task, taskDueBefore), task);
+  updateTaskBuckets();
   updateTasksFile();
 }
 
 void updateTaskArray() {
+  uint32_t generation = sysfsGeneration(TASKS_FILE);
+  if (generation == tasksGeneration) {
+    // Still current, only the day may have rolled over
+    DateTime now = rtc.now();
+    if (packDate(now.year(), now.month(), now.day()) != taskBucketsDay) updateTaskBuckets();
+    return;
+  }
+
   SDActive = true;
   setCpuFrequencyMhz(240);
   delay(50);
   
-  File file = SD_MMC.open(TASKS_FILE, "r");
+  File file = sysfsOpen(TASKS_FILE, "r");
   if (!file) {
     #ifndef NATIVE_TEST
     Serial.println("Failed to open file for reading");
     #else
     std::cout << "Failed to open file for reading" << std::endl;
     #endif
+    if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+    SDActive = false;
     return;
   }
 
   tasks.clear();
 
-  while (file.available()) {
-    String line = file.readStringUntil('\n');
-    line.trim();
-    
-    if (line.length() == 0) {
-      continue;
-    }
-
-    int delimiterPos1 = line.indexOf('|');
-    int delimiterPos2 = line.indexOf('|', delimiterPos1 + 1);
-    int delimiterPos3 = line.indexOf('|', delimiterPos2 + 1);
-
-    if (delimiterPos1 == -1 || delimiterPos2 == -1 || delimiterPos3 == -1) {
-      continue; // Skip malformed lines
-    }
-
-    String taskName = line.substring(0, delimiterPos1);
-    String dueDate = line.substring(delimiterPos1 + 1, delimiterPos2);
-    String priority = line.substring(delimiterPos2 + 1, delimiterPos3);
-    String completed = line.substring(delimiterPos3 + 1);
-
-    tasks.push_back({taskName, dueDate, priority, completed});
+  // name|YYYYMMDD|priority|completed
+  RecordReader<File> reader(file);
+  while (reader.next(4)) {
+    if (reader.count < 4) continue; // Skip malformed lines
+
+    Task task;
+    task.name      = String(reader.fields[0].ptr);
+    task.due       = fieldDate(reader.fields[1]);
+    task.priority  = (uint8_t)fieldInt(reader.fields[2], 0);
+    task.completed = fieldEquals(reader.fields[3], "1");
+    tasks.push_back(std::move(task));
   }
 
   file.close();
 
+  // The file may have been edited by hand, sort once here
+  std::stable_sort(tasks.begin(), tasks.end(), taskDueBefore);
+  updateTaskBuckets();
+  tasksGeneration = generation;
+
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
   SDActive = false;
 }
@@ -85,13 +148,14 @@ void updateTasksFile() {
   SDActive = true;
   setCpuFrequencyMhz(240);
   delay(50);
-  
-  delFile(TASKS_FILE);
 
-  for (size_t i = 0; i < tasks.size(); i++) {
-    String taskInfo = tasks[i][0] + "|" + tasks[i][1] + "|" + tasks[i][2] + "|" + tasks[i][3];
-    appendToFile(TASKS_FILE, taskInfo);
-  }
+  sysfsWriteRecords(TASKS_FILE, tasks.size() + 1, [](size_t i) -> String {
+    if (i == 0) return String(RECORD_HEADER);
+    const Task& task = tasks[i - 1];
+    return escapeField(task.name) + "|" + (task.due ? String(task.due) : String("")) + "|" + String(task.priority) + "|" + (task.completed ? "1" : "0");
+  });
+  // Our own write, the list in RAM already matches it
+  tasksGeneration = sysfsGeneration(TASKS_FILE);
 
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
   SDActive = false;
@@ -100,11 +164,21 @@ void updateTasksFile() {
 void deleteTask(int index) {
   if (index >= 0 && index < (int)tasks.size()) {
     tasks.erase(tasks.begin() + index);
+    updateTaskBuckets();
   }
 }
 
+String formatDueDate(uint32_t due) {
+  if (due == 0) return "Invalid";
+  char formatted[9];
+  snprintf(formatted, sizeof(formatted), "%02u/%02u/%02u",
+           (unsigned)packedMonth(due) % 100, (unsigned)packedDay(due) % 100, (unsigned)packedYear(due) % 100);
+  return String(formatted);
+}
+
 String convertDateFormat(String yyyymmdd) {
-  if (yyyymmdd.length() != 8) {
+  uint32_t date = parsePackedDate(yyyymmdd.c_str(), yyyymmdd.length());
+  if (yyyymmdd.length() != 8 || date == 0) {
     #ifndef NATIVE_TEST
     Serial.println(("INVALID DATE: " + yyyymmdd).c_str());
     #else
@@ -113,11 +187,7 @@ String convertDateFormat(String yyyymmdd) {
     return "Invalid";
   }
 
-  String year = yyyymmdd.substring(2, 4);
-  String month = yyyymmdd.substring(4, 6);
-  String day = yyyymmdd.substring(6, 8);
-
-  return month + "/" + day + "/" + year;
+  return formatDueDate(date);
 }
 
 #ifndef NATIVE_TEST
@@ -164,7 +234,7 @@ void processKB_TASKS() {
         }
         // SELECT A TASK
         else if (inchar >= '0' && inchar <= '9') {
-          int taskIndex = (inchar == '0') ? 10 : (inchar - '1');  // Adjust for 1-based input
+          size_t taskIndex = (inchar == '0') ? 10 : (inchar - '1');  // Adjust for 1-based input
 
           // SET SELECTED TASK
           if (taskIndex < tasks.size()) {
@@ -328,17 +398,37 @@ void processKB_TASKS() {
         KBBounceMillis = currentMillis;
       }
       break;
-  
+    default:
+      break;
   }
 }
 
+// Skipped for native testing, it has too many hardware dependencies
 #ifndef NATIVE_TEST
+// Task list rows, buckets are already in due order. The rows line up with the
+// numbered slots of the bitmap, so groups are split by a rule instead of a heading
+// and the due column says which group a task is in.
+static void drawTaskList() {
+  int loopCount = std::min((int)tasks.size(), MAX_FILES);
+  for (int i = 0; i < loopCount; i++) {
+    uint8_t bucket = taskBucketOf(i);
+    if (i > 0 && i == taskBucketStart[bucket]) display.fillRect(29, 54 + (17 * i) - 14, 262, 1, GxEPD_BLACK);
+
+    display.setFont(&FreeSerif9pt7b);
+    // PRINT TASK NAME
+    display.setCursor(29, 54 + (17 * i));
+    if (bucket == TASKS_OVERDUE) display.print("! ");
+    display.print(tasks[i].name.c_str());
+    // PRINT TASK DUE DATE
+    display.setCursor(231, 54 + (17 * i));
+    if (bucket == TASKS_TODAY) display.print("Today");
+    else if (bucket == TASKS_THIS_WEEK) display.print(daysOfTheWeek[weekdayFromDays(daysFromPacked(tasks[i].due))]);
+    else display.print(formatDueDate(tasks[i].due).c_str());
+    if (DEBUG_VERBOSE) Serial.println(tasks[i].name + " " + formatDueDate(tasks[i].due));
+  }
+}
+
 void einkHandler_TASKS() {
-#else
-// Skip einkHandler_TASKS for native testing - it has too many hardware dependencies
-/*
-void einkHandler_TASKS() {
-#endif
   switch (CurrentTasksState) {
     case TASKS0:
       if (newState) {
@@ -352,24 +442,12 @@ void einkHandler_TASKS() {
 
         // DRAW FILE LIST
         updateTaskArray();
-        sortTasksByDueDate(tasks);
 
         if (!tasks.empty()) {
           if (DEBUG_VERBOSE) Serial.println("Printing Tasks");
 
           drawStatusBar("Select (0-9),New Task (N)");
-
-          int loopCount = std::min((int)tasks.size(), MAX_FILES);
-          for (int i = 0; i < loopCount; i++) {
-            display.setFont(&FreeSerif9pt7b);
-            // PRINT TASK NAME
-            display.setCursor(29, 54 + (17 * i));
-            display.print(tasks[i][0].c_str());
-            // PRINT TASK DUE DATE
-            display.setCursor(231, 54 + (17 * i));
-            display.print(convertDateFormat(tasks[i][1]).c_str());
-            Serial.print(tasks[i][0].c_str()); Serial.println(convertDateFormat(tasks[i][1]).c_str());
-          }
+          drawTaskList();
         }
         else drawStatusBar("No Tasks! Add New Task (N)");
 
@@ -388,22 +466,10 @@ void einkHandler_TASKS() {
 
           // DRAW FILE LIST
           updateTaskArray();
-          sortTasksByDueDate(tasks);
 
           if (!tasks.empty()) {
             if (DEBUG_VERBOSE) Serial.println("Printing Tasks");
-
-            int loopCount = std::min((int)tasks.size(), MAX_FILES);
-            for (int i = 0; i < loopCount; i++) {
-              display.setFont(&FreeSerif9pt7b);
-              // PRINT TASK NAME
-              display.setCursor(29, 54 + (17 * i));
-              display.print(tasks[i][0].c_str());
-              // PRINT TASK DUE DATE
-              display.setCursor(231, 54 + (17 * i));
-              display.print(convertDateFormat(tasks[i][1]).c_str());
-              Serial.print(tasks[i][0].c_str()); Serial.println(convertDateFormat(tasks[i][1]).c_str());
-            }
+            drawTaskList();
           }
           switch (newTaskState) {
             case 0:
@@ -425,15 +491,14 @@ void einkHandler_TASKS() {
         display.fillScreen(GxEPD_WHITE);
 
         // DRAW APP
-        drawStatusBar("T:" + tasks[selectedTask][0]);
+        drawStatusBar("T:" + tasks[selectedTask].name);
         display.drawBitmap(0, 0, tasksApp1, 320, 218, GxEPD_BLACK);
 
         refresh();
       }
       break;
-    
+    default:
+      break;
   }
 }
-#ifdef NATIVE_TEST
-*/
-#endif
\ No newline at end of file
+#endif
@@ -4,6 +4,7 @@
 #include "sdmmc_cmd.h"
 #include "driver/sdmmc_host.h"
 #include "driver/sdmmc_defs.h"
+#include "freertos/semphr.h"
 
 void USB_INIT() {
   // OPEN USB FILE TRANSFER
@@ -13,34 +14,58 @@ void USB_INIT() {
   newState = true;
 }
 
-static int32_t onWrite(uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize) {
+// The card under USB, one SD command per call
+class SdmmcBlockDevice : public BlockDevice {
+public:
+  uint32_t sectorSize() const { return card ? card->csd.sector_size : 0; }
+  uint32_t sectorCount() const { return card ? card->csd.capacity : 0; }
+  bool read(uint32_t lba, uint32_t count, uint8_t* dst) { return sdmmc_read_sectors(card, dst, lba, count) == ESP_OK; }
+  bool write(uint32_t lba, uint32_t count, const uint8_t* src) { return sdmmc_write_sectors(card, src, lba, count) == ESP_OK; }
+};
+
+static SdmmcBlockDevice  sdBlocks;
+// Callbacks come from the USB task and the idle flush from the main loop
+static SemaphoreHandle_t mscLock = nullptr;
+
+// Writes what the cache gathered, now or only once the host has gone quiet.
+// Also called from the USB event callback, which has SDActive set already.
+static bool mscSync(bool idleOnly) {
+  if (!mscLock || !card) return true;
+  bool wasActive = SDActive;
   SDActive = true;
+  xSemaphoreTake(mscLock, portMAX_DELAY);
+  bool ok = idleOnly ? mscFlushIdle() : mscFlush();
+  xSemaphoreGive(mscLock);
+  SDActive = wasActive;
+  return ok;
+}
+
+// MSC CALLBACKS
+// Whole requests go through the cache (mscFunc.cpp)
+static int32_t onWrite(uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize) {
   if (!card || card->csd.sector_size == 0) return -1;
-  uint32_t secSize = card->csd.sector_size;
-  for (uint32_t i = 0; i < bufsize / secSize; ++i) {
-    esp_err_t err = sdmmc_write_sectors(card, buffer + i * secSize, lba + i, 1);
-    if (err != ESP_OK) return -1;
-  }
+  SDActive = true;
+  xSemaphoreTake(mscLock, portMAX_DELAY);
+  bool ok = mscWrite(lba, bufsize / card->csd.sector_size, buffer);
+  xSemaphoreGive(mscLock);
   SDActive = false;
-  return bufsize;
+  return ok ? (int32_t)bufsize : -1;
 }
 
 static int32_t onRead(uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize) {
-  SDActive = true;
   if (!card || card->csd.sector_size == 0) return -1;
-  uint32_t secSize = card->csd.sector_size;
-  for (uint32_t i = 0; i < bufsize / secSize; ++i) {
-    esp_err_t err = sdmmc_read_sectors(card, (uint8_t*)buffer + i * secSize, lba + i, 1);
-    if (err != ESP_OK) return -1;
-  }
+  SDActive = true;
+  xSemaphoreTake(mscLock, portMAX_DELAY);
+  bool ok = mscRead(lba, bufsize / card->csd.sector_size, (uint8_t*)buffer);
+  xSemaphoreGive(mscLock);
   SDActive = false;
-  return bufsize;
+  return ok ? (int32_t)bufsize : -1;
 }
 
 static bool onStartStop(uint8_t power_condition, bool start, bool eject) {
-  SDActive = true;
   Serial.printf("MSC Start/Stop: power=%u, start=%d, eject=%d\n", power_condition, start, eject);
-  SDActive = false;
+  // A failed flush fails the eject, the host mustn't think its data is on the card
+  if (!start || eject) return mscSync(false);
   return true;
 }
 
@@ -50,8 +75,8 @@ static void usbEventCallback(void* arg, esp_event_base_t event_base, int32_t eve
     arduino_usb_event_data_t* data = (arduino_usb_event_data_t*)event_data;
     switch (event_id) {
       case ARDUINO_USB_STARTED_EVENT: Serial.println("USB Connected"); break;
-      case ARDUINO_USB_STOPPED_EVENT: Serial.println("USB Disconnected"); break;
-      case ARDUINO_USB_SUSPEND_EVENT: Serial.println("USB Suspended"); break;
+      case ARDUINO_USB_STOPPED_EVENT: Serial.println("USB Disconnected"); mscSync(false); break;
+      case ARDUINO_USB_SUSPEND_EVENT: Serial.println("USB Suspended"); mscSync(false); break;
       case ARDUINO_USB_RESUME_EVENT:  Serial.println("USB Resumed"); break;
     }
   }
@@ -67,6 +92,9 @@ void USBAppSetup() {
 
   if (mscEnabled) return;
 
+  // The host should see current system files
+  sysfsFlushAll();
+
   Serial.println("Unmounting SD_MMC for USB MSC...");
   SD_MMC.end();  // unmount FS before raw access
 
@@ -109,6 +137,15 @@ void USBAppSetup() {
     return;
   }
 
+  if (!mscLock) mscLock = xSemaphoreCreateMutex();
+  if (!mscLock) {
+    Serial.println("Failed to create MSC lock");
+    free(card);
+    card = nullptr;
+    return;
+  }
+  mscCacheBegin(&sdBlocks);
+
   // Setup USB MSC
   Serial.println("Initializing USB MSC...");
   msc.vendorID("ESP32");
@@ -136,7 +173,10 @@ void USBAppShutdown() {
   msc.mediaPresent(false);
   delay(100);
 
-  // Stop MSC functionality
+  // Stop MSC functionality, after the last gathered writes
+  xSemaphoreTake(mscLock, portMAX_DELAY);
+  mscCacheEnd();
+  xSemaphoreGive(mscLock);
   msc.end();
 
   // Free card struct
@@ -178,6 +218,11 @@ void USBAppShutdown() {
   if (!SD_MMC.exists("/sys"))     SD_MMC.mkdir("/sys");
   if (!SD_MMC.exists("/journal")) SD_MMC.mkdir("/journal");
 
+  // Files may have changed on the host, catch up in the background
+  sysfsSyncFromSD();
+  invalidateEventCache();
+  reconcileRequest();
+
   if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
 
   disableTimeout = false;
@@ -191,6 +236,9 @@ void processKB_USB() {
     oledLine(currentLine, false);
   }
   
+  // Gathered writes go to the card once the host is quiet
+  mscSync(true);
+
   if (currentMillis - KBBounceMillis >= KB_COOLDOWN) {  
     char inchar = updateKeypress();
     // HANDLE INPUTS
@@ -0,0 +1,704 @@
+//  oooooooooo.    ooooo   .oooooo.    ooooooooooooo  //
+//  `888'   `Y8b   `888'  d8P'  `Y8b   8'   888   `8  //
+//   888      888   888   888               888       //
+//   888      888   888   888               888       //
+//   888      888   888   888               888       //
+//   888     d88'   888   `88b    ooo       888       //
+//  o888bood8P'    o888o   `Y8bood8P'       o888o      //
+#include "globals.h"
+#ifdef NATIVE_TEST
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include "esp_partition.h"
+#endif
+
+// DICTIONARY LOOKUP
+// Reads the compiled image (include/dictFormat.h) from the DICT_PARTITION
+// flash partition when one holds an image, else from DICT_FILE on the card.
+// Flash is memory mapped, so reads come straight from it, and the sparse
+// index and headwords are used in place.
+// From the card the sparse index is kept in RAM, so a lookup is a binary
+// search over it, then one over a single stride of records on the card.
+// Reads go through two cached blocks, so a search alternating between the
+// offset table and the records, or a trie node across a block edge, doesn't
+// read the same block over and over.
+
+static File        dictFile;
+static DictHeader  dictHeader;
+static bool        dictLoaded = false;          // dictHeader is valid
+static std::vector<DictSparse> dictSparse;      // Copy of the sparse index, from the card
+static const DictSparse* dictSparseAt = nullptr;
+static size_t      dictSparseCount = 0;
+
+static const uint8_t* dictMap = nullptr;        // The mapped partition, while open
+static uint32_t       dictMapSize = 0;
+
+static uint8_t  dictBlock[2][DICT_BLOCK_SIZE];
+static uint32_t dictBlockStart[2] = { 0, 0 };
+static uint32_t dictBlockLen[2]   = { 0, 0 };
+static uint8_t  dictBlockRecent   = 0;          // The other one goes first
+uint32_t dictBlockLoads = 0;                    // Blocks read from the card, for timing lookups
+
+static void dictDropBlocks() {
+  dictBlockLen[0] = dictBlockLen[1] = 0;
+}
+
+// FLASH PARTITION
+#ifdef NATIVE_TEST
+// A plain file stands in for the partition, mapped for every open so tests
+// can swap it
+static bool dictMapOpen() {
+  int fd = open(DICT_PARTITION, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(DictHeader)) {
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  dictMap = (const uint8_t*)map;
+  dictMapSize = st.st_size;
+  return true;
+}
+
+static void dictMapClose() {
+  if (dictMap) munmap((void*)dictMap, dictMapSize);
+  dictMap = nullptr;
+  dictMapSize = 0;
+}
+#else
+static const uint8_t* dictPartition = nullptr;  // Mapped on first use, for good
+static uint32_t       dictPartitionSize = 0;
+static bool           dictPartitionTried = false;
+
+static bool dictMapOpen() {
+  if (!dictPartitionTried) {
+    dictPartitionTried = true;
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, DICT_PARTITION);
+    const void* map = nullptr;
+    spi_flash_mmap_handle_t handle;
+    if (part && esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &map, &handle) == ESP_OK) {
+      dictPartition = (const uint8_t*)map;
+      dictPartitionSize = part->size;
+    }
+  }
+  dictMap = dictPartition;
+  dictMapSize = dictPartitionSize;
+  return dictMap != nullptr;
+}
+
+// Stays mapped, the partition only changes when it is flashed
+static void dictMapClose() {
+  dictMap = nullptr;
+  dictMapSize = 0;
+}
+#endif
+
+// READING
+static bool dictRead(uint32_t offset, void* out, size_t len) {
+  if (dictMap) {
+    if (offset > dictMapSize || len > dictMapSize - offset) return false;
+    memcpy(out, dictMap + offset, len);
+    return true;
+  }
+
+  uint8_t* dst = (uint8_t*)out;
+  while (len > 0) {
+    uint8_t b = dictBlockRecent;
+    if (offset < dictBlockStart[b] || offset >= dictBlockStart[b] + dictBlockLen[b]) {
+      b ^= 1;
+      if (offset < dictBlockStart[b] || offset >= dictBlockStart[b] + dictBlockLen[b]) {
+        dictBlockStart[b] = offset - offset % DICT_BLOCK_SIZE;
+        dictBlockLen[b] = dictFile.seek(dictBlockStart[b]) ? dictFile.read(dictBlock[b], DICT_BLOCK_SIZE) : 0;
+        dictBlockLoads++;
+        if (offset >= dictBlockStart[b] + dictBlockLen[b]) {
+          dictBlockLen[b] = 0;
+          return false;
+        }
+      }
+    }
+    dictBlockRecent = b;
+
+    size_t n = dictBlockStart[b] + dictBlockLen[b] - offset;
+    if (n > len) n = len;
+    memcpy(dst, dictBlock[b] + (offset - dictBlockStart[b]), n);
+    dst    += n;
+    offset += n;
+    len    -= n;
+  }
+  return true;
+}
+
+static uint32_t dictRead24(uint32_t offset) {
+  uint8_t raw[3];
+  if (!dictRead(offset, raw, 3)) return 0;
+  return raw[0] | (raw[1] << 8) | ((uint32_t)raw[2] << 16);
+}
+
+static uint32_t dictRead32(uint32_t offset) {
+  uint8_t raw[4];
+  if (!dictRead(offset, raw, 4)) return 0;
+  return raw[0] | (raw[1] << 8) | (raw[2] << 16) | ((uint32_t)raw[3] << 24);
+}
+
+static uint32_t dictRecordOffset(uint32_t index) {
+  return dictHeader.sections[DICT_SEC_ENTRIES].offset + dictRead32(dictHeader.sections[DICT_SEC_OFFSETS].offset + index * 4);
+}
+
+// Headword of the record at offset into head (room for 256), returns its length
+static size_t dictReadHeadAt(uint32_t offset, char* head) {
+  uint8_t len = 0;
+  if (offset == 0 || !dictRead(offset, &len, 1) || !dictRead(offset + 1, head, len)) return 0;
+  head[len] = '\0';
+  return len;
+}
+
+static size_t dictReadHead(uint32_t index, char* head) {
+  return dictReadHeadAt(dictRecordOffset(index), head);
+}
+
+// Headword of the record at offset, in place when mapped, else read into
+// buffer (room for 256). Not terminated, nullptr if it can't be read.
+static const char* dictHeadAt(uint32_t offset, char* buffer, size_t& len) {
+  if (dictMap) {
+    len = 0;
+    if (offset == 0 || offset >= dictMapSize) return nullptr;
+    len = dictMap[offset];
+    return offset + 1 + len <= dictMapSize ? (const char*)dictMap + offset + 1 : nullptr;
+  }
+  len = dictReadHeadAt(offset, buffer);
+  return len > 0 ? buffer : nullptr;
+}
+
+// OPEN / CLOSE
+static bool dictValid(const DictHeader& header, uint32_t imageSize) {
+  if (memcmp(header.magic, DICT_MAGIC, 4) != 0 || header.version != DICT_VERSION ||
+      header.sections[DICT_SEC_OFFSETS].size < header.entryCount * 4) {
+    return false;
+  }
+  for (int s = 0; s < DICT_SECTIONS; s++) {
+    const DictSection& section = header.sections[s];
+    if (section.offset > imageSize || section.size > imageSize - section.offset) return false;
+  }
+  return true;
+}
+
+// Opens the image, preferring the flash partition. The sparse index is only
+// read again from the card if the image changed.
+bool dictBegin() {
+  DictHeader header;
+  dictDropBlocks();
+  if (dictMapOpen()) {
+    memcpy(&header, dictMap, sizeof(header));
+    // An empty partition is all 0xFF, not an error
+    if (!dictValid(header, dictMapSize)) dictMapClose();
+  }
+
+  if (!dictMap) {
+    if (noSD) {
+      dictLoaded = false;
+      return false;
+    }
+    dictFile = SD_MMC.open(DICT_FILE, "r");
+    if (!dictFile) {
+      dictLoaded = false;
+      return false;
+    }
+    if (!dictRead(0, &header, sizeof(header)) || !dictValid(header, dictFile.size())) {
+      #ifndef NATIVE_TEST
+      Serial.println("Dictionary image is damaged or too new");
+      #else
+      std::cout << "Dictionary image is damaged or too new" << std::endl;
+      #endif
+      dictFile.close();
+      dictLoaded = false;
+      return false;
+    }
+  }
+
+  if (!dictLoaded || memcmp(&header, &dictHeader, sizeof(header)) != 0) {
+    dictHeader = header;
+    dictSparse.clear();
+    dictLoaded = true;
+  }
+
+  size_t sparseCount = header.sections[DICT_SEC_SPARSE].size / sizeof(DictSparse);
+  if (dictMap) {
+    dictSparseAt = (const DictSparse*)(dictMap + header.sections[DICT_SEC_SPARSE].offset);
+  }
+  else {
+    if (dictSparse.size() != sparseCount) {
+      dictSparse.resize(sparseCount);
+      if (sparseCount > 0 && !dictRead(header.sections[DICT_SEC_SPARSE].offset, &dictSparse[0], sparseCount * sizeof(DictSparse))) {
+        dictSparse.clear();
+      }
+    }
+    dictSparseAt = dictSparse.empty() ? nullptr : &dictSparse[0];
+  }
+  dictSparseCount = dictSparseAt ? sparseCount : 0;
+  return true;
+}
+
+void dictEnd() {
+  if (dictFile) dictFile.close();
+  dictMapClose();
+  dictDropBlocks();
+  dictSparseAt = nullptr;
+  dictSparseCount = 0;
+}
+
+// SEARCH
+static size_t sparseKeyLen(const DictSparse& sparse) {
+  size_t len = 0;
+  while (len < DICT_SPARSE_KEY && sparse.key[len]) len++;
+  return len;
+}
+
+// Sparse keys are truncated, so they only tell for sure which side of key
+// their whole headword falls on when the stored bytes already differ
+static bool sparseBefore(const DictSparse& sparse, const char* key, size_t keyLen) {
+  size_t len = sparseKeyLen(sparse);
+  size_t n = len < keyLen ? len : keyLen;
+  int c = dictCompare(sparse.key, n, key, n);
+  return c < 0 || (c == 0 && len < DICT_SPARSE_KEY && len < keyLen);
+}
+
+static bool sparseAfter(const DictSparse& sparse, const char* key, size_t keyLen) {
+  size_t len = sparseKeyLen(sparse);
+  size_t n = len < keyLen ? len : keyLen;
+  return dictCompare(sparse.key, n, key, n) > 0;
+}
+
+// First record whose headword is >= key, or with prefix set, whose first
+// keyLen bytes are > key (the end of the records starting with key)
+static uint32_t dictBound(const char* key, size_t keyLen, bool prefix) {
+  uint32_t lo = 0, hi = dictHeader.entryCount;
+
+  // Narrow to one stride with the sparse index
+  size_t a = 0, b = dictSparseCount;
+  while (a < b) {
+    size_t mid = (a + b) / 2;
+    if (sparseBefore(dictSparseAt[mid], key, keyLen)) a = mid + 1;
+    else b = mid;
+  }
+  if (a > 0) lo = dictSparseAt[a - 1].entry;
+  b = dictSparseCount;
+  while (a < b) {
+    size_t mid = (a + b) / 2;
+    if (sparseAfter(dictSparseAt[mid], key, keyLen)) b = mid;
+    else a = mid + 1;
+  }
+  if (a < dictSparseCount) hi = dictSparseAt[a].entry;
+
+  // Then search that stride of records
+  char head[256];
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    size_t len = 0;
+    const char* at = dictHeadAt(dictRecordOffset(mid), head, len);
+    if (prefix && len > keyLen) len = keyLen;
+    int c = dictCompare(at ? at : head, len, key, keyLen);
+    if (prefix ? c <= 0 : c < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// Records whose headword starts with word, as [first, end)
+bool dictFind(const String& word, uint32_t& first, uint32_t& end) {
+  first = end = 0;
+  if (!dictLoaded || word.length() == 0) return false;
+  first = dictBound(word.c_str(), word.length(), false);
+  end   = dictBound(word.c_str(), word.length(), true);
+  return first < end;
+}
+
+bool dictEntry(uint32_t index, String& head, String& def) {
+  if (!dictLoaded || index >= dictHeader.entryCount) return false;
+
+  char text[256];
+  uint32_t offset = dictRecordOffset(index);
+  size_t headLen = dictReadHead(index, text);
+  if (headLen == 0) return false;
+  head = String(text);
+
+  uint8_t raw[2];
+  offset += 1 + headLen;
+  if (!dictRead(offset, raw, 2)) return false;
+  uint16_t defLen = raw[0] | (raw[1] << 8);
+  offset += 2;
+
+  // Long definitions come through the small buffer in pieces
+  def = "";
+  while (defLen > 0) {
+    size_t n = defLen < sizeof(text) - 1 ? defLen : sizeof(text) - 1;
+    if (!dictRead(offset, text, n)) return false;
+    text[n] = '\0';
+    def += text;
+    offset += n;
+    defLen -= n;
+  }
+  return true;
+}
+
+// COMPLETIONS
+// Walks the trie along prefix and returns the best words stored at the node
+// where it ends, in their original case. Reads one node per label passed.
+uint8_t dictComplete(const String& prefix, String* words, uint8_t max) {
+  const DictSection& trie = dictHeader.sections[DICT_SEC_TRIE];
+  if (!dictLoaded || trie.size == 0) return 0;
+
+  const char* key = prefix.c_str();
+  size_t keyLen = prefix.length();
+  size_t pos = 0;
+  uint32_t at = trie.offset;
+  char text[256];
+
+  while (true) {
+    // Label
+    uint8_t labelLen = 0;
+    if (!dictRead(at, &labelLen, 1) || !dictRead(at + 1, text, labelLen)) return 0;
+    at += 1 + labelLen;
+    size_t n = keyLen - pos < labelLen ? keyLen - pos : labelLen;
+    if (dictCompare(text, n, key + pos, n) != 0) return 0;
+    pos += n;
+
+    uint8_t topCount = 0;
+    if (!dictRead(at, &topCount, 1)) return 0;
+    at += 1;
+
+    // Prefix used up, in this label or at its end
+    if (pos == keyLen) {
+      uint8_t count = 0;
+      for (uint8_t t = 0; t < topCount && count < max; t++) {
+        size_t len = dictReadHeadAt(dictHeader.sections[DICT_SEC_ENTRIES].offset + dictRead32(at + 4 * t), text);
+        len = dictWordLength(text, len);
+        if (len == 0) continue;
+        text[len] = '\0';
+        words[count++] = String(text);
+      }
+      return count;
+    }
+
+    // Child starting with the next byte, children are sorted by it
+    at += 4 * topCount;
+    uint8_t raw[2];
+    if (!dictRead(at, raw, 2)) return 0;
+    uint16_t childCount = raw[0] | (raw[1] << 8);
+    at += 2;
+
+    unsigned char want = (unsigned char)dictFold(key[pos]);
+    uint16_t lo = 0, hi = childCount;
+    uint32_t next = 0;
+    while (lo < hi) {
+      uint16_t mid = (lo + hi) / 2;
+      uint8_t first = 0;
+      if (!dictRead(at + 4 * mid, &first, 1)) return 0;
+      if (first == want) {
+        next = dictRead24(at + 4 * mid + 1);
+        break;
+      }
+      if (first < want) lo = mid + 1;
+      else hi = mid;
+    }
+    if (lo >= hi) return 0;
+    at = trie.offset + next;
+  }
+}
+
+// DID YOU MEAN
+// Looks up the delete keys of word in the fuzzy index, then checks the words
+// found there against it. Work is bounded: at most DICT_FUZZY_KEYS buckets,
+// DICT_FUZZY_SCAN postings and DICT_FUZZY_CHECK headwords read per query.
+// With two cached blocks that is about a block per start table entry and per
+// bucket, and two per headword (its offset, then the record).
+static const uint16_t DICT_FUZZY_SCAN  = 2048;
+static const uint8_t  DICT_FUZZY_CHECK = 48;
+static const uint8_t  DICT_FUZZY_WORD  = 48;    // Longer words aren't corrected
+
+// Optimal string alignment distance of folded a and b, limit + 1 if over limit
+static uint8_t dictDistance(const char* a, size_t aLen, const char* b, size_t bLen, uint8_t limit) {
+  if ((aLen > bLen ? aLen - bLen : bLen - aLen) > limit) return limit + 1;
+  uint8_t rows[3][DICT_FUZZY_WORD + 1];
+  uint8_t* before = rows[0];
+  uint8_t* prev   = rows[1];
+  uint8_t* row    = rows[2];
+  for (size_t j = 0; j <= bLen; j++) prev[j] = j;
+
+  for (size_t i = 1; i <= aLen; i++) {
+    row[0] = i;
+    uint8_t best = row[0];
+    for (size_t j = 1; j <= bLen; j++) {
+      uint8_t cost = dictFold(a[i - 1]) == dictFold(b[j - 1]) ? 0 : 1;
+      uint8_t d = prev[j - 1] + cost;
+      if (prev[j] + 1 < d) d = prev[j] + 1;
+      if (row[j - 1] + 1 < d) d = row[j - 1] + 1;
+      if (i > 1 && j > 1 && dictFold(a[i - 1]) == dictFold(b[j - 2]) && dictFold(a[i - 2]) == dictFold(b[j - 1]) &&
+          before[j - 2] + 1 < d) {
+        d = before[j - 2] + 1;
+      }
+      row[j] = d;
+      if (d < best) best = d;
+    }
+    if (best > limit) return limit + 1;
+    uint8_t* spare = before;
+    before = prev;
+    prev   = row;
+    row    = spare;
+  }
+  return prev[bLen] > limit ? limit + 1 : prev[bLen];
+}
+
+static uint32_t dictGap(uint32_t a, uint32_t b) {
+  return a > b ? a - b : b - a;
+}
+
+// Up to max dictionary words within edit distance 2 of word, closest first,
+// then nearest in length. Returns how many it found.
+uint8_t dictSuggest(const String& word, String* words, uint8_t max) {
+  const DictSection& fuzzy = dictHeader.sections[DICT_SEC_FUZZY];
+  size_t len = word.length();
+  if (!dictLoaded || fuzzy.size < 8 || len < 3 || len > DICT_FUZZY_WORD || max == 0) return 0;
+
+  uint32_t bucketCount = dictRead32(fuzzy.offset);
+  if (bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0) return 0;
+  uint32_t starts   = fuzzy.offset + 4;
+  uint32_t postings = starts + 4 * (bucketCount + 1);
+
+  // Every new word in the buckets of the keys is checked against the whole
+  // word, the best max kept in order. Keys only come from the first bytes, so
+  // when a bucket has more new words than are left to check, the ones filed
+  // nearest to where word would be are kept. A word within distance d shares
+  // a key made with at most d deletes, so once the kept words are all closer
+  // than the next level of keys reaches, the rest are skipped.
+  uint32_t checked[DICT_FUZZY_CHECK];
+  uint8_t  checkedCount = 0;
+  uint16_t scanned = 0;
+  uint32_t near = 0;
+  bool     nearKnown = false;
+  uint32_t best[DICT_TRIE_TOP];
+  uint8_t  bestScore[DICT_TRIE_TOP];
+  if (max > DICT_TRIE_TOP) max = DICT_TRIE_TOP;
+  uint8_t count = 0;
+  bool done = false;
+  char head[256];
+  dictForEachDelete(word.c_str(), len, [&](const char* key, size_t keyLen, int deletes) {
+    if (done || checkedCount == DICT_FUZZY_CHECK || scanned == DICT_FUZZY_SCAN) return;
+    if (count > 0 && count == max && bestScore[count - 1] < 4 * deletes) {
+      done = true;
+      return;
+    }
+
+    // The bucket's new words first, then their headwords, so the postings
+    // block isn't evicted between them
+    uint32_t hash = dictHash(key, keyLen);
+    uint32_t bucket = hash & (bucketCount - 1);
+    uint32_t at  = dictRead32(starts + 4 * bucket);
+    uint32_t end = dictRead32(starts + 4 * bucket + 4);
+    uint8_t  first = checkedCount;
+    uint8_t  pending = checkedCount;
+    for (; at < end && scanned < DICT_FUZZY_SCAN; at++, scanned++) {
+      uint32_t posting = dictRead32(postings + 4 * at);
+      if ((posting ^ hash) & 0xFF000000u) continue;
+      uint32_t record = posting & 0xFFFFFF;
+      uint8_t c = 0;
+      while (c < pending && checked[c] != record) c++;
+      if (c < pending) continue;
+      if (pending < DICT_FUZZY_CHECK) {
+        checked[pending++] = record;
+        continue;
+      }
+
+      if (!nearKnown) {
+        near = dictBound(word.c_str(), len, false);
+        nearKnown = true;
+      }
+      uint8_t far = first;
+      for (c = first; c < pending; c++) {
+        if (dictGap(checked[c], near) > dictGap(checked[far], near)) far = c;
+      }
+      if (dictGap(record, near) < dictGap(checked[far], near)) checked[far] = record;
+    }
+    checkedCount = pending;
+
+    for (uint8_t c = first; c < checkedCount; c++) {
+      size_t headLen = dictWordLength(head, dictReadHead(checked[c], head));
+      if (headLen == 0 || headLen > DICT_FUZZY_WORD) continue;
+      uint8_t distance = dictDistance(word.c_str(), len, head, headLen, 2);
+      if (distance > 2) continue;
+
+      uint8_t score = distance * 4 + (headLen > len ? headLen - len : len - headLen);
+      uint8_t place = count;
+      while (place > 0 && (score < bestScore[place - 1] || (score == bestScore[place - 1] && checked[c] < best[place - 1]))) place--;
+      if (place >= max) continue;
+      if (count < max) count++;
+      for (uint8_t k = count - 1; k > place; k--) {
+        best[k] = best[k - 1];
+        bestScore[k] = bestScore[k - 1];
+        words[k] = words[k - 1];
+      }
+      best[place] = checked[c];
+      bestScore[place] = score;
+      head[headLen] = '\0';
+      words[place] = String(head);
+    }
+  });
+  return count;
+}
+
+// REVERSE LOOKUP
+// Finds the records whose definitions use the terms of query. The postings of
+// the rarest term become the candidates and the other lists are merged into
+// them, so only records using every term are kept and ranked by their summed
+// weights. If none uses them all, the most common term is dropped and the
+// search runs again.
+static const uint8_t  DICT_QUERY_TERMS = 8;
+static const uint16_t DICT_SEARCH_CANDIDATES = 2048;    // Best postings kept of a longer first list
+
+struct DictTerm {
+  uint32_t count;
+  uint32_t at;            // Postings, from the start of the image
+  uint32_t end;
+};
+
+struct DictPostings {
+  uint32_t at;
+  uint32_t end;
+  uint32_t record;
+  uint8_t  weight;
+};
+
+static bool dictFindTerm(const char* term, size_t len, DictTerm& found) {
+  const DictSection& terms = dictHeader.sections[DICT_SEC_TERMS];
+  if (terms.size < 4) return false;
+
+  uint32_t lo = 0, hi = dictRead32(terms.offset);
+  char text[256];
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint32_t at = terms.offset + dictRead32(terms.offset + 4 + 4 * mid);
+    uint8_t n = 0;
+    if (!dictRead(at, &n, 1) || !dictRead(at + 1, text, n)) return false;
+    int c = dictCompare(text, n, term, len);
+    if (c == 0) {
+      uint32_t postings = dictHeader.sections[DICT_SEC_POSTINGS].offset;
+      found.count = dictRead32(at + 1 + n);
+      found.at    = postings + dictRead32(at + 5 + n);
+      found.end   = found.at + dictRead32(at + 9 + n);
+      return found.count > 0;
+    }
+    if (c < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return false;
+}
+
+static bool dictNextPosting(DictPostings& list) {
+  uint32_t gap = 0;
+  uint8_t byte = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (list.at >= list.end || !dictRead(list.at++, &byte, 1)) return false;
+    gap |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  list.record += gap;
+  return list.at < list.end && dictRead(list.at++, &list.weight, 1);
+}
+
+static DictPostings dictOpenPostings(const DictTerm& term) {
+  DictPostings list = { term.at, term.end, 0, 0 };
+  return list;
+}
+
+// Up to max records ranked for query, best first. Returns how many.
+uint8_t dictSearch(const String& query, uint32_t* records, uint8_t max) {
+  if (!dictLoaded || dictHeader.sections[DICT_SEC_POSTINGS].size == 0 || max == 0) return 0;
+
+  // Known terms of the query, rarest first
+  DictTerm terms[DICT_QUERY_TERMS];
+  char     seen[DICT_QUERY_TERMS][DICT_TERM_MAX];
+  uint8_t  seenLen[DICT_QUERY_TERMS];
+  uint8_t  termCount = 0, seenCount = 0;
+  char term[DICT_TERM_MAX];
+  size_t pos = 0, len;
+  while (seenCount < DICT_QUERY_TERMS && (len = dictNextTerm(query.c_str(), query.length(), pos, term)) > 0) {
+    bool repeat = false;
+    for (uint8_t s = 0; s < seenCount; s++) repeat |= seenLen[s] == len && memcmp(seen[s], term, len) == 0;
+    if (repeat) continue;
+    memcpy(seen[seenCount], term, len);
+    seenLen[seenCount++] = len;
+
+    DictTerm found;
+    if (!dictFindTerm(term, len, found)) continue;
+    uint8_t at = termCount++;
+    while (at > 0 && terms[at - 1].count > found.count) {
+      terms[at] = terms[at - 1];
+      at--;
+    }
+    terms[at] = found;
+  }
+
+  std::vector<uint32_t> hits;
+  std::vector<uint16_t> scores;
+  for (uint8_t active = termCount; active > 0 && hits.empty(); active--) {
+    // Candidates from the rarest list, its best postings if it's long
+    DictPostings list = dictOpenPostings(terms[0]);
+    if (terms[0].count <= DICT_SEARCH_CANDIDATES) {
+      while (dictNextPosting(list)) {
+        hits.push_back(list.record);
+        scores.push_back(list.weight);
+      }
+    }
+    else {
+      std::vector<std::pair<uint8_t, uint32_t>> best;    // Min-heap on weight
+      while (dictNextPosting(list)) {
+        std::pair<uint8_t, uint32_t> posting(list.weight, list.record);
+        if (best.size() == DICT_SEARCH_CANDIDATES) {
+          if (posting.first <= best.front().first) continue;
+          std::pop_heap(best.begin(), best.end(), std::greater<std::pair<uint8_t, uint32_t>>());
+          best.pop_back();
+        }
+        best.push_back(posting);
+        std::push_heap(best.begin(), best.end(), std::greater<std::pair<uint8_t, uint32_t>>());
+      }
+      std::sort(best.begin(), best.end(), [](const std::pair<uint8_t, uint32_t>& a, const std::pair<uint8_t, uint32_t>& b) {
+        return a.second < b.second;
+      });
+      for (size_t b = 0; b < best.size(); b++) {
+        hits.push_back(best[b].second);
+        scores.push_back(best[b].first);
+      }
+    }
+
+    // Keep the candidates every other list has too
+    for (uint8_t t = 1; t < active && !hits.empty(); t++) {
+      list = dictOpenPostings(terms[t]);
+      size_t c = 0, kept = 0;
+      while (c < hits.size() && dictNextPosting(list)) {
+        while (c < hits.size() && hits[c] < list.record) c++;
+        if (c < hits.size() && hits[c] == list.record) {
+          hits[kept]   = hits[c];
+          scores[kept] = scores[c] + list.weight;
+          kept++;
+          c++;
+        }
+      }
+      hits.resize(kept);
+      scores.resize(kept);
+    }
+  }
+
+  // Best scores first, then dictionary order
+  std::vector<uint32_t> order(hits.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  size_t count = order.size() < max ? order.size() : max;
+  std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](uint32_t a, uint32_t b) {
+    return scores[a] != scores[b] ? scores[a] > scores[b] : hits[a] < hits[b];
+  });
+  for (size_t i = 0; i < count; i++) records[i] = hits[order[i]];
+  return count;
+}
@@ -0,0 +1,289 @@
+//  oooooooooooo ooooo ooooo      ooo oooooooooo.   oooooooooooo ooooooooo.    //
+//  `888'     `8 `888' `888b.     `8' `888'   `Y8b  `888'     `8 `888   `Y88.  //
+//   888          888   8 `88b.    8   888      888  888          888   .d88'  //
+//   888oooo8     888   8   `88b.  8   888      888  888oooo8     888ooo88P'   //
+//   888    "     888   8     `88b.8   888      888  888    "     888`88b.     //
+//   888          888   8       `888   888     d88'  888       o  888  `88b.   //
+//  o888o        o888o o8o        `8  o888bood8P'   o888ooooood8 o888o  o888o  //
+#include "globals.h"
+
+// FUZZY FILE FINDER
+// Every path on the card is cached in one flat buffer and kept current by the
+// file operations in sysFunc.cpp. The cache is filled FINDER_LOAD_BATCH
+// entries at a time, starting on first use, so typing "/" never waits for a
+// walk of the whole card; matches show up as the paths arrive.
+// Matching is incremental: levels[k] holds the files matching the first k+1
+// query characters together with the position right after their match, so
+// each typed character only re-checks the survivors of the previous one.
+
+String  finderTop[FINDER_TOP];
+uint8_t finderTopCount = 0;
+
+struct FinderHit {
+  uint16_t file;                 // Index into pathStarts
+  uint16_t pos;                  // One past the last matched char
+};
+
+static std::vector<char> pathBlob;        // NUL separated paths, original case
+static std::vector<uint32_t> pathStarts;  // Offset of each path
+static bool finderLoaded = false;         // Every path is cached
+static bool finderLoading = false;        // finderWalk is filling the cache
+static DirWalk finderWalk;
+
+static std::vector<std::vector<FinderHit>> levels;
+static String finderQuery = "";
+
+// HELPERS
+static const char* finderPath(size_t i) {
+  return &pathBlob[pathStarts[i]];
+}
+
+static bool isBoundary(const char* path, int i) {
+  if (i == 0) return true;
+  char prev = path[i - 1];
+  return !isalnum((unsigned char)prev) || (islower((unsigned char)prev) && isupper((unsigned char)path[i]));
+}
+
+static int findFrom(const char* path, int from, char c) {
+  for (int i = from; path[i] != '\0'; i++) {
+    if (tolower((unsigned char)path[i]) == c) return i;
+  }
+  return -1;
+}
+
+static void resetMatches() {
+  levels.clear();
+  finderQuery = "";
+  finderTopCount = 0;
+}
+
+static void addPath(const String& path) {
+  if (pathStarts.size() >= FINDER_MAX_FILES) return;
+  pathStarts.push_back(pathBlob.size());
+  pathBlob.insert(pathBlob.end(), path.c_str(), path.c_str() + path.length() + 1);
+}
+
+// Removed paths are cut out of the buffer so they never count toward FINDER_MAX_FILES
+static void erasePath(size_t i) {
+  uint32_t start = pathStarts[i];
+  uint32_t len = strlen(finderPath(i)) + 1;
+  pathBlob.erase(pathBlob.begin() + start, pathBlob.begin() + start + len);
+  pathStarts.erase(pathStarts.begin() + i);
+  for (size_t j = i; j < pathStarts.size(); j++) pathStarts[j] -= len;
+}
+
+static int32_t findPath(const String& path) {
+  for (size_t i = 0; i < pathStarts.size(); i++) {
+    if (path == finderPath(i)) return i;
+  }
+  return -1;
+}
+
+static String normalizeFinderPath(String path) {
+  if (!path.startsWith("/")) path = "/" + path;
+  return path;
+}
+
+// Best alignment of query in path. Only starts at word boundaries (and the
+// first occurrence) are tried, which keeps this cheap enough to run on
+// every survivor.
+static int scoreMatch(const char* path, const String& query) {
+  int len = strlen(path);
+  int base = 0;
+  for (int i = 0; i < len; i++) if (path[i] == '/') base = i + 1;
+
+  int best = -1;
+  int first = findFrom(path, 0, query[0]);
+  for (int start = first; start != -1; start = findFrom(path, start + 1, query[0])) {
+    if (start != first && !isBoundary(path, start)) continue;
+
+    int score = 0;
+    int prev = -2;
+    size_t qi = 0;
+    for (int i = start; i < len && qi < query.length(); i++) {
+      if (tolower((unsigned char)path[i]) != query[qi]) continue;
+      score += 1;
+      if (i == prev + 1)         score += 4;  // Consecutive run
+      if (isBoundary(path, i))   score += 6;  // Start of a word
+      if (i >= base)             score += 2;  // Inside the file name
+      prev = i;
+      qi++;
+    }
+    if (qi == query.length() && score > best) best = score;
+  }
+  if (best < 0) return best;
+
+  // Typing the whole name (with or without .txt) always wins
+  String name = String(path + base);
+  name.toLowerCase();
+  if (name == query || name == query + ".txt") best += 1000;
+
+  // Shorter paths win ties
+  return best * 64 - min(len, 63);
+}
+
+static void rankMatches() {
+  int topScores[FINDER_TOP];
+  finderTopCount = 0;
+  if (levels.empty()) return;
+
+  for (const FinderHit& hit : levels.back()) {
+    const char* path = finderPath(hit.file);
+    int score = scoreMatch(path, finderQuery);
+    if (score < 0) continue;
+
+    // Insertion into the short top list
+    int slot = finderTopCount;
+    while (slot > 0 && topScores[slot - 1] < score) slot--;
+    if (slot >= FINDER_TOP) continue;
+    for (int j = min((int)finderTopCount, FINDER_TOP - 1); j > slot; j--) {
+      topScores[j] = topScores[j - 1];
+      finderTop[j] = finderTop[j - 1];
+    }
+    topScores[slot] = score;
+    finderTop[slot] = String(path);
+    if (finderTopCount < FINDER_TOP) finderTopCount++;
+  }
+}
+
+// Runs the current query over paths [from, end) and appends them to the levels
+static void matchPaths(size_t from) {
+  for (size_t i = from; i < pathStarts.size(); i++) {
+    int pos = 0;
+    for (size_t k = 0; k < levels.size(); k++) {
+      pos = findFrom(finderPath(i), pos, finderQuery[k]);
+      if (pos == -1) break;
+      pos++;
+      levels[k].push_back({ (uint16_t)i, (uint16_t)pos });
+    }
+  }
+}
+
+static void finderLoadBegin() {
+  std::vector<char>().swap(pathBlob);
+  std::vector<uint32_t>().swap(pathStarts);
+  resetMatches();
+
+  dirWalkBegin(finderWalk, "/");
+  finderLoaded = false;
+  finderLoading = true;
+}
+
+// Caches up to FINDER_LOAD_BATCH more paths, the current matches grow with them
+static void finderLoadStep() {
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  size_t from = pathStarts.size();
+  String path;
+  size_t size;
+  time_t mtime;
+  for (int i = 0; i < FINDER_LOAD_BATCH; i++) {
+    if (!dirWalkNext(finderWalk, path, size, mtime)) {
+      finderLoading = false;
+      break;
+    }
+    if (pathStarts.size() >= FINDER_MAX_FILES) {
+      Serial.println("Finder: file limit reached");
+      dirWalkEnd(finderWalk);
+      finderLoading = false;
+      break;
+    }
+    addPath(path);
+  }
+
+  if (!finderLoading) {
+    finderLoaded = true;
+    if (DEBUG_VERBOSE) Serial.printf("Finder: %u files cached\r\n", (unsigned)pathStarts.size());
+  }
+
+  matchPaths(from);
+  rankMatches();
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+}
+
+// CACHE UPKEEP
+void finderAdd(String path) {
+  // A walk in progress may already be past the folder, start over
+  if (finderLoading) finderLoadBegin();
+  if (!finderLoaded) return;
+  path = normalizeFinderPath(path);
+  if (path.startsWith("/sys/") || path.startsWith("/dict/")) return;
+  if (findPath(path) != -1) return;
+  addPath(path);
+  resetMatches();
+}
+
+void finderRemove(String path) {
+  if (finderLoading) finderLoadBegin();
+  if (!finderLoaded) return;
+  int32_t i = findPath(normalizeFinderPath(path));
+  if (i == -1) return;
+  erasePath(i);
+  resetMatches();
+}
+
+void finderInvalidate() {
+  if (finderLoading) dirWalkEnd(finderWalk);
+  finderLoaded = false;
+  finderLoading = false;
+  std::vector<char>().swap(pathBlob);
+  std::vector<uint32_t>().swap(pathStarts);
+  resetMatches();
+}
+
+// Caches one more batch of paths while a load is under way.
+// Returns true if the matches may have changed.
+bool finderStep() {
+  if (!finderLoading || noSD || mscEnabled || SDActive) return false;
+  finderLoadStep();
+  return true;
+}
+
+// MATCHING
+int finderUpdate(String query) {
+  query.toLowerCase();
+  query = removeChar(query, ' ');
+
+  if (!finderLoaded && !finderLoading && !noSD) finderLoadBegin();
+  // Every keystroke moves the load along by one batch
+  if (finderLoading && !noSD && !SDActive) finderLoadStep();
+  if (query == finderQuery && levels.size() == query.length()) return finderTopCount;
+
+  // Levels shared with the previous query are kept
+  size_t keep = 0;
+  while (keep < query.length() && keep < finderQuery.length() && keep < levels.size() && query[keep] == finderQuery[keep]) keep++;
+  levels.resize(keep);
+
+  for (size_t k = keep; k < query.length(); k++) {
+    std::vector<FinderHit> next;
+    char c = query[k];
+
+    if (k == 0) {
+      for (size_t i = 0; i < pathStarts.size(); i++) {
+        int pos = findFrom(finderPath(i), 0, c);
+        if (pos != -1) next.push_back({ (uint16_t)i, (uint16_t)(pos + 1) });
+      }
+    }
+    else {
+      for (const FinderHit& hit : levels[k - 1]) {
+        int pos = findFrom(finderPath(hit.file), hit.pos, c);
+        if (pos != -1) next.push_back({ hit.file, (uint16_t)(pos + 1) });
+      }
+    }
+    levels.push_back(std::move(next));
+  }
+
+  finderQuery = query;
+  rankMatches();
+  return finderTopCount;
+}
+
+// Same, but finishes loading the cache first. Used when a pick is committed.
+int finderFinish(String query) {
+  if (!finderLoaded && !finderLoading && !noSD) finderLoadBegin();
+  while (finderLoading && !noSD && !SDActive) finderLoadStep();
+  return finderUpdate(query);
+}
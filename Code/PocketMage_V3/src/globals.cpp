@@ -10,9 +10,10 @@
 //  8""88888P'  o888ooooood8     o888o        `YbodP'    o888o         //
 
 // Display setup
-GxEPD2_BW<GxEPD2_310_GDEQ031T10, GxEPD2_310_GDEQ031T10::HEIGHT> display(GxEPD2_310_GDEQ031T10(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
+// Both go through taps (screenTap.h) that tools/pmremote reads the screens from
+GxEPD2_BW<EinkTap<GxEPD2_310_GDEQ031T10>, GxEPD2_310_GDEQ031T10::HEIGHT> display(EinkTap<GxEPD2_310_GDEQ031T10>(EPD_CS, EPD_DC, EPD_RST, EPD_BUSY));
 volatile bool GxEPD2_310_GDEQ031T10::useFastFullUpdate = true;
-U8G2_SSD1326_ER_256X32_F_4W_HW_SPI u8g2(U8G2_R2, OLED_CS, OLED_DC, OLED_RST); //256x32
+OledTap<U8G2_SSD1326_ER_256X32_F_4W_HW_SPI> u8g2(U8G2_R2, OLED_CS, OLED_DC, OLED_RST); //256x32
 
 // Keypad setup
 Adafruit_TCA8418 keypad;
@@ -109,6 +110,7 @@ int lines = 0;
 String outLines[13];
 String lines_prev[13];
 String filesList[MAX_FILES];
+String filesListMeta[MAX_FILES];
 uint8_t fileIndex = 0;
 String editingFile;
 String prevEditingFile = "";
@@ -130,7 +132,7 @@ int lastTouch = -1;
 unsigned long lastTouchTime = 0;
 
 // <TASKS.cpp>
-std::vector<std::vector<String>> tasks;
+std::vector<Task> tasks;
 uint8_t selectedTask = 0;
 TasksState CurrentTasksState = TASKS0;
 uint8_t newTaskState = 0;
@@ -0,0 +1,412 @@
+//  ooooo   .oooooo.    .oooooo..o  //
+//  `888'  d8P'  `Y8b  d8P'    `Y8  //
+//   888  888          Y88bo.       //
+//   888  888           `"Y8888o.   //
+//   888  888               `"Y88b  //
+//   888  `88b    ooo  oo     .d8P  //
+//  o888o  `Y8bood8P'  8""88888P'   //
+#include "globals.h"
+
+// ICALENDAR IMPORT
+// Streams an .ics file through a fixed read buffer and a fixed line buffer,
+// so memory use doesn't grow with the file. Each VEVENT is appended to
+// EVENTS_FILE as soon as its END:VEVENT is read.
+// RRULEs the event store can't express (INTERVAL > 1, last weekday of the
+// month, series that already ended ...) keep only their first occurrence.
+
+#define ICS_READ_BUF 512
+#define ICS_LINE_MAX 256
+#define ICS_TEXT_MAX 48       // Longest name or note kept
+#define ICS_RRULE_MAX 96
+
+struct IcsEvent {
+  char     name[ICS_TEXT_MAX];
+  char     note[ICS_TEXT_MAX];
+  char     location[ICS_TEXT_MAX];
+  char     rrule[ICS_RRULE_MAX];
+  uint32_t date;          // Packed YYYYMMDD start, 0 if missing
+  int16_t  time;          // Minutes after midnight, -1 for all-day
+  uint32_t endDate;       // DTEND, 0 if missing
+  int16_t  endTime;
+  int32_t  duration;      // DURATION in minutes, -1 if missing
+};
+
+struct IcsState {
+  IcsEvent event;
+  char     line[ICS_LINE_MAX];
+  size_t   lineLen;
+  bool     atLineStart;   // Just saw a line break, the next char may fold it
+  bool     inEvent;
+  uint8_t  nested;        // VALARM and friends inside the current VEVENT
+  int      imported;
+  int      single;        // Repeat rule dropped
+  int      skipped;       // No usable DTSTART
+};
+
+static IcsState ics;
+
+// TEXT
+// Copies an ICS TEXT value, undoing its escapes and escaping it again as an
+// events file field (records.h)
+static void icsCopyText(char* dst, const char* src) {
+  size_t n = 0;
+  for (const char* p = src; *p && n < ICS_TEXT_MAX - 1; p++) {
+    char c = *p;
+    if (c == '\\' && p[1]) {
+      p++;
+      c = (*p == 'n' || *p == 'N') ? ' ' : *p;
+    }
+    if (needsEscape(c)) {
+      if (n + 2 > ICS_TEXT_MAX - 1) break;
+      dst[n++] = '\\';
+    }
+    dst[n++] = c;
+  }
+  dst[n] = '\0';
+}
+
+// DATES
+// "20250115", "20250115T0900[00]" or "20250115T090000Z". UTC times are
+// shifted by ICS_UTC_OFFSET, which can move the date.
+static bool icsParseDateTime(const char* value, uint32_t& date, int16_t& minutes) {
+  size_t len = strlen(value);
+  date = parsePackedDate(value, len);
+  if (date == 0) return false;
+
+  minutes = -1;
+  if (len >= 13 && value[8] == 'T') {
+    int32_t hhmm = parseDigits(value + 9, 4);
+    if (hhmm < 0 || hhmm / 100 > 23 || hhmm % 100 > 59) return false;
+    int32_t total = hhmm / 100 * 60 + hhmm % 100;
+
+    if (value[len - 1] == 'Z') {
+      int32_t day = daysFromPacked(date);
+      total += ICS_UTC_OFFSET;
+      while (total < 0)     { total += 1440; day--; }
+      while (total >= 1440) { total -= 1440; day++; }
+      date = packedFromDays(day);
+    }
+    minutes = total;
+  }
+  return true;
+}
+
+// "PT1H30M", "P1D", "P2W" in minutes
+static int32_t icsParseDuration(const char* value) {
+  int32_t minutes = 0;
+  int32_t number = 0;
+  for (const char* p = value; *p; p++) {
+    if (*p >= '0' && *p <= '9') { number = number * 10 + (*p - '0'); continue; }
+    switch (*p) {
+      case 'W': minutes += number * 7 * 1440; break;
+      case 'D': minutes += number * 1440;     break;
+      case 'H': minutes += number * 60;       break;
+      case 'M': minutes += number;            break;
+      default: break;                         // P, T, S
+    }
+    number = 0;
+  }
+  return minutes;
+}
+
+// REPEAT RULES
+static int icsWeekday(const char* code) {
+  const char* codes[] = { "SU", "MO", "TU", "WE", "TH", "FR", "SA" };
+  for (int i = 0; i < 7; i++) {
+    if (code[0] == codes[i][0] && code[1] == codes[i][1]) return i;
+  }
+  return -1;
+}
+
+// Maps an RRULE onto the repeat codes in CALENDAR.cpp. Returns false when the
+// rule can't be expressed, out is then left empty. Repeats never end there, so
+// a series with COUNT or UNTIL is kept as its first date rather than forever.
+static bool icsRepeatCode(const IcsEvent& event, char* out, size_t outLen) {
+  const char* daysOfWeek[] = { "Su", "Mo", "Tu", "We", "Th", "Fr", "Sa" };
+  out[0] = '\0';
+  if (event.rrule[0] == '\0') return true;
+
+  char freq[10] = "";
+  char byDay[40] = "";
+  int  byMonthDay = 0;
+  int  byMonth = 0;
+  int  bySetPos = 0;
+  int  interval = 1;
+  bool ends = false;
+
+  // KEY=VALUE pairs separated by ';'
+  char rule[ICS_RRULE_MAX];
+  strncpy(rule, event.rrule, sizeof(rule) - 1);
+  rule[sizeof(rule) - 1] = '\0';
+  for (char* part = rule; part && *part; ) {
+    char* next = strchr(part, ';');
+    if (next) *next++ = '\0';
+    char* eq = strchr(part, '=');
+    if (eq) {
+      *eq = '\0';
+      const char* value = eq + 1;
+      if      (!strcmp(part, "FREQ"))       { strncpy(freq, value, sizeof(freq) - 1); }
+      else if (!strcmp(part, "BYDAY"))      { strncpy(byDay, value, sizeof(byDay) - 1); }
+      else if (!strcmp(part, "BYMONTHDAY")) { byMonthDay = atoi(value); if (strchr(value, ',')) return false; }
+      else if (!strcmp(part, "BYMONTH"))    { byMonth = atoi(value); if (strchr(value, ',')) return false; }
+      else if (!strcmp(part, "BYSETPOS"))   { bySetPos = atoi(value); }
+      else if (!strcmp(part, "INTERVAL"))   { interval = atoi(value); }
+      else if (!strcmp(part, "UNTIL") || !strcmp(part, "COUNT")) { ends = true; }
+    }
+    part = next;
+  }
+
+  // The store has no end dates, intervals or days counted from the month's end
+  if (interval > 1 || ends || byMonthDay < 0) return false;
+
+  int month = packedMonth(event.date);
+  int day   = packedDay(event.date);
+
+  if (!strcmp(freq, "DAILY")) {
+    if (byDay[0]) return false;
+    snprintf(out, outLen, "DAILY");
+  }
+  else if (!strcmp(freq, "WEEKLY")) {
+    char code[16] = "";
+    if (byDay[0] == '\0') {
+      strcpy(code, daysOfWeek[weekdayOf(packedYear(event.date), month, day)]);
+    }
+    for (const char* p = byDay; *p; ) {
+      int wd = icsWeekday(p);
+      if (wd < 0) return false;          // "1MO" style is not weekly
+      if (!strstr(code, daysOfWeek[wd])) strcat(code, daysOfWeek[wd]);
+      p += 2;
+      if (*p == ',') p++;
+    }
+    snprintf(out, outLen, "WEEKLY %s", code);
+  }
+  else if (!strcmp(freq, "MONTHLY")) {
+    if (byDay[0] == '\0') {
+      snprintf(out, outLen, "MONTHLY %d", byMonthDay > 0 ? byMonthDay : day);
+    }
+    else {
+      // "2TU", or "TU" with BYSETPOS=2. Negative positions are not supported.
+      if (strchr(byDay, ',') || byMonthDay != 0) return false;
+      int nth = (byDay[0] >= '1' && byDay[0] <= '5') ? byDay[0] - '0' : bySetPos;
+      int wd  = icsWeekday(byDay[0] >= '1' && byDay[0] <= '5' ? byDay + 1 : byDay);
+      if (nth < 1 || nth > 5 || wd < 0) return false;
+      snprintf(out, outLen, "MONTHLY %d%s", nth, daysOfWeek[wd]);
+    }
+  }
+  else if (!strcmp(freq, "YEARLY")) {
+    if (byDay[0] || (byMonth != 0 && byMonth != month) || (byMonthDay != 0 && byMonthDay != day)) return false;
+    String monthName = getMonthName(month);
+    snprintf(out, outLen, "YEARLY %c%c%c%02d", toupper(monthName[0]), toupper(monthName[1]), toupper(monthName[2]), day);
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+// EVENTS
+static void icsEmit(File& out) {
+  IcsEvent& e = ics.event;
+  if (e.date == 0) {
+    ics.skipped++;
+    return;
+  }
+
+  int32_t minutes = 0;
+  if (e.duration >= 0) {
+    minutes = e.duration;
+  }
+  else if (e.endDate != 0) {
+    minutes = (daysFromPacked(e.endDate) - daysFromPacked(e.date)) * 1440;
+    if (e.time >= 0 && e.endTime >= 0) minutes += e.endTime - e.time;
+    if (minutes < 0) minutes = 0;
+  }
+
+  char repeat[24];
+  if (!icsRepeatCode(e, repeat, sizeof(repeat))) {
+    repeat[0] = '\0';
+    ics.single++;
+  }
+
+  char timeCode[5] = "";
+  if (e.time >= 0 && e.time < 1440) snprintf(timeCode, sizeof(timeCode), "%02u%02u", (unsigned)e.time / 60 % 100, (unsigned)e.time % 60);
+
+  char line[ICS_TEXT_MAX * 2 + 64];
+  snprintf(line, sizeof(line), "%s|%08lu|%s|%ld|%s|%s\n",
+           e.name[0] ? e.name : "Event", (unsigned long)e.date, timeCode, (long)minutes, repeat,
+           e.note[0] ? e.note : e.location);
+  out.print(line);
+  ics.imported++;
+}
+
+// One unfolded content line: NAME;PARAM=...:VALUE
+static void icsLine(char* line, File& out) {
+  // Split at the first ':' outside a quoted parameter
+  char* value = nullptr;
+  bool quoted = false;
+  for (char* p = line; *p; p++) {
+    if (*p == '"') quoted = !quoted;
+    else if (*p == ':' && !quoted) { *p = '\0'; value = p + 1; break; }
+  }
+  if (!value) return;
+
+  char* params = strchr(line, ';');
+  if (params) *params++ = '\0';
+  const char* name = line;
+
+  if (!strcmp(name, "BEGIN")) {
+    if (!strcmp(value, "VEVENT")) {
+      memset(&ics.event, 0, sizeof(ics.event));
+      ics.event.time = -1;
+      ics.event.endTime = -1;
+      ics.event.duration = -1;
+      ics.inEvent = true;
+      ics.nested = 0;
+    }
+    else if (ics.inEvent) {
+      ics.nested++;
+    }
+    return;
+  }
+  if (!strcmp(name, "END")) {
+    if (!ics.inEvent) return;
+    if (ics.nested > 0) ics.nested--;
+    else if (!strcmp(value, "VEVENT")) {
+      icsEmit(out);
+      ics.inEvent = false;
+    }
+    return;
+  }
+  if (!ics.inEvent || ics.nested > 0) return;
+
+  if      (!strcmp(name, "SUMMARY"))     icsCopyText(ics.event.name, value);
+  else if (!strcmp(name, "DESCRIPTION")) icsCopyText(ics.event.note, value);
+  else if (!strcmp(name, "LOCATION"))    icsCopyText(ics.event.location, value);
+  else if (!strcmp(name, "DURATION"))    ics.event.duration = icsParseDuration(value);
+  else if (!strcmp(name, "DTSTART")) {
+    if (!icsParseDateTime(value, ics.event.date, ics.event.time)) ics.event.date = 0;
+  }
+  else if (!strcmp(name, "DTEND")) {
+    if (!icsParseDateTime(value, ics.event.endDate, ics.event.endTime)) ics.event.endDate = 0;
+  }
+  else if (!strcmp(name, "RRULE")) {
+    strncpy(ics.event.rrule, value, ICS_RRULE_MAX - 1);
+    ics.event.rrule[ICS_RRULE_MAX - 1] = '\0';
+  }
+}
+
+// Unfolds content lines one character at a time
+static void icsFlushLine(File& out) {
+  if (ics.lineLen > 0) {
+    ics.line[ics.lineLen] = '\0';
+    icsLine(ics.line, out);
+  }
+  ics.lineLen = 0;
+}
+
+static void icsFeed(char c, File& out) {
+  if (ics.atLineStart) {
+    ics.atLineStart = false;
+    if (c == ' ' || c == '\t') return;     // Folded continuation
+    icsFlushLine(out);
+  }
+  if (c == '\r') return;
+  if (c == '\n') {
+    ics.atLineStart = true;
+    return;
+  }
+  if (ics.lineLen < ICS_LINE_MAX - 1) ics.line[ics.lineLen++] = c;
+}
+
+// IMPORT
+// Returns the number of events added, -1 if the file couldn't be read
+int icsImport(const String& path) {
+  File in = SD_MMC.open(path, "r");
+  if (!in) {
+    Serial.println("ICS: failed to open " + path);
+    return -1;
+  }
+
+  // Imported text is escaped, older events files are upgraded first
+  File out = sysfsUpgradeRecords(EVENTS_FILE) ? sysfsOpen(EVENTS_FILE, "a") : File();
+  if (!out) {
+    Serial.println("ICS: failed to open events file");
+    in.close();
+    return -1;
+  }
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  memset(&ics, 0, sizeof(ics));
+
+  uint8_t buf[ICS_READ_BUF];
+  size_t n;
+  while ((n = in.read(buf, sizeof(buf))) > 0) {
+    for (size_t i = 0; i < n; i++) icsFeed((char)buf[i], out);
+  }
+  icsFlushLine(out);
+
+  in.close();
+  out.close();
+  invalidateEventCache();
+
+  Serial.printf("ICS: %s imported %d events (%d without repeat, %d skipped)\r\n",
+                path.c_str(), ics.imported, ics.single, ics.skipped);
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+
+  return ics.imported;
+}
+
+#ifndef NATIVE_TEST
+// Imports every .ics file on the card that isn't already listed, unchanged,
+// in SYS_ICS_LOG
+int icsImportAll() {
+  if (noSD) {
+    oledWord("IMPORT FAILED - No SD!");
+    delay(5000);
+    return -1;
+  }
+
+  int total = 0;
+  DirWalk walk;
+  dirWalkBegin(walk, "/");
+
+  String path;
+  size_t size;
+  time_t mtime;
+  while (dirWalkNext(walk, path, size, mtime)) {
+    String lower = path;
+    lower.toLowerCase();
+    if (!lower.endsWith(".ics")) continue;
+
+    String stamp = path + "|" + String((unsigned long)size) + "|" + String((unsigned long)mtime);
+    bool seen = false;
+    File log = SD_MMC.open(SYS_ICS_LOG, FILE_READ);
+    if (log) {
+      while (log.available() && !seen) {
+        String entry = log.readStringUntil('\n');
+        entry.trim();
+        if (entry == stamp) seen = true;
+      }
+      log.close();
+    }
+    if (seen) continue;
+
+    oledWord("Importing " + path);
+    int count = icsImport(path);
+    if (count < 0) continue;
+    total += count;
+
+    log = SD_MMC.open(SYS_ICS_LOG, FILE_APPEND);
+    if (log) {
+      log.println(stamp);
+      log.close();
+    }
+  }
+
+  return total;
+}
+#endif
@@ -0,0 +1,639 @@
+//  ooooo ooooo      ooo oooooooooo.   oooooooooooo ooooooo  ooooo  //
+//  `888' `888b.     `8' `888'   `Y8b  `888'     `8  `8888    d8'   //
+//   888   8 `88b.    8   888      888  888            Y888..8P     //
+//   888   8   `88b.  8   888      888  888oooo8        `8888'      //
+//   888   8     `88b.8   888      888  888    "       .8PY888.     //
+//   888   8       `888   888     d88'  888       o   d8'  `888b    //
+//  o888o o8o        `8  o888bood8P'   o888ooooood8 o888o  o88888o  //
+#include "globals.h"
+
+// FULL-TEXT SEARCH INDEX
+// The index lives in SYS_INDEX_DIR:
+//   files.txt  "+id:buckets|/path" adds or renames a document, "-id" drops it.
+//              buckets is a hex mask of the bNN.txt files holding its postings
+//   bNN.txt    "term|id:line,line,..." postings, one bucket per term hash
+// Both are appended to as notes change. files.txt is read once into
+// indexDocs, so saves and searches look ids and paths up in RAM and a query
+// opens one bucket per term. A re-save gets a fresh id and drops the old one,
+// whose postings are skipped at query time until enough documents are
+// dropped. Then the buckets they touched are rewritten without them, one per
+// background step, and files.txt last. A full rebuild starts from scratch.
+
+struct IndexDoc {
+  uint32_t id;
+  uint64_t buckets;      // Bit b set when bucket b holds postings of this document
+  String   path;         // "" once dropped
+  bool     sweeping;     // Dropped before the running compaction began
+};
+
+bool indexResultsActive = false;
+int  indexResultLines[MAX_FILES];
+
+static std::vector<IndexDoc> indexDocs;  // Sorted by id
+static bool indexLoaded = false;
+static uint32_t nextDocId = 1;
+static uint32_t droppedDocs = 0;         // In indexDocs with their postings still in the buckets
+
+static bool compactRunning = false;
+static uint64_t compactBuckets = 0;      // Buckets the running compaction still has to rewrite
+
+static bool rebuildPending = false;
+static bool rebuildStarted = false;
+static DirWalk rebuildWalk;
+
+static const uint64_t ALL_BUCKETS = ~(uint64_t)0;
+
+// HELPERS
+static String indexTablePath() {
+  return String(SYS_INDEX_DIR) + "/files.txt";
+}
+
+static String indexBucketPath(uint16_t bucket) {
+  return String(SYS_INDEX_DIR) + "/b" + String(bucket) + ".txt";
+}
+
+static uint16_t indexBucket(const String& term) {
+  return hashString(term) % INDEX_BUCKETS;
+}
+
+static String normalizePath(String path) {
+  if (!path.startsWith("/")) path = "/" + path;
+  return path;
+}
+
+static void appendIndexLine(const String& path, const String& text) {
+  File f = SD_MMC.open(path, FILE_APPEND);
+  if (!f) {
+    Serial.println("Index: failed to open " + path);
+    return;
+  }
+  f.print(text);
+  f.close();
+}
+
+static String tableLine(const IndexDoc& doc) {
+  char head[32];
+  snprintf(head, sizeof(head), "+%lu:%llx|", (unsigned long)doc.id, (unsigned long long)doc.buckets);
+  return String(head) + doc.path + "\n";
+}
+
+static String backupPath(const String& path) {
+  return path + ".bak";
+}
+
+// Replaces path with tmpPath, which holds its new contents. The old file is
+// moved aside first and only removed once the new one is in place, so a power
+// cut in between leaves it to recoverIndexFiles().
+static bool replaceIndexFile(const String& tmpPath, const String& path) {
+  String bakPath = backupPath(path);
+  if (SD_MMC.exists(bakPath)) SD_MMC.remove(bakPath);
+  if (SD_MMC.exists(path) && !SD_MMC.rename(path, bakPath)) {
+    Serial.println("Index: failed to replace " + path);
+    return false;
+  }
+  if (!SD_MMC.rename(tmpPath, path)) {
+    SD_MMC.rename(bakPath, path);
+    Serial.println("Index: failed to replace " + path);
+    return false;
+  }
+  SD_MMC.remove(bakPath);
+  return true;
+}
+
+// Puts back an old file whose replacement never arrived. Its postings are a
+// superset of the compacted ones, so the index stays correct either way.
+static void recoverIndexFile(const String& path) {
+  String bakPath = backupPath(path);
+  if (!SD_MMC.exists(bakPath)) return;
+  if (SD_MMC.exists(path)) SD_MMC.remove(bakPath);
+  else SD_MMC.rename(bakPath, path);
+}
+
+static void recoverIndexFiles() {
+  recoverIndexFile(indexTablePath());
+  for (uint16_t b = 0; b < INDEX_BUCKETS; b++) recoverIndexFile(indexBucketPath(b));
+}
+
+// Splits text into lowercase alphanumeric words and hands each one to
+// onTerm along with the line it was found on.
+template <typename F>
+static void forEachTerm(const String& text, F onTerm) {
+  String word = "";
+  int line = 0;
+  for (size_t i = 0; i <= text.length(); i++) {
+    char c = (i < text.length()) ? text[i] : '\n';
+    if (isalnum((unsigned char)c)) {
+      if (word.length() < INDEX_MAX_TERM) word += (char)tolower((unsigned char)c);
+    }
+    else {
+      if (word.length() >= 2) onTerm(word, line);
+      word = "";
+      if (c == '\n') line++;
+    }
+  }
+}
+
+// DOCUMENT TABLE
+static bool docLess(const IndexDoc& doc, uint32_t id) {
+  return doc.id < id;
+}
+
+static IndexDoc* findDoc(uint32_t id) {
+  auto it = std::lower_bound(indexDocs.begin(), indexDocs.end(), id, docLess);
+  return (it != indexDocs.end() && it->id == id) ? &*it : nullptr;
+}
+
+static IndexDoc* findLiveDoc(const String& path) {
+  for (IndexDoc& doc : indexDocs) {
+    if (doc.path.length() > 0 && doc.path == path) return &doc;
+  }
+  return nullptr;
+}
+
+// Replays files.txt into indexDocs. Lines from before the bucket masks say
+// nothing about where their postings are, so they count as in every bucket.
+static void indexLoad() {
+  if (indexLoaded) return;
+  indexLoaded = true;
+  indexDocs.clear();
+  droppedDocs = 0;
+  nextDocId = 1;
+
+  recoverIndexFiles();
+  File table = SD_MMC.open(indexTablePath(), FILE_READ);
+  if (!table) return;
+
+  RecordReader<File> reader(table);
+  while (reader.nextLine()) {
+    char kind = reader.line[0];
+    if (kind != '+' && kind != '-') continue;
+    char* end = nullptr;
+    uint32_t id = strtoul(reader.line + 1, &end, 10);
+    if (end == reader.line + 1) continue;
+    if (id >= nextDocId) nextDocId = id + 1;
+
+    IndexDoc* doc = findDoc(id);
+    if (kind == '-') {
+      if (doc) doc->path = "";
+      continue;
+    }
+
+    uint64_t buckets = ALL_BUCKETS;
+    if (*end == ':') buckets = strtoull(end + 1, &end, 16);
+    if (*end != '|') continue;
+    if (!doc) {
+      IndexDoc added = { id, buckets, "", false };
+      doc = &*indexDocs.insert(std::lower_bound(indexDocs.begin(), indexDocs.end(), id, docLess), added);
+    }
+    doc->buckets = buckets;
+    doc->path = end + 1;
+  }
+  table.close();
+
+  for (const IndexDoc& doc : indexDocs) {
+    if (doc.path.length() == 0) droppedDocs++;
+  }
+}
+
+// Starts a compaction once the dropped documents are at least INDEX_COMPACT_MIN
+// and a quarter of the live ones, so its cost is spread over as many saves
+static void maybeCompact(bool force) {
+  if (compactRunning || droppedDocs == 0) return;
+  uint32_t live = indexDocs.size() - droppedDocs;
+  if (!force && (droppedDocs < INDEX_COMPACT_MIN || droppedDocs * 4 < live)) return;
+
+  compactBuckets = 0;
+  for (IndexDoc& doc : indexDocs) {
+    doc.sweeping = doc.path.length() == 0;
+    if (doc.sweeping) compactBuckets |= doc.buckets;
+  }
+  compactRunning = true;
+}
+
+static void dropDoc(IndexDoc& doc, String& tableText) {
+  tableText += "-" + String(doc.id) + "\n";
+  doc.path = "";
+  droppedDocs++;
+}
+
+static void indexText(const String& path, const String& text) {
+  if (!SD_MMC.exists(SYS_INDEX_DIR)) SD_MMC.mkdir(SYS_INDEX_DIR);
+  indexLoad();
+
+  uint32_t id = nextDocId++;
+
+  // Collect up to INDEX_MAX_HITS line numbers per unique term
+  std::vector<String> terms;
+  std::vector<String> hits;
+  std::vector<uint8_t> hitCounts;
+  forEachTerm(text, [&](const String& term, int line) {
+    for (size_t i = 0; i < terms.size(); i++) {
+      if (terms[i] == term) {
+        if (hitCounts[i] < INDEX_MAX_HITS) {
+          hits[i] += "," + String(line);
+          hitCounts[i]++;
+        }
+        return;
+      }
+    }
+    terms.push_back(term);
+    hits.push_back(String(line));
+    hitCounts.push_back(1);
+  });
+
+  // Group postings by bucket so each bucket file is opened once
+  std::vector<String> buckets(INDEX_BUCKETS);
+  uint64_t used = 0;
+  for (size_t i = 0; i < terms.size(); i++) {
+    uint16_t b = indexBucket(terms[i]);
+    buckets[b] += terms[i] + "|" + String(id) + ":" + hits[i] + "\n";
+    used |= (uint64_t)1 << b;
+  }
+  for (uint16_t b = 0; b < INDEX_BUCKETS; b++) {
+    if (buckets[b].length() > 0) appendIndexLine(indexBucketPath(b), buckets[b]);
+  }
+
+  // Publish the document last so a partial write is never visible
+  String tableText = "";
+  IndexDoc* old = findLiveDoc(path);
+  if (old) dropDoc(*old, tableText);
+  IndexDoc doc = { id, used, path, false };
+  tableText += tableLine(doc);
+  appendIndexLine(indexTablePath(), tableText);
+  indexDocs.push_back(doc);
+  maybeCompact(false);
+
+  if (DEBUG_VERBOSE) Serial.printf("Indexed %s as %u (%u terms)\r\n", path.c_str(), id, (unsigned)terms.size());
+}
+
+// UPDATE HOOKS
+void indexFile(String path, const String& text) {
+  if (noSD) return;
+  path = normalizePath(path);
+  if (!isNoteFile(path)) return;
+  indexText(path, text);
+}
+
+void indexRemove(String path) {
+  if (noSD) return;
+  path = normalizePath(path);
+  if (!isNoteFile(path)) return;
+  indexLoad();
+  IndexDoc* doc = findLiveDoc(path);
+  if (!doc) return;
+
+  String tableText = "";
+  dropDoc(*doc, tableText);
+  appendIndexLine(indexTablePath(), tableText);
+  maybeCompact(false);
+}
+
+void indexRename(String oldPath, String newPath) {
+  if (noSD) return;
+  oldPath = normalizePath(oldPath);
+  newPath = normalizePath(newPath);
+  indexLoad();
+  IndexDoc* doc = isNoteFile(oldPath) ? findLiveDoc(oldPath) : nullptr;
+
+  if (doc && isNoteFile(newPath)) {
+    // Postings stay valid, only the path changes. A note renamed over
+    // another one replaces it.
+    String tableText = "";
+    IndexDoc* replaced = findLiveDoc(newPath);
+    if (replaced && replaced != doc) dropDoc(*replaced, tableText);
+    doc->path = newPath;
+    tableText += tableLine(*doc);
+    appendIndexLine(indexTablePath(), tableText);
+    maybeCompact(false);
+  }
+  else if (doc) {
+    String tableText = "";
+    dropDoc(*doc, tableText);
+    appendIndexLine(indexTablePath(), tableText);
+    maybeCompact(false);
+  }
+  else if (isNoteFile(newPath)) {
+    indexText(newPath, readFileQuiet(newPath));
+  }
+}
+
+void indexRequestCompact() {
+  if (noSD) return;
+  indexLoad();
+  maybeCompact(true);
+}
+
+// QUERY
+// Bucket lines are appended in id order whatever their term, so a bucket can
+// be searched by id. A query reads the smallest of its buckets in full and,
+// in the others, only looks up the ids still in the running.
+typedef std::vector<std::pair<uint32_t, int>> Postings;   // Live id and first line, by id
+
+static const uint32_t NO_POSTING = 0xFFFFFFFF;
+static const size_t BUCKET_SKIP = 2 * RECORD_READ_BUF;     // Closer than this, reading on beats seeking
+
+// Posting id on a bucket line, 0 if it has none
+static uint32_t postingId(const char* line) {
+  const char* sep = strchr(line, '|');
+  return sep ? strtoul(sep + 1, NULL, 10) : 0;
+}
+
+// First line number of term's posting on a bucket line, -1 for another term
+static int postingLine(const char* line, const String& term) {
+  if (strncmp(line, term.c_str(), term.length()) != 0 || line[term.length()] != '|') return -1;
+  const char* colon = strchr(line + term.length(), ':');
+  return colon ? (int)strtol(colon + 1, NULL, 10) : -1;
+}
+
+// Reads a bucket a line at a time, from the start or from any byte offset
+struct BucketCursor {
+  RecordReader<File> reader;
+  size_t size;
+  size_t start = 0;       // Offset of the current line
+  uint32_t id = 0;        // Its posting id, NO_POSTING past the end
+
+  explicit BucketCursor(File& file) : reader(file), size(file.size()) {
+    seek(0);
+  }
+
+  void next() {
+    start = reader.consumed;
+    id = reader.nextLine() ? postingId(reader.line) : NO_POSTING;
+  }
+
+  // To the first line starting at or after pos
+  void seek(size_t pos) {
+    reader.seek(pos == 0 ? 0 : pos - 1);
+    if (pos > 0) reader.skipLine();
+    next();
+  }
+
+  // To the first line with an id of at least target. Near lines are read on,
+  // far ones found by doubling the stride and then halving the gap, so a
+  // lookup costs a few short reads however long the bucket is.
+  void seekId(uint32_t target) {
+    size_t from = start;
+    while (id < target && start < from + BUCKET_SKIP) next();
+    if (id >= target) return;
+
+    size_t lo = start, hi = size, stride = BUCKET_SKIP;
+    while (lo + stride < size) {
+      seek(lo + stride);
+      if (id >= target) {
+        hi = start;
+        break;
+      }
+      lo = start;
+      stride *= 2;
+    }
+    while (hi - lo > BUCKET_SKIP) {
+      seek(lo + (hi - lo) / 2);
+      if (start >= hi) break;
+      if (id >= target) hi = start;
+      else lo = start;
+    }
+    seek(lo);
+    while (id < target) next();
+  }
+};
+
+// Every live posting of term in bucket
+static void readPostings(File& bucket, const String& term, Postings& out) {
+  for (BucketCursor cursor(bucket); cursor.id != NO_POSTING; cursor.next()) {
+    int line = postingLine(cursor.reader.line, term);
+    if (line < 0) continue;
+    IndexDoc* doc = findDoc(cursor.id);
+    if (!doc || doc->path.length() == 0) continue;
+    out.push_back(std::make_pair(cursor.id, line));
+  }
+}
+
+// Keeps the matches term also has a posting for, walking the bucket forward
+// once alongside them. With takeLine their line becomes term's.
+static void keepPostings(File& bucket, const String& term, bool takeLine, Postings& matches) {
+  BucketCursor cursor(bucket);
+  size_t kept = 0;
+  for (size_t i = 0; i < matches.size() && cursor.id != NO_POSTING; i++) {
+    uint32_t id = matches[i].first;
+    cursor.seekId(id);
+    int line = -1;
+    for (; cursor.id == id; cursor.next()) {
+      if (line < 0) line = postingLine(cursor.reader.line, term);
+    }
+    if (line < 0) continue;
+    matches[kept] = matches[i];
+    if (takeLine) matches[kept].second = line;
+    kept++;
+  }
+  matches.resize(kept);
+}
+
+int indexSearch(String query) {
+  if (noSD) {
+    oledWord("SEARCH FAILED - No SD!");
+    delay(5000);
+    return 0;
+  }
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+  delay(50);
+
+  indexLoad();
+
+  std::vector<String> queryTerms;
+  forEachTerm(query, [&](const String& term, int) {
+    if (queryTerms.size() < 4 && std::find(queryTerms.begin(), queryTerms.end(), term) == queryTerms.end()) {
+      queryTerms.push_back(term);
+    }
+  });
+
+  // Each bucket opened once, even when terms share it
+  std::vector<uint16_t> bucketIds;
+  std::vector<File> buckets;
+  std::vector<size_t> termBucket;
+  buckets.reserve(queryTerms.size());
+  bool missing = false;
+  for (const String& term : queryTerms) {
+    uint16_t b = indexBucket(term);
+    size_t i = std::find(bucketIds.begin(), bucketIds.end(), b) - bucketIds.begin();
+    if (i == bucketIds.size()) {
+      bucketIds.push_back(b);
+      buckets.push_back(SD_MMC.open(indexBucketPath(b), FILE_READ));
+      if (!buckets.back()) missing = true;
+    }
+    termBucket.push_back(i);
+  }
+
+  // Smallest bucket first, then ANDed with the others. The line shown is the
+  // one of the first term typed.
+  Postings matches;
+  if (!missing && !queryTerms.empty()) {
+    std::vector<size_t> order(queryTerms.size());
+    for (size_t t = 0; t < order.size(); t++) order[t] = t;
+    std::vector<size_t> sizes;
+    for (File& bucket : buckets) sizes.push_back(bucket.size());
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return sizes[termBucket[a]] < sizes[termBucket[b]];
+    });
+
+    readPostings(buckets[termBucket[order[0]]], queryTerms[order[0]], matches);
+    for (size_t k = 1; k < order.size() && !matches.empty(); k++) {
+      size_t t = order[k];
+      keepPostings(buckets[termBucket[t]], queryTerms[t], t == 0, matches);
+    }
+  }
+  for (File& bucket : buckets) {
+    if (bucket) bucket.close();
+  }
+
+  // Newest documents first
+  fileIndex = 0;
+  for (int i = 0; i < MAX_FILES; i++) {
+    filesList[i] = "-";
+    indexResultLines[i] = 0;
+  }
+  for (int i = (int)matches.size() - 1; i >= 0 && fileIndex < MAX_FILES; i--) {
+    filesList[fileIndex] = findDoc(matches[i].first)->path.substring(1);
+    indexResultLines[fileIndex] = matches[i].second;
+    fileIndex++;
+  }
+  indexResultsActive = true;
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+
+  return fileIndex;
+}
+
+// COMPACTION
+// Copies bucket b without the postings of documents that are no longer live
+static void compactBucket(uint16_t b) {
+  String path = indexBucketPath(b);
+  String tmpPath = path + ".tmp";
+  File in = SD_MMC.open(path, FILE_READ);
+  if (!in) return;
+  File out = SD_MMC.open(tmpPath, FILE_WRITE);
+  if (!out) {
+    in.close();
+    Serial.println("Index: failed to open " + tmpPath);
+    return;
+  }
+
+  RecordReader<File> reader(in);
+  String kept = "";
+  while (reader.nextLine()) {
+    IndexDoc* doc = findDoc(postingId(reader.line));
+    if (!doc || doc->path.length() == 0) continue;
+    kept += reader.line;
+    kept += "\n";
+    if (kept.length() >= 512) {
+      out.print(kept);
+      kept = "";
+    }
+  }
+  out.print(kept);
+  in.close();
+  out.close();
+  replaceIndexFile(tmpPath, path);
+}
+
+// Rewrites files.txt with the live documents and forgets the swept ones
+static void compactTable() {
+  String tmpPath = indexTablePath() + ".tmp";
+  File out = SD_MMC.open(tmpPath, FILE_WRITE);
+  if (!out) {
+    Serial.println("Index: failed to open " + tmpPath);
+    return;
+  }
+  for (const IndexDoc& doc : indexDocs) {
+    if (doc.sweeping) continue;
+    out.print(tableLine(doc));
+    // Dropped since the compaction began, its postings may still be about
+    if (doc.path.length() == 0) out.print("-" + String(doc.id) + "\n");
+  }
+  out.close();
+  if (!replaceIndexFile(tmpPath, indexTablePath())) return;
+
+  uint32_t swept = 0;
+  indexDocs.erase(std::remove_if(indexDocs.begin(), indexDocs.end(), [&swept](const IndexDoc& doc) {
+    if (!doc.sweeping) return false;
+    swept++;
+    return true;
+  }), indexDocs.end());
+  droppedDocs -= swept;
+  if (DEBUG_VERBOSE) Serial.printf("Index compacted, %u documents dropped\r\n", swept);
+}
+
+// BACKGROUND WORK
+void indexRequestRebuild() {
+  rebuildPending = true;
+  rebuildStarted = false;
+}
+
+static void startRebuild() {
+  // Drop the old index entirely, the walk below re-adds every note
+  for (uint16_t b = 0; b < INDEX_BUCKETS; b++) {
+    String path = indexBucketPath(b);
+    if (SD_MMC.exists(path)) SD_MMC.remove(path);
+    if (SD_MMC.exists(backupPath(path))) SD_MMC.remove(backupPath(path));
+  }
+  if (SD_MMC.exists(indexTablePath())) SD_MMC.remove(indexTablePath());
+  if (SD_MMC.exists(backupPath(indexTablePath()))) SD_MMC.remove(backupPath(indexTablePath()));
+  if (!SD_MMC.exists(SYS_INDEX_DIR)) SD_MMC.mkdir(SYS_INDEX_DIR);
+
+  indexDocs.clear();
+  indexLoaded = true;
+  nextDocId = 1;
+  droppedDocs = 0;
+  compactRunning = false;
+  dirWalkBegin(rebuildWalk, "/");
+  rebuildStarted = true;
+}
+
+static void rebuildStep() {
+  if (!rebuildStarted) startRebuild();
+
+  String path;
+  size_t size;
+  time_t mtime;
+  while (true) {
+    if (!dirWalkNext(rebuildWalk, path, size, mtime)) {
+      rebuildPending = false;
+      Serial.println("Search index rebuilt");
+      break;
+    }
+    if (isNoteFile(path)) {
+      indexText(path, readFileQuiet(path));
+      break;
+    }
+  }
+}
+
+static void compactStep() {
+  if (compactBuckets != 0) {
+    uint16_t b = 0;
+    while (!(compactBuckets & ((uint64_t)1 << b))) b++;
+    compactBuckets &= ~((uint64_t)1 << b);
+    compactBucket(b);
+    return;
+  }
+  compactTable();
+  compactRunning = false;
+  maybeCompact(false);
+}
+
+// Indexes one file or rewrites one bucket per call so typing never stalls for long
+void indexBackgroundStep() {
+  if ((!rebuildPending && !compactRunning) || noSD || mscEnabled || SDActive) return;
+  if (millis() - prevTimeMillis < BACKGROUND_IDLE_MS) return;
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  if (rebuildPending) rebuildStep();
+  else compactStep();
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+}
@@ -0,0 +1,253 @@
+//  ooo        ooooo oooooooooooo ooooooooooooo       .o.        //
+//  `88.       .888' `888'     `8 8'   888   `8      .888.       //
+//   888b     d'888   888              888          .8"888.      //
+//   8 Y88. .P  888   888oooo8         888         .8' `888.     //
+//   8  `888'   888   888    "         888        .88ooo8888.    //
+//   8    Y     888   888       o      888       .8'     `888.   //
+//  o8o        o888o o888ooooood8     o888o     o88o     o8888o  //
+#include "globals.h"
+
+// FILE METADATA
+// SYS_METADATA_FILE keeps one line per note, so the file wizard and the USB
+// reconcile never open the notes themselves:
+//   path|YYYYMMDD-HHMM|N Bytes|N Char|N Words|FAT mtime|first line
+// The first line is escaped like any record text (include/records.h). Lines
+// from older firmware end after "N Char" or "N Words", their missing fields
+// read back as "". The file needs no RECORD_HEADER: FAT paths can't hold '\'
+// or '|', and the preview came in together with escaping.
+
+void writeMetadata(const String& path) {
+  File file = SD_MMC.open(path);
+  if (!file || file.isDirectory()) {
+    Serial.println("Invalid file for metadata.");
+    return;
+  }
+  file.close();
+
+  writeMetadata(path, readFileToString(SD_MMC, path.c_str()));
+}
+
+// True if a metadata line belongs to path, without copying the line
+static bool metadataLineIs(const char* line, const String& path) {
+  size_t len = path.length();
+  return strncmp(line, path.c_str(), len) == 0 && line[len] == '|';
+}
+
+void writeMetadata(const String& path, const String& text) {
+  // Get char and word counts
+  int charCount = countVisibleChars(text);
+
+  String flatText = text;
+  flatText.replace('\n', ' ');
+  int wordCount = countWords(flatText);
+
+  // First non-empty line as a preview
+  String preview = "";
+  int lineStart = 0;
+  while (lineStart < (int)text.length()) {
+    int lineEnd = text.indexOf('\n', lineStart);
+    if (lineEnd == -1) lineEnd = text.length();
+    preview = text.substring(lineStart, lineEnd);
+    preview.trim();
+    if (preview.length() > 0) break;
+    lineStart = lineEnd + 1;
+  }
+
+  // Size and mtime as FAT reports them, so reconcileStep() can spot host edits
+  size_t fatSize = text.length();
+  unsigned long fatTime = 0;
+  File file = SD_MMC.open(path);
+  if (file && !file.isDirectory()) {
+    fatSize = file.size();
+    fatTime = (unsigned long)file.getLastWrite();
+  }
+  if (file) file.close();
+
+  writeMetadata(path, fatSize, fatTime, charCount, wordCount, preview);
+}
+
+// Same, for writers that counted the text as it went out
+void writeMetadata(const String& path, size_t fatSize, unsigned long fatTime, int charCount, int wordCount, String preview) {
+  // Format size string
+  String fileSizeStr = String(fatSize) + " Bytes";
+  String charStr  = String(charCount) + " Char";
+  String wordStr = String(wordCount) + " Words";
+
+  preview.replace('\r', ' ');
+  if (preview.length() > METADATA_PREVIEW_LEN) preview = preview.substring(0, METADATA_PREVIEW_LEN);
+  preview = escapeField(preview);
+
+  // Get current time from RTC
+  DateTime now = rtc.now();
+  char timestamp[20];
+  sprintf(timestamp, "%04d%02d%02d-%02d%02d",
+          now.year(), now.month(), now.day(), now.hour(), now.minute());
+
+  // Compose new metadata line
+  String newEntry = path + "|" + timestamp + "|" + fileSizeStr + "|" + charStr + "|" + wordStr + "|" + String(fatTime) + "|" + preview;
+
+  const char* metaPath = SYS_METADATA_FILE;
+
+  // Read existing entries and rebuild the file without duplicates
+  File metaFile = sysfsOpen(metaPath, FILE_READ);
+  String updatedMeta = "";
+  bool replaced = false;
+
+  if (metaFile) {
+    RecordReader<File> reader(metaFile);
+    while (reader.nextLine()) {
+      if (metadataLineIs(reader.line, path)) {
+        updatedMeta += newEntry + "\n";
+        replaced = true;
+      } else {
+        updatedMeta += reader.line;
+        updatedMeta += "\n";
+      }
+    }
+    metaFile.close();
+  }
+
+  if (!replaced) {
+    updatedMeta += newEntry + "\n";
+  }
+
+  // Write back the updated metadata
+  metaFile = sysfsOpen(metaPath, FILE_WRITE);
+  if (!metaFile) {
+    Serial.println("Failed to open metadata file for writing.");
+    return;
+  }
+  metaFile.print(updatedMeta);
+  metaFile.close();
+
+  Serial.println("Metadata updated.");
+}
+
+String getMetadataField(const String& metaLine, uint8_t field) {
+  // path|YYYYMMDD-HHMM|size|chars|words|fatTime|preview
+  std::vector<char> line(metaLine.c_str(), metaLine.c_str() + metaLine.length() + 1);
+
+  FieldSpan fields[7];
+  uint8_t count = splitRecord(line.data(), metaLine.length(), fields, 7);
+  if (field >= count) return "";
+  return String(fields[field].ptr);
+}
+
+String getFileMetadata(String path) {
+  if (noSD) return "";
+  if (!path.startsWith("/")) path = "/" + path;
+
+  File metaFile = sysfsOpen(SYS_METADATA_FILE, FILE_READ);
+  if (!metaFile) return "";
+
+  String result = "";
+  RecordReader<File> reader(metaFile);
+  while (reader.nextLine()) {
+    if (metadataLineIs(reader.line, path)) {
+      result = reader.line;
+      break;
+    }
+  }
+  metaFile.close();
+  return result;
+}
+
+// Looks up every entry of filesList in a single pass over the metadata file
+void loadFilesListMetadata() {
+  for (int i = 0; i < MAX_FILES; i++) filesListMeta[i] = "";
+  if (noSD) return;
+
+  File metaFile = sysfsOpen(SYS_METADATA_FILE, FILE_READ);
+  if (!metaFile) return;
+
+  String listPaths[MAX_FILES];
+  for (int i = 0; i < MAX_FILES; i++) {
+    if (filesList[i] == "-" || filesList[i] == "") continue;
+    listPaths[i] = filesList[i].startsWith("/") ? filesList[i] : "/" + filesList[i];
+  }
+
+  // Only lines that match get copied into a String
+  RecordReader<File> reader(metaFile);
+  while (reader.nextLine()) {
+    for (int i = 0; i < MAX_FILES; i++) {
+      if (listPaths[i].length() > 0 && metadataLineIs(reader.line, listPaths[i])) filesListMeta[i] = reader.line;
+    }
+  }
+  metaFile.close();
+}
+
+void deleteMetadata(String path) {
+  const char* metaPath = SYS_METADATA_FILE;
+  
+
+  // Open metadata file for reading
+  File metaFile = sysfsOpen(metaPath, FILE_READ);
+  if (!metaFile) {
+    Serial.println("Metadata file not found.");
+    return;
+  }
+
+  // Store lines that don't match the given path
+  std::vector<String> keptLines;
+  RecordReader<File> reader(metaFile);
+  while (reader.nextLine()) {
+    if (!metadataLineIs(reader.line, path)) {
+      keptLines.push_back(reader.line);
+    }
+  }
+  metaFile.close();
+
+  // Rewrite the file with the kept lines
+  File writeFile = sysfsOpen(metaPath, FILE_WRITE);
+  if (!writeFile) {
+    Serial.println("Failed to recreate metadata file.");
+    return;
+  }
+
+  for (const String& line : keptLines) {
+    writeFile.println(line);
+  }
+
+  writeFile.close();
+  Serial.println("Metadata entry deleted (if it existed).");
+}
+
+void renMetadata(String oldPath, String newPath) {
+  setCpuFrequencyMhz(240);
+  const char* metaPath = SYS_METADATA_FILE;
+
+  // Open metadata file for reading
+  File metaFile = sysfsOpen(metaPath, FILE_READ);
+  if (!metaFile) {
+    Serial.println("Metadata file not found.");
+    return;
+  }
+
+  std::vector<String> updatedLines;
+
+  RecordReader<File> reader(metaFile);
+  while (reader.nextLine()) {
+    if (metadataLineIs(reader.line, oldPath)) {
+      // Replace old path with new path, keep the rest of the line from its '|'
+      updatedLines.push_back(newPath + (reader.line + oldPath.length()));
+    }
+    else updatedLines.push_back(reader.line);
+  }
+
+  metaFile.close();
+
+  // Rewrite the file with the updated lines
+  File writeFile = sysfsOpen(metaPath, FILE_WRITE);
+  if (!writeFile) {
+    Serial.println("Failed to recreate metadata file.");
+    return;
+  }
+
+  for (const String& l : updatedLines) {
+    writeFile.println(l);
+  }
+
+  writeFile.close();
+  Serial.println("Metadata updated for renamed file.");
+  if (SAVE_POWER) setCpuFrequencyMhz(40);
+}
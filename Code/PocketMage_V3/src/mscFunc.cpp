@@ -0,0 +1,157 @@
+//  ooo        ooooo   .oooooo..o    .oooooo.   //
+//  `88.       .888'  d8P'    `Y8   d8P'  `Y8b  //
+//   888b     d'888   Y88bo.       888          //
+//   8 Y88. .P  888    `"Y8888o.   888          //
+//   8  `888'   888        `"Y88b  888          //
+//   8    Y     888   oo     .d8P  `88b    ooo  //
+//  o8o        o888o  8""88888P'    `Y8bood8P'  //
+#include "globals.h"
+#ifndef NATIVE_TEST
+#include "esp_heap_caps.h"
+#endif
+
+// USB MASS STORAGE CACHE
+// The host asks for a few KB at a time. A read carrying on from the last one
+// fills a read-ahead window of MSC_CACHE_SECTORS with one command, and later
+// reads are served from it. Writes carrying on from the last one are gathered
+// and go to the device as one command when something else comes along, the
+// buffer fills, or mscFlush() is called: on eject, stop, or once the host has
+// been quiet for MSC_FLUSH_MS. Not thread safe, USB.cpp holds a lock around
+// every call.
+//
+// The host was told gathered writes are done, so if sending them fails they
+// are kept and tried again later, and the next read or write fails to let the
+// host know.
+
+static BlockDevice* mscDevice = nullptr;
+static uint32_t mscSectorSize = 0;
+static uint8_t* mscReadBuf = nullptr;          // Read-ahead window
+static uint32_t mscReadLba = 0;
+static uint32_t mscReadCount = 0;
+static uint32_t mscNextRead = UINT32_MAX;      // Sector after the last read
+static uint8_t* mscWriteBuf = nullptr;         // Gathered writes
+static uint32_t mscWriteLba = 0;
+static uint32_t mscWriteCount = 0;
+static unsigned long mscWriteMillis = 0;
+static bool     mscWriteFailed = false;      // Not yet reported to the host
+
+static bool overlaps(uint32_t lba, uint32_t count, uint32_t start, uint32_t len) {
+  return len > 0 && lba < start + len && start < lba + count;
+}
+
+static uint8_t* mscAlloc(size_t size) {
+  #ifndef NATIVE_TEST
+  return (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_DMA);     // Both buffers are DMA targets
+  #else
+  return (uint8_t*)malloc(size);
+  #endif
+}
+
+static void mscFree(uint8_t* buf) {
+  #ifndef NATIVE_TEST
+  heap_caps_free(buf);
+  #else
+  free(buf);
+  #endif
+}
+
+// Without buffers every request goes straight through
+void mscCacheBegin(BlockDevice* device) {
+  mscCacheEnd();
+  mscDevice = device;
+  mscSectorSize = device->sectorSize();
+  mscReadBuf  = mscAlloc(MSC_CACHE_SECTORS * mscSectorSize);
+  mscWriteBuf = mscAlloc(MSC_CACHE_SECTORS * mscSectorSize);
+}
+
+void mscCacheEnd() {
+  mscFlush();
+  if (mscReadBuf)  mscFree(mscReadBuf);
+  if (mscWriteBuf) mscFree(mscWriteBuf);
+  mscReadBuf = mscWriteBuf = nullptr;
+  mscReadCount = mscWriteCount = 0;
+  mscNextRead = UINT32_MAX;
+  mscWriteFailed = false;
+  mscDevice = nullptr;
+}
+
+bool mscFlush() {
+  if (!mscDevice || mscWriteCount == 0) return true;
+  if (!mscDevice->write(mscWriteLba, mscWriteCount, mscWriteBuf)) {
+    #ifndef NATIVE_TEST
+    Serial.printf("MSC flush of %u sectors at %u failed\n", mscWriteCount, mscWriteLba);
+    #else
+    std::cout << "MSC flush of " << mscWriteCount << " sectors at " << mscWriteLba << " failed" << std::endl;
+    #endif
+    mscWriteFailed = true;
+    mscWriteMillis = millis();      // Idle flushes retry after another quiet spell
+    return false;
+  }
+  mscWriteCount = 0;
+  return true;
+}
+
+// A flush the host didn't ask for failed since the last request
+static bool mscTakeFailure() {
+  bool failed = mscWriteFailed;
+  mscWriteFailed = false;
+  return failed;
+}
+
+// Flushing inside a request, a failure reaches the host through it
+static bool mscFlushInRequest() {
+  if (mscFlush()) return true;
+  mscWriteFailed = false;
+  return false;
+}
+
+// Flushes once the host has been quiet for MSC_FLUSH_MS
+bool mscFlushIdle() {
+  if (mscWriteCount == 0 || (unsigned long)millis() - mscWriteMillis < MSC_FLUSH_MS) return true;
+  return mscFlush();
+}
+
+bool mscRead(uint32_t lba, uint32_t count, uint8_t* dst) {
+  if (!mscDevice || mscTakeFailure()) return false;
+  // Gathered writes the host reads back go out first
+  if (overlaps(lba, count, mscWriteLba, mscWriteCount) && !mscFlushInRequest()) return false;
+
+  if (mscReadCount > 0 && lba >= mscReadLba && lba + count <= mscReadLba + mscReadCount) {
+    memcpy(dst, mscReadBuf + (lba - mscReadLba) * mscSectorSize, count * mscSectorSize);
+    mscNextRead = lba + count;
+    return true;
+  }
+
+  bool sequential = lba == mscNextRead;
+  mscNextRead = lba + count;
+  if (!sequential || !mscReadBuf || count >= MSC_CACHE_SECTORS) return mscDevice->read(lba, count, dst);
+
+  uint32_t fill = MSC_CACHE_SECTORS;
+  if (lba + fill > mscDevice->sectorCount()) fill = mscDevice->sectorCount() - lba;
+  mscReadCount = 0;
+  // The window mustn't hold older copies of gathered sectors
+  if (overlaps(lba, fill, mscWriteLba, mscWriteCount) && !mscFlushInRequest()) return false;
+  if (fill < count || !mscDevice->read(lba, fill, mscReadBuf)) return mscDevice->read(lba, count, dst);
+
+  mscReadLba = lba;
+  mscReadCount = fill;
+  memcpy(dst, mscReadBuf, count * mscSectorSize);
+  return true;
+}
+
+bool mscWrite(uint32_t lba, uint32_t count, const uint8_t* src) {
+  if (!mscDevice || mscTakeFailure()) return false;
+  // The read-ahead window no longer matches the device
+  if (overlaps(lba, count, mscReadLba, mscReadCount)) mscReadCount = 0;
+
+  if (!mscWriteBuf || count >= MSC_CACHE_SECTORS) return mscFlushInRequest() && mscDevice->write(lba, count, src);
+
+  if (mscWriteCount > 0 && (lba != mscWriteLba + mscWriteCount || mscWriteCount + count > MSC_CACHE_SECTORS)) {
+    if (!mscFlushInRequest()) return false;
+  }
+  if (mscWriteCount == 0) mscWriteLba = lba;
+  memcpy(mscWriteBuf + mscWriteCount * mscSectorSize, src, count * mscSectorSize);
+  mscWriteCount += count;
+  mscWriteMillis = millis();
+  return true;
+}
@@ -0,0 +1,27 @@
+//  ooooo      ooo   .oooooo.   ooooooooooooo oooooooooooo  .oooooo..o  //
+//  `888b.     `8'  d8P'  `Y8b  8'   888   `8 `888'     `8 d8P'    `Y8  //
+//   8 `88b.    8  888      888      888       888         Y88bo.       //
+//   8   `88b.  8  888      888      888       888oooo8     `"Y8888o.   //
+//   8     `88b.8  888      888      888       888    "         `"Y88b  //
+//   8       `888  `88b    d88'      888       888       o oo     .d8P  //
+//  o8o        `8   `Y8bood8P'      o888o     o888ooooood8 8""88888P'   //
+#include "globals.h"
+
+// Notes are .txt files outside the system folders
+bool isNoteFile(const String& path) {
+  String lower = path;
+  lower.toLowerCase();
+  if (!lower.startsWith("/") || !lower.endsWith(".txt")) return false;
+  if (lower.startsWith("/sys/") || lower.startsWith("/dict/")) return false;
+  return true;
+}
+
+// FNV-1a
+uint32_t hashString(const String& str) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < str.length(); i++) {
+    hash ^= (uint8_t)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
@@ -0,0 +1,232 @@
+//  ooooooooo.   oooooooooooo   .oooooo.     .oooooo.   ooooo      ooo   .oooooo.   ooooo ooooo        oooooooooooo  //
+//  `888   `Y88. `888'     `8  d8P'  `Y8b   d8P'  `Y8b  `888b.     `8'  d8P'  `Y8b  `888' `888'        `888'     `8  //
+//   888   .d88'  888         888          888      888  8 `88b.    8  888           888   888          888          //
+//   888ooo88P'   888oooo8    888          888      888  8   `88b.  8  888           888   888          888oooo8     //
+//   888`88b.     888    "    888          888      888  8     `88b.8  888           888   888          888    "     //
+//   888  `88b.   888       o `88b    ooo  `88b    d88'  8       `888  `88b    ooo   888   888       o  888       o  //
+//  o888o  o888o o888ooooood8  `Y8bood8P'   `Y8bood8P'  o8o        `8   `Y8bood8P'  o888o o888ooooood8 o888ooooood8  //
+#include "globals.h"
+
+// USB RECONCILE
+// While the card is mounted on a host anything may change behind our back.
+// Instead of re-reading every note, the FAT size and mtime of each note are
+// compared with the ones recorded in SYS_METADATA_FILE:
+//   LOAD   read (path hash, size, mtime) of every metadata entry
+//   WALK   visit every note, queue it in SYS_DIRTY_FILE when it differs
+//   PRUNE  drop metadata and index entries of notes that are gone
+//   DIRTY  refresh metadata and index of one queued note per step, then
+//          compact the index, which the refreshes left full of old postings
+// reconcileRequest() only resets this state machine, so leaving USB mode takes
+// the same time on any card. The work runs from loop() while the keyboard is idle.
+
+enum ReconcilePhase { RECONCILE_IDLE, RECONCILE_LOAD, RECONCILE_WALK, RECONCILE_PRUNE, RECONCILE_DIRTY };
+
+struct MetaStamp {
+  uint32_t pathHash;
+  uint32_t size;
+  uint32_t mtime;
+};
+
+static const uint32_t UNKNOWN_MTIME = 0xFFFFFFFF;   // FAT can't go that far
+
+static ReconcilePhase reconcilePhase = RECONCILE_IDLE;
+static std::vector<MetaStamp> stamps;    // Sorted by pathHash once loaded
+static std::vector<bool> stampSeen;
+static DirWalk reconcileWalk;
+static uint32_t readOffset = 0;          // Resume point in the metadata or dirty file
+static uint32_t dirtyCount = 0;
+
+// HELPERS
+static bool stampLess(const MetaStamp& a, const MetaStamp& b) {
+  return a.pathHash < b.pathHash;
+}
+
+static size_t firstStamp(uint32_t hash) {
+  MetaStamp key = { hash, 0, 0 };
+  return std::lower_bound(stamps.begin(), stamps.end(), key, stampLess) - stamps.begin();
+}
+
+static void releaseStamps() {
+  std::vector<MetaStamp>().swap(stamps);
+  std::vector<bool>().swap(stampSeen);
+}
+
+// PHASES
+static void loadStamps() {
+  File metaFile = sysfsOpen(SYS_METADATA_FILE, FILE_READ);
+  if (metaFile) {
+    metaFile.seek(readOffset);
+    RecordReader<File> reader(metaFile);
+    bool done = false;
+    for (int i = 0; i < RECONCILE_BATCH; i++) {
+      if (!reader.next(7)) {
+        done = true;
+        break;
+      }
+      // path|YYYYMMDD-HHMM|size|chars|words|fatTime|preview. Lines from
+      // before fatTime still count, so a missing note is pruned, but never
+      // match, so a present one is refreshed.
+      String path = reader.fields[0].ptr;
+      if (!isNoteFile(path)) continue;
+
+      MetaStamp stamp;
+      stamp.pathHash = hashString(path);
+      stamp.size     = reader.count > 2 ? strtoul(reader.fields[2].ptr, NULL, 10) : 0;
+      stamp.mtime    = reader.count == 7 ? strtoul(reader.fields[5].ptr, NULL, 10) : UNKNOWN_MTIME;
+      stamps.push_back(stamp);
+    }
+    // The reader reads ahead, resume after the last line it handed out
+    readOffset += reader.consumed;
+    metaFile.close();
+    if (!done) return;
+  }
+
+  std::sort(stamps.begin(), stamps.end(), stampLess);
+  stampSeen.assign(stamps.size(), false);
+
+  // Start with an empty queue
+  File dirty = SD_MMC.open(SYS_DIRTY_FILE, FILE_WRITE);
+  if (dirty) dirty.close();
+  dirtyCount = 0;
+
+  dirWalkBegin(reconcileWalk, "/");
+  reconcilePhase = RECONCILE_WALK;
+}
+
+static void walkNotes() {
+  String queued = "";
+  bool done = false;
+
+  String path;
+  size_t size;
+  time_t mtime;
+  for (int i = 0; i < RECONCILE_BATCH; i++) {
+    if (!dirWalkNext(reconcileWalk, path, size, mtime)) {
+      done = true;
+      break;
+    }
+    if (!isNoteFile(path)) continue;
+
+    uint32_t hash = hashString(path);
+    bool unchanged = false;
+    for (size_t s = firstStamp(hash); s < stamps.size() && stamps[s].pathHash == hash; s++) {
+      stampSeen[s] = true;
+      if (stamps[s].size == size && stamps[s].mtime == (uint32_t)mtime) unchanged = true;
+    }
+    if (!unchanged) {
+      queued += path + "\n";
+      dirtyCount++;
+    }
+  }
+
+  if (queued.length() > 0) {
+    File dirty = SD_MMC.open(SYS_DIRTY_FILE, FILE_APPEND);
+    if (dirty) {
+      dirty.print(queued);
+      dirty.close();
+    }
+    else Serial.println("Reconcile: failed to queue dirty files");
+  }
+
+  if (done) reconcilePhase = RECONCILE_PRUNE;
+}
+
+static void pruneMissing() {
+  uint32_t missing = std::count(stampSeen.begin(), stampSeen.end(), false);
+
+  if (missing > 0) {
+    // Stream through a temp file, the store may not fit in RAM
+    String tmpPath = String(SYS_METADATA_FILE) + ".tmp";
+    File metaFile = sysfsOpen(SYS_METADATA_FILE, FILE_READ);
+    File tmpFile  = sysfsOpen(tmpPath, FILE_WRITE);
+
+    if (metaFile && tmpFile) {
+      RecordReader<File> reader(metaFile);
+      while (reader.nextLine()) {
+        String line = reader.line;
+        String path = getMetadataField(line, 0);
+        if (isNoteFile(path)) {
+          uint32_t hash = hashString(path);
+          size_t s = firstStamp(hash);
+          if (s < stamps.size() && stamps[s].pathHash == hash && !stampSeen[s]) {
+            indexRemove(path);
+            continue;
+          }
+        }
+        tmpFile.print(line + "\n");
+      }
+      metaFile.close();
+      tmpFile.close();
+
+      sysfsRename(tmpPath, SYS_METADATA_FILE);
+    }
+    else {
+      Serial.println("Reconcile: failed to prune metadata");
+      if (metaFile) metaFile.close();
+      if (tmpFile) tmpFile.close();
+    }
+  }
+
+  Serial.printf("Reconcile: %u changed, %u removed\r\n", dirtyCount, missing);
+  releaseStamps();
+  readOffset = 0;
+  reconcilePhase = RECONCILE_DIRTY;
+}
+
+static void refreshDirty() {
+  String path = "";
+  File dirty = SD_MMC.open(SYS_DIRTY_FILE, FILE_READ);
+  if (dirty) {
+    dirty.seek(readOffset);
+    if (dirty.available()) path = dirty.readStringUntil('\n');
+    readOffset = dirty.position();
+    dirty.close();
+  }
+
+  if (path.length() == 0) {
+    SD_MMC.remove(SYS_DIRTY_FILE);
+    reconcilePhase = RECONCILE_IDLE;
+    indexRequestCompact();
+    Serial.println("Reconcile finished");
+    return;
+  }
+
+  // The file may have been deleted since it was queued
+  if (!SD_MMC.exists(path)) return;
+
+  String text = readFileQuiet(path);
+  writeMetadata(path, text);
+  indexFile(path, text);
+}
+
+// PUBLIC
+void reconcileRequest() {
+  releaseStamps();
+  dirWalkBegin(reconcileWalk, "/");
+  readOffset = 0;
+  dirtyCount = 0;
+  reconcilePhase = RECONCILE_LOAD;
+
+  // Cached paths are reloaded on next use
+  finderInvalidate();
+}
+
+// Does a bounded amount of work per call so typing never stalls for long
+void reconcileStep() {
+  if (reconcilePhase == RECONCILE_IDLE || noSD || mscEnabled || SDActive) return;
+  if (millis() - prevTimeMillis < BACKGROUND_IDLE_MS) return;
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  switch (reconcilePhase) {
+    case RECONCILE_LOAD:  loadStamps();   break;
+    case RECONCILE_WALK:  walkNotes();    break;
+    case RECONCILE_PRUNE: pruneMissing(); break;
+    case RECONCILE_DIRTY: refreshDirty(); break;
+    default: break;
+  }
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+}
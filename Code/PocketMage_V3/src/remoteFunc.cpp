@@ -0,0 +1,213 @@
+//  ooooooooo.   oooooooooooo ooo        ooooo   .oooooo.   ooooooooooooo oooooooooooo  //
+//  `888   `Y88. `888'     `8 `88.       .888'  d8P'  `Y8b  8'   888   `8 `888'     `8  //
+//   888   .d88'  888          888b     d'888  888      888      888       888          //
+//   888ooo88P'   888oooo8     8 Y88. .P  888  888      888      888       888oooo8     //
+//   888`88b.     888    "     8  `888'   888  888      888      888       888    "     //
+//   888  `88b.   888       o  8    Y     888  `88b    d88'      888       888       o  //
+//  o888o  o888o o888ooooood8 o8o        o888o  `Y8bood8P'      o888o     o888ooooood8  //
+#include "globals.h"
+
+// REMOTE CONTROL
+// Answers tools/pmremote (protocol in include/remoteProto.h), reached through
+// syncPoll(). Sent keys wait in a ring that updateKeypress() empties before it
+// looks at the keypad. The screens are copied as they go out: the e-ink from
+// the writes to the panel controller (EinkTap, include/screenTap.h), the OLED
+// from each sendBuffer() (OledTap). So a snapshot is what the panel shows,
+// not what is half drawn in the buffer. The e-ink copy is written from the
+// e-ink task, so a snapshot taken during a refresh can mix two frames.
+
+static uint16_t remoteKeys[REMOTE_KEY_QUEUE];          // Below 0x100 a character, else 0x100 | matrix key
+static uint8_t  remoteKeyHead = 0;
+static uint8_t  remoteKeyCount = 0;
+
+static uint32_t remoteStats[REMOTE_STAT_COUNT];
+static unsigned long remoteLoopStart = 0;
+static unsigned long remoteKeyAt = 0;
+static bool     remoteWaitOled = false;                // A key was taken and its frame hasn't gone out yet
+static bool     remoteWaitEink = false;
+
+// What the panels show, see REMOTE_SNAP
+static const size_t EINK_BYTES = EINK_PANEL_WIDTH * EINK_PANEL_HEIGHT / 8;
+static const size_t OLED_BYTES = OLED_WIDTH * OLED_HEIGHT / 8;
+static uint8_t  einkShadow[EINK_BYTES];                // Rows, MSB first, 1 = ink
+static uint8_t  oledTiles[OLED_BYTES];                 // As u8g2 sends it: 8 row pages, LSB on top
+static uint32_t einkFrame = 0;
+static uint32_t oledFrame = 0;
+
+// Last picture taken, paged out by later SNAP requests
+static uint8_t  snapPacked[EINK_BYTES + EINK_BYTES / 128 + 1];
+static uint8_t  snapRows[OLED_BYTES];
+static uint32_t snapLen = 0;
+static uint8_t  snapScreen = REMOTE_EINK;
+static uint32_t snapFrame = 0;
+
+static void remoteError(uint8_t seq, const char* message) {
+  syncReply(SYNC_ERR, seq, (const uint8_t*)message, strlen(message));
+}
+
+// KEYS
+static void handleKeys(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  if (len < 1 || payload[0] > REMOTE_MATRIX) return remoteError(seq, "bad keys");
+  bool matrix = payload[0] == REMOTE_MATRIX;
+
+  // Keys off the matrix count as taken, and are dropped
+  uint16_t taken = 0;
+  for (uint16_t i = 1; i < len && remoteKeyCount < REMOTE_KEY_QUEUE; i++, taken++) {
+    if (matrix && payload[i] >= 40) continue;
+    remoteKeys[(remoteKeyHead + remoteKeyCount) % REMOTE_KEY_QUEUE] = matrix ? (0x100 | payload[i]) : payload[i];
+    remoteKeyCount++;
+  }
+
+  uint8_t out[4];
+  syncPut16(out, taken);
+  syncPut16(out + 2, REMOTE_KEY_QUEUE - remoteKeyCount);
+  syncReply(REMOTE_KEYS | SYNC_REPLY, seq, out, sizeof(out));
+}
+
+// The next sent key, -1 if there is none
+int remoteTakeKey() {
+  if (remoteKeyCount == 0) return -1;
+  int key = remoteKeys[remoteKeyHead];
+  remoteKeyHead = (remoteKeyHead + 1) % REMOTE_KEY_QUEUE;
+  remoteKeyCount--;
+  return key;
+}
+
+// updateKeypress() handed a key to an app, sent or typed
+void remoteKeyTaken() {
+  remoteStats[REMOTE_KEYS_TAKEN]++;
+  remoteKeyAt = micros();
+  remoteWaitOled = true;
+  remoteWaitEink = true;
+}
+
+// SNAP
+static void takeSnapshot(uint8_t screen) {
+  if (screen == REMOTE_EINK) {
+    snapFrame = einkFrame;
+    snapLen = remotePack(einkShadow, EINK_BYTES, snapPacked);
+  }
+  else {
+    memset(snapRows, 0, OLED_BYTES);
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+      for (int x = 0; x < OLED_WIDTH; x++) {
+        if (oledTiles[(y / 8) * OLED_WIDTH + x] & (1 << (y % 8))) {
+          snapRows[y * (OLED_WIDTH / 8) + x / 8] |= 0x80 >> (x % 8);
+        }
+      }
+    }
+    snapFrame = oledFrame;
+    snapLen = remotePack(snapRows, OLED_BYTES, snapPacked);
+  }
+  snapScreen = screen;
+}
+
+static void handleSnap(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  if (len < 5 || payload[0] > REMOTE_OLED) return remoteError(seq, "bad screen");
+  uint8_t  screen = payload[0];
+  uint32_t offset = syncGet32(payload + 1);
+  if (offset == 0) takeSnapshot(screen);
+  else if (screen != snapScreen || offset > snapLen) return remoteError(seq, "bad offset");
+
+  bool eink = screen == REMOTE_EINK;
+  uint32_t chunk = snapLen - offset;
+  if (chunk > SYNC_PAYLOAD_MAX - REMOTE_SNAP_HEADER) chunk = SYNC_PAYLOAD_MAX - REMOTE_SNAP_HEADER;
+
+  uint8_t out[SYNC_PAYLOAD_MAX];
+  out[0] = screen;
+  out[1] = eink ? 3 : 2;                      // display.setRotation(3), U8G2_R2
+  syncPut16(out + 2, eink ? EINK_PANEL_WIDTH : OLED_WIDTH);
+  syncPut16(out + 4, eink ? EINK_PANEL_HEIGHT : OLED_HEIGHT);
+  syncPut32(out + 6, snapFrame);
+  syncPut32(out + 10, snapLen);
+  syncPut32(out + 14, offset);
+  memcpy(out + REMOTE_SNAP_HEADER, snapPacked + offset, chunk);
+  syncReply(REMOTE_SNAP | SYNC_REPLY, seq, out, REMOTE_SNAP_HEADER + chunk);
+}
+
+// STATS
+static void handleStats(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  remoteStats[REMOTE_APP] = CurrentAppState;
+  remoteStats[REMOTE_KEYS_WAITING] = remoteKeyCount;
+
+  uint8_t out[1 + REMOTE_STAT_COUNT * 4];
+  out[0] = REMOTE_STAT_COUNT;
+  for (int i = 0; i < REMOTE_STAT_COUNT; i++) syncPut32(out + 1 + i * 4, remoteStats[i]);
+  if (len >= 1 && payload[0]) memset(remoteStats, 0, sizeof(remoteStats));
+  syncReply(REMOTE_STATS | SYNC_REPLY, seq, out, sizeof(out));
+}
+
+// Frames of types SYNC_* doesn't use, from syncFunc.cpp
+void remoteHandle(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len) {
+  switch (type) {
+    case REMOTE_KEYS:  handleKeys(seq, payload, len);  break;
+    case REMOTE_SNAP:  handleSnap(seq, payload, len);  break;
+    case REMOTE_STATS: handleStats(seq, payload, len); break;
+    case REMOTE_HELLO: syncReply(REMOTE_HELLO | SYNC_REPLY, seq, nullptr, 0); break;
+    default:
+      remoteError(seq, "unknown request");
+      break;
+  }
+}
+
+// COUNTERS
+void remoteLoopBegin() {
+  remoteLoopStart = micros();
+}
+
+// Before loop() sleeps
+void remoteLoopEnd() {
+  uint32_t us = micros() - remoteLoopStart;
+  remoteStats[REMOTE_LOOPS]++;
+  remoteStats[REMOTE_LOOP_US] += us;
+  if (us > remoteStats[REMOTE_LOOP_MAX_US]) remoteStats[REMOTE_LOOP_MAX_US] = us;
+}
+
+// Part of a GxEPD2 bitmap (1 = white, wBitmap wide) going to the panel at x, y.
+// Like the driver, x and w are taken to whole bytes.
+void remotePanelWrite(const uint8_t* bitmap, int16_t xPart, int16_t yPart, int16_t wBitmap, int16_t hBitmap,
+                      int16_t x, int16_t y, int16_t w, int16_t h, bool invert, bool mirrorY) {
+  int16_t wbBitmap = (wBitmap + 7) / 8;
+  xPart -= xPart % 8;
+  x -= x % 8;
+  int16_t wb = (w + 7) / 8;
+
+  for (int16_t row = 0; row < h; row++) {
+    int16_t py = y + row;
+    int16_t by = yPart + row;
+    if (py < 0 || py >= EINK_PANEL_HEIGHT || by < 0 || by >= hBitmap) continue;
+    if (mirrorY) by = hBitmap - 1 - by;
+    for (int16_t col = 0; col < wb; col++) {
+      int16_t px = x / 8 + col;
+      int16_t bx = xPart / 8 + col;
+      if (px < 0 || px >= EINK_PANEL_WIDTH / 8 || bx >= wbBitmap) continue;
+      uint8_t data = bitmap[by * wbBitmap + bx];
+      einkShadow[py * (EINK_PANEL_WIDTH / 8) + px] = invert ? data : (uint8_t)~data;
+    }
+  }
+}
+
+// The panel finished showing what was written to it
+void remoteEinkRefreshed(uint32_t us, bool partial) {
+  einkFrame++;
+  remoteStats[REMOTE_EINK_REFRESHES]++;
+  if (partial) remoteStats[REMOTE_EINK_PARTIAL]++;
+  remoteStats[REMOTE_EINK_US] += us;
+  if (us > remoteStats[REMOTE_EINK_MAX_US]) remoteStats[REMOTE_EINK_MAX_US] = us;
+  if (remoteWaitEink) {
+    remoteStats[REMOTE_KEY_TO_EINK_US] = micros() - remoteKeyAt;
+    remoteWaitEink = false;
+  }
+}
+
+// u8g2 sent its buffer, OLED_WIDTH x OLED_HEIGHT in pages
+void remoteOledSent(const uint8_t* tiles, uint32_t us) {
+  memcpy(oledTiles, tiles, OLED_BYTES);
+  oledFrame++;
+  remoteStats[REMOTE_OLED_FRAMES]++;
+  remoteStats[REMOTE_OLED_US] += us;
+  if (remoteWaitOled) {
+    remoteStats[REMOTE_KEY_TO_OLED_US] = micros() - remoteKeyAt;
+    remoteWaitOled = false;
+  }
+}
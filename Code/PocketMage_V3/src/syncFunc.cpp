@@ -0,0 +1,308 @@
+//   .oooooo..o  oooooo   oooo ooooo      ooo    .oooooo.    //
+//  d8P'    `Y8   `888.   .8'  `888b.     `8'   d8P'  `Y8b   //
+//  Y88bo.         `888. .8'    8 `88b.    8   888           //
+//   `"Y8888o.      `888.8'     8   `88b.  8   888           //
+//       `"Y88b      `888'      8     `88b.8   888           //
+//  oo     .d8P       888       8       `888   `88b    ooo   //
+//  8""88888P'       o888o     o8o        `8    `Y8bood8P'   //
+#include "globals.h"
+
+// USB SERIAL SYNC
+// Answers tools/pmsync (protocol in include/syncProto.h) from loop(). While a
+// session is open syncPoll() keeps answering for up to SYNC_POLL_MS, then
+// hands back to the keyboard and screen until the next call. A patch goes to
+// <note>.tmp and only replaces the note once its size and hash check out. A
+// session the host drops for SYNC_SESSION_MS is closed along with its .tmp.
+// Replaced notes get their metadata and index entries from the same
+// reconcile as after USB mass storage, once the session ends. The same port
+// carries tools/pmremote's requests, handed to remoteFunc.cpp.
+
+static SyncPort*  syncPort = nullptr;
+static SyncParser syncIn;
+static uint8_t    syncOut[SYNC_FRAME_MAX];     // Last reply, sent again for a repeated request
+static size_t     syncOutLen = 0;
+static int        syncLastSeq = -1;
+static bool       syncSession = false;
+static unsigned long syncHeard = 0;            // Last request of the session
+static bool       syncChanged = false;         // A note was replaced this session
+static uint8_t    syncBlock[SYNC_BLOCK];
+
+// Patch in progress, patchPath is empty without one
+static File     patchOld;
+static File     patchNew;
+static String   patchPath = "";
+static uint32_t patchSize = 0;
+static uint64_t patchHash = 0;
+static uint32_t patchWritten = 0;
+static uint64_t patchRunning = 0;
+static bool     patchOk = false;
+
+// HELPERS
+// Also sends the replies of remoteFunc.cpp
+void syncReply(uint8_t type, uint8_t seq, const uint8_t* payload, uint16_t len) {
+  syncOutLen = syncFrame(type, seq, payload, len, syncOut);
+  syncLastSeq = seq;
+  syncPort->write(syncOut, syncOutLen);
+}
+
+static void replyOk(uint8_t type, uint8_t seq) {
+  syncReply(type | SYNC_REPLY, seq, nullptr, 0);
+}
+
+static void replyErr(uint8_t seq, const char* message) {
+  syncReply(SYNC_ERR, seq, (const uint8_t*)message, strlen(message));
+}
+
+// Paths are absolute and can't climb out with ".."
+static bool payloadPath(const uint8_t* payload, uint16_t len, String& path) {
+  char buf[256];
+  if (len == 0 || len >= sizeof(buf) || payload[0] != '/') return false;
+  memcpy(buf, payload, len);
+  buf[len] = '\0';
+  if (strlen(buf) != len || strstr(buf, "..")) return false;
+  path = String(buf);
+  return true;
+}
+
+static void patchClose(bool keep) {
+  patchOld.close();
+  patchNew.close();
+  if (!keep && patchPath.length() > 0) SD_MMC.remove(patchPath + ".tmp");
+  patchPath = "";
+}
+
+static void endSession() {
+  patchClose(false);
+  if (syncChanged) reconcileRequest();
+  syncChanged = false;
+  syncSession = false;
+  syncLastSeq = -1;
+}
+
+// REQUESTS
+static void handleHello(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  if (len < 2 || syncGet16(payload) != SYNC_VERSION) return replyErr(seq, "version mismatch");
+  if (syncSession) endSession();
+  syncSession = true;
+
+  uint8_t out[6];
+  syncPut16(out, SYNC_VERSION);
+  syncPut16(out + 2, SYNC_BLOCK);
+  syncPut16(out + 4, SYNC_PAYLOAD_MAX);
+  syncReply(SYNC_HELLO | SYNC_REPLY, seq, out, sizeof(out));
+}
+
+// Checksums of up to SYNC_SIGS blocks from firstBlock. A missing note has none.
+static void handleSig(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  String path;
+  if (len < 5 || !payloadPath(payload + 4, len - 4, path)) return replyErr(seq, "bad path");
+  uint32_t first = syncGet32(payload);
+
+  uint8_t out[10 + SYNC_SIGS * 8];
+  uint32_t size = SYNC_MISSING;
+  uint16_t count = 0;
+  File file;
+  if (SD_MMC.exists(path)) file = SD_MMC.open(path, "r");
+  if (file) {
+    size = file.size();
+    uint32_t blocks = (size + SYNC_BLOCK - 1) / SYNC_BLOCK;
+    if (first < blocks && file.seek((size_t)first * SYNC_BLOCK)) {
+      while (count < SYNC_SIGS && first + count < blocks) {
+        size_t n = file.read(syncBlock, SYNC_BLOCK);
+        if (n == 0) break;
+        syncPut32(out + 10 + count * 8, syncWeak(syncBlock, n));
+        syncPut32(out + 14 + count * 8, syncStrong(syncBlock, n));
+        count++;
+      }
+    }
+    file.close();
+  }
+  syncPut32(out, size);
+  syncPut32(out + 4, first);
+  syncPut16(out + 8, count);
+  syncReply(SYNC_SIG | SYNC_REPLY, seq, out, 10 + count * 8);
+}
+
+static void handleBegin(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  String path;
+  if (len < 13 || !payloadPath(payload + 12, len - 12, path)) return replyErr(seq, "bad path");
+  if (!isNoteFile(path)) return replyErr(seq, "not a note");
+  if (CurrentAppState == TXT && path == editingFile) return replyErr(seq, "open in TXT");
+
+  patchClose(false);
+  if (SD_MMC.exists(path)) patchOld = SD_MMC.open(path, "r");   // New notes are all DATA
+  patchNew = SD_MMC.open(path + ".tmp", "w");
+  if (!patchNew) {
+    patchOld.close();
+    return replyErr(seq, "can't write");
+  }
+  patchPath    = path;
+  patchSize    = syncGet32(payload);
+  patchHash    = syncGet64(payload + 4);
+  patchWritten = 0;
+  patchRunning = syncHash64(nullptr, 0);
+  patchOk      = true;
+  replyOk(SYNC_BEGIN, seq);
+}
+
+static bool patchWrite(const uint8_t* data, size_t len) {
+  if (patchNew.write(data, len) != len) patchOk = false;
+  patchRunning = syncHash64(data, len, patchRunning);
+  patchWritten += len;
+  return patchOk;
+}
+
+static void handleCopy(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  if (patchPath.length() == 0) return replyErr(seq, "no patch");
+  if (len < 6 || syncGet16(payload + 4) > SYNC_COPY_MAX) return replyErr(seq, "bad copy");
+  uint32_t block = syncGet32(payload);
+  uint16_t count = syncGet16(payload + 4);
+  if (!patchOld.seek((size_t)block * SYNC_BLOCK)) return replyErr(seq, "bad copy");
+
+  for (uint16_t i = 0; i < count; i++) {
+    size_t n = patchOld.read(syncBlock, SYNC_BLOCK);
+    if (n == 0) return replyErr(seq, "bad copy");
+    if (!patchWrite(syncBlock, n)) return replyErr(seq, "write failed");
+  }
+  replyOk(SYNC_COPY, seq);
+}
+
+static void handleData(uint8_t seq, const uint8_t* payload, uint16_t len) {
+  if (patchPath.length() == 0) return replyErr(seq, "no patch");
+  if (!patchWrite(payload, len)) return replyErr(seq, "write failed");
+  replyOk(SYNC_DATA, seq);
+}
+
+static void handleEnd(uint8_t seq) {
+  if (patchPath.length() == 0) return replyErr(seq, "no patch");
+  String path = patchPath;
+  bool ok = patchOk && patchWritten == patchSize && patchRunning == patchHash;
+  patchOld.close();
+  patchNew.close();
+
+  if (ok) {
+    if (SD_MMC.exists(path)) SD_MMC.remove(path);
+    ok = SD_MMC.rename(path + ".tmp", path);
+  }
+  if (!ok) {
+    patchClose(false);
+    return replyErr(seq, "check failed");
+  }
+  patchPath = "";
+  syncChanged = true;
+  replyOk(SYNC_END, seq);
+}
+
+static void handleFrame() {
+  uint8_t type = syncIn.type();
+  uint8_t seq  = syncIn.seq();
+  const uint8_t* payload = syncIn.payload();
+  uint16_t len = syncIn.length();
+
+  // The host lost our reply and asked again. A HELLO starts a new run
+  // instead, whose requests mustn't match the last seq of the one before.
+  if (type == SYNC_HELLO || type == REMOTE_HELLO) {
+    syncLastSeq = -1;
+  }
+  else if (seq == syncLastSeq) {
+    syncPort->write(syncOut, syncOutLen);
+    return;
+  }
+  // pmremote, which needs neither the card nor a session
+  if (type >= REMOTE_KEYS && type <= REMOTE_LAST) return remoteHandle(type, seq, payload, len);
+  if (noSD || mscEnabled) {
+    if (syncSession) endSession();
+    return replyErr(seq, "no card");
+  }
+  if (type != SYNC_HELLO && !syncSession) return replyErr(seq, "no session");
+  syncHeard = millis();
+
+  switch (type) {
+    case SYNC_HELLO: handleHello(seq, payload, len); break;
+    case SYNC_SIG:   handleSig(seq, payload, len);   break;
+    case SYNC_BEGIN: handleBegin(seq, payload, len); break;
+    case SYNC_COPY:  handleCopy(seq, payload, len);  break;
+    case SYNC_DATA:  handleData(seq, payload, len);  break;
+    case SYNC_END:   handleEnd(seq);                 break;
+    case SYNC_BYE:
+      endSession();
+      replyOk(SYNC_BYE, seq);
+      break;
+    default:
+      replyErr(seq, "unknown request");
+      break;
+  }
+}
+
+// PORT
+void syncBegin(SyncPort* port) {
+  syncPort = port;
+  syncIn.reset();
+  syncLastSeq = -1;
+}
+
+#ifndef NATIVE_TEST
+// The USB CDC port, shared with Serial.print()
+class SerialSyncPort : public SyncPort {
+public:
+  size_t read(uint8_t* dst, size_t max) {
+    int n = Serial.available();
+    if (n <= 0) return 0;
+    return Serial.read(dst, (size_t)n < max ? (size_t)n : max);
+  }
+
+  bool write(const uint8_t* src, size_t len) {
+    return Serial.write(src, len) == len;
+  }
+};
+
+static SerialSyncPort serialSyncPort;
+
+void syncBegin() {
+  syncBegin(&serialSyncPort);
+}
+#endif
+
+// Called from loop(). Returns as soon as nothing is waiting, outside a session.
+void syncPoll() {
+  if (!syncPort) return;
+
+  unsigned long start = millis();
+  unsigned long heard = start;
+  #ifndef NATIVE_TEST
+  bool busy = false;
+  #endif
+  uint8_t buf[64];
+  while (millis() - start < SYNC_POLL_MS) {
+    size_t n = syncPort->read(buf, sizeof(buf));
+    for (size_t i = 0; i < n; i++) {
+      if (!syncIn.feed(buf[i])) continue;
+      #ifndef NATIVE_TEST
+      if (!busy) {
+        SDActive = true;
+        setCpuFrequencyMhz(240);
+      }
+      busy = true;
+      #endif
+      handleFrame();
+      heard = millis();
+    }
+    if (n == 0 && (!syncSession || millis() - heard >= SYNC_GAP_MS)) break;
+  }
+
+  if (syncSession && millis() - syncHeard >= SYNC_SESSION_MS) {
+    #ifndef NATIVE_TEST
+    Serial.println("SYNC: host went quiet, closing the session");
+    #else
+    std::cout << "SYNC: host went quiet, closing the session" << std::endl;
+    #endif
+    endSession();
+  }
+
+  #ifndef NATIVE_TEST
+  if (busy) {
+    if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+    SDActive = false;
+  }
+  #endif
+}
@@ -32,7 +32,11 @@ void saveFile() {
     oledWord("Saved: "+ editingFile);
 
     // Write MetaData
-    writeMetadata(editingFile);
+    writeMetadata(editingFile, textToSave);
+
+    // Update search index
+    indexFile(editingFile, textToSave);
+    finderAdd(editingFile);
     
     delay(1000);
     keypad.enableInterrupts();
@@ -41,70 +45,6 @@ void saveFile() {
   }
 }
 
-void writeMetadata(const String& path) {
-  File file = SD_MMC.open(path);
-  if (!file || file.isDirectory()) {
-    Serial.println("Invalid file for metadata.");
-    return;
-  }
-
-  // Get file size
-  size_t fileSizeBytes = file.size();
-  file.close();
-
-  // Format size string
-  String fileSizeStr = String(fileSizeBytes) + " Bytes";
-
-  // Get line and char counts
-  int charCount = countVisibleChars(readFileToString(SD_MMC, path.c_str()));
-
-  String charStr  = String(charCount) + " Char";
-
-  // Get current time from RTC
-  DateTime now = rtc.now();
-  char timestamp[20];
-  sprintf(timestamp, "%04d%02d%02d-%02d%02d",
-          now.year(), now.month(), now.day(), now.hour(), now.minute());
-
-  // Compose new metadata line
-  String newEntry = path + "|" + timestamp + "|" + fileSizeStr + "|" + charStr;
-
-  const char* metaPath = SYS_METADATA_FILE;
-
-  // Read existing entries and rebuild the file without duplicates
-  File metaFile = SD_MMC.open(metaPath, FILE_READ);
-  String updatedMeta = "";
-  bool replaced = false;
-
-  if (metaFile) {
-    while (metaFile.available()) {
-      String line = metaFile.readStringUntil('\n');
-      if (line.startsWith(path + "|")) {
-        updatedMeta += newEntry + "\n";
-        replaced = true;
-      } else if (line.length() > 1) {
-        updatedMeta += line + "\n";
-      }
-    }
-    metaFile.close();
-  }
-
-  if (!replaced) {
-    updatedMeta += newEntry + "\n";
-  }
-
-  // Write back the updated metadata
-  metaFile = SD_MMC.open(metaPath, FILE_WRITE);
-  if (!metaFile) {
-    Serial.println("Failed to open metadata file for writing.");
-    return;
-  }
-  metaFile.print(updatedMeta);
-  metaFile.close();
-
-  Serial.println("Metadata updated.");
-}
-
 void loadFile(bool showOLED) {
   if (noSD) {
     oledWord("LOAD FAILED - No SD!");
@@ -152,6 +92,8 @@ void delFile(String fileName) {
 
     // Delete MetaData
     deleteMetadata(fileName);
+    indexRemove(fileName);
+    finderRemove(fileName);
 
     delay(1000);
     keypad.enableInterrupts();
@@ -160,45 +102,6 @@ void delFile(String fileName) {
   }
 }
 
-void deleteMetadata(String path) {
-  const char* metaPath = SYS_METADATA_FILE;
-  
-
-  // Open metadata file for reading
-  File metaFile = SD_MMC.open(metaPath, FILE_READ);
-  if (!metaFile) {
-    Serial.println("Metadata file not found.");
-    return;
-  }
-
-  // Store lines that don't match the given path
-  std::vector<String> keptLines;
-  while (metaFile.available()) {
-    String line = metaFile.readStringUntil('\n');
-    if (!line.startsWith(path + "|")) {
-      keptLines.push_back(line);
-    }
-  }
-  metaFile.close();
-
-  // Delete the original metadata file
-  SD_MMC.remove(metaPath);
-
-  // Recreate the file and write back the kept lines
-  File writeFile = SD_MMC.open(metaPath, FILE_WRITE);
-  if (!writeFile) {
-    Serial.println("Failed to recreate metadata file.");
-    return;
-  }
-
-  for (const String& line : keptLines) {
-    writeFile.println(line);
-  }
-
-  writeFile.close();
-  Serial.println("Metadata entry deleted (if it existed).");
-}
-
 void renFile(String oldFile, String newFile) {
   if (noSD) {
     oledWord("RENAME FAILED - No SD!");
@@ -220,6 +123,9 @@ void renFile(String oldFile, String newFile) {
 
     // Update MetaData
     renMetadata(oldFile, newFile);
+    indexRename(oldFile, newFile);
+    finderRemove(oldFile);
+    finderAdd(newFile);
 
     keypad.enableInterrupts();
     if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
@@ -227,57 +133,6 @@ void renFile(String oldFile, String newFile) {
   }
 }
 
-void renMetadata(String oldPath, String newPath) {
-  setCpuFrequencyMhz(240);
-  const char* metaPath = SYS_METADATA_FILE;
-
-  // Open metadata file for reading
-  File metaFile = SD_MMC.open(metaPath, FILE_READ);
-  if (!metaFile) {
-    Serial.println("Metadata file not found.");
-    return;
-  }
-
-  std::vector<String> updatedLines;
-
-  while (metaFile.available()) {
-    String line = metaFile.readStringUntil('\n');
-    if (line.startsWith(oldPath + "|")) {
-      // Replace old path with new path at the start of the line
-      int separatorIndex = line.indexOf('|');
-      if (separatorIndex != -1) {
-        // Keep rest of line after '|'
-        String rest = line.substring(separatorIndex);
-        line = newPath + rest;
-      } else {
-        // Just replace whole line with new path if malformed
-        line = newPath;
-      }
-    }
-    updatedLines.push_back(line);
-  }
-
-  metaFile.close();
-
-  // Delete old metadata file
-  SD_MMC.remove(metaPath);
-
-  // Recreate file and write updated lines
-  File writeFile = SD_MMC.open(metaPath, FILE_WRITE);
-  if (!writeFile) {
-    Serial.println("Failed to recreate metadata file.");
-    return;
-  }
-
-  for (const String& l : updatedLines) {
-    writeFile.println(l);
-  }
-
-  writeFile.close();
-  Serial.println("Metadata updated for renamed file.");
-  if (SAVE_POWER) setCpuFrequencyMhz(40);
-}
-
 void copyFile(String oldFile, String newFile) {
   if (noSD) {
     oledWord("COPY FAILED - No SD!");
@@ -298,7 +153,9 @@ void copyFile(String oldFile, String newFile) {
     oledWord("Saved: "+ newFile);
 
     // Write MetaData
-    writeMetadata(newFile);
+    writeMetadata(newFile, textToLoad);
+    indexFile(newFile, textToLoad);
+    finderAdd(newFile);
 
     delay(1000);
     keypad.enableInterrupts();
@@ -459,7 +316,29 @@ void PWR_BTN_irq() {
   PWR_BTN_event = true;
 }
 
+// Key number row * 10 + column through the current layer
+static char keyFromMatrix(int k) {
+  switch (CurrentKBState) {
+    case NORMAL:
+      return keysArray[k/10][k%10];
+    case SHIFT:
+      return keysArraySHFT[k/10][k%10];
+    case FUNC:
+      return keysArrayFN[k/10][k%10];
+    default:
+      return 0;
+  }
+}
+
 char updateKeypress() {
+  // Keys sent by tools/pmremote go first
+  int remote = remoteTakeKey();
+  if (remote >= 0) {
+    prevTimeMillis = millis();
+    remoteKeyTaken();
+    return remote < 0x100 ? (char)remote : keyFromMatrix(remote & 0xFF);
+  }
+
   if (TCA8418_event == true) {
     int k = keypad.getEvent();
     
@@ -476,18 +355,10 @@ char updateKeypress() {
       if ((k/10) < 4) {
         //Key was pressed, reset timeout counter
         prevTimeMillis = millis();
+        remoteKeyTaken();
 
         //Return Key
-        switch (CurrentKBState) {
-          case NORMAL:
-            return keysArray[k/10][k%10];
-          case SHIFT:
-            return keysArraySHFT[k/10][k%10];
-          case FUNC:
-            return keysArrayFN[k/10][k%10];
-          default:
-            return 0;
-        }
+        return keyFromMatrix(k);
       }
     }
   }
@@ -651,6 +522,9 @@ void checkTimeout() {
           saveFile();
         }
 
+        // The card may be pulled while asleep
+        sysfsFlushAll();
+
         switch (CurrentAppState) {
           case TXT:
             if (SLEEPMODE == "TEXT" && editingFile != "") {
@@ -716,7 +590,6 @@ void checkTimeout() {
       CurrentAppState = HOME;
       CurrentHOMEState = NOWLATER;
       updateTaskArray();
-      sortTasksByDueDate(tasks);
 
       u8g2.setPowerSave(1);
       OLEDPowerSave  = true;
@@ -796,6 +669,9 @@ void deepSleep(bool alternateScreenSaver) {
   // Put OLED to sleep
   u8g2.setPowerSave(1);
 
+  // The card may be pulled while asleep
+  sysfsFlushAll();
+
   // Stop the einkHandler task
   if (einkHandlerTaskHandle != NULL) {
     vTaskDelete(einkHandlerTaskHandle);
@@ -1101,6 +977,71 @@ void renameFile(fs::FS &fs, const char *path1, const char *path2) {
   }
 }
 
+// Reads a whole file without touching the display, for background work
+String readFileQuiet(const String& path) {
+  File file = SD_MMC.open(path, FILE_READ);
+  if (!file || file.isDirectory()) return "";
+  String content = "";
+  content.reserve(file.size());
+  while (file.available()) content += (char)file.read();
+  file.close();
+  return content;
+}
+
+void dirWalkBegin(DirWalk& walk, const String& root) {
+  if (walk.dir) walk.dir.close();
+  walk.dir = File();
+  walk.dirPath = "";
+  walk.pending.clear();
+  walk.pending.push_back(root);
+}
+
+// Stops a walk before its end, closing the folder it was reading
+void dirWalkEnd(DirWalk& walk) {
+  if (walk.dir) walk.dir.close();
+  walk.dir = File();
+  walk.pending.clear();
+}
+
+// Returns the next file of the walk, skipping /sys and /dict.
+// Returns false once every folder has been visited.
+bool dirWalkNext(DirWalk& walk, String& path, size_t& size, time_t& mtime) {
+  while (true) {
+    if (!walk.dir) {
+      if (walk.pending.empty()) return false;
+      walk.dirPath = walk.pending.back();
+      walk.pending.pop_back();
+      walk.dir = SD_MMC.open(walk.dirPath);
+      if (!walk.dir || !walk.dir.isDirectory()) {
+        walk.dir = File();
+        continue;
+      }
+    }
+
+    File entry = walk.dir.openNextFile();
+    if (!entry) {
+      walk.dir.close();
+      walk.dir = File();
+      continue;
+    }
+
+    String name = String(entry.name());
+    if (name.lastIndexOf('/') != -1) name = name.substring(name.lastIndexOf('/') + 1);
+    path = (walk.dirPath == "/" ? "" : walk.dirPath) + "/" + name;
+
+    if (entry.isDirectory()) {
+      entry.close();
+      if (path != "/sys" && path != "/dict") walk.pending.push_back(path);
+      continue;
+    }
+
+    size = entry.size();
+    mtime = entry.getLastWrite();
+    entry.close();
+    return true;
+  }
+}
+
 void deleteFile(fs::FS &fs, const char *path) {
   if (noSD) {
     oledWord("OP FAILED - No SD!");
@@ -0,0 +1,366 @@
+//   .oooooo..o oooooo   oooo  .oooooo..o oooooooooooo  .oooooo..o  //
+//  d8P'    `Y8  `888.   .8'  d8P'    `Y8 `888'     `8 d8P'    `Y8  //
+//  Y88bo.        `888. .8'   Y88bo.       888         Y88bo.       //
+//   `"Y8888o.     `888.8'     `"Y8888o.   888oooo8     `"Y8888o.   //
+//       `"Y88b     `888'          `"Y88b  888    "         `"Y88b  //
+//  oo     .d8P      888      oo     .d8P  888         oo     .d8P  //
+//  8""88888P'      o888o     8""88888P'  o888o        8""88888P'   //
+#include "globals.h"
+#include <LittleFS.h>
+
+// FLASH SYSTEM STORE
+// Small, hot system files live on a LittleFS partition in internal flash so
+// system screens render without waking the SD card. Writes land in flash and
+// are copied to the card in the background so the files stay visible over USB.
+// manifest.txt keeps one line per file with the card size and mtime seen at
+// the last sync, and whether flash holds changes the card doesn't have yet:
+//   /sys/tasks.txt|412|1745280000|1
+// A card copy that no longer matches its stamp was edited elsewhere, so it is
+// copied back into flash (the card wins).
+
+static const char* hotFiles[] = { TASKS_FILE,      EVENTS_FILE,      STOOL_FILE,
+                                  STOOL_DAYS_FILE, STOOL_WEEKS_FILE, SYS_METADATA_FILE };
+static const uint8_t hotFileCount = sizeof(hotFiles) / sizeof(hotFiles[0]);
+static const char* manifestPath = "/manifest.txt";
+
+struct SyncStamp {
+  uint32_t size;
+  uint32_t mtime;
+  bool dirty;                    // Flash is ahead of the card
+  unsigned long dirtySince;
+};
+
+static SyncStamp hotStamps[hotFileCount];
+static bool sysfsMounted = false;
+
+// Bumped whenever a hot file may have changed, so apps can keep parsed copies
+// in RAM and only re-read after a write or a sync from the card
+static uint32_t hotGenerations[hotFileCount] = { 1, 1, 1, 1, 1, 1 };
+
+// HELPERS
+static int hotIndex(const String& path) {
+  for (uint8_t i = 0; i < hotFileCount; i++) {
+    if (path == hotFiles[i]) return i;
+  }
+  return -1;
+}
+
+static void saveManifest() {
+  File manifest = LittleFS.open(manifestPath, FILE_WRITE);
+  if (!manifest) {
+    Serial.println("SYSFS: failed to write manifest");
+    return;
+  }
+  for (uint8_t i = 0; i < hotFileCount; i++) {
+    manifest.print(String(hotFiles[i]) + "|" + String(hotStamps[i].size) + "|" +
+                   String(hotStamps[i].mtime) + "|" + (hotStamps[i].dirty ? "1" : "0") + "\n");
+  }
+  manifest.close();
+}
+
+static void loadManifest() {
+  for (uint8_t i = 0; i < hotFileCount; i++) hotStamps[i] = { 0, 0, false, 0 };
+
+  File manifest = LittleFS.open(manifestPath, FILE_READ);
+  if (!manifest) return;
+  // path|size|mtime|dirty
+  RecordReader<File> reader(manifest);
+  while (reader.next(4)) {
+    if (reader.count < 4) continue;
+
+    int i = hotIndex(reader.fields[0].ptr);
+    if (i == -1) continue;
+    hotStamps[i].size  = strtoul(reader.fields[1].ptr, NULL, 10);
+    hotStamps[i].mtime = strtoul(reader.fields[2].ptr, NULL, 10);
+    hotStamps[i].dirty = reader.fields[3].ptr[0] == '1';
+  }
+  manifest.close();
+}
+
+static bool copyBetween(fs::FS& from, fs::FS& to, const char* path) {
+  File src = from.open(path, FILE_READ);
+  if (!src || src.isDirectory()) return false;
+  File dst = to.open(path, FILE_WRITE);
+  if (!dst) {
+    src.close();
+    return false;
+  }
+
+  uint8_t buf[512];
+  size_t n;
+  while ((n = src.read(buf, sizeof(buf))) > 0) dst.write(buf, n);
+  src.close();
+  dst.close();
+  return true;
+}
+
+// Records what the card holds now, so later edits on the host can be spotted
+static void stampFromSD(uint8_t i) {
+  File file = SD_MMC.open(hotFiles[i]);
+  if (file && !file.isDirectory()) {
+    hotStamps[i].size  = file.size();
+    hotStamps[i].mtime = (uint32_t)file.getLastWrite();
+  }
+  if (file) file.close();
+}
+
+static void markDirty(int i) {
+  bool wasDirty = hotStamps[i].dirty;
+  hotStamps[i].dirty = true;
+  hotStamps[i].dirtySince = millis();
+  if (!wasDirty) saveManifest();
+}
+
+static void flushHotFile(uint8_t i) {
+  if (!SD_MMC.exists("/sys")) SD_MMC.mkdir("/sys");
+  if (!copyBetween(LittleFS, SD_MMC, hotFiles[i])) {
+    Serial.printf("SYSFS: failed to write back %s\r\n", hotFiles[i]);
+    return;
+  }
+  stampFromSD(i);
+  hotStamps[i].dirty = false;
+  saveManifest();
+  if (DEBUG_VERBOSE) Serial.printf("SYSFS: wrote back %s\r\n", hotFiles[i]);
+}
+
+// SETUP
+bool sysfsBegin() {
+  if (!LittleFS.begin(FORMAT_SPIFFS_IF_FAILED, "/sysfs", 10, SYSFS_PARTITION)) {
+    Serial.println("SYSFS MOUNT FAILED, system files stay on SD");
+    return false;
+  }
+  sysfsMounted = true;
+
+  if (!LittleFS.exists("/sys")) LittleFS.mkdir("/sys");
+  loadManifest();
+  sysfsSyncFromSD();
+
+  // Hot files always exist, even without a card
+  for (uint8_t i = 0; i < hotFileCount; i++) {
+    if (LittleFS.exists(hotFiles[i])) continue;
+    File f = LittleFS.open(hotFiles[i], FILE_WRITE);
+    if (f) f.close();
+  }
+  return true;
+}
+
+// Brings flash up to date with anything changed on the card while it was
+// out of our hands (USB, card reader). Only a handful of files, so cheap.
+void sysfsSyncFromSD() {
+  if (!sysfsMounted) {
+    // Files are read straight off the card, which may have been edited
+    for (uint8_t i = 0; i < hotFileCount; i++) hotGenerations[i]++;
+    return;
+  }
+  if (noSD) return;
+
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+
+  for (uint8_t i = 0; i < hotFileCount; i++) {
+    File file = SD_MMC.open(hotFiles[i]);
+    bool onCard = file && !file.isDirectory();
+    uint32_t size  = onCard ? file.size() : 0;
+    uint32_t mtime = onCard ? (uint32_t)file.getLastWrite() : 0;
+    if (file) file.close();
+
+    if (onCard && (!LittleFS.exists(hotFiles[i]) || size != hotStamps[i].size || mtime != hotStamps[i].mtime)) {
+      if (hotStamps[i].dirty) Serial.printf("SYSFS: %s changed on both sides, keeping the card copy\r\n", hotFiles[i]);
+      if (copyBetween(SD_MMC, LittleFS, hotFiles[i])) {
+        hotStamps[i].size  = size;
+        hotStamps[i].mtime = mtime;
+        hotStamps[i].dirty = false;
+        hotGenerations[i]++;
+      }
+    }
+    else if (!onCard) {
+      // Put it back on the card at the next write-back
+      hotStamps[i].dirty = true;
+      hotStamps[i].dirtySince = 0;
+    }
+  }
+  saveManifest();
+
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = false;
+}
+
+// FILE ACCESS
+File sysfsOpen(const String& path, const char* mode) {
+  int i = hotIndex(path);
+  bool writing = strcmp(mode, FILE_READ) != 0;
+  if (i != -1 && writing) hotGenerations[i]++;
+
+  if (!sysfsMounted) return SD_MMC.open(path, mode);
+  if (i != -1 && writing) markDirty(i);
+  return LittleFS.open(path, mode);
+}
+
+uint32_t sysfsGeneration(const String& path) {
+  int i = hotIndex(path);
+  return i == -1 ? 0 : hotGenerations[i];
+}
+
+// WHOLE-FILE WRITER
+// Rewrites a collection (tasks, events, stool log) in one pass. Record lines
+// go into a small buffer that goes out in SYSFS_WRITE_BUF chunks to
+// path.tmp, which then replaces the file, so a failed write leaves the old
+// file intact. Characters and words are counted on the way through and the
+// metadata line is updated once at the end.
+static const size_t SYSFS_WRITE_BUF = 512;
+
+struct RecordWriter {
+  File file;
+  char buf[SYSFS_WRITE_BUF];
+  size_t used = 0;
+  size_t bytes = 0;
+  bool ok = true;
+
+  int chars = 0;
+  int words = 0;
+  bool inWord = false;
+  String preview = "";   // First non-empty line, once lineDone
+  bool lineDone = false;
+};
+
+static void writerFlush(RecordWriter& w) {
+  if (w.used == 0) return;
+  if (w.ok && w.file.write((const uint8_t*)w.buf, w.used) != w.used) w.ok = false;
+  w.bytes += w.used;
+  w.used = 0;
+}
+
+static void writerPut(RecordWriter& w, const char* text, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = text[i];
+
+    // Same counts as countVisibleChars() and countWords()
+    if (c >= 32 && c <= 126) w.chars++;
+    if (c == ' ' || c == '\n') {
+      if (w.inWord) w.words++;
+      w.inWord = false;
+    }
+    else w.inWord = true;
+
+    if (!w.lineDone) {
+      if (c == '\n') {
+        w.preview.trim();
+        w.lineDone = w.preview.length() > 0;
+      }
+      else if (w.preview.length() < METADATA_PREVIEW_LEN * 2) w.preview += c;
+    }
+
+    w.buf[w.used++] = c;
+    if (w.used == SYSFS_WRITE_BUF) writerFlush(w);
+  }
+}
+
+static bool writerOpen(RecordWriter& w, const String& tmpPath) {
+  w.file = sysfsOpen(tmpPath, FILE_WRITE);
+  if (!w.file) {
+    Serial.println("SYSFS: failed to open " + tmpPath + " for writing");
+    return false;
+  }
+  return true;
+}
+
+static bool writerCommit(RecordWriter& w, const String& tmpPath, const String& path) {
+  writerFlush(w);
+  w.file.close();
+
+  if (!w.ok || !sysfsRename(tmpPath, path)) {
+    Serial.println("SYSFS: failed to write " + path + ", keeping the old copy");
+    if (sysfsMounted) LittleFS.remove(tmpPath);
+    else SD_MMC.remove(tmpPath);
+    return false;
+  }
+
+  if (w.inWord) w.words++;
+  if (!w.lineDone) w.preview.trim();
+  // /sys is never reconciled, so there's no card mtime to record
+  writeMetadata(path, w.bytes, 0, w.chars, w.words, w.preview);
+  return true;
+}
+
+// record(i) gives line i of count, with its text fields already escaped
+// (escapeField(), records.h)
+bool sysfsWriteRecords(const String& path, size_t count, std::function<String(size_t)> record) {
+  String tmpPath = path + ".tmp";
+  RecordWriter w;
+  if (!writerOpen(w, tmpPath)) return false;
+
+  for (size_t i = 0; i < count; i++) {
+    String line = record(i);
+    writerPut(w, line.c_str(), line.length());
+    writerPut(w, "\n", 1);
+  }
+  return writerCommit(w, tmpPath, path);
+}
+
+// Escaped records may only be appended to a file that starts with RECORD_HEADER
+// (records.h). A file from older firmware is rewritten once with its lines
+// re-encoded, a missing one is created with just the header.
+bool sysfsUpgradeRecords(const String& path) {
+  std::vector<String> lines;
+  File file = sysfsOpen(path, FILE_READ);
+  if (file) {
+    if (hasRecordHeader(file)) {
+      file.close();
+      return true;
+    }
+    RecordReader<File> reader(file);
+    while (reader.nextLine()) lines.push_back(escapeLegacyLine<String>(reader.line));
+    file.close();
+  }
+
+  return sysfsWriteRecords(path, lines.size() + 1, [&lines](size_t i) {
+    return i == 0 ? String(RECORD_HEADER) : lines[i - 1];
+  });
+}
+
+bool sysfsRename(const String& pathFrom, const String& pathTo) {
+  int i = hotIndex(pathTo);
+  if (i != -1) hotGenerations[i]++;
+
+  if (!sysfsMounted) {
+    if (SD_MMC.exists(pathTo)) SD_MMC.remove(pathTo);
+    return SD_MMC.rename(pathFrom, pathTo);
+  }
+
+  if (LittleFS.exists(pathTo)) LittleFS.remove(pathTo);
+  bool ok = LittleFS.rename(pathFrom, pathTo);
+  if (ok && i != -1) markDirty(i);
+  return ok;
+}
+
+// WRITE-BEHIND
+// Writes back at most one file per call, once it has been left alone for a while
+void sysfsFlushStep() {
+  if (!sysfsMounted || noSD || mscEnabled || SDActive) return;
+  if (millis() - prevTimeMillis < BACKGROUND_IDLE_MS) return;
+
+  for (uint8_t i = 0; i < hotFileCount; i++) {
+    if (!hotStamps[i].dirty || millis() - hotStamps[i].dirtySince < SYSFS_FLUSH_MS) continue;
+
+    SDActive = true;
+    setCpuFrequencyMhz(240);
+    flushHotFile(i);
+    if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+    SDActive = false;
+    return;
+  }
+}
+
+// Before the card leaves our hands (USB, sleep)
+void sysfsFlushAll() {
+  if (!sysfsMounted || noSD || mscEnabled) return;
+
+  bool wasActive = SDActive;
+  SDActive = true;
+  setCpuFrequencyMhz(240);
+  for (uint8_t i = 0; i < hotFileCount; i++) {
+    if (hotStamps[i].dirty) flushHotFile(i);
+  }
+  if (SAVE_POWER) setCpuFrequencyMhz(POWER_SAVE_FREQ);
+  SDActive = wasActive;
+}
@@ -0,0 +1,22 @@
+// Device globals and calls the firmware sources expect, for native tests that
+// include them directly. Include after globals.h; a test that needs another
+// value (noSD = true) sets it before its first test runs.
+#ifndef NATIVE_STUBS_H
+#define NATIVE_STUBS_H
+
+struct MockSerial {
+  void println(const String& s) { std::cout << s << std::endl; }
+  template <typename... Args> void printf(const char* fmt, Args... args) { std::printf(fmt, args...); }
+};
+static MockSerial Serial;
+
+void setCpuFrequencyMhz(int) {}
+
+bool noSD = false;
+bool mscEnabled = false;
+bool SDActive = false;
+bool SAVE_POWER = false;
+int POWER_SAVE_FREQ = 40;
+bool DEBUG_VERBOSE = false;
+
+#endif
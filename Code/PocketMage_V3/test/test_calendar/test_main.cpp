@@ -5,6 +5,7 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <chrono>
 // Native test-specific CalendarState and variables
 enum CalendarState { MONTH, WEEK };
 CalendarState CurrentCalendarState = MONTH;
@@ -13,6 +14,7 @@ struct MockSerialStream : public std::ostream {
   MockSerialStream() : std::ostream(std::cout.rdbuf()) {}
   void println(const char* s) { std::cout << s << std::endl; }
   void println(const std::string& s) { std::cout << s << std::endl; }
+  template <typename... Args> void printf(const char* fmt, Args... args) { std::printf(fmt, args...); }
 };
 static MockSerialStream Serial;
 // Mock isDigit
@@ -34,6 +36,8 @@ struct DateTime {
   int year() const { return _year; }
   int month() const { return _month; }
   int day() const { return _day; }
+  int hour() const { return 0; }
+  int minute() const { return 0; }
   int dayOfTheWeek() const { return (_year + _month + _day) % 7; }
   struct Diff {
     int _days;
@@ -62,7 +66,7 @@ MockRTC rtc;
 // extern int OLED_MAX_FPS;
 // extern AppState CurrentAppState;
 // Define all global variables and mocks required by CALENDAR.cpp (copied from test_tasks)
-std::vector<std::vector<String>> tasks;
+std::vector<Task> tasks;
 bool SAVE_POWER = false;
 int POWER_SAVE_FREQ = 40;
 bool SDActive = false;
@@ -145,6 +149,36 @@ void appendToFile(const String& path, const String& content) {
   f.close();
 }
 
+File sysfsOpen(const String& path, const char* mode) {
+  return SD_MMC.open(path, mode);
+}
+
+bool sysfsWriteRecords(const String& path, size_t count, std::function<String(size_t)> record) {
+  String tmpPath = path + ".tmp";
+  std::ofstream f(tmpPath, std::ios::trunc);
+  for (size_t i = 0; i < count; i++) f << record(i) << "\n";
+  f.close();
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// Same as sysfsFunc.cpp, on the test folder
+bool sysfsUpgradeRecords(const String& path) {
+  std::vector<String> lines;
+  File file = sysfsOpen(path, "r");
+  if (file) {
+    if (hasRecordHeader(file)) {
+      file.close();
+      return true;
+    }
+    RecordReader<File> reader(file);
+    while (reader.nextLine()) lines.push_back(escapeLegacyLine<String>(reader.line));
+    file.close();
+  }
+  return sysfsWriteRecords(path, lines.size() + 1, [&lines](size_t i) {
+    return i == 0 ? String(RECORD_HEADER) : lines[i - 1];
+  });
+}
+
 // Provide definitions for native test build
 #ifdef NATIVE_TEST
 #define EVENTS_FILE "sys/events.txt"
@@ -154,6 +188,9 @@ void appendToFile(const String& path, const String& content) {
 
 // Include only the core CALENDAR functions (not display functions)
 #include "../src/CALENDAR.cpp"
+#include "../src/icsFunc.cpp"
+
+int icsImportAll() { return 0; }
 
 // Black-box E2E Test: Focus on functionality, not internal state
 void test_e2e_user_calendar_flow() {
@@ -172,35 +209,39 @@ void test_e2e_user_calendar_flow() {
 
   // === USER STORY 1: Add multiple events ===
   std::cout << "Adding events..." << std::endl;
-  addEvent("Doctor Appt", "20250115", "0900", "60", "", "Annual checkup");
+  addEvent("Doctor Appt", "20250115", "0900", "60", "", "Annual checkup | bring card");
   addEvent("Project Due", "20250120", "2359", "0", "", "Final report");
   addEvent("Birthday", "20250110", "0000", "0", "YEARLY 0110", "Cake!");
 
   // Verify events are sorted by date
   TEST_ASSERT_EQUAL(3, calendarEvents.size());
-  TEST_ASSERT_EQUAL_STRING("Birthday", calendarEvents[0][0].c_str());
-  TEST_ASSERT_EQUAL_STRING("Doctor Appt", calendarEvents[1][0].c_str());
-  TEST_ASSERT_EQUAL_STRING("Project Due", calendarEvents[2][0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Birthday", calendarEvents[0].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Doctor Appt", calendarEvents[1].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Project Due", calendarEvents[2].name.c_str());
 
   // === USER STORY 2: File persistence ===
   std::cout << "Testing file persistence..." << std::endl;
-  std::vector<std::vector<String>> eventsBeforeRestart = calendarEvents;
+  std::vector<CalendarEvent> eventsBeforeRestart = calendarEvents;
   calendarEvents.clear();
   TEST_ASSERT_EQUAL(0, calendarEvents.size());
   updateEventArray();
   TEST_ASSERT_EQUAL(eventsBeforeRestart.size(), calendarEvents.size());
   for (size_t i = 0; i < eventsBeforeRestart.size(); i++) {
-    TEST_ASSERT_EQUAL_STRING(eventsBeforeRestart[i][0].c_str(), calendarEvents[i][0].c_str());
-    TEST_ASSERT_EQUAL_STRING(eventsBeforeRestart[i][1].c_str(), calendarEvents[i][1].c_str());
+    TEST_ASSERT_EQUAL_STRING(eventsBeforeRestart[i].name.c_str(), calendarEvents[i].name.c_str());
+    TEST_ASSERT_EQUAL_UINT32(eventsBeforeRestart[i].date, calendarEvents[i].date);
+    TEST_ASSERT_EQUAL(eventsBeforeRestart[i].time, calendarEvents[i].time);
+    TEST_ASSERT_EQUAL_STRING(eventsBeforeRestart[i].note.c_str(), calendarEvents[i].note.c_str());
   }
+  // The '|' in the note is escaped on disk, not taken as a field separator
+  TEST_ASSERT_EQUAL_STRING("Annual checkup | bring card", calendarEvents[1].note.c_str());
 
   // === USER STORY 3: Delete event ===
   std::cout << "Testing event deletion..." << std::endl;
   deleteEvent(1); // Remove "Doctor Appt"
   updateEventsFile();
   TEST_ASSERT_EQUAL(2, calendarEvents.size());
-  TEST_ASSERT_EQUAL_STRING("Birthday", calendarEvents[0][0].c_str());
-  TEST_ASSERT_EQUAL_STRING("Project Due", calendarEvents[1][0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Birthday", calendarEvents[0].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Project Due", calendarEvents[1].name.c_str());
 
   // === USER STORY 4: Navigation flow ===
   std::cout << "Testing navigation..." << std::endl;
@@ -219,7 +260,7 @@ void test_e2e_user_calendar_flow() {
   std::cout << "Testing repeat event logic..." << std::endl;
   addEvent("Yoga Class", "20250117", "1800", "60", "WEEKLY Fr", "Stretch");
   int count = 0;
-  for (const auto& ev : calendarEvents) if (ev[0] == "Yoga Class") count++;
+  for (const auto& ev : calendarEvents) if (ev.name == "Yoga Class") count++;
   TEST_ASSERT_EQUAL(1, count);
 
   // === CLEANUP ===
@@ -228,7 +269,250 @@ void test_e2e_user_calendar_flow() {
   std::cout << "=== BLACK-BOX E2E: User Calendar Flow PASSED! ===" << std::endl;
 }
 
+// Repeat codes compile once and answer per-day queries without strings
+void test_compiled_repeat_rules() {
+  EventRule weekly = compileRepeat(20250101, "WEEKLY MoWeFr");
+  TEST_ASSERT_EQUAL(REPEAT_WEEKLY, weekly.kind);
+  TEST_ASSERT_EQUAL_UINT8(0x2A, weekly.weekdays);
+  TEST_ASSERT_TRUE(eventOccursOn(weekly, 2025, 3, 5, 3));    // Wednesday
+  TEST_ASSERT_FALSE(eventOccursOn(weekly, 2025, 3, 4, 2));   // Tuesday
+  TEST_ASSERT_TRUE(eventOccursOn(weekly, 2025, 1, 1, 3));    // Start date
+
+  TEST_ASSERT_EQUAL(REPEAT_WEEKLY, compileRepeat(20250101, "WEEKLY_SaSu").kind);
+
+  EventRule nth = compileRepeat(20250101, "MONTHLY 2We");
+  TEST_ASSERT_EQUAL(REPEAT_MONTHLY_NTH, nth.kind);
+  TEST_ASSERT_TRUE(eventOccursOn(nth, 2025, 3, 12, 3));      // 2nd Wednesday
+  TEST_ASSERT_FALSE(eventOccursOn(nth, 2025, 3, 19, 3));     // 3rd Wednesday
+
+  EventRule monthly = compileRepeat(20250101, "MONTHLY 23");
+  TEST_ASSERT_EQUAL(REPEAT_MONTHLY_DAY, monthly.kind);
+  TEST_ASSERT_TRUE(eventOccursOn(monthly, 2025, 7, 23, 3));
+
+  EventRule yearlyName = compileRepeat(20250422, "YEARLY APR22");
+  EventRule yearlyNum  = compileRepeat(20250110, "YEARLY 0110");
+  TEST_ASSERT_EQUAL(REPEAT_YEARLY, yearlyName.kind);
+  TEST_ASSERT_TRUE(eventOccursOn(yearlyName, 2030, 4, 22, 1));
+  TEST_ASSERT_TRUE(eventOccursOn(yearlyNum, 2026, 1, 10, 6));
+  TEST_ASSERT_FALSE(eventOccursOn(yearlyNum, 2026, 1, 11, 0));
+
+  TEST_ASSERT_EQUAL(REPEAT_NONE, compileRepeat(20250101, "").kind);
+  TEST_ASSERT_EQUAL(REPEAT_NONE, compileRepeat(20250101, "WEEKLY Xx").kind);
+
+  // March 2025 starts on a Saturday and has 31 days
+  uint32_t days = expandRuleInMonth(weekly, 2025, 3, 6, 31);
+  TEST_ASSERT_EQUAL_UINT32((1UL << 3) | (1UL << 5) | (1UL << 7), days & 0xFE);
+  TEST_ASSERT_EQUAL_UINT32(1UL << 12, expandRuleInMonth(nth, 2025, 3, 6, 31));
+  TEST_ASSERT_EQUAL_UINT32(0, expandRuleInMonth(compileRepeat(20250101, "MONTHLY 5Sa"), 2025, 2, 6, 28));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFE, expandRuleInMonth(compileRepeat(20250101, "DAILY"), 2025, 3, 6, 31));
+}
+
+// The week layout expands the rules for 7 days and orders each day by time
+void test_week_layout() {
+  system("mkdir -p sys");
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+  updateEventsFile();
+
+  addEvent("Yoga", "20250101", "1800", "60", "WEEKLY MoWeFr", "");
+  addEvent("Standup", "20250101", "0930", "15", "DAILY", "");
+  addEvent("Dentist", "20250114", "0800", "60", "", "");
+  for (int i = 0; i < 6; i++) addEvent("Extra", "20250116", "1" + String(i) + "00", "30", "", "");
+
+  int32_t sunday = daysFromCivil(2025, 1, 12);
+  buildWeekLayout(sunday);
+  TEST_ASSERT_EQUAL(1, weekLayout.count[0]);   // Sun: Standup
+  TEST_ASSERT_EQUAL(2, weekLayout.count[1]);   // Mon: Standup, Yoga
+  TEST_ASSERT_EQUAL(2, weekLayout.count[2]);   // Tue: Dentist, Standup
+  TEST_ASSERT_EQUAL(7, weekLayout.count[4]);   // Thu: Standup + 6 extras
+
+  TEST_ASSERT_EQUAL_STRING("Dentist", calendarEvents[weekLayout.slots[2][0]].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Standup", calendarEvents[weekLayout.slots[2][1]].name.c_str());
+  TEST_ASSERT_EQUAL(930, weekLayout.times[4][0]);
+  TEST_ASSERT_EQUAL(1400, weekLayout.times[4][WEEK_SLOTS - 1]);
+
+  // Picking a day only marks the old and new columns for redraw
+  weekSelectedDay = 1;
+  weekRedrawMask = 0;
+  commandSelectWeek("Thu");
+  TEST_ASSERT_EQUAL(4, weekSelectedDay);
+  TEST_ASSERT_EQUAL((1 << 1) | (1 << 4), weekRedrawMask);
+
+  // Opening a day from the month view lands on its week (rtc is 2025-01-15)
+  openWeekOf(2025, 1, 2);
+  TEST_ASSERT_EQUAL(WEEK, CurrentCalendarState);
+  TEST_ASSERT_EQUAL(-2, weekOffsetCount);
+  TEST_ASSERT_EQUAL(4, weekSelectedDay);
+
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+}
+
+static std::vector<std::string> readEventLines() {
+  std::vector<std::string> lines;
+  std::ifstream f(EVENTS_FILE);
+  std::string line;
+  while (std::getline(f, line)) if (!line.empty()) lines.push_back(line);
+  return lines;
+}
+
+// .ics files stream into the events file, one line per VEVENT
+void test_ics_import() {
+  system("mkdir -p sys");
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+  updateEventsFile();
+
+  std::ofstream icsFile("test_import.ics", std::ios::trunc);
+  icsFile << "BEGIN:VCALENDAR\r\nVERSION:2.0\r\n"
+         "BEGIN:VTIMEZONE\r\nTZID:Europe/Berlin\r\nBEGIN:STANDARD\r\nDTSTART:19701025T030000\r\nEND:STANDARD\r\nEND:VTIMEZONE\r\n"
+         // Folded summary, escaped text, alarm inside the event
+         "BEGIN:VEVENT\r\nSUMMARY:Team\r\n  sync\r\nDTSTART;TZID=\"Europe/Berlin\":20250113T093000\r\n"
+         "DTEND;TZID=\"Europe/Berlin\":20250113T101500\r\nRRULE:FREQ=WEEKLY;BYDAY=MO,WE\r\n"
+         "DESCRIPTION:Bring\\, notes | stuff\r\nBEGIN:VALARM\r\nDESCRIPTION:Reminder\r\nEND:VALARM\r\nEND:VEVENT\r\n"
+         // All-day yearly
+         "BEGIN:VEVENT\r\nSUMMARY:Anniversary\r\nDTSTART;VALUE=DATE:20250214\r\nDTEND;VALUE=DATE:20250215\r\nRRULE:FREQ=YEARLY\r\nEND:VEVENT\r\n"
+         // UTC time, nth weekday, DURATION
+         "BEGIN:VEVENT\r\nSUMMARY:Book club\r\nDTSTART:20250108T180000Z\r\nDURATION:PT1H30M\r\nRRULE:FREQ=MONTHLY;BYDAY=2WE\r\nLOCATION:Library\r\nEND:VEVENT\r\n"
+         // Unsupported interval and finished series keep their first date only
+         "BEGIN:VEVENT\r\nSUMMARY:Fortnightly\r\nDTSTART:20250110T120000\r\nRRULE:FREQ=WEEKLY;INTERVAL=2\r\nEND:VEVENT\r\n"
+         "BEGIN:VEVENT\r\nSUMMARY:Old series\r\nDTSTART:20230301T080000\r\nRRULE:FREQ=DAILY;UNTIL=20240101T000000Z\r\nEND:VEVENT\r\n"
+         // No start date
+         "BEGIN:VEVENT\r\nSUMMARY:Broken\r\nEND:VEVENT\r\n"
+         "BEGIN:VEVENT\nSUMMARY:Rent\nDTSTART:20250101T090000\nRRULE:FREQ=MONTHLY;BYMONTHDAY=15\nEND:VEVENT\n"
+         "END:VCALENDAR";
+  icsFile.close();
+
+  TEST_ASSERT_EQUAL(6, icsImport("test_import.ics"));
+  TEST_ASSERT_EQUAL(2, ics.single);
+  TEST_ASSERT_EQUAL(1, ics.skipped);
+
+  std::vector<std::string> lines = readEventLines();
+  TEST_ASSERT_EQUAL(7, lines.size());
+  TEST_ASSERT_EQUAL_STRING(RECORD_HEADER, lines[0].c_str());    // Imported text is escaped
+  TEST_ASSERT_EQUAL_STRING("Team sync|20250113|0930|45|WEEKLY MoWe|Bring, notes \\| stuff", lines[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("Anniversary|20250214||1440|YEARLY FEB14|", lines[2].c_str());
+  TEST_ASSERT_EQUAL_STRING("Book club|20250108|1800|90|MONTHLY 2We|Library", lines[3].c_str());
+  TEST_ASSERT_EQUAL_STRING("Fortnightly|20250110|1200|0||", lines[4].c_str());
+  TEST_ASSERT_EQUAL_STRING("Old series|20230301|0800|0||", lines[5].c_str());
+  TEST_ASSERT_EQUAL_STRING("Rent|20250101|0900|0|MONTHLY 15|", lines[6].c_str());
+
+  // The cache picks the new events up
+  TEST_ASSERT_EQUAL(2, checkEvents("20250115", true));   // Team sync (Wed) and Rent
+  TEST_ASSERT_EQUAL(1, checkEvents("20260214", true));   // Anniversary
+
+  // A few thousand events stream through the same fixed buffers
+  std::ofstream big("test_big.ics", std::ios::trunc);
+  big << "BEGIN:VCALENDAR\r\n";
+  for (int i = 0; i < 3000; i++) {
+    big << "BEGIN:VEVENT\r\nUID:" << i << "\r\nSUMMARY:Event " << i << "\r\nDTSTART:2025" << (i % 12 < 9 ? "0" : "") << (i % 12 + 1)
+        << "10T0800\r\nDURATION:PT30M\r\nEND:VEVENT\r\n";
+  }
+  big << "END:VCALENDAR\r\n";
+  big.close();
+  TEST_ASSERT_EQUAL(3000, icsImport("test_big.ics"));
+  TEST_ASSERT_EQUAL(3007, readEventLines().size());
+
+  std::remove("test_import.ics");
+  std::remove("test_big.ics");
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+}
+
+// Overlap warnings and free slot search run off the interval index
+void test_event_intervals() {
+  system("mkdir -p sys");
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+  updateEventsFile();
+
+  addEvent("Standup", "20250101", "0900", "30", "DAILY", "");
+  addEvent("Lunch", "20250113", "1200", "60", "WEEKLY MoTuWeThFr", "");
+  addEvent("Holiday", "20250117", "", "1440", "", "");        // All day, doesn't block time
+  addEvent("Deadline", "20250116", "1000", "0", "", "");       // No duration
+
+  int first = -1;
+  TEST_ASSERT_EQUAL(1, eventConflicts(makeEvent("", "20250116", "0915", "30", "", ""), &first));
+  TEST_ASSERT_EQUAL_STRING("Standup", calendarEvents[first].name.c_str());
+  TEST_ASSERT_EQUAL(0, eventConflicts(makeEvent("", "20250116", "0930", "30", "", ""), &first));   // Touching isn't overlapping
+  TEST_ASSERT_EQUAL(0, eventConflicts(makeEvent("", "20250116", "1000", "60", "", ""), &first));
+  // Daily at 11:30 for an hour runs into lunch on the 5 weekdays in range (16th..29th has 10)
+  TEST_ASSERT_EQUAL(10, eventConflicts(makeEvent("", "20250116", "1130", "60", "DAILY", ""), &first));
+  TEST_ASSERT_EQUAL(0, eventConflicts(makeEvent("", "20250116", "", "60", "", ""), &first));
+
+  int32_t wed = daysFromCivil(2025, 1, 15) * 1440;
+  TEST_ASSERT_EQUAL_INT32(wed + 8 * 60, findFreeSlot(wed + 8 * 60, 60));
+  TEST_ASSERT_EQUAL_INT32(wed + 9 * 60 + 30, findFreeSlot(wed + 8 * 60 + 30, 60));
+  TEST_ASSERT_EQUAL_INT32(wed + 13 * 60, findFreeSlot(wed + 11 * 60, 180));
+  // Too late in the day, rolls over to tomorrow morning
+  TEST_ASSERT_EQUAL_INT32(wed + 1440 + 8 * 60, findFreeSlot(wed + 19 * 60 + 30, 60));
+  TEST_ASSERT_EQUAL_INT32(-1, findFreeSlot(wed, FREE_SLOT_END - FREE_SLOT_START + 1));
+
+  // Hundreds of recurring events still answer well under a millisecond per query
+  for (int i = 0; i < 300; i++) {
+    char time[5];
+    snprintf(time, sizeof(time), "%02d%02d", 8 + i % 12, (i * 7) % 60);
+    calendarEvents.push_back(makeEvent("Recurring", "20250101", time, "20", i % 2 ? "DAILY" : "WEEKLY MoWeFr", ""));
+  }
+  sortEventsByDate(calendarEvents);
+  rulesCompiled = false;
+  ensureIntervalIndex(daysFromCivil(2025, 1, 15));
+  TEST_ASSERT_TRUE(intervals.size() > 2000);
+
+  auto start = std::chrono::steady_clock::now();
+  const int queries = 1000;
+  int32_t found = 0;
+  for (int i = 0; i < queries; i++) {
+    if (findFreeSlot(wed + (i % 10) * 1440, 5 + i % 40) >= 0) found++;
+    found += overlappingIntervals(wed + i * 13, wed + i * 13 + 30, &first) > 0;
+  }
+  double perQueryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / queries;
+  std::cout << "Interval index: " << intervals.size() << " occurrences, " << perQueryMs << " ms per query" << std::endl;
+  TEST_ASSERT_TRUE(found > 0);
+  TEST_ASSERT_TRUE(perQueryMs < 1.0);
+
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+}
+
 // Add Unity test runner
+// Series that end, and days counted back from the month's end, can't repeat
+// in the store. They keep their first date rather than going on forever.
+void test_ics_bounded_rules() {
+  system("mkdir -p sys");
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+  updateEventsFile();
+
+  std::ofstream icsFile("test_bounded.ics", std::ios::trunc);
+  icsFile << "BEGIN:VCALENDAR\r\n"
+         "BEGIN:VEVENT\r\nSUMMARY:Three weeks\r\nDTSTART:20200108T090000\r\nRRULE:FREQ=WEEKLY;COUNT=3\r\nEND:VEVENT\r\n"
+         "BEGIN:VEVENT\r\nSUMMARY:Until later\r\nDTSTART:20250101T070000\r\nRRULE:FREQ=DAILY;UNTIL=20991231T000000Z\r\nEND:VEVENT\r\n"
+         "BEGIN:VEVENT\r\nSUMMARY:Month end\r\nDTSTART;VALUE=DATE:20250131\r\nRRULE:FREQ=MONTHLY;BYMONTHDAY=-1\r\nEND:VEVENT\r\n"
+         "BEGIN:VEVENT\r\nSUMMARY:Weekly\r\nDTSTART:20250106T090000\r\nRRULE:FREQ=WEEKLY\r\nEND:VEVENT\r\n"
+         "END:VCALENDAR\r\n";
+  icsFile.close();
+
+  TEST_ASSERT_EQUAL(4, icsImport("test_bounded.ics"));
+  TEST_ASSERT_EQUAL(3, ics.single);
+  std::vector<std::string> lines = readEventLines();
+  TEST_ASSERT_EQUAL(5, lines.size());
+  TEST_ASSERT_EQUAL_STRING("Three weeks|20200108|0900|0||", lines[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("Until later|20250101|0700|0||", lines[2].c_str());
+  TEST_ASSERT_EQUAL_STRING("Month end|20250131||0||", lines[3].c_str());
+  TEST_ASSERT_EQUAL_STRING("Weekly|20250106|0900|0|WEEKLY Mo|", lines[4].c_str());
+
+  // Only the open ended series goes on
+  TEST_ASSERT_EQUAL(1, checkEvents("20250113", true));
+  TEST_ASSERT_EQUAL(0, checkEvents("20200115", true));
+  TEST_ASSERT_EQUAL(0, checkEvents("20250102", true));
+  TEST_ASSERT_EQUAL(0, checkEvents("20250228", true));
+
+  std::remove("test_bounded.ics");
+  delFile(EVENTS_FILE);
+  calendarEvents.clear();
+}
+
 void setUp(void) {
   // Reset state before each test if needed
 }
@@ -240,5 +524,10 @@ void tearDown(void) {
 int main(int argc, char **argv) {
   UNITY_BEGIN();
   RUN_TEST(test_e2e_user_calendar_flow);
+  RUN_TEST(test_compiled_repeat_rules);
+  RUN_TEST(test_week_layout);
+  RUN_TEST(test_ics_import);
+  RUN_TEST(test_ics_bounded_rules);
+  RUN_TEST(test_event_intervals);
   return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include <unity.h>
+#include <string.h>
+#include "../include/civildate.h"
+
+// Day numbers round trip through every date the apps can store
+void test_days_round_trip() {
+  int32_t first = daysFromCivil(1900, 1, 1);
+  int32_t last  = daysFromCivil(2200, 12, 31);
+  int year = 1900, month = 1, day = 1;
+
+  for (int32_t days = first; days <= last; days++) {
+    TEST_ASSERT_EQUAL_INT32(days, daysFromCivil(year, month, day));
+    CivilDate c = civilFromDays(days);
+    TEST_ASSERT_EQUAL(year, c.year);
+    TEST_ASSERT_EQUAL(month, c.month);
+    TEST_ASSERT_EQUAL(day, c.day);
+    TEST_ASSERT_EQUAL_UINT32(packDate(year, month, day), packedFromDays(days));
+
+    // Step the reference date by hand
+    if (++day > daysInMonth(year, month)) {
+      day = 1;
+      if (++month > 12) { month = 1; year++; }
+    }
+  }
+}
+
+void test_weekdays() {
+  TEST_ASSERT_EQUAL(4, weekdayOf(1970, 1, 1));   // Thursday
+  TEST_ASSERT_EQUAL(3, weekdayOf(1969, 12, 31)); // Before the epoch
+  TEST_ASSERT_EQUAL(4, weekdayOf(2024, 2, 29));  // Leap day, Thursday
+  TEST_ASSERT_EQUAL(0, weekdayOf(2025, 6, 1));   // Sunday
+  TEST_ASSERT_EQUAL(6, weekdayOf(2025, 3, 1));   // Saturday
+
+  // Thanksgiving, the 4th Thursday of November
+  TEST_ASSERT_EQUAL(27, nthWeekdayDay(2025, 11, 4, 4));
+  TEST_ASSERT_EQUAL(28, nthWeekdayDay(2024, 11, 4, 4));
+  // 5th Saturday of February 2025 doesn't exist
+  TEST_ASSERT_TRUE(nthWeekdayDay(2025, 2, 6, 5) > daysInMonth(2025, 2));
+
+  TEST_ASSERT_EQUAL(1, weekOfMonth(7));
+  TEST_ASSERT_EQUAL(2, weekOfMonth(8));
+  TEST_ASSERT_EQUAL(5, weekOfMonth(29));
+}
+
+void test_months_and_leap_years() {
+  TEST_ASSERT_EQUAL(29, daysInMonth(2000, 2));
+  TEST_ASSERT_EQUAL(28, daysInMonth(1900, 2));
+  TEST_ASSERT_EQUAL(29, daysInMonth(2024, 2));
+  TEST_ASSERT_EQUAL(31, daysInMonth(2025, 12));
+  TEST_ASSERT_EQUAL(30, daysInMonth(2025, 11));
+}
+
+void test_packed_dates() {
+  const char* good = "20250115";
+  TEST_ASSERT_EQUAL_UINT32(20250115, parsePackedDate(good, strlen(good)));
+  TEST_ASSERT_EQUAL(2025, packedYear(20250115));
+  TEST_ASSERT_EQUAL(1, packedMonth(20250115));
+  TEST_ASSERT_EQUAL(15, packedDay(20250115));
+
+  // Longer strings (timestamps) only look at the date part
+  const char* stamp = "20250115143000";
+  TEST_ASSERT_EQUAL_UINT32(20250115, parsePackedDate(stamp, strlen(stamp)));
+
+  const char* bad[] = { "", "2025011", "baddate!", "20251301", "20250230", "20250100", "2025-1-1" };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    TEST_ASSERT_EQUAL_UINT32(0, parsePackedDate(bad[i], strlen(bad[i])));
+  }
+
+  TEST_ASSERT_EQUAL_INT32(1430, parseDigits("1430", 4));
+  TEST_ASSERT_EQUAL_INT32(-1, parseDigits("14:30", 5));
+
+  // Packed dates sort the same as day numbers
+  TEST_ASSERT_TRUE(packDate(2024, 12, 31) < packDate(2025, 1, 1));
+  TEST_ASSERT_EQUAL_INT32(1, daysFromPacked(20250101) - daysFromPacked(20241231));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_days_round_trip);
+  RUN_TEST(test_weekdays);
+  RUN_TEST(test_months_and_leap_years);
+  RUN_TEST(test_packed_dates);
+  return UNITY_END();
+}
@@ -0,0 +1,623 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include <map>
+#include <set>
+#define DICTC_NO_MAIN
+#include "../tools/dictc/dictc.cpp"
+
+bool noSD = false;
+MockSD_MMC SD_MMC;
+
+#include "../src/dictFunc.cpp"
+
+static void writeImage(DictBuilder& builder) {
+  TEST_ASSERT_TRUE(dictWriteImage(DICT_FILE, builder.build()));
+}
+
+static String headAt(uint32_t index) {
+  String head, def;
+  TEST_ASSERT_TRUE(dictEntry(index, head, def));
+  return head;
+}
+
+void test_small_dictionary() {
+  DictBuilder builder;
+  builder.addLine("Zebra (n.) A striped horse.");
+  builder.addLine("Abacus (n.) A frame with beads for counting.");
+  builder.addLine("  abaft (adv.) Toward the stern.\r");
+  builder.addLine("Abacus (n.) A slab on top of a column.");
+  builder.addLine("no headword here");
+  builder.addLine("");
+  builder.addLine("Boat (n.) A small vessel.");
+  TEST_ASSERT_EQUAL(5, builder.size());
+  writeImage(builder);
+
+  TEST_ASSERT_TRUE(dictBegin());
+  uint32_t first, end;
+
+  // Case doesn't matter, senses keep their order
+  TEST_ASSERT_TRUE(dictFind("ABAC", first, end));
+  TEST_ASSERT_EQUAL(2, end - first);
+  String head, def;
+  TEST_ASSERT_TRUE(dictEntry(first, head, def));
+  TEST_ASSERT_EQUAL_STRING("Abacus (n.)", head.c_str());
+  TEST_ASSERT_EQUAL_STRING("A frame with beads for counting.", def.c_str());
+  TEST_ASSERT_TRUE(dictEntry(first + 1, head, def));
+  TEST_ASSERT_EQUAL_STRING("A slab on top of a column.", def.c_str());
+
+  TEST_ASSERT_TRUE(dictFind("ab", first, end));
+  TEST_ASSERT_EQUAL(3, end - first);
+  TEST_ASSERT_EQUAL_STRING("abaft (adv.)", headAt(end - 1).c_str());
+
+  // The whole headword matches too
+  TEST_ASSERT_TRUE(dictFind("boat (n.)", first, end));
+  TEST_ASSERT_EQUAL(1, end - first);
+
+  TEST_ASSERT_FALSE(dictFind("aa", first, end));
+  TEST_ASSERT_FALSE(dictFind("zz", first, end));
+  TEST_ASSERT_FALSE(dictFind("boats", first, end));
+  TEST_ASSERT_FALSE(dictFind("", first, end));
+  TEST_ASSERT_FALSE(dictEntry(5, head, def));
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+static uint32_t timeLookups(const char* from) {
+  auto start = std::chrono::steady_clock::now();
+  uint32_t first, end, total = 0;
+  for (int i = 0; i < 2000; i++) {
+    char prefix[4] = { (char)('a' + i % 6), (char)('a' + i / 6 % 6), (char)('a' + i / 36 % 6), 0 };
+    dictFind(prefix, first, end);
+    total += end - first;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "2000 lookups " << from << " in " << ms << " ms, " << total << " matches" << std::endl;
+  return total;
+}
+
+// Every prefix agrees with a plain scan, across many strides and headwords
+// longer than the sparse keys
+void test_large_dictionary_matches_scan() {
+  DictBuilder builder;
+  std::vector<std::string> heads;
+  uint32_t seed = 12345;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    std::string word;
+    int len = 1 + (seed >> 16) % 9;
+    for (int k = 0; k < len; k++) {
+      seed = seed * 1103515245 + 12345;
+      word += (char)('a' + (seed >> 16) % 6);
+    }
+    // Long shared stems around the sparse key length
+    if (i % 7 == 0) word = "electroencephal" + word;
+    std::string head = word + " (n.)";
+    if (i % 3 == 0) head[0] = toupper(head[0]);
+    builder.addLine(head + " Definition " + std::to_string(i));
+    std::string folded = head;
+    for (size_t k = 0; k < folded.size(); k++) folded[k] = dictFold(folded[k]);
+    heads.push_back(folded);
+  }
+  writeImage(builder);
+  std::sort(heads.begin(), heads.end());
+
+  TEST_ASSERT_TRUE(dictBegin());
+  const char* probes[] = { "a", "ab", "fff", "f", "cab", "electro", "electroencephal", "electroencephala",
+                           "electroencephalf", "electroencephalaaa", "electroencephalb (n", "g", "0", "ddd (n.)" };
+  for (size_t p = 0; p < sizeof(probes) / sizeof(probes[0]); p++) {
+    std::string prefix = probes[p];
+    size_t expectFirst = std::lower_bound(heads.begin(), heads.end(), prefix) - heads.begin();
+    size_t expectEnd = expectFirst;
+    while (expectEnd < heads.size() && heads[expectEnd].compare(0, prefix.size(), prefix) == 0) expectEnd++;
+
+    uint32_t first, end;
+    bool found = dictFind(String(prefix), first, end);
+    TEST_ASSERT_EQUAL(expectEnd > expectFirst, found);
+    TEST_ASSERT_EQUAL_UINT32(expectFirst, first);
+    TEST_ASSERT_EQUAL_UINT32(expectEnd, end);
+  }
+
+  // Lookups only touch a stride's worth of the image
+  uint32_t total = timeLookups("from the card");
+  dictEnd();
+
+  // The same image mapped, as from the flash partition
+  TEST_ASSERT_TRUE(dictWriteImage(DICT_PARTITION, builder.build()));
+  TEST_ASSERT_TRUE(dictBegin());
+  TEST_ASSERT_EQUAL(total, timeLookups("mapped"));
+  dictEnd();
+
+  std::remove(DICT_PARTITION);
+  std::remove(DICT_FILE);
+}
+
+void test_completions() {
+  DictBuilder builder;
+  builder.addLine("Set (v.) To put.");
+  builder.addLine("Set (v.) To fix.");
+  builder.addLine("Set (n.) A group.");
+  builder.addLine("Setback (n.) A reverse.");
+  builder.addLine("Settle (v.) To agree.");
+  builder.addLine("Settle (n.) A bench.");
+  builder.addLine("Seta (n.) A bristle.");
+  builder.addLine("Sea (n.) Salt water.");
+  builder.addLine("Sea urchin (n.) A spiny animal.");
+  builder.addLine("Zoo (n.) Animals.");
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+
+  String words[DICT_TRIE_TOP];
+  // Most senses first, then shorter words
+  TEST_ASSERT_EQUAL(3, dictComplete("se", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Set", words[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Settle", words[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("Sea", words[2].c_str());
+
+  // Ending inside a label, and past a word that is itself a prefix
+  TEST_ASSERT_EQUAL(1, dictComplete("SETT", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Settle", words[0].c_str());
+  TEST_ASSERT_EQUAL(1, dictComplete("setb", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Setback", words[0].c_str());
+  TEST_ASSERT_EQUAL(1, dictComplete("sea ", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Sea urchin", words[0].c_str());
+
+  TEST_ASSERT_EQUAL(0, dictComplete("sx", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL(0, dictComplete("settles", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL(1, dictComplete("s", words, 1));
+  TEST_ASSERT_EQUAL_STRING("Set", words[0].c_str());
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+struct RankedWord {
+  std::string word;
+  std::string shown;
+  uint32_t senses;
+};
+
+// Completions match a brute-force ranking, and the card reads per keystroke
+// stay bounded by the prefix length
+void test_completions_match_scan() {
+  DictBuilder builder;
+  std::map<std::string, RankedWord> ranked;
+  uint32_t seed = 777;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    std::string word;
+    int len = 1 + (seed >> 16) % 8;
+    for (int k = 0; k < len; k++) {
+      seed = seed * 1103515245 + 12345;
+      word += (char)('a' + (seed >> 16) % 5);
+    }
+    builder.addLine(word + " (n.) Sense " + std::to_string(i));
+    RankedWord& r = ranked[word];
+    r.word = r.shown = word;
+    r.senses++;
+  }
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+
+  std::vector<RankedWord> all;
+  for (std::map<std::string, RankedWord>::iterator it = ranked.begin(); it != ranked.end(); ++it) all.push_back(it->second);
+
+  uint32_t worstExtra = 0;
+  for (int i = 0; i < 500; i++) {
+    std::string prefix;
+    uint32_t len = 1 + i % 6;
+    for (uint32_t k = 0; k < len; k++) prefix += (char)('a' + (i * 7 + k * 3) % 5);
+
+    std::vector<RankedWord> expect;
+    for (size_t w = 0; w < all.size(); w++) {
+      if (all[w].word.compare(0, prefix.size(), prefix) == 0) expect.push_back(all[w]);
+    }
+    std::stable_sort(expect.begin(), expect.end(), [](const RankedWord& a, const RankedWord& b) {
+      if (a.senses != b.senses) return a.senses > b.senses;
+      return a.word.size() < b.word.size();
+    });
+    if (expect.size() > DICT_TRIE_TOP) expect.resize(DICT_TRIE_TOP);
+
+    String words[DICT_TRIE_TOP];
+    dictEnd();
+    TEST_ASSERT_TRUE(dictBegin());
+    uint32_t loads = dictBlockLoads;
+    uint8_t count = dictComplete(String(prefix), words, DICT_TRIE_TOP);
+    loads = dictBlockLoads - loads;
+    if (loads > 2 * len && loads - 2 * len > worstExtra) worstExtra = loads - 2 * len;
+
+    TEST_ASSERT_EQUAL(expect.size(), count);
+    for (uint8_t w = 0; w < count; w++) TEST_ASSERT_EQUAL_STRING(expect[w].shown.c_str(), words[w].c_str());
+  }
+  std::cout << "Worst completion: " << worstExtra << " blocks over two per prefix byte" << std::endl;
+  // Two blocks per trie level at most, plus the headwords shown
+  TEST_ASSERT_TRUE(worstExtra <= 2 * DICT_TRIE_TOP);
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+void test_suggestions() {
+  DictBuilder builder;
+  builder.addLine("Receive (v.) To take.");
+  builder.addLine("Recipe (n.) Directions for cooking.");
+  builder.addLine("Separate (adj.) Apart.");
+  builder.addLine("Definitely (adv.) Surely.");
+  builder.addLine("Weird (adj.) Strange.");
+  builder.addLine("Word (n.) A unit of speech.");
+  builder.addLine("Ward (n.) A room in a hospital.");
+  builder.addLine("Zoo (n.) Animals.");
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+
+  String words[DICT_TRIE_TOP];
+  // Transposition, substitution, insertion, deletion, two edits
+  TEST_ASSERT_EQUAL(2, dictSuggest("recieve", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Receive", words[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Recipe", words[1].c_str());
+  TEST_ASSERT_EQUAL(1, dictSuggest("seperate", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Separate", words[0].c_str());
+  TEST_ASSERT_EQUAL(1, dictSuggest("definitelly", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Definitely", words[0].c_str());
+  TEST_ASSERT_EQUAL(1, dictSuggest("RECIP", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Recipe", words[0].c_str());
+  TEST_ASSERT_EQUAL(1, dictSuggest("defnately", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Definitely", words[0].c_str());
+
+  // Closest first, then nearest in length, then in dictionary order
+  TEST_ASSERT_EQUAL(3, dictSuggest("werd", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Ward", words[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Word", words[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("Weird", words[2].c_str());
+  TEST_ASSERT_EQUAL(1, dictSuggest("werd", words, 1));
+
+  // Too far, or too short to guess at
+  TEST_ASSERT_EQUAL(0, dictSuggest("xylophone", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL(0, dictSuggest("zo", words, DICT_TRIE_TOP));
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+// Keys only come from the first bytes of a word, so a long word shares every
+// one with all the words starting the same way. The right one is found even
+// when far more of them than are checked come first in the buckets.
+void test_suggestions_among_shared_prefixes() {
+  DictBuilder builder;
+  for (int i = 0; i < 300; i++) {
+    char head[32];
+    snprintf(head, sizeof(head), "interna%c%c%03d", 'a' + i / 26 % 19, 'a' + i % 26, i);
+    builder.addLine(std::string(head) + " (n.) Filler.");
+  }
+  builder.addLine("International (adj.) Between nations.");
+  builder.addLine("Internet (n.) The network.");
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+
+  String words[DICT_TRIE_TOP];
+  uint32_t loads = dictBlockLoads;
+  TEST_ASSERT_EQUAL(1, dictSuggest("internationl", words, DICT_TRIE_TOP));
+  loads = dictBlockLoads - loads;
+  TEST_ASSERT_EQUAL_STRING("International", words[0].c_str());
+  std::cout << "Shared prefix suggestion: " << loads << " blocks" << std::endl;
+  TEST_ASSERT_TRUE(loads <= 1 + 2 * DICT_FUZZY_KEYS + 2 * DICT_FUZZY_CHECK);
+  TEST_ASSERT_EQUAL(1, dictSuggest("intrenet", words, DICT_TRIE_TOP));
+  TEST_ASSERT_EQUAL_STRING("Internet", words[0].c_str());
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+static size_t plainDistance(const std::string& a, const std::string& b) {
+  std::vector<std::vector<size_t>> d(a.size() + 1, std::vector<size_t>(b.size() + 1));
+  for (size_t i = 0; i <= a.size(); i++) d[i][0] = i;
+  for (size_t j = 0; j <= b.size(); j++) d[0][j] = j;
+  for (size_t i = 1; i <= a.size(); i++) {
+    for (size_t j = 1; j <= b.size(); j++) {
+      d[i][j] = std::min(std::min(d[i - 1][j] + 1, d[i][j - 1] + 1), d[i - 1][j - 1] + (a[i - 1] != b[j - 1]));
+      if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+    }
+  }
+  return d[a.size()][b.size()];
+}
+
+// Suggestions for misspelt words match a brute-force search of the whole
+// word list, and each query reads a bounded number of blocks
+void test_suggestions_match_scan() {
+  DictBuilder builder;
+  std::set<std::string> unique;
+  uint32_t seed = 4242;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1103515245 + 12345;
+    std::string word;
+    int len = 3 + (seed >> 16) % 10;
+    for (int k = 0; k < len; k++) {
+      seed = seed * 1103515245 + 12345;
+      word += (char)('a' + (seed >> 16) % 26);
+    }
+    builder.addLine(word + " (n.) Sense " + std::to_string(i));
+    unique.insert(word);
+  }
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+  std::vector<std::string> all(unique.begin(), unique.end());
+
+  uint32_t worst = 0, total = 0;
+  int queries = 0, answered = 0, exact = 0;
+  for (size_t i = 0; i < all.size(); i += 37) {
+    // One or two random edits
+    std::string query = all[i];
+    for (int e = 0; e < 1 + (int)(i % 2); e++) {
+      seed = seed * 1103515245 + 12345;
+      size_t at = (seed >> 16) % query.size();
+      char c = (char)('a' + (seed >> 8) % 26);
+      switch ((seed >> 20) % 4) {
+        case 0: query[at] = c; break;
+        case 1: query.insert(query.begin() + at, c); break;
+        case 2: if (query.size() > 3) query.erase(at, 1); break;
+        case 3: if (at + 1 < query.size()) std::swap(query[at], query[at + 1]); break;
+      }
+    }
+    if (unique.count(query)) continue;
+    queries++;
+
+    std::vector<std::pair<size_t, std::string>> expect;
+    for (size_t w = 0; w < all.size(); w++) {
+      size_t distance = plainDistance(query, all[w]);
+      size_t lenDiff = all[w].size() > query.size() ? all[w].size() - query.size() : query.size() - all[w].size();
+      if (distance <= 2) expect.push_back(std::make_pair(distance * 4 + lenDiff, all[w]));
+    }
+    std::sort(expect.begin(), expect.end());
+    if (expect.size() > DICT_TRIE_TOP) expect.resize(DICT_TRIE_TOP);
+
+    String words[DICT_TRIE_TOP];
+    dictEnd();
+    TEST_ASSERT_TRUE(dictBegin());
+    uint32_t loads = dictBlockLoads;
+    uint8_t count = dictSuggest(String(query), words, DICT_TRIE_TOP);
+    loads = dictBlockLoads - loads;
+    if (loads > worst) worst = loads;
+    total += loads;
+    if (count > 0) answered++;
+
+    // Every word shown is within reach and in order, and the best one is as
+    // close as the best in the whole list. Among many words equally far
+    // from a short query the capped search may pick others than the scan.
+    TEST_ASSERT_EQUAL_MESSAGE(expect.size(), count, query.c_str());
+    bool same = true;
+    size_t last = 0;
+    for (uint8_t w = 0; w < count; w++) {
+      std::string shown = words[w].c_str();
+      TEST_ASSERT_TRUE(unique.count(shown) == 1);
+      size_t lenDiff = shown.size() > query.size() ? shown.size() - query.size() : query.size() - shown.size();
+      size_t score = plainDistance(query, shown) * 4 + lenDiff;
+      TEST_ASSERT_TRUE(score >= last && score <= 2 * 4 + 2);
+      if (w == 0) TEST_ASSERT_EQUAL_MESSAGE(expect[0].first, score, query.c_str());
+      if (shown != expect[w].second) same = false;
+      last = score;
+    }
+    if (same) exact++;
+  }
+  std::cout << "Suggestions: " << answered << "/" << queries << " answered, " << exact << " as the full scan, "
+            << (double)total / queries << " blocks per query, worst " << worst << " of "
+            << 1 + 2 * DICT_FUZZY_KEYS + 2 * DICT_FUZZY_CHECK << std::endl;
+  // The bucket count, then per key its start table entry and postings, and
+  // per headword its offset and record
+  TEST_ASSERT_TRUE(worst <= 1 + 2 * DICT_FUZZY_KEYS + 2 * DICT_FUZZY_CHECK);
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+void test_reverse_lookup() {
+  DictBuilder builder;
+  builder.addLine("Dinghy (n.) A small boat.");
+  builder.addLine("Skiff (n.) A small light boat for rowing or sailing.");
+  builder.addLine("Liner (n.) A large ship carrying passengers.");
+  builder.addLine("Boat (n.) A small vessel for travelling on water.");
+  builder.addLine("Pebble (n.) A small stone, rounded by water.");
+  builder.addLine("Raft (n.) Logs tied together, floating on water; boats of the simplest kind.");
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+
+  uint32_t records[8];
+  String head, def;
+  // Every term used, the shortest definition first
+  TEST_ASSERT_EQUAL(2, dictSearch("a small boat", records, 8));
+  TEST_ASSERT_EQUAL_STRING("Dinghy (n.)", headAt(records[0]).c_str());
+  TEST_ASSERT_EQUAL_STRING("Skiff (n.)", headAt(records[1]).c_str());
+  TEST_ASSERT_EQUAL(1, dictSearch("a small boat", records, 1));
+
+  // Plurals, case and stop words don't matter
+  TEST_ASSERT_EQUAL(3, dictSearch("BOATS", records, 8));
+  TEST_ASSERT_EQUAL(2, dictSearch("small, on the water", records, 8));
+  // Equal scores in dictionary order
+  TEST_ASSERT_EQUAL_STRING("Boat (n.)", headAt(records[0]).c_str());
+  TEST_ASSERT_EQUAL_STRING("Pebble (n.)", headAt(records[1]).c_str());
+
+  // Unknown terms are left out, then the most common ones until something matches
+  TEST_ASSERT_EQUAL(1, dictSearch("enormous ship", records, 8));
+  TEST_ASSERT_EQUAL_STRING("Liner (n.)", headAt(records[0]).c_str());
+  TEST_ASSERT_EQUAL(1, dictSearch("small ship", records, 8));
+  TEST_ASSERT_EQUAL_STRING("Liner (n.)", headAt(records[0]).c_str());
+
+  TEST_ASSERT_EQUAL(0, dictSearch("of the", records, 8));
+  TEST_ASSERT_EQUAL(0, dictSearch("zzz", records, 8));
+  TEST_ASSERT_EQUAL(0, dictSearch("", records, 8));
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+// Multi-term queries return only records using every term, as many as a scan
+// finds, and stay within a bounded number of reads
+void test_reverse_lookup_matches_scan() {
+  DictBuilder builder;
+  std::vector<std::set<std::string>> used;
+  std::vector<std::string> vocabulary;
+  for (int v = 0; v < 400; v++) vocabulary.push_back("term" + std::string(1, 'a' + v % 26) + std::string(1, 'a' + v / 26));
+  uint32_t seed = 99;
+  for (int i = 0; i < 20000; i++) {
+    std::string def;
+    std::set<std::string> terms;
+    int words = 3 + i % 12;
+    for (int k = 0; k < words; k++) {
+      // Skewed, so some terms are common and most are rare
+      seed = seed * 1103515245 + 12345;
+      uint32_t r = (seed >> 16) % 400;
+      r = r * r / 400;
+      def += vocabulary[r] + " ";
+      terms.insert(vocabulary[r]);
+    }
+    char head[16];
+    snprintf(head, sizeof(head), "w%05d (n.)", i);
+    builder.addLine(std::string(head) + " " + def);
+    used.push_back(terms);
+  }
+  writeImage(builder);
+  TEST_ASSERT_TRUE(dictBegin());
+
+  uint32_t worst = 0, total = 0;
+  int queries = 0;
+  for (int q = 0; q < 200; q++) {
+    std::vector<std::string> terms;
+    for (int k = 0; k < 2 + q % 2; k++) terms.push_back(vocabulary[(q * 37 + k * 101) % 400]);
+    std::string query;
+    for (size_t k = 0; k < terms.size(); k++) query += terms[k] + " ";
+
+    size_t expect = 0;
+    for (size_t i = 0; i < used.size(); i++) {
+      bool all = true;
+      for (size_t k = 0; k < terms.size(); k++) all &= used[i].count(terms[k]) == 1;
+      if (all) expect++;
+    }
+    if (expect == 0) continue;
+    queries++;
+
+    uint32_t records[8];
+    dictEnd();
+    TEST_ASSERT_TRUE(dictBegin());
+    uint32_t loads = dictBlockLoads;
+    uint8_t count = dictSearch(String(query), records, 8);
+    loads = dictBlockLoads - loads;
+    if (loads > worst) worst = loads;
+    total += loads;
+
+    TEST_ASSERT_EQUAL_MESSAGE(expect < 8 ? expect : 8, count, query.c_str());
+    for (uint8_t r = 0; r < count; r++) {
+      for (size_t k = 0; k < terms.size(); k++) TEST_ASSERT_TRUE(used[records[r]].count(terms[k]) == 1);
+    }
+  }
+  std::cout << "Reverse lookup: " << queries << " queries, " << (double)total / queries << " blocks per query, worst "
+            << worst << std::endl;
+  dictEnd();
+
+  std::remove(DICT_FILE);
+}
+
+void test_flash_partition() {
+  DictBuilder card;
+  card.addLine("Apple (n.) A fruit.");
+  writeImage(card);
+  DictBuilder flash;
+  flash.addLine("Pear (n.) A fruit.");
+  flash.addLine("Plum (n.) A stone fruit.");
+  TEST_ASSERT_TRUE(dictWriteImage(DICT_PARTITION, flash.build()));
+
+  // The partition wins, and is read without loading blocks
+  uint32_t first, end;
+  TEST_ASSERT_TRUE(dictBegin());
+  uint32_t loads = dictBlockLoads;
+  TEST_ASSERT_FALSE(dictFind("apple", first, end));
+  TEST_ASSERT_TRUE(dictFind("p", first, end));
+  TEST_ASSERT_EQUAL(2, end - first);
+  TEST_ASSERT_EQUAL_STRING("Plum (n.)", headAt(first + 1).c_str());
+  String words[DICT_TRIE_TOP];
+  TEST_ASSERT_EQUAL(1, dictSuggest("plumm", words, DICT_TRIE_TOP));
+  uint32_t records[4];
+  TEST_ASSERT_EQUAL(1, dictSearch("stone", records, 4));
+  TEST_ASSERT_EQUAL(0, dictBlockLoads - loads);
+  dictEnd();
+
+  // No card needed
+  noSD = true;
+  TEST_ASSERT_TRUE(dictBegin());
+  TEST_ASSERT_TRUE(dictFind("pear", first, end));
+  dictEnd();
+  noSD = false;
+
+  // An erased partition falls back to the card
+  std::vector<uint8_t> erased(4096, 0xFF);
+  TEST_ASSERT_TRUE(dictWriteImage(DICT_PARTITION, erased));
+  TEST_ASSERT_TRUE(dictBegin());
+  TEST_ASSERT_TRUE(dictFind("apple", first, end));
+  dictEnd();
+
+  // As does one whose sections run past its end
+  std::vector<uint8_t> cut = flash.build();
+  cut.resize(cut.size() / 2);
+  TEST_ASSERT_TRUE(dictWriteImage(DICT_PARTITION, cut));
+  TEST_ASSERT_TRUE(dictBegin());
+  TEST_ASSERT_TRUE(dictFind("apple", first, end));
+  dictEnd();
+
+  std::remove(DICT_PARTITION);
+  std::remove(DICT_FILE);
+}
+
+void test_missing_and_changed_image() {
+  std::remove(DICT_FILE);
+  TEST_ASSERT_FALSE(dictBegin());
+
+  // Not an image
+  std::ofstream junk(DICT_FILE);
+  junk << "Abacus (n.) Not compiled" << std::endl;
+  junk.close();
+  TEST_ASSERT_FALSE(dictBegin());
+
+  DictBuilder first;
+  first.addLine("Apple (n.) A fruit.");
+  writeImage(first);
+  uint32_t a, b;
+  TEST_ASSERT_TRUE(dictBegin());
+  TEST_ASSERT_TRUE(dictFind("apple", a, b));
+  dictEnd();
+
+  // A new image copied over the old one is picked up on the next open, even
+  // one with the same layout
+  DictBuilder second;
+  second.addLine("Pear (n.) A fruit.");
+  writeImage(second);
+  TEST_ASSERT_TRUE(dictBegin());
+  TEST_ASSERT_FALSE(dictFind("apple", a, b));
+  TEST_ASSERT_TRUE(dictFind("pear", a, b));
+  TEST_ASSERT_EQUAL_STRING("Pear (n.)", headAt(a).c_str());
+  dictEnd();
+
+  noSD = true;
+  TEST_ASSERT_FALSE(dictBegin());
+  noSD = false;
+
+  std::remove(DICT_FILE);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_dictionary);
+  RUN_TEST(test_large_dictionary_matches_scan);
+  RUN_TEST(test_completions);
+  RUN_TEST(test_completions_match_scan);
+  RUN_TEST(test_suggestions);
+  RUN_TEST(test_suggestions_among_shared_prefixes);
+  RUN_TEST(test_suggestions_match_scan);
+  RUN_TEST(test_reverse_lookup);
+  RUN_TEST(test_reverse_lookup_matches_scan);
+  RUN_TEST(test_flash_partition);
+  RUN_TEST(test_missing_and_changed_image);
+  return UNITY_END();
+}
@@ -6,7 +6,7 @@
 enum FileWizState { WIZ0_, WIZ1_, WIZ1_YN, WIZ2_R, WIZ2_C, WIZ3_ };
 
 // Define all global variables required by FILEWIZ.cpp
-std::vector<std::vector<String>> tasks;
+std::vector<Task> tasks;
 bool SAVE_POWER = false;
 int POWER_SAVE_FREQ = 40;
 bool SDActive = false;
@@ -30,7 +30,10 @@ String currentWord = "";
 FileWizState CurrentFileWizState = WIZ0_;
 String workingFile = "";
 String filesList[MAX_FILES];
+String filesListMeta[MAX_FILES];
 uint8_t fileIndex = 0;
+bool indexResultsActive = false;
+int indexResultLines[MAX_FILES];
 
 // Add timing variables for keyboard processing
 unsigned long KBBounceMillis = 0;
@@ -163,6 +166,48 @@ namespace fs {
   struct FS {};
 }
 
+// What metaFunc.cpp needs
+struct MockSerial {
+  void println(const String& s) { std::cout << s << std::endl; }
+};
+static MockSerial Serial;
+bool noSD = false;
+struct DateTime {
+  int year() const { return 2025; }
+  int month() const { return 1; }
+  int day() const { return 15; }
+  int hour() const { return 9; }
+  int minute() const { return 30; }
+};
+struct MockRTC { DateTime now() { return DateTime(); } };
+MockRTC rtc;
+int countVisibleChars(String input) {
+  int count = 0;
+  for (char c : input) if (c > ' ') count++;
+  return count;
+}
+int countWords(String str) {
+  int count = 0;
+  bool inWord = false;
+  for (char c : str) {
+    if (c == ' ') inWord = false;
+    else if (!inWord) {
+      inWord = true;
+      count++;
+    }
+  }
+  return count;
+}
+String readFileToString(MockSD_MMC& fs, const char* path) {
+  std::ifstream f(path);
+  return String(std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()));
+}
+File sysfsOpen(const String& path, const char* mode) {
+  return SD_MMC.open(path, mode);
+}
+
+#include "../src/metaFunc.cpp"
+
 // Include only the core FILEWIZ functions (not display functions)
 #include "../src/FILEWIZ.cpp"
 
@@ -379,6 +424,77 @@ void test_e2e_user_filewiz_flow() {
   std::cout << "=== BLACK-BOX E2E: User FileWiz Flow PASSED! ===" << std::endl;
 }
 
+static String metaFileText() {
+  std::ifstream f(SYS_METADATA_FILE);
+  return String(std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()));
+}
+
+void test_metadata_round_trip() {
+  std::remove(SYS_METADATA_FILE);
+  writeMetadata("/notes/a.txt", "\n  Ideas | plans \\ more\r\nsecond line here");
+  writeMetadata("/b.txt", "short");
+
+  String meta = getFileMetadata("/notes/a.txt");
+  TEST_ASSERT_EQUAL_STRING("/notes/a.txt", getMetadataField(meta, 0).c_str());
+  TEST_ASSERT_EQUAL_STRING("20250115-0930", getMetadataField(meta, 1).c_str());
+  TEST_ASSERT_EQUAL_STRING("41 Bytes", getMetadataField(meta, 2).c_str());
+  TEST_ASSERT_EQUAL_STRING("30 Char", getMetadataField(meta, 3).c_str());
+  TEST_ASSERT_EQUAL_STRING("8 Words", getMetadataField(meta, 4).c_str());
+  TEST_ASSERT_EQUAL_STRING("0", getMetadataField(meta, 5).c_str());
+  TEST_ASSERT_EQUAL_STRING("Ideas | plans \\ more", getMetadataField(meta, 6).c_str());
+  TEST_ASSERT_EQUAL_STRING("", getMetadataField(meta, 7).c_str());
+
+  // Rewriting a note replaces its line
+  writeMetadata("/notes/a.txt", 10, 1700000000, 8, 2, String(std::string(80, 'x')) + "|");
+  meta = getFileMetadata("notes/a.txt");
+  TEST_ASSERT_EQUAL_STRING("10 Bytes", getMetadataField(meta, 2).c_str());
+  TEST_ASSERT_EQUAL_STRING("1700000000", getMetadataField(meta, 5).c_str());
+  TEST_ASSERT_EQUAL_STRING(String(std::string(METADATA_PREVIEW_LEN, 'x')).c_str(), getMetadataField(meta, 6).c_str());
+  String text = metaFileText();
+  TEST_ASSERT_EQUAL(2, (int)std::count(text.begin(), text.end(), '\n'));
+
+  // Renamed and deleted lines
+  renMetadata("/notes/a.txt", "/notes/c.txt");
+  TEST_ASSERT_EQUAL_STRING("", getFileMetadata("/notes/a.txt").c_str());
+  TEST_ASSERT_EQUAL_STRING("10 Bytes", getMetadataField(getFileMetadata("/notes/c.txt"), 2).c_str());
+  deleteMetadata("/b.txt");
+  TEST_ASSERT_EQUAL_STRING("", getFileMetadata("/b.txt").c_str());
+  TEST_ASSERT_EQUAL_STRING("notes/c.txt", getMetadataField(getFileMetadata("/notes/c.txt"), 0).substring(1).c_str());
+  std::remove(SYS_METADATA_FILE);
+}
+
+void test_metadata_old_lines() {
+  std::ofstream(SYS_METADATA_FILE) <<
+    "/old.txt|20240101-1200|12 Bytes|10 Char\n"                // Before word counts
+    "/mid.txt|20240102-1200|20 Bytes|15 Char|3 Words|Hi there\n" // Before FAT mtimes
+    "/new.txt|20240103-1200|30 Bytes|25 Char|5 Words|1700000000|Hello\n";
+
+  String old = getFileMetadata("/old.txt");
+  TEST_ASSERT_EQUAL_STRING("10 Char", getMetadataField(old, 3).c_str());
+  TEST_ASSERT_EQUAL_STRING("", getMetadataField(old, 4).c_str());
+  TEST_ASSERT_EQUAL_STRING("", getMetadataField(old, 6).c_str());
+
+  String mid = getFileMetadata("/mid.txt");
+  TEST_ASSERT_EQUAL_STRING("3 Words", getMetadataField(mid, 4).c_str());
+  TEST_ASSERT_EQUAL_STRING("", getMetadataField(mid, 6).c_str());
+
+  // The file wizard's list, in one pass
+  for (int i = 0; i < MAX_FILES; i++) filesList[i] = "-";
+  filesList[0] = "new.txt";
+  filesList[1] = "missing.txt";
+  filesList[2] = "old.txt";
+  loadFilesListMetadata();
+  TEST_ASSERT_EQUAL_STRING("Hello", getMetadataField(filesListMeta[0], 6).c_str());
+  TEST_ASSERT_EQUAL_STRING("", filesListMeta[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("12 Bytes", getMetadataField(filesListMeta[2], 2).c_str());
+
+  // Saving an old note brings its line up to date, the others stay as they were
+  writeMetadata("/old.txt", "Now longer");
+  TEST_ASSERT_EQUAL_STRING("Now longer", getMetadataField(getFileMetadata("/old.txt"), 6).c_str());
+  TEST_ASSERT_EQUAL_STRING("Hi there", getMetadataField(getFileMetadata("/mid.txt"), 5).c_str());
+  std::remove(SYS_METADATA_FILE);
+}
+
 // Unity test runner
 void setUp(void) {
   // Reset state before each test
@@ -411,6 +527,8 @@ int main(int argc, char **argv) {
   
   // Single comprehensive e2e test
   RUN_TEST(test_e2e_user_filewiz_flow);
+  RUN_TEST(test_metadata_round_trip);
+  RUN_TEST(test_metadata_old_lines);
   
   return UNITY_END();
 } 
\ No newline at end of file
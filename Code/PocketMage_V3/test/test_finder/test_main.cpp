@@ -0,0 +1,235 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include "../nativeStubs.h"
+#include <chrono>
+
+String removeChar(String str, char character) {
+  String result = "";
+  for (char c : str) if (c != character) result += c;
+  return result;
+}
+
+// The card is a list of paths, the walk hands them out in order
+static std::vector<String> cardPaths;
+static int walkReads = 0;
+
+void dirWalkBegin(DirWalk& walk, const String& root) {
+  walk.paths = cardPaths;
+  walk.next = 0;
+}
+
+bool dirWalkNext(DirWalk& walk, String& path, size_t& size, time_t& mtime) {
+  if (walk.next == walk.paths.size()) return false;
+  walkReads++;
+  path = walk.paths[walk.next++];
+  size = 0;
+  mtime = 0;
+  return true;
+}
+
+void dirWalkEnd(DirWalk& walk) {
+  walk.paths.clear();
+  walk.next = 0;
+}
+
+using std::min;                  // Arduino.h provides min()
+#include "../src/finderFunc.cpp"
+
+// HELPERS
+static void setCard(const std::vector<String>& paths) {
+  finderInvalidate();
+  cardPaths = paths;
+  walkReads = 0;
+}
+
+// Top picks in order, joined by spaces
+static String picks() {
+  String result = "";
+  for (int i = 0; i < finderTopCount; i++) {
+    if (i > 0) result += " ";
+    result += finderTop[i];
+  }
+  return result;
+}
+
+static int score(const char* path, const char* query) {
+  return scoreMatch(path, String(query));
+}
+
+// TESTS
+void test_score_prefers_boundaries_and_names() {
+  // Word starts beat scattered letters
+  TEST_ASSERT_GREATER_THAN(score("/salt.txt", "sl"), score("/sun_lamp.txt", "sl"));
+  // Letters in the file name beat letters in a folder
+  TEST_ASSERT_GREATER_THAN(score("/todo/notes.txt", "todo"), score("/notes/xy/todo.txt", "todo"));
+  // Consecutive runs beat gaps
+  TEST_ASSERT_GREATER_THAN(score("/xmxe.txt", "me"), score("/xmeet.txt", "me"));
+  // camelCase humps count as word starts
+  TEST_ASSERT_GREATER_THAN(score("/wordy.txt", "wr"), score("/weeklyReport.txt", "wr"));
+  // Typing the whole name always wins, with or without .txt
+  TEST_ASSERT_GREATER_THAN(score("/a/b/c/d/long/journal_ideas.txt", "ideas"), score("/ideas.txt", "ideas"));
+  TEST_ASSERT_GREATER_THAN(score("/ideas_old.txt", "ideas"), score("/ideas.txt", "ideas"));
+  // Shorter paths win ties
+  TEST_ASSERT_GREATER_THAN(score("/bb/notes.txt", "n"), score("/b/notes.txt", "n"));
+  // Letters out of order don't match
+  TEST_ASSERT_EQUAL(-1, score("/abc.txt", "cba"));
+}
+
+void test_rank_orders_top_picks() {
+  setCard({ "/archive/old_plans.txt", "/plan.txt", "/projects/plant_log.txt", "/pool/lane.txt", "/misc.txt" });
+  TEST_ASSERT_EQUAL(FINDER_TOP, finderFinish("plan"));
+  TEST_ASSERT_EQUAL_STRING("/plan.txt /archive/old_plans.txt /projects/plant_log.txt", picks().c_str());
+
+  // Spaces and case are ignored
+  TEST_ASSERT_EQUAL(FINDER_TOP, finderUpdate("P lan"));
+  TEST_ASSERT_EQUAL_STRING("/plan.txt", finderTop[0].c_str());
+
+  TEST_ASSERT_EQUAL(0, finderUpdate("zzz"));
+}
+
+void test_narrowing_and_widening_reuse_levels() {
+  std::vector<String> paths;
+  for (int i = 0; i < 300; i++) paths.push_back("/notes/day" + String(i) + ".txt");
+  paths.push_back("/todo.txt");
+  paths.push_back("/travel/tokyo.txt");
+  setCard(paths);
+  finderFinish("");
+
+  finderUpdate("t");
+  TEST_ASSERT_EQUAL(1, (int)levels.size());
+  size_t firstLevel = levels[0].size();
+  const FinderHit* firstData = levels[0].data();
+
+  // Narrowing only adds levels, each no bigger than the one before
+  finderUpdate("to");
+  finderUpdate("tok");
+  TEST_ASSERT_EQUAL(3, (int)levels.size());
+  TEST_ASSERT_TRUE(levels[1].size() <= levels[0].size());
+  TEST_ASSERT_EQUAL(1, (int)levels[2].size());
+  TEST_ASSERT_EQUAL_STRING("/travel/tokyo.txt", picks().c_str());
+  TEST_ASSERT_TRUE(firstData == levels[0].data());
+
+  // Backspace pops a level, the first one is never rebuilt
+  finderUpdate("to");
+  TEST_ASSERT_EQUAL(2, (int)levels.size());
+  TEST_ASSERT_EQUAL_STRING("/todo.txt /travel/tokyo.txt", picks().c_str());
+  TEST_ASSERT_TRUE(firstData == levels[0].data());
+  TEST_ASSERT_EQUAL(firstLevel, levels[0].size());
+
+  // Editing the middle of the query keeps the shared prefix
+  finderUpdate("tr");
+  TEST_ASSERT_TRUE(firstData == levels[0].data());
+  TEST_ASSERT_EQUAL_STRING("/travel/tokyo.txt", finderTop[0].c_str());
+
+  finderUpdate("");
+  TEST_ASSERT_EQUAL(0, (int)levels.size());
+  TEST_ASSERT_EQUAL(0, finderTopCount);
+}
+
+void test_loads_in_bounded_steps() {
+  std::vector<String> paths;
+  for (int i = 0; i < FINDER_LOAD_BATCH * 4; i++) paths.push_back("/n/file" + String(i) + ".txt");
+  paths.push_back("/zebra.txt");
+  setCard(paths);
+
+  // The first keystroke reads one batch only
+  TEST_ASSERT_EQUAL(0, finderUpdate("zeb"));
+  TEST_ASSERT_EQUAL(FINDER_LOAD_BATCH, walkReads);
+  TEST_ASSERT_TRUE(finderLoading);
+
+  // Steps from the loop read the rest, the match appears once it is cached
+  int steps = 0;
+  while (finderStep()) steps++;
+  TEST_ASSERT_EQUAL(4, steps);
+  TEST_ASSERT_TRUE(finderLoaded);
+  TEST_ASSERT_EQUAL(1, finderTopCount);
+  TEST_ASSERT_EQUAL_STRING("/zebra.txt", finderTop[0].c_str());
+  TEST_ASSERT_FALSE(finderStep());
+
+  // Levels grown by the steps agree with matching from scratch
+  std::vector<std::vector<FinderHit>> grown = levels;
+  finderUpdate("");
+  finderUpdate("zeb");
+  TEST_ASSERT_EQUAL(grown.size(), levels.size());
+  for (size_t k = 0; k < levels.size(); k++) TEST_ASSERT_EQUAL(grown[k].size(), levels[k].size());
+
+  // No step runs while the card is busy
+  setCard(paths);
+  finderUpdate("z");
+  SDActive = true;
+  TEST_ASSERT_FALSE(finderStep());
+  SDActive = false;
+
+  // Committing a pick finishes the load
+  TEST_ASSERT_EQUAL(1, finderFinish("zebra"));
+  TEST_ASSERT_EQUAL_STRING("/zebra.txt", finderTop[0].c_str());
+}
+
+void test_removed_paths_free_their_slot() {
+  std::vector<String> paths;
+  for (int i = 0; i < FINDER_MAX_FILES; i++) paths.push_back("/f" + String(i) + ".txt");
+  setCard(paths);
+  finderFinish("");
+  TEST_ASSERT_EQUAL(FINDER_MAX_FILES, (int)pathStarts.size());
+
+  for (int i = 0; i < 10; i++) finderRemove("/f" + String(i) + ".txt");
+  TEST_ASSERT_EQUAL(FINDER_MAX_FILES - 10, (int)pathStarts.size());
+
+  // The freed slots take new files, and every path still reads back whole
+  for (int i = 0; i < 10; i++) finderAdd("/new" + String(i) + ".txt");
+  TEST_ASSERT_EQUAL(FINDER_MAX_FILES, (int)pathStarts.size());
+  TEST_ASSERT_EQUAL(1, finderUpdate("new7"));
+  TEST_ASSERT_EQUAL_STRING("/new7.txt", finderTop[0].c_str());
+  TEST_ASSERT_EQUAL(1, finderUpdate("f4095.txt"));
+  TEST_ASSERT_EQUAL_STRING("/f4095.txt", finderTop[0].c_str());
+  TEST_ASSERT_EQUAL(-1, findPath("/f3.txt"));
+}
+
+void test_changes_during_load_restart_it() {
+  setCard({ "/a.txt", "/b.txt" });
+  cardPaths.resize(FINDER_LOAD_BATCH * 2, "/filler.txt");
+  finderUpdate("a");
+  TEST_ASSERT_TRUE(finderLoading);
+
+  // A note saved in a folder the walk already passed
+  cardPaths.push_back("/late.txt");
+  finderAdd("/late.txt");
+  TEST_ASSERT_EQUAL(1, finderFinish("late"));
+  TEST_ASSERT_EQUAL_STRING("/late.txt", finderTop[0].c_str());
+}
+
+void test_keystroke_cost_with_many_files() {
+  std::vector<String> paths;
+  for (int i = 0; i < 4000; i++) {
+    paths.push_back("/folder" + String(i % 40) + "/note_" + String(i) + ".txt");
+  }
+  setCard(paths);
+  finderFinish("");
+
+  const char* typed = "foldernote";
+  auto begin = std::chrono::steady_clock::now();
+  for (int len = 1; len <= (int)strlen(typed); len++) finderUpdate(String(std::string(typed, len)));
+  auto end = std::chrono::steady_clock::now();
+  double perKey = std::chrono::duration<double, std::milli>(end - begin).count() / strlen(typed);
+  printf("Finder: %.3f ms per keystroke over 4000 paths (host)\n", perKey);
+
+  // Later keystrokes only see the survivors of the earlier ones
+  for (size_t k = 1; k < levels.size(); k++) TEST_ASSERT_TRUE(levels[k].size() <= levels[k - 1].size());
+  TEST_ASSERT_EQUAL(FINDER_TOP, finderTopCount);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_score_prefers_boundaries_and_names);
+  RUN_TEST(test_rank_orders_top_picks);
+  RUN_TEST(test_narrowing_and_widening_reuse_levels);
+  RUN_TEST(test_loads_in_bounded_steps);
+  RUN_TEST(test_removed_paths_free_their_slot);
+  RUN_TEST(test_changes_during_load_restart_it);
+  RUN_TEST(test_keystroke_cost_with_many_files);
+  return UNITY_END();
+}
@@ -0,0 +1,370 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include "../nativeStubs.h"
+#include <filesystem>
+#include <map>
+
+namespace stdfs = std::filesystem;
+
+static int clockMs = 0;
+int millis() { return clockMs; }
+void delay(int) {}
+void oledWord(const String&) {}
+
+int prevTimeMillis = 0;
+String filesList[MAX_FILES];
+uint8_t fileIndex = 0;
+
+// The card is a folder. Opens for reading are counted per path.
+#define INDEX_CARD "test_index_card"
+MockSD_MMC SD_MMC;
+static std::map<std::string, int> opens;
+struct CardSD {
+  File open(const String& path, const char* mode) {
+    if (strcmp(mode, "r") == 0) opens[path]++;
+    return SD_MMC.open(INDEX_CARD + path, mode);
+  }
+  bool exists(const String& path) { return stdfs::exists(INDEX_CARD + path); }
+  bool remove(const String& path) { return std::remove((INDEX_CARD + path).c_str()) == 0; }
+  bool rename(const String& from, const String& to) {
+    return std::rename((INDEX_CARD + from).c_str(), (INDEX_CARD + to).c_str()) == 0;
+  }
+  bool mkdir(const String& path) { return stdfs::create_directories(INDEX_CARD + path); }
+};
+static CardSD card;
+
+String readFileQuiet(const String& path) {
+  std::ifstream f(INDEX_CARD + path, std::ios::binary);
+  return String(std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()));
+}
+
+void dirWalkBegin(DirWalk& walk, const String& root) {
+  walk.paths.clear();
+  walk.next = 0;
+  for (auto& entry : stdfs::recursive_directory_iterator(INDEX_CARD + root)) {
+    String path = entry.path().string().substr(strlen(INDEX_CARD));
+    if (entry.is_regular_file() && !path.startsWith("/sys/")) walk.paths.push_back(path);
+  }
+  std::sort(walk.paths.begin(), walk.paths.end());
+}
+
+bool dirWalkNext(DirWalk& walk, String& path, size_t& size, time_t& mtime) {
+  if (walk.next == walk.paths.size()) return false;
+  path = walk.paths[walk.next++];
+  size = stdfs::file_size(INDEX_CARD + path);
+  mtime = 0;
+  return true;
+}
+
+#include "../src/notesFunc.cpp"
+#define SD_MMC card
+#include "../src/indexFunc.cpp"
+#undef SD_MMC
+
+// HELPERS
+static void writeNote(const String& path, const String& text) {
+  std::ofstream f(INDEX_CARD + path, std::ios::trunc | std::ios::binary);
+  f << text;
+}
+
+// Forgets everything in RAM, as after a reboot
+static void reboot() {
+  indexLoaded = false;
+  indexDocs.clear();
+  droppedDocs = 0;
+  nextDocId = 1;
+  compactRunning = false;
+  compactBuckets = 0;
+  rebuildPending = false;
+  rebuildStarted = false;
+  opens.clear();
+}
+
+static void freshCard() {
+  stdfs::remove_all(INDEX_CARD);
+  stdfs::create_directories(INDEX_CARD);
+  reboot();
+}
+
+// Runs background steps with the keyboard idle until there's nothing left
+static int runBackground() {
+  int steps = 0;
+  while ((rebuildPending || compactRunning) && steps < 10000) {
+    clockMs += BACKGROUND_IDLE_MS;
+    indexBackgroundStep();
+    steps++;
+  }
+  return steps;
+}
+
+// Search results as "path:line" joined by spaces, newest first
+static String results(const String& query) {
+  int hits = indexSearch(query);
+  String out = "";
+  for (int i = 0; i < hits; i++) {
+    if (i > 0) out += " ";
+    out += filesList[i] + ":" + String(indexResultLines[i]);
+  }
+  return out;
+}
+
+static size_t indexBytes() {
+  size_t bytes = 0;
+  for (auto& entry : stdfs::directory_iterator(INDEX_CARD SYS_INDEX_DIR)) bytes += entry.file_size();
+  return bytes;
+}
+
+static int tableLines() {
+  std::ifstream f(INDEX_CARD SYS_INDEX_DIR "/files.txt");
+  std::string line;
+  int n = 0;
+  while (std::getline(f, line)) n++;
+  return n;
+}
+
+// TESTS
+void test_index_and_search() {
+  freshCard();
+  indexFile("/fruit.txt", "Apples and pears\nBanana bread\n");
+  indexFile("/veg.txt", "Carrots\nApples are not vegetables");
+  indexFile("notes/mixed.txt", "banana apples");
+  indexFile("/sys/tasks.txt", "apples");
+
+  TEST_ASSERT_EQUAL_STRING("notes/mixed.txt:0 veg.txt:1 fruit.txt:0", results("apples").c_str());
+  TEST_ASSERT_EQUAL_STRING("notes/mixed.txt:0 fruit.txt:1", results("BANANA apples").c_str());
+  TEST_ASSERT_EQUAL_STRING("veg.txt:0", results("carrots").c_str());
+  TEST_ASSERT_EQUAL_STRING("", results("kiwi").c_str());
+
+  // The same after a reboot, from the files alone
+  reboot();
+  TEST_ASSERT_EQUAL_STRING("notes/mixed.txt:0 veg.txt:1 fruit.txt:0", results("apples").c_str());
+}
+
+void test_replace_remove_rename() {
+  freshCard();
+  indexFile("/a.txt", "alpha beta");
+  indexFile("/b.txt", "beta gamma");
+
+  indexFile("/a.txt", "delta\nbeta");
+  TEST_ASSERT_EQUAL_STRING("", results("alpha").c_str());
+  TEST_ASSERT_EQUAL_STRING("a.txt:0", results("delta").c_str());
+  TEST_ASSERT_EQUAL_STRING("a.txt:1 b.txt:0", results("beta").c_str());
+
+  indexRemove("/b.txt");
+  TEST_ASSERT_EQUAL_STRING("a.txt:1", results("beta").c_str());
+  TEST_ASSERT_EQUAL_STRING("", results("gamma").c_str());
+
+  indexRename("/a.txt", "/c.txt");
+  TEST_ASSERT_EQUAL_STRING("c.txt:0", results("delta").c_str());
+
+  // Renamed over another note, which goes
+  indexFile("/d.txt", "delta epsilon");
+  indexRename("/d.txt", "/c.txt");
+  TEST_ASSERT_EQUAL_STRING("c.txt:0", results("delta").c_str());
+  TEST_ASSERT_EQUAL_STRING("", results("beta").c_str());
+
+  // Renamed away from notes, then a note renamed in from outside them
+  indexRename("/c.txt", "/c.bak");
+  TEST_ASSERT_EQUAL_STRING("", results("delta").c_str());
+  writeNote("/e.txt", "zeta");
+  indexRename("/e.md", "/e.txt");
+  TEST_ASSERT_EQUAL_STRING("e.txt:0", results("zeta").c_str());
+
+  reboot();
+  TEST_ASSERT_EQUAL_STRING("", results("delta").c_str());
+  TEST_ASSERT_EQUAL_STRING("e.txt:0", results("zeta").c_str());
+}
+
+void test_table_read_once() {
+  freshCard();
+  indexFile("/a.txt", "one two");
+  reboot();
+  for (int i = 0; i < 5; i++) {
+    indexFile("/a.txt", "one two " + String(i));
+    indexRename("/a.txt", "/b.txt");
+    indexRename("/b.txt", "/a.txt");
+    results("two");
+  }
+  indexRemove("/b.txt");
+  TEST_ASSERT_EQUAL(1, opens[SYS_INDEX_DIR "/files.txt"]);
+
+  // One bucket per query term
+  opens.clear();
+  results("one two");
+  int bucketOpens = 0;
+  for (auto& o : opens) bucketOpens += o.second;
+  TEST_ASSERT_EQUAL(2, bucketOpens);
+}
+
+void test_saves_stay_compact() {
+  freshCard();
+  String text = "";
+  for (int w = 0; w < 200; w++) text += "word" + String(w) + (w % 10 == 9 ? "\n" : " ");
+  indexFile("/other.txt", "unrelated words here");
+  indexFile("/long.txt", text);
+  size_t once = indexBytes();
+
+  // Never more than INDEX_COMPACT_MIN old copies of the note
+  size_t most = 0;
+  int mostLines = 0;
+  for (int i = 0; i < 300; i++) {
+    indexFile("/long.txt", text + "edit" + String(i));
+    runBackground();
+    most = std::max(most, indexBytes());
+    mostLines = std::max(mostLines, tableLines());
+  }
+  std::printf("Index after 1 save: %zu bytes, at most %zu bytes and %d table lines over 300 more\n", once, most, mostLines);
+  TEST_ASSERT_TRUE(most < once * (INDEX_COMPACT_MIN + 2));
+  TEST_ASSERT_TRUE(mostLines <= 2 * INDEX_COMPACT_MIN + 3);
+
+  TEST_ASSERT_EQUAL_STRING("long.txt:19", results("word199").c_str());
+  TEST_ASSERT_EQUAL_STRING("long.txt:20", results("edit299").c_str());
+  TEST_ASSERT_EQUAL_STRING("", results("edit298").c_str());
+  TEST_ASSERT_EQUAL_STRING("other.txt:0", results("unrelated").c_str());
+
+  reboot();
+  TEST_ASSERT_EQUAL_STRING("long.txt:20", results("edit299").c_str());
+  TEST_ASSERT_EQUAL_STRING("other.txt:0", results("unrelated").c_str());
+  TEST_ASSERT_TRUE(droppedDocs < INDEX_COMPACT_MIN);
+}
+
+void test_compaction_interleaved_with_saves() {
+  freshCard();
+  for (int n = 0; n < 8; n++) indexFile("/n" + String(n) + ".txt", "common note" + String(n));
+  for (int i = 0; i < INDEX_COMPACT_MIN; i++) indexFile("/n0.txt", "common again" + String(i));
+  TEST_ASSERT_TRUE(compactRunning);
+
+  // Notes keep changing between compaction steps
+  for (int i = 0; i < 4; i++) {
+    clockMs += BACKGROUND_IDLE_MS;
+    indexBackgroundStep();
+    indexFile("/n1.txt", "common step" + String(i));
+  }
+  runBackground();
+  TEST_ASSERT_EQUAL(8, indexSearch("common"));
+  TEST_ASSERT_EQUAL_STRING("n1.txt:0 n0.txt:0 n7.txt:0", results("common").substring(0, 26).c_str());
+  TEST_ASSERT_EQUAL_STRING("n1.txt:0", results("step3").c_str());
+  TEST_ASSERT_EQUAL_STRING("", results("step2").c_str());
+
+  // Dropped during the run, so still known on reload and swept next time
+  reboot();
+  TEST_ASSERT_EQUAL(8, indexSearch("common"));
+  TEST_ASSERT_EQUAL(4, droppedDocs);
+  indexRequestCompact();
+  runBackground();
+  TEST_ASSERT_EQUAL(0, droppedDocs);
+  TEST_ASSERT_EQUAL(8, indexSearch("common"));
+  TEST_ASSERT_EQUAL(8, tableLines());
+}
+
+void test_legacy_table() {
+  freshCard();
+  stdfs::create_directories(INDEX_CARD SYS_INDEX_DIR);
+  std::ofstream(INDEX_CARD SYS_INDEX_DIR "/files.txt") << "+1|/old.txt\n+2|/older.txt\n-1\n+3|/old.txt\n";
+  String b = String(indexBucket("legacy"));
+  std::ofstream(INDEX_CARD SYS_INDEX_DIR "/b" + b + ".txt") << "legacy|1:0\nlegacy|2:4\nlegacy|3:2\n";
+
+  TEST_ASSERT_EQUAL_STRING("old.txt:2 older.txt:4", results("legacy").c_str());
+
+  // Without bucket masks every bucket is swept
+  indexRequestCompact();
+  TEST_ASSERT_EQUAL(INDEX_BUCKETS + 1, runBackground());
+  TEST_ASSERT_EQUAL_STRING("old.txt:2 older.txt:4", results("legacy").c_str());
+  std::ifstream bucket(INDEX_CARD SYS_INDEX_DIR "/b" + b + ".txt");
+  std::string kept((std::istreambuf_iterator<char>(bucket)), std::istreambuf_iterator<char>());
+  TEST_ASSERT_EQUAL_STRING("legacy|2:4\nlegacy|3:2\n", kept.c_str());
+}
+
+void test_rebuild() {
+  freshCard();
+  writeNote("/x.txt", "rebuilt text");
+  stdfs::create_directories(INDEX_CARD "/sub");
+  writeNote("/sub/y.txt", "more text");
+  indexFile("/gone.txt", "text");
+
+  indexRequestRebuild();
+  runBackground();
+  TEST_ASSERT_EQUAL_STRING("x.txt:0 sub/y.txt:0", results("text").c_str());
+  reboot();
+  TEST_ASSERT_EQUAL_STRING("x.txt:0 sub/y.txt:0", results("text").c_str());
+}
+
+void test_and_across_long_buckets() {
+  freshCard();
+  const char* words[] = { "all", "even", "third", "rare", "fifth" };
+  for (int n = 0; n < 300; n++) {
+    String text = "all\n";
+    text += n % 2 == 0 ? "even\n" : "odd\n";
+    text += n % 3 == 0 ? "third\n" : "x\n";
+    text += n % 97 == 0 ? "rare\n" : "y\n";
+    text += n % 5 == 0 ? "fifth" : "z";
+    indexFile("/n" + String(n) + ".txt", text);
+  }
+  const int every[] = { 1, 2, 3, 97, 5 };
+
+  // Each pair either way round, against the notes that have both words. Word
+  // a is on line a.
+  for (int a = 0; a < 5; a++) {
+    for (int b = 0; b < 5; b++) {
+      if (a == b) continue;
+      String expected = "";
+      int shown = 0;
+      for (int n = 299; n >= 0 && shown < MAX_FILES; n--) {
+        if (n % every[a] != 0 || n % every[b] != 0) continue;
+        if (shown++ > 0) expected += " ";
+        expected += "n" + String(n) + ".txt:" + String(a);
+      }
+      String query = String(words[a]) + " " + words[b];
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.c_str(), results(query).c_str(), query.c_str());
+    }
+  }
+  TEST_ASSERT_EQUAL_STRING("n291.txt:3 n0.txt:3", results("rare all third").c_str());
+  TEST_ASSERT_EQUAL_STRING("", results("rare kiwi").c_str());
+}
+
+void test_interrupted_replace() {
+  freshCard();
+  indexFile("/a.txt", "alpha");
+  indexFile("/b.txt", "beta");
+  String table = INDEX_CARD SYS_INDEX_DIR "/files.txt";
+  String bucket = INDEX_CARD + indexBucketPath(indexBucket("beta"));
+
+  // Power lost after the old table was moved aside, and after a bucket was
+  // replaced but before its old copy was removed
+  stdfs::rename(table.c_str(), (table + ".bak").c_str());
+  stdfs::copy_file(bucket.c_str(), (bucket + ".bak").c_str());
+  reboot();
+  TEST_ASSERT_EQUAL_STRING("a.txt:0", results("alpha").c_str());
+  TEST_ASSERT_EQUAL_STRING("b.txt:0", results("beta").c_str());
+  TEST_ASSERT_TRUE(stdfs::exists(table.c_str()));
+  TEST_ASSERT_FALSE(stdfs::exists((table + ".bak").c_str()));
+  TEST_ASSERT_FALSE(stdfs::exists((bucket + ".bak").c_str()));
+
+  // A finished compaction leaves no copies behind
+  indexFile("/a.txt", "gamma");
+  indexRequestCompact();
+  runBackground();
+  TEST_ASSERT_EQUAL_STRING("a.txt:0", results("gamma").c_str());
+  for (auto& entry : stdfs::directory_iterator(INDEX_CARD SYS_INDEX_DIR)) {
+    TEST_ASSERT_TRUE(entry.path().extension() == ".txt");
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_index_and_search);
+  RUN_TEST(test_replace_remove_rename);
+  RUN_TEST(test_table_read_once);
+  RUN_TEST(test_saves_stay_compact);
+  RUN_TEST(test_compaction_interleaved_with_saves);
+  RUN_TEST(test_legacy_table);
+  RUN_TEST(test_rebuild);
+  RUN_TEST(test_and_across_long_buckets);
+  RUN_TEST(test_interrupted_replace);
+  stdfs::remove_all(INDEX_CARD);
+  return UNITY_END();
+}
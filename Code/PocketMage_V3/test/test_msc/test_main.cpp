@@ -0,0 +1,280 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+
+static int mockMillis = 0;
+int millis() { return mockMillis; }
+
+#include "../src/mscFunc.cpp"
+
+#define MSC_IMAGE "test_msc.img"
+// TinyUSB hands the callbacks CFG_TUD_MSC_EP_BUFSIZE bytes at a time, 4 KB on
+// the ESP32-S3 core
+static const uint32_t REQUEST_SECTORS = 8;
+
+struct Request {
+  bool     write;
+  uint32_t lba;
+  uint32_t count;
+};
+
+// Sector contents that tell writes apart
+static void fillSector(uint8_t* sector, uint32_t lba, uint32_t version) {
+  for (int i = 0; i < 512; i++) sector[i] = (uint8_t)(lba * 31 + version * 7 + i);
+}
+
+// Everything read through the cache matches a plain copy of the disk, and the
+// image does once the cache is flushed
+void test_cache_matches_plain_disk() {
+  std::remove(MSC_IMAGE);
+  const uint32_t sectors = 2048;
+  FileBlockDevice disk(MSC_IMAGE, sectors);
+  TEST_ASSERT_TRUE(disk.ok());
+  std::vector<uint8_t> plain(sectors * 512, 0);
+  mscCacheBegin(&disk);
+
+  uint32_t seed = 2024, version = 0, lba = 0;
+  std::vector<uint8_t> buf(72 * 512);
+  for (int i = 0; i < 5000; i++) {
+    seed = seed * 1103515245 + 12345;
+    // Mostly runs carrying on from the last request, some jumps
+    if ((seed >> 16) % 4 == 0) lba = (seed >> 8) % sectors;
+    uint32_t count = 1 + (seed >> 20) % 16;
+    if ((seed >> 12) % 50 == 0) count = 64 + (seed >> 4) % 8;
+    if (lba + count > sectors) lba = sectors - count;
+
+    if ((seed >> 24) % 3 == 0) {
+      version++;
+      for (uint32_t s = 0; s < count; s++) fillSector(&buf[s * 512], lba + s, version);
+      TEST_ASSERT_TRUE(mscWrite(lba, count, &buf[0]));
+      memcpy(&plain[lba * 512], &buf[0], count * 512);
+    }
+    else {
+      TEST_ASSERT_TRUE(mscRead(lba, count, &buf[0]));
+      TEST_ASSERT_EQUAL_MEMORY(&plain[lba * 512], &buf[0], count * 512);
+    }
+    lba += count;
+    if (lba >= sectors) lba = 0;
+
+    // The host goes quiet now and then
+    mockMillis += (seed >> 8) % 7 == 0 ? MSC_FLUSH_MS : 1;
+    TEST_ASSERT_TRUE(mscFlushIdle());
+  }
+  mscCacheEnd();
+
+  std::vector<uint8_t> image(sectors * 512);
+  TEST_ASSERT_TRUE(disk.read(0, sectors, &image[0]));
+  TEST_ASSERT_EQUAL_MEMORY(&plain[0], &image[0], plain.size());
+  std::remove(MSC_IMAGE);
+}
+
+void test_writes_gathered_until_quiet() {
+  std::remove(MSC_IMAGE);
+  FileBlockDevice disk(MSC_IMAGE, 256);
+  mscCacheBegin(&disk);
+
+  uint8_t buf[REQUEST_SECTORS * 512];
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t s = 0; s < REQUEST_SECTORS; s++) fillSector(buf + s * 512, r * REQUEST_SECTORS + s, 1);
+    TEST_ASSERT_TRUE(mscWrite(r * REQUEST_SECTORS, REQUEST_SECTORS, buf));
+  }
+  TEST_ASSERT_EQUAL(0, disk.commands);
+
+  // Not quiet long enough yet
+  mockMillis += MSC_FLUSH_MS - 1;
+  TEST_ASSERT_TRUE(mscFlushIdle());
+  TEST_ASSERT_EQUAL(0, disk.commands);
+  mockMillis += 1;
+  TEST_ASSERT_TRUE(mscFlushIdle());
+  TEST_ASSERT_EQUAL(1, disk.commands);
+  TEST_ASSERT_EQUAL(4 * REQUEST_SECTORS, disk.sectorsWritten);
+
+  // A write that doesn't carry on sends the gathered ones first
+  TEST_ASSERT_TRUE(mscWrite(100, 1, buf));
+  TEST_ASSERT_TRUE(mscWrite(101, 1, buf));
+  TEST_ASSERT_TRUE(mscWrite(50, 1, buf));
+  TEST_ASSERT_EQUAL(2, disk.commands);
+  mscCacheEnd();
+  TEST_ASSERT_EQUAL(3, disk.commands);
+
+  // Reading past the end of the disk fails, as it does on the card
+  mscCacheBegin(&disk);
+  TEST_ASSERT_FALSE(mscRead(250, 8, buf));
+  mscCacheEnd();
+  std::remove(MSC_IMAGE);
+}
+
+// A card whose writes fail while failWrites is set
+class FailingDisk : public FileBlockDevice {
+public:
+  FailingDisk(const char* path, uint32_t sectors) : FileBlockDevice(path, sectors) {}
+  bool failWrites = false;
+  bool write(uint32_t lba, uint32_t count, const uint8_t* src) {
+    return !failWrites && FileBlockDevice::write(lba, count, src);
+  }
+};
+
+// Gathered writes the host was already told about survive a failed flush,
+// and the host hears about it on its next request
+void test_failed_flush_keeps_writes() {
+  std::remove(MSC_IMAGE);
+  FailingDisk disk(MSC_IMAGE, 256);
+  mscCacheBegin(&disk);
+
+  uint8_t buf[REQUEST_SECTORS * 512];
+  uint8_t back[REQUEST_SECTORS * 512];
+  for (uint32_t s = 0; s < REQUEST_SECTORS; s++) fillSector(buf + s * 512, 16 + s, 1);
+  TEST_ASSERT_TRUE(mscWrite(16, REQUEST_SECTORS, buf));
+
+  disk.failWrites = true;
+  mockMillis += MSC_FLUSH_MS;
+  TEST_ASSERT_FALSE(mscFlushIdle());
+  // Not retried until the host has been quiet again
+  TEST_ASSERT_TRUE(mscFlushIdle());
+
+  // The next request fails once, then reads still work
+  TEST_ASSERT_FALSE(mscRead(100, 1, back));
+  TEST_ASSERT_TRUE(mscRead(100, 1, back));
+
+  // Reading the kept sectors back tries them again and fails itself, once
+  TEST_ASSERT_FALSE(mscRead(16, REQUEST_SECTORS, back));
+  TEST_ASSERT_TRUE(mscRead(100, 1, back));
+
+  // Once the card takes writes again they get there
+  disk.failWrites = false;
+  mockMillis += MSC_FLUSH_MS;
+  TEST_ASSERT_TRUE(mscFlushIdle());
+  TEST_ASSERT_TRUE(mscRead(16, REQUEST_SECTORS, back));
+  TEST_ASSERT_EQUAL_MEMORY(buf, back, sizeof(back));
+  mscCacheEnd();
+
+  std::vector<uint8_t> image(REQUEST_SECTORS * 512);
+  TEST_ASSERT_TRUE(disk.read(16, REQUEST_SECTORS, &image[0]));
+  TEST_ASSERT_EQUAL_MEMORY(buf, &image[0], image.size());
+
+  // A write that has to send the gathered ones first fails with them
+  mscCacheBegin(&disk);
+  TEST_ASSERT_TRUE(mscWrite(40, 1, buf));
+  disk.failWrites = true;
+  TEST_ASSERT_FALSE(mscWrite(80, 1, buf));
+  TEST_ASSERT_FALSE(mscFlush());
+  disk.failWrites = false;
+  TEST_ASSERT_FALSE(mscWrite(80, 1, buf));      // The failed flush above
+  TEST_ASSERT_TRUE(mscWrite(80, 1, buf));
+  mscCacheEnd();
+  TEST_ASSERT_TRUE(disk.read(40, 1, &image[0]));
+  TEST_ASSERT_EQUAL_MEMORY(buf, &image[0], 512);
+  std::remove(MSC_IMAGE);
+}
+
+// BENCHMARK
+// Host access patterns replayed against the file-backed card, the way
+// onRead/onWrite used to do them (a command per sector), a command per
+// request, and through the cache
+
+// Mounting: boot sector, the whole FAT, then directories all over the disk
+static std::vector<Request> fatScan() {
+  std::vector<Request> requests;
+  requests.push_back({ false, 0, 1 });
+  for (uint32_t lba = 32; lba < 32 + 2048; lba += REQUEST_SECTORS) requests.push_back({ false, lba, REQUEST_SECTORS });
+  uint32_t seed = 7;
+  for (int d = 0; d < 200; d++) {
+    seed = seed * 1103515245 + 12345;
+    requests.push_back({ false, 4096 + (seed >> 8) % 60000 / 8 * 8, REQUEST_SECTORS });
+  }
+  return requests;
+}
+
+// A 16 MB file copied on, FAT updated along the way, then read back
+static std::vector<Request> largeCopy() {
+  std::vector<Request> requests;
+  const uint32_t start = 8192, sectors = 16 * 2048;
+  for (uint32_t s = 0; s < sectors; s += REQUEST_SECTORS) {
+    requests.push_back({ true, start + s, REQUEST_SECTORS });
+    if (s % 2048 == 0) requests.push_back({ true, 32 + s / 2048, 1 });
+  }
+  for (uint32_t s = 0; s < sectors; s += REQUEST_SECTORS) requests.push_back({ false, start + s, REQUEST_SECTORS });
+  return requests;
+}
+
+// 500 notes: a cluster or two of text, the directory entry, the FAT
+static std::vector<Request> smallFiles() {
+  std::vector<Request> requests;
+  uint32_t cluster = 50000;
+  for (int f = 0; f < 500; f++) {
+    int clusters = 1 + f % 2;
+    for (int c = 0; c < clusters; c++, cluster += REQUEST_SECTORS) requests.push_back({ true, cluster, REQUEST_SECTORS });
+    requests.push_back({ true, (uint32_t)(4096 + f / 16), 1 });
+    requests.push_back({ true, 32 + cluster / 65536, 1 });
+  }
+  return requests;
+}
+
+enum ReplayMode { PER_SECTOR, PER_REQUEST, CACHED };
+
+struct ReplayResult {
+  uint64_t commands;
+  double   mbPerSecond;
+};
+
+static ReplayResult replay(FileBlockDevice& disk, const std::vector<Request>& requests, ReplayMode mode) {
+  std::vector<uint8_t> buf(REQUEST_SECTORS * 512);
+  uint64_t bytes = 0;
+  disk.resetStats();
+  if (mode == CACHED) mscCacheBegin(&disk);
+
+  for (size_t r = 0; r < requests.size(); r++) {
+    const Request& q = requests[r];
+    for (uint32_t s = 0; s < q.count; s++) fillSector(&buf[s * 512], q.lba + s, r);
+    bool ok = true;
+    if (mode == PER_SECTOR) {
+      for (uint32_t s = 0; s < q.count && ok; s++) {
+        ok = q.write ? disk.write(q.lba + s, 1, &buf[s * 512]) : disk.read(q.lba + s, 1, &buf[s * 512]);
+      }
+    }
+    else if (mode == PER_REQUEST) ok = q.write ? disk.write(q.lba, q.count, &buf[0]) : disk.read(q.lba, q.count, &buf[0]);
+    else ok = q.write ? mscWrite(q.lba, q.count, &buf[0]) : mscRead(q.lba, q.count, &buf[0]);
+    TEST_ASSERT_TRUE(ok);
+    bytes += q.count * 512;
+  }
+
+  if (mode == CACHED) mscCacheEnd();
+  ReplayResult result = { disk.commands, bytes / (double)disk.busyMicros };    // Bytes per us is MB/s
+  return result;
+}
+
+void test_benchmark_patterns() {
+  std::remove(MSC_IMAGE);
+  FileBlockDevice disk(MSC_IMAGE, 80 * 2048);
+  TEST_ASSERT_TRUE(disk.ok());
+
+  const char* names[] = { "FAT scan", "16 MB copy", "500 small files" };
+  std::vector<Request> patterns[] = { fatScan(), largeCopy(), smallFiles() };
+  const char* modes[] = { "per sector", "per request", "cached" };
+  for (int p = 0; p < 3; p++) {
+    ReplayResult results[3];
+    for (int m = 0; m < 3; m++) {
+      results[m] = replay(disk, patterns[p], (ReplayMode)m);
+      printf("%-16s %-12s %8llu commands %6.2f MB/s\n", names[p], modes[m], (unsigned long long)results[m].commands,
+             results[m].mbPerSecond);
+    }
+    // Never more commands than the host sent requests, and fewer than sectors
+    TEST_ASSERT_TRUE(results[CACHED].commands <= results[PER_REQUEST].commands);
+    TEST_ASSERT_TRUE(results[CACHED].commands < results[PER_SECTOR].commands);
+    TEST_ASSERT_TRUE(results[CACHED].mbPerSecond > results[PER_SECTOR].mbPerSecond);
+  }
+  std::remove(MSC_IMAGE);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_cache_matches_plain_disk);
+  RUN_TEST(test_writes_gathered_until_quiet);
+  RUN_TEST(test_failed_flush_keeps_writes);
+  RUN_TEST(test_benchmark_patterns);
+  return UNITY_END();
+}
@@ -0,0 +1,373 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include "../nativeStubs.h"
+#include <filesystem>
+#include <map>
+
+namespace stdfs = std::filesystem;
+
+static int clockMs = 0;
+int millis() { return clockMs; }
+
+int prevTimeMillis = 0;
+String filesList[MAX_FILES];
+String filesListMeta[MAX_FILES];
+
+// The card is a folder, FAT mtimes are kept aside since the host clock would
+// not move between two writes of a test
+#define RECONCILE_CARD "test_reconcile_card"
+MockSD_MMC SD_MMC;
+static std::map<std::string, time_t> mtimes;
+struct CardSD {
+  File open(const String& path, const char* mode = "r") {
+    File file = SD_MMC.open(RECONCILE_CARD + path, mode);
+    file.lastWrite = mtimes[path];
+    return file;
+  }
+  bool exists(const String& path) { return stdfs::exists(RECONCILE_CARD + path); }
+  bool remove(const String& path) { return std::remove((RECONCILE_CARD + path).c_str()) == 0; }
+};
+static CardSD card;
+
+// The system folder lives on the card too
+File sysfsOpen(const String& path, const char* mode) {
+  return SD_MMC.open(RECONCILE_CARD "/sys/" + path, mode);
+}
+
+bool sysfsRename(const String& pathFrom, const String& pathTo) {
+  return std::rename((RECONCILE_CARD "/sys/" + pathFrom).c_str(), (RECONCILE_CARD "/sys/" + pathTo).c_str()) == 0;
+}
+
+String readFileToString(CardSD& fs, const char* path) {
+  std::ifstream f(RECONCILE_CARD + std::string(path), std::ios::binary);
+  return String(std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()));
+}
+
+String readFileQuiet(const String& path) {
+  return readFileToString(card, path.c_str());
+}
+
+void dirWalkBegin(DirWalk& walk, const String& root) {
+  walk.paths.clear();
+  walk.next = 0;
+  for (auto& entry : stdfs::recursive_directory_iterator(RECONCILE_CARD + root)) {
+    String path = entry.path().string().substr(strlen(RECONCILE_CARD));
+    if (entry.is_regular_file() && !path.startsWith("/sys/")) walk.paths.push_back(path);
+  }
+  std::sort(walk.paths.begin(), walk.paths.end());
+}
+
+bool dirWalkNext(DirWalk& walk, String& path, size_t& size, time_t& mtime) {
+  if (walk.next == walk.paths.size()) return false;
+  path = walk.paths[walk.next++];
+  size = stdfs::file_size(RECONCILE_CARD + path);
+  mtime = mtimes[path];
+  return true;
+}
+
+struct DateTime {
+  int year() const { return 2025; }
+  int month() const { return 1; }
+  int day() const { return 15; }
+  int hour() const { return 9; }
+  int minute() const { return 30; }
+};
+struct MockRTC { DateTime now() { return DateTime(); } };
+MockRTC rtc;
+int countVisibleChars(String input) {
+  int count = 0;
+  for (char c : input) if (c > ' ') count++;
+  return count;
+}
+int countWords(String str) {
+  int count = 0;
+  bool inWord = false;
+  for (char c : str) {
+    if (c == ' ') inWord = false;
+    else if (!inWord) {
+      inWord = true;
+      count++;
+    }
+  }
+  return count;
+}
+
+// The index and the finder only record what they were asked to do
+static std::vector<String> indexed;
+static std::vector<String> unindexed;
+static int compactRequests = 0;
+static int finderInvalidations = 0;
+void indexFile(String path, const String& text) { indexed.push_back(path); }
+void indexRemove(String path) { unindexed.push_back(path); }
+void indexRequestCompact() { compactRequests++; }
+void finderInvalidate() { finderInvalidations++; }
+
+#define SD_MMC card
+#include "../src/notesFunc.cpp"
+#include "../src/metaFunc.cpp"
+#include "../src/reconcileFunc.cpp"
+#undef SD_MMC
+
+// HELPERS
+static time_t clockFat = 1000;
+
+// Writes a note as the host would, FAT stamps it with a new mtime
+static void hostWrite(const String& path, const String& text) {
+  stdfs::create_directories(stdfs::path(std::string(RECONCILE_CARD + path)).parent_path());
+  std::ofstream f(RECONCILE_CARD + path, std::ios::trunc | std::ios::binary);
+  f << text;
+  mtimes[path] = clockFat++;
+}
+
+static void hostDelete(const String& path) {
+  stdfs::remove(std::string(RECONCILE_CARD + path));
+  mtimes.erase(path);
+}
+
+static String readCard(const String& path) {
+  std::ifstream f(RECONCILE_CARD + path, std::ios::binary);
+  return String(std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>()));
+}
+
+static void freshCard() {
+  stdfs::remove_all(RECONCILE_CARD);
+  stdfs::create_directories(RECONCILE_CARD "/sys");
+  mtimes.clear();
+  reconcilePhase = RECONCILE_IDLE;
+  releaseStamps();
+  indexed.clear();
+  unindexed.clear();
+  compactRequests = 0;
+  finderInvalidations = 0;
+}
+
+static void clearCalls() {
+  indexed.clear();
+  unindexed.clear();
+  compactRequests = 0;
+}
+
+// One step with the keyboard idle
+static void idleStep() {
+  clockMs += BACKGROUND_IDLE_MS;
+  reconcileStep();
+}
+
+static int runUntil(ReconcilePhase phase) {
+  int steps = 0;
+  while (reconcilePhase != phase && steps < 10000) {
+    idleStep();
+    steps++;
+  }
+  return steps;
+}
+
+// Notes written by the firmware itself have metadata that matches the card
+static void firmwareWrite(const String& path, const String& text) {
+  hostWrite(path, text);
+  writeMetadata(path, text);
+}
+
+static bool metadataHas(const String& path) {
+  return getFileMetadata(path).length() > 0;
+}
+
+static bool contains(const std::vector<String>& list, const String& path) {
+  return std::find(list.begin(), list.end(), path) != list.end();
+}
+
+static void setUpCard() {
+  freshCard();
+  firmwareWrite("/a.txt", "alpha\n");
+  firmwareWrite("/b.txt", "bravo\n");
+  firmwareWrite("/sub/c.txt", "charlie\n");
+}
+
+// TESTS
+void test_unchanged_card_queues_nothing() {
+  setUpCard();
+  reconcileRequest();
+  TEST_ASSERT_EQUAL(1, finderInvalidations);
+  TEST_ASSERT_EQUAL(RECONCILE_LOAD, reconcilePhase);
+
+  runUntil(RECONCILE_DIRTY);
+  TEST_ASSERT_EQUAL_STRING("", readCard(SYS_DIRTY_FILE).c_str());
+  TEST_ASSERT_EQUAL(0, (int)unindexed.size());
+
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL(0, (int)indexed.size());
+  TEST_ASSERT_EQUAL(1, compactRequests);
+  TEST_ASSERT_FALSE(card.exists(SYS_DIRTY_FILE));
+}
+
+void test_host_changes_are_found() {
+  setUpCard();
+  String oldA = getFileMetadata("/a.txt");
+
+  hostWrite("/b.txt", "bravo, edited on the host\n");
+  mtimes["/a.txt"] = clockFat++;            // Touched, same size
+  hostWrite("/d.txt", "delta\n");
+  hostDelete("/sub/c.txt");
+  clearCalls();
+
+  reconcileRequest();
+  runUntil(RECONCILE_DIRTY);
+
+  // Walked in path order, c is gone from metadata and index before any refresh
+  TEST_ASSERT_EQUAL_STRING("/a.txt\n/b.txt\n/d.txt\n", readCard(SYS_DIRTY_FILE).c_str());
+  TEST_ASSERT_FALSE(metadataHas("/sub/c.txt"));
+  TEST_ASSERT_EQUAL(1, (int)unindexed.size());
+  TEST_ASSERT_EQUAL_STRING("/sub/c.txt", unindexed[0].c_str());
+  TEST_ASSERT_EQUAL(0, (int)indexed.size());
+  TEST_ASSERT_EQUAL(0, compactRequests);
+
+  // One note per step, then the index is compacted once
+  idleStep();
+  TEST_ASSERT_EQUAL(1, (int)indexed.size());
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL(3, (int)indexed.size());
+  TEST_ASSERT_TRUE(contains(indexed, "/a.txt"));
+  TEST_ASSERT_TRUE(contains(indexed, "/b.txt"));
+  TEST_ASSERT_TRUE(contains(indexed, "/d.txt"));
+  TEST_ASSERT_EQUAL(1, compactRequests);
+
+  TEST_ASSERT_NOT_EQUAL(0, strcmp(oldA.c_str(), getFileMetadata("/a.txt").c_str()));
+  TEST_ASSERT_EQUAL_STRING("26 Bytes", getMetadataField(getFileMetadata("/b.txt"), 2).c_str());
+  TEST_ASSERT_EQUAL_STRING("delta", getMetadataField(getFileMetadata("/d.txt"), 6).c_str());
+
+  // A second pass finds nothing left to do
+  clearCalls();
+  reconcileRequest();
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL(0, (int)indexed.size());
+  TEST_ASSERT_EQUAL(0, (int)unindexed.size());
+}
+
+void test_waits_for_idle_keyboard() {
+  setUpCard();
+  hostWrite("/b.txt", "bravo again\n");
+  reconcileRequest();
+
+  prevTimeMillis = clockMs;
+  reconcileStep();
+  TEST_ASSERT_EQUAL(RECONCILE_LOAD, reconcilePhase);
+
+  mscEnabled = true;
+  clockMs += BACKGROUND_IDLE_MS;
+  reconcileStep();
+  TEST_ASSERT_EQUAL(RECONCILE_LOAD, reconcilePhase);
+  mscEnabled = false;
+
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_TRUE(contains(indexed, "/b.txt"));
+}
+
+void test_many_notes_resume_across_batches() {
+  freshCard();
+  const int notes = RECONCILE_BATCH * 3 + 5;
+  for (int i = 0; i < notes; i++) {
+    char path[24];
+    snprintf(path, sizeof(path), "/n%03d.txt", i);
+    firmwareWrite(path, String("note ") + String(i) + "\n");
+  }
+  for (int i = 0; i < notes; i += 10) {
+    char path[24];
+    snprintf(path, sizeof(path), "/n%03d.txt", i);
+    hostWrite(path, "changed on the host\n");
+  }
+  hostDelete("/n001.txt");
+  hostDelete("/n099.txt");
+  clearCalls();
+
+  reconcileRequest();
+  int loadSteps = 0;
+  while (reconcilePhase == RECONCILE_LOAD) {
+    idleStep();
+    loadSteps++;
+  }
+  TEST_ASSERT_EQUAL(notes / RECONCILE_BATCH + 1, loadSteps);
+  TEST_ASSERT_EQUAL(notes, (int)stamps.size());
+
+  runUntil(RECONCILE_DIRTY);
+  TEST_ASSERT_EQUAL(2, (int)unindexed.size());
+  TEST_ASSERT_FALSE(metadataHas("/n001.txt"));
+  TEST_ASSERT_FALSE(metadataHas("/n099.txt"));
+  TEST_ASSERT_TRUE(metadataHas("/n002.txt"));
+
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL((notes + 9) / 10, (int)indexed.size());
+  TEST_ASSERT_EQUAL_STRING("changed on the host", getMetadataField(getFileMetadata("/n010.txt"), 6).c_str());
+}
+
+void test_old_metadata_lines() {
+  freshCard();
+  hostWrite("/a.txt", "alpha\n");
+  hostWrite("/b.txt", "bravo\n");
+  std::ofstream meta(RECONCILE_CARD "/sys/" SYS_METADATA_FILE);
+  meta << "/a.txt|20240101-1200|6 Bytes|5 Char\n";
+  meta << "/b.txt|20240101-1200|6 Bytes|5 Char|1 Words\n";
+  meta << "/gone.txt|20240101-1200|6 Bytes|5 Char|1 Words\n";
+  meta.close();
+
+  reconcileRequest();
+  runUntil(RECONCILE_DIRTY);
+  TEST_ASSERT_EQUAL_STRING("/a.txt\n/b.txt\n", readCard(SYS_DIRTY_FILE).c_str());
+  TEST_ASSERT_FALSE(metadataHas("/gone.txt"));
+  TEST_ASSERT_EQUAL(1, (int)unindexed.size());
+
+  // Refreshed lines carry the FAT mtime, so they match from now on
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL_STRING("bravo", getMetadataField(getFileMetadata("/b.txt"), 6).c_str());
+  clearCalls();
+  reconcileRequest();
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL(0, (int)indexed.size());
+}
+
+void test_note_deleted_after_queueing() {
+  setUpCard();
+  hostWrite("/a.txt", "alpha, longer now\n");
+  hostWrite("/b.txt", "bravo, longer now\n");
+  clearCalls();
+
+  reconcileRequest();
+  runUntil(RECONCILE_DIRTY);
+  hostDelete("/a.txt");
+
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_EQUAL(1, (int)indexed.size());
+  TEST_ASSERT_EQUAL_STRING("/b.txt", indexed[0].c_str());
+  TEST_ASSERT_FALSE(card.exists(SYS_DIRTY_FILE));
+}
+
+void test_request_restarts_pass() {
+  setUpCard();
+  hostWrite("/b.txt", "bravo again\n");
+  reconcileRequest();
+  runUntil(RECONCILE_PRUNE);
+
+  // Mounted again halfway, the new pass starts over and finds it all
+  hostWrite("/a.txt", "alpha again\n");
+  reconcileRequest();
+  TEST_ASSERT_EQUAL(0, (int)stamps.size());
+  runUntil(RECONCILE_IDLE);
+  TEST_ASSERT_TRUE(contains(indexed, "/a.txt"));
+  TEST_ASSERT_TRUE(contains(indexed, "/b.txt"));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unchanged_card_queues_nothing);
+  RUN_TEST(test_host_changes_are_found);
+  RUN_TEST(test_waits_for_idle_keyboard);
+  RUN_TEST(test_many_notes_resume_across_batches);
+  RUN_TEST(test_old_metadata_lines);
+  RUN_TEST(test_note_deleted_after_queueing);
+  RUN_TEST(test_request_restarts_pass);
+  stdfs::remove_all(RECONCILE_CARD);
+  return UNITY_END();
+}
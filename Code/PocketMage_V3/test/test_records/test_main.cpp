@@ -0,0 +1,416 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// Every heap allocation in the process goes through here, so a parse can be
+// measured in allocations per row
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const char* RECORDS_TMP = "records_test.txt";
+
+static void writeText(const char* path, const std::string& text) {
+  std::ofstream f(path, std::ios::trunc | std::ios::binary);
+  f << text;
+}
+
+static File openText(const char* path) {
+  return File(std::fstream(path, std::ios::in | std::ios::binary));
+}
+
+// CODEC
+void test_split_fields() {
+  char line[64];
+  FieldSpan fields[RECORD_MAX_FIELDS];
+
+  strcpy(line, "Buy milk|20250120|2|0");
+  TEST_ASSERT_EQUAL(4, splitRecord(line, strlen(line), fields, 4));
+  TEST_ASSERT_EQUAL_STRING("Buy milk", fields[0].ptr);
+  TEST_ASSERT_EQUAL(8, fields[0].len);
+  TEST_ASSERT_EQUAL_STRING("20250120", fields[1].ptr);
+  TEST_ASSERT_EQUAL_STRING("0", fields[3].ptr);
+
+  // Empty fields, including a trailing one
+  strcpy(line, "Holiday|20250117||1440||");
+  TEST_ASSERT_EQUAL(6, splitRecord(line, strlen(line), fields, 6));
+  TEST_ASSERT_EQUAL(0, fields[2].len);
+  TEST_ASSERT_EQUAL_STRING("1440", fields[3].ptr);
+  TEST_ASSERT_EQUAL(0, fields[5].len);
+
+  // Fewer separators than expected: the caller checks the count
+  strcpy(line, "no separators");
+  TEST_ASSERT_EQUAL(1, splitRecord(line, strlen(line), fields, 4));
+  TEST_ASSERT_EQUAL_STRING("no separators", fields[0].ptr);
+}
+
+void test_escape_round_trip() {
+  const char* texts[] = { "plain", "a|b", "|lead and trail|", "C:\\temp\\", "two\nlines", "\\|", "" };
+  char line[128];
+  FieldSpan fields[RECORD_MAX_FIELDS];
+
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    String escaped = escapeField(String(texts[i]));
+    String record = "x|" + escaped + "|y";
+    TEST_ASSERT_TRUE(strchr(escaped.c_str(), '\n') == NULL);
+
+    strcpy(line, record.c_str());
+    TEST_ASSERT_EQUAL(3, splitRecord(line, strlen(line), fields, 3));
+    TEST_ASSERT_EQUAL_STRING("x", fields[0].ptr);
+    TEST_ASSERT_EQUAL_STRING(texts[i], fields[1].ptr);
+    TEST_ASSERT_EQUAL_STRING("y", fields[2].ptr);
+  }
+
+  // Nothing to escape comes back unchanged
+  TEST_ASSERT_EQUAL_STRING("Buy milk", escapeField(String("Buy milk")).c_str());
+  TEST_ASSERT_EQUAL_STRING("a\\|b", escapeField(String("a|b")).c_str());
+}
+
+// Files written before escaping existed still read the same
+void test_legacy_lines() {
+  char line[64];
+  FieldSpan fields[RECORD_MAX_FIELDS];
+
+  // A raw '|' past the last expected field stays in it
+  strcpy(line, "4|20250115143000|cramps | bloating");
+  TEST_ASSERT_EQUAL(3, splitRecord(line, strlen(line), fields, 3));
+  TEST_ASSERT_EQUAL_STRING("cramps | bloating", fields[2].ptr);
+
+  // A lone backslash is kept as typed
+  strcpy(line, "Copy C:\\docs|20250120|0|0");
+  TEST_ASSERT_EQUAL(4, splitRecord(line, strlen(line), fields, 4));
+  TEST_ASSERT_EQUAL_STRING("Copy C:\\docs", fields[0].ptr);
+
+  strcpy(line, "ends in\\");
+  splitRecord(line, strlen(line), fields, 1);
+  TEST_ASSERT_EQUAL_STRING("ends in\\", fields[0].ptr);
+
+  // Without RECORD_HEADER nothing is unescaped, a typed "\n" stays two chars
+  strcpy(line, "see C:\\new\\|20250120|0|0");
+  TEST_ASSERT_EQUAL(4, splitRecord(line, strlen(line), fields, 4, false));
+  TEST_ASSERT_EQUAL_STRING("see C:\\new\\", fields[0].ptr);
+
+  // Re-encoded for a file with the header, the same text comes back
+  std::string upgraded = escapeLegacyLine<String>("see C:\\new\\|x\\\\y|0|0");
+  TEST_ASSERT_EQUAL_STRING("see C:\\\\new\\\\|x\\\\\\\\y|0|0", upgraded.c_str());
+  strcpy(line, upgraded.c_str());
+  TEST_ASSERT_EQUAL(4, splitRecord(line, strlen(line), fields, 4));
+  TEST_ASSERT_EQUAL_STRING("see C:\\new\\", fields[0].ptr);
+  TEST_ASSERT_EQUAL_STRING("x\\\\y", fields[1].ptr);
+}
+
+// The header line decides whether a file's text fields are unescaped
+void test_header() {
+  writeText(RECORDS_TMP, std::string(RECORD_HEADER) + "\nTwo\\nlines|1\n");
+  File file = openText(RECORDS_TMP);
+  TEST_ASSERT_TRUE(hasRecordHeader(file));
+  RecordReader<File> reader(file);
+  TEST_ASSERT_TRUE(reader.next(2));                       // Header skipped
+  TEST_ASSERT_TRUE(reader.escaped);
+  TEST_ASSERT_EQUAL_STRING("Two\nlines", reader.fields[0].ptr);
+  TEST_ASSERT_FALSE(reader.next(2));
+  file.close();
+
+  // Older file: same bytes without the header read back verbatim
+  writeText(RECORDS_TMP, "Two\\nlines|1\n" + std::string(RECORD_HEADER) + "\n");
+  File legacy = openText(RECORDS_TMP);
+  TEST_ASSERT_FALSE(hasRecordHeader(legacy));
+  RecordReader<File> legacyReader(legacy);
+  TEST_ASSERT_TRUE(legacyReader.next(2));
+  TEST_ASSERT_FALSE(legacyReader.escaped);
+  TEST_ASSERT_EQUAL_STRING("Two\\nlines", legacyReader.fields[0].ptr);
+  TEST_ASSERT_TRUE(legacyReader.next(2));                 // Only a first line is a header
+  TEST_ASSERT_EQUAL_STRING(RECORD_HEADER, legacyReader.fields[0].ptr);
+  legacy.close();
+
+  // A longer first line only starts like the header
+  writeText(RECORDS_TMP, std::string(RECORD_HEADER) + "0|x\n");
+  File other = openText(RECORDS_TMP);
+  TEST_ASSERT_FALSE(hasRecordHeader(other));
+  other.close();
+
+  writeText(RECORDS_TMP, "");
+  File empty = openText(RECORDS_TMP);
+  TEST_ASSERT_FALSE(hasRecordHeader(empty));
+  empty.close();
+  std::remove(RECORDS_TMP);
+}
+
+void test_field_decoding() {
+  char line[64];
+  FieldSpan fields[RECORD_MAX_FIELDS];
+  strcpy(line, "42|-5||4x|20250229|20250230|1");
+  TEST_ASSERT_EQUAL(7, splitRecord(line, strlen(line), fields, 7));
+
+  TEST_ASSERT_EQUAL_INT32(42, fieldInt(fields[0], -1));
+  TEST_ASSERT_EQUAL_INT32(-5, fieldInt(fields[1], -1));
+  TEST_ASSERT_EQUAL_INT32(-1, fieldInt(fields[2], -1));
+  TEST_ASSERT_EQUAL_INT32(-1, fieldInt(fields[3], -1));
+  TEST_ASSERT_EQUAL_UINT32(0, fieldDate(fields[4]));          // 2025 isn't a leap year
+  TEST_ASSERT_EQUAL_UINT32(0, fieldDate(fields[5]));
+  TEST_ASSERT_TRUE(fieldEquals(fields[6], "1"));
+  TEST_ASSERT_FALSE(fieldEquals(fields[6], "10"));
+  TEST_ASSERT_FALSE(fieldEquals(fields[0], "4"));
+
+  strcpy(line, "20240229");
+  splitRecord(line, strlen(line), fields, 1);
+  TEST_ASSERT_EQUAL_UINT32(20240229, fieldDate(fields[0]));
+}
+
+// READER
+void test_reader() {
+  std::string longName(300, 'n');
+  std::string text = "  first|1\r\n"
+                     "\n"
+                     "   \r\n"
+                     "second|2\n" +
+                     longName + "|3\n" +
+                     std::string(150, 'w') + "|4\n"
+                     "last|5";
+  writeText(RECORDS_TMP, text);
+
+  File file = openText(RECORDS_TMP);
+  RecordReader<File> reader(file);
+
+  TEST_ASSERT_TRUE(reader.next(2));
+  TEST_ASSERT_EQUAL_STRING("first", reader.fields[0].ptr);
+  TEST_ASSERT_EQUAL_STRING("1", reader.fields[1].ptr);
+  TEST_ASSERT_TRUE(reader.next(2));                       // Blank lines skipped
+  TEST_ASSERT_EQUAL_STRING("second", reader.fields[0].ptr);
+
+  // Lines past RECORD_LINE_MAX come back whole
+  TEST_ASSERT_TRUE(reader.next(2));
+  TEST_ASSERT_EQUAL(302, reader.lineLen);
+  TEST_ASSERT_EQUAL(2, reader.count);
+  TEST_ASSERT_EQUAL(300, reader.fields[0].len);
+  TEST_ASSERT_EQUAL_STRING("3", reader.fields[1].ptr);
+
+  // Lines spanning read chunks come back whole
+  TEST_ASSERT_TRUE(reader.next(2));
+  TEST_ASSERT_EQUAL(150, reader.fields[0].len);
+  TEST_ASSERT_EQUAL_STRING("4", reader.fields[1].ptr);
+
+  TEST_ASSERT_TRUE(reader.next(2));                       // No final newline
+  TEST_ASSERT_EQUAL_STRING("last", reader.fields[0].ptr);
+  TEST_ASSERT_FALSE(reader.next(2));
+  TEST_ASSERT_EQUAL(text.length(), reader.consumed);
+
+  file.close();
+  std::remove(RECORDS_TMP);
+}
+
+// A record much longer than RECORD_LINE_MAX survives a line by line rewrite
+void test_long_line_rewrite() {
+  std::string note;
+  for (int i = 0; i < 700; i++) note += "word" + std::to_string(i) + (i % 50 == 49 ? "\\n" : " ");
+  std::string text = std::string(RECORD_HEADER) + "\nshort|1\n6|20250114211500|" + note + "\nafter|2\n";
+  writeText(RECORDS_TMP, text);
+
+  File file = openText(RECORDS_TMP);
+  RecordReader<File> reader(file);
+  std::string rewritten = std::string(RECORD_HEADER) + "\n";
+  while (reader.nextLine()) rewritten += std::string(reader.line, reader.lineLen) + "\n";
+  file.close();
+  TEST_ASSERT_TRUE(text == rewritten);
+
+  // Fields of the long line, and the short one after it
+  file = openText(RECORDS_TMP);
+  RecordReader<File> fieldReader(file);
+  TEST_ASSERT_TRUE(fieldReader.next(3));
+  TEST_ASSERT_TRUE(fieldReader.next(3));
+  TEST_ASSERT_TRUE(note.length() > 8 * RECORD_LINE_MAX);
+  TEST_ASSERT_EQUAL(note.length() - 14, fieldReader.fields[2].len);   // 14 "\\n" became '\n'
+  TEST_ASSERT_EQUAL('\n', fieldReader.fields[2].ptr[strlen("word0 ") * 10 + strlen("word10 ") * 39 + 6]);
+  TEST_ASSERT_TRUE(fieldReader.next(3));
+  TEST_ASSERT_EQUAL_STRING("after", fieldReader.fields[0].ptr);
+  TEST_ASSERT_TRUE(fieldReader.line == fieldReader.lineBuf);
+  file.close();
+  std::remove(RECORDS_TMP);
+}
+
+// BENCHMARKS
+// The parsers each app used before the codec, kept here to compare against
+static void legacyParseTasks(File& file, std::vector<std::vector<String>>& rows) {
+  while (file.available()) {
+    String line = file.readStringUntil('\n');
+    line.trim();
+    if (line.length() == 0) continue;
+
+    int delimiterPos1 = line.indexOf('|');
+    int delimiterPos2 = line.indexOf('|', delimiterPos1 + 1);
+    int delimiterPos3 = line.indexOf('|', delimiterPos2 + 1);
+    if (delimiterPos1 == -1 || delimiterPos2 == -1 || delimiterPos3 == -1) continue;
+
+    String taskName = line.substring(0, delimiterPos1);
+    String dueDate = line.substring(delimiterPos1 + 1, delimiterPos2);
+    String priority = line.substring(delimiterPos2 + 1, delimiterPos3);
+    String completed = line.substring(delimiterPos3 + 1);
+
+    rows.push_back({taskName, dueDate, priority, completed});
+  }
+}
+
+static void legacyParseEvents(File& file, std::vector<std::vector<String>>& rows) {
+  while (file.available()) {
+    String line = file.readStringUntil('\n');
+    line.trim();
+    if (line.length() == 0) continue;
+
+    uint8_t delimiterPos1 = line.indexOf('|');
+    uint8_t delimiterPos2 = line.indexOf('|', delimiterPos1 + 1);
+    uint8_t delimiterPos3 = line.indexOf('|', delimiterPos2 + 1);
+    uint8_t delimiterPos4 = line.indexOf('|', delimiterPos3 + 1);
+    uint8_t delimiterPos5 = line.indexOf('|', delimiterPos4 + 1);
+
+    String eventName = line.substring(0, delimiterPos1);
+    String startDate = line.substring(delimiterPos1 + 1, delimiterPos2);
+    String startTime = line.substring(delimiterPos2 + 1, delimiterPos3);
+    String duration  = line.substring(delimiterPos3 + 1, delimiterPos4);
+    String repeat    = line.substring(delimiterPos4 + 1, delimiterPos5);
+    String note      = line.substring(delimiterPos5 + 1);
+
+    rows.push_back({eventName, startDate, startTime, duration, repeat, note});
+  }
+}
+
+// Same layout as CalendarEvent in CALENDAR.cpp
+struct BenchEvent {
+  String   name;
+  uint32_t date;
+  int16_t  time;
+  int32_t  duration;
+  String   repeat;
+  String   note;
+};
+
+static void codecParseTasks(File& file, std::vector<Task>& rows) {
+  RecordReader<File> reader(file);
+  while (reader.next(4)) {
+    if (reader.count < 4) continue;
+    Task task;
+    task.name      = reader.fields[0].ptr;
+    task.due       = fieldDate(reader.fields[1]);
+    task.priority  = (uint8_t)fieldInt(reader.fields[2], 0);
+    task.completed = fieldEquals(reader.fields[3], "1");
+    rows.push_back(std::move(task));
+  }
+}
+
+static void codecParseEvents(File& file, std::vector<BenchEvent>& rows) {
+  RecordReader<File> reader(file);
+  while (reader.next(6)) {
+    if (reader.count < 6) continue;
+    BenchEvent event;
+    event.name     = reader.fields[0].ptr;
+    event.date     = fieldDate(reader.fields[1]);
+    event.time     = (int16_t)fieldInt(reader.fields[2], -1);
+    event.duration = fieldInt(reader.fields[3], -1);
+    event.repeat   = reader.fields[4].ptr;
+    event.note     = reader.fields[5].ptr;
+    rows.push_back(std::move(event));
+  }
+}
+
+struct BenchResult {
+  double allocsPerRow;
+  double rowsPerSecond;
+};
+
+// Parses the file `passes` times, rows reserved up front so only the parser is counted
+template <typename Row, typename Parse>
+static BenchResult runBench(const char* label, size_t rowCount, int passes, Parse parse) {
+  std::vector<Row> rows;
+  rows.reserve(rowCount);
+  size_t allocs = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < passes; pass++) {
+    rows.clear();
+    File file = openText(RECORDS_TMP);
+    size_t before = allocations;
+    parse(file, rows);
+    allocs += allocations - before;
+    file.close();
+    TEST_ASSERT_EQUAL(rowCount, rows.size());
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  BenchResult result;
+  result.allocsPerRow  = (double)allocs / (rowCount * passes);
+  result.rowsPerSecond = rowCount * passes / seconds;
+  std::cout << label << ": " << result.allocsPerRow << " allocations/row, "
+            << (long)result.rowsPerSecond << " rows/s" << std::endl;
+  return result;
+}
+
+// Realistic mix of short names (fit in a small-string buffer) and long ones
+static const char* benchNames[] = {
+  "Buy milk", "Renew passport at the post office", "Call Sam", "Book flights for the conference",
+  "Water plants", "Finish quarterly report draft",
+};
+static const char* benchRepeats[] = { "", "DAILY", "WEEKLY MoWeFr", "MONTHLY 2We", "", "YEARLY APR22" };
+
+void test_benchmark_tasks() {
+  const size_t rowCount = 4000;
+  std::string text;
+  for (size_t i = 0; i < rowCount; i++) {
+    char row[96];
+    snprintf(row, sizeof(row), "%s|2025%02d%02d|%d|%d\n", benchNames[i % 6], (int)(i % 12 + 1), (int)(i % 28 + 1), (int)(i % 4), (int)(i % 2));
+    text += row;
+  }
+  writeText(RECORDS_TMP, text);
+
+  BenchResult legacy = runBench<std::vector<String>>("tasks legacy", rowCount, 5, legacyParseTasks);
+  BenchResult codec  = runBench<Task>("tasks codec ", rowCount, 5, codecParseTasks);
+  TEST_ASSERT_TRUE(codec.allocsPerRow < legacy.allocsPerRow);
+  // Only names past the small-string buffer allocate
+  TEST_ASSERT_TRUE(codec.allocsPerRow <= 0.5);
+
+  std::remove(RECORDS_TMP);
+}
+
+void test_benchmark_events() {
+  const size_t rowCount = 4000;
+  std::string text;
+  for (size_t i = 0; i < rowCount; i++) {
+    char row[160];
+    snprintf(row, sizeof(row), "%s|2025%02d%02d|%02d%02d|%d|%s|%s\n", benchNames[i % 6], (int)(i % 12 + 1), (int)(i % 28 + 1),
+             (int)(8 + i % 10), (int)(i % 4 * 15), (int)(15 + i % 4 * 15), benchRepeats[i % 6],
+             i % 3 ? "" : "Bring the printed agenda and notes");
+    text += row;
+  }
+  writeText(RECORDS_TMP, text);
+
+  BenchResult legacy = runBench<std::vector<String>>("events legacy", rowCount, 5, legacyParseEvents);
+  BenchResult codec  = runBench<BenchEvent>("events codec ", rowCount, 5, codecParseEvents);
+  TEST_ASSERT_TRUE(codec.allocsPerRow < legacy.allocsPerRow);
+
+  std::remove(RECORDS_TMP);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_split_fields);
+  RUN_TEST(test_escape_round_trip);
+  RUN_TEST(test_legacy_lines);
+  RUN_TEST(test_field_decoding);
+  RUN_TEST(test_reader);
+  RUN_TEST(test_header);
+  RUN_TEST(test_long_line_rewrite);
+  RUN_TEST(test_benchmark_tasks);
+  RUN_TEST(test_benchmark_events);
+  return UNITY_END();
+}
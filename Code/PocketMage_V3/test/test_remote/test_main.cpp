@@ -0,0 +1,382 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include "../nativeStubs.h"
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <stdlib.h>
+#define PMREMOTE_NO_MAIN
+#include "../tools/pmremote/pmremote.cpp"
+
+int millis() {
+  using namespace std::chrono;
+  return (int)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+unsigned long micros() {
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+String editingFile = "";
+AppState CurrentAppState = HOME;
+void reconcileRequest() {}
+#include "../src/notesFunc.cpp"
+
+// syncFunc.cpp never gets this far without a card
+struct NoCard {
+  File open(const String& path, const char* mode) { return File(); }
+  bool exists(const String& path) { return false; }
+  bool remove(const String& path) { return false; }
+  bool rename(const String& from, const String& to) { return false; }
+};
+static NoCard card;
+#define SD_MMC card
+#include "../src/syncFunc.cpp"
+#undef SD_MMC
+#include "../src/remoteFunc.cpp"
+
+// A pty pair like test_sync, with loop()'s share of the work: the keys an app
+// takes, then syncPoll()
+struct SimDevice {
+  int master = -1;
+  int slave = -1;
+  FdSyncPort* port = nullptr;
+  std::atomic<bool> running;
+  std::thread loop;
+  std::mutex lock;
+  std::vector<int> keys;     // Taken by the "apps"
+
+  bool start() {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return false;
+    slave = FdSyncPort::openTty(ptsname(master));
+    if (slave < 0) return false;
+    port = new FdSyncPort(master);
+    syncBegin(port);
+    running = true;
+    loop = std::thread([this]() {
+      while (running) {
+        remoteLoopBegin();
+        int key = remoteTakeKey();
+        if (key >= 0) {
+          std::lock_guard<std::mutex> guard(lock);
+          keys.push_back(key);
+          remoteKeyTaken();
+        }
+        syncPoll();
+        remoteLoopEnd();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    return true;
+  }
+
+  std::vector<int> taken() {
+    std::lock_guard<std::mutex> guard(lock);
+    return keys;
+  }
+
+  void stop() {
+    running = false;
+    if (loop.joinable()) loop.join();
+    close(slave);
+    close(master);
+    delete port;
+  }
+};
+
+// Waits for the device to take count keys
+static std::vector<int> waitForKeys(SimDevice& device, size_t count) {
+  for (int i = 0; i < 500 && device.taken().size() < count; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  return device.taken();
+}
+
+// A full e-ink frame as GxEPD2 writes it, 1 = white, with a black box and
+// noise that doesn't pack, so the snapshot takes several replies
+static std::vector<uint8_t> einkFrameWithBox() {
+  std::vector<uint8_t> bitmap(EINK_PANEL_WIDTH * EINK_PANEL_HEIGHT / 8, 0xFF);
+  for (int y = 10; y < 20; y++) {
+    for (int x = 16; x < 40; x++) bitmap[y * (EINK_PANEL_WIDTH / 8) + x / 8] &= ~(0x80 >> (x % 8));
+  }
+  uint32_t seed = 7;
+  for (int y = 100; y < 200; y++) {
+    for (int b = 0; b < EINK_PANEL_WIDTH / 8; b++) {
+      seed = seed * 1103515245 + 12345;
+      bitmap[y * (EINK_PANEL_WIDTH / 8) + b] = (uint8_t)(seed >> 16);
+    }
+  }
+  return bitmap;
+}
+
+void test_pack_round_trip() {
+  std::vector<std::vector<uint8_t>> cases;
+  cases.push_back(std::vector<uint8_t>(9600, 0));
+  cases.push_back(einkFrameWithBox());
+  std::vector<uint8_t> mixed;
+  for (int i = 0; i < 1000; i++) mixed.push_back(i % 7 < 3 ? 0xAA : (uint8_t)(i * 31));
+  cases.push_back(mixed);
+  cases.push_back(std::vector<uint8_t>(1, 0x42));
+
+  for (const std::vector<uint8_t>& in : cases) {
+    std::vector<uint8_t> packed(in.size() + in.size() / 128 + 1);
+    size_t len = remotePack(in.data(), in.size(), packed.data());
+    TEST_ASSERT_TRUE(len <= packed.size());
+    std::vector<uint8_t> out(in.size());
+    TEST_ASSERT_TRUE(remoteUnpack(packed.data(), len, out.data(), out.size()));
+    TEST_ASSERT_TRUE(out == in);
+    // Cut short, or one byte too many expected
+    TEST_ASSERT_FALSE(remoteUnpack(packed.data(), len - 1, out.data(), out.size()));
+    out.push_back(0);
+    TEST_ASSERT_FALSE(remoteUnpack(packed.data(), len, out.data(), out.size()));
+  }
+
+  // A blank e-ink frame is a few bytes
+  uint8_t blank[9600] = { 0 };
+  uint8_t packed[9600 + 9600 / 128 + 1];
+  TEST_ASSERT_TRUE(remotePack(blank, sizeof(blank), packed) < 160);
+}
+
+void test_keys_arrive_in_order() {
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  RemoteClient client(host, 500);
+
+  TEST_ASSERT_TRUE(client.keys(REMOTE_CHARS, "hi\r"));
+  TEST_ASSERT_TRUE(client.keys(REMOTE_MATRIX, std::string("\x00\x13", 2)));
+  std::vector<int> keys = waitForKeys(device, 5);
+  TEST_ASSERT_EQUAL(5, keys.size());
+  TEST_ASSERT_EQUAL('h', keys[0]);
+  TEST_ASSERT_EQUAL('i', keys[1]);
+  TEST_ASSERT_EQUAL(13, keys[2]);
+  TEST_ASSERT_EQUAL(0x100 | 0, keys[3]);
+  TEST_ASSERT_EQUAL(0x100 | 19, keys[4]);
+
+  // More than the queue holds waits for the apps to catch up
+  std::string many;
+  for (int i = 0; i < 3 * REMOTE_KEY_QUEUE; i++) many += (char)('a' + i % 26);
+  TEST_ASSERT_TRUE(client.keys(REMOTE_CHARS, many));
+  keys = waitForKeys(device, 5 + many.size());
+  TEST_ASSERT_EQUAL(5 + many.size(), keys.size());
+  for (size_t i = 0; i < many.size(); i++) TEST_ASSERT_EQUAL(many[i], keys[5 + i]);
+
+  // Out of range matrix keys are dropped
+  TEST_ASSERT_TRUE(client.keys(REMOTE_MATRIX, std::string("\x28", 1)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  TEST_ASSERT_EQUAL(5 + many.size(), device.taken().size());
+
+  device.stop();
+}
+
+void test_snapshots() {
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  RemoteClient client(host, 500);
+
+  // A full frame, then a 16x8 window of it blacked out at panel (64, 40)
+  std::vector<uint8_t> frame = einkFrameWithBox();
+  remotePanelWrite(frame.data(), 0, 0, EINK_PANEL_WIDTH, EINK_PANEL_HEIGHT, 0, 0, EINK_PANEL_WIDTH, EINK_PANEL_HEIGHT, false, false);
+  remoteEinkRefreshed(1000, false);
+  std::vector<uint8_t> black(frame.size(), 0x00);
+  remotePanelWrite(black.data(), 64, 40, EINK_PANEL_WIDTH, EINK_PANEL_HEIGHT, 64, 40, 16, 8, false, false);
+  remoteEinkRefreshed(300, true);
+
+  RemoteSnap snap;
+  TEST_ASSERT_TRUE(client.snap(REMOTE_EINK, snap));
+  TEST_ASSERT_EQUAL(EINK_PANEL_WIDTH, snap.width);
+  TEST_ASSERT_EQUAL(EINK_PANEL_HEIGHT, snap.height);
+  TEST_ASSERT_EQUAL(3, snap.rotation);
+  TEST_ASSERT_EQUAL(einkFrame, snap.frame);
+  TEST_ASSERT_TRUE(snap.ink(16, 10));
+  TEST_ASSERT_TRUE(snap.ink(39, 19));
+  TEST_ASSERT_FALSE(snap.ink(40, 19));
+  TEST_ASSERT_FALSE(snap.ink(16, 20));
+  TEST_ASSERT_TRUE(snap.ink(64, 40));
+  TEST_ASSERT_TRUE(snap.ink(79, 47));
+  TEST_ASSERT_FALSE(snap.ink(80, 47));
+  TEST_ASSERT_FALSE(snap.ink(200, 300));
+  int wrong = 0;
+  for (int y = 100; y < 200; y++) {
+    for (int x = 0; x < EINK_PANEL_WIDTH; x++) {
+      bool white = frame[y * (EINK_PANEL_WIDTH / 8) + x / 8] & (0x80 >> (x % 8));
+      if (snap.ink(x, y) == white) wrong++;
+    }
+  }
+  TEST_ASSERT_EQUAL(0, wrong);
+
+  // Turned the way the firmware draws: panel (x, y) is at (319 - y, x)
+  int width, height;
+  std::vector<uint8_t> view = remoteView(snap, width, height);
+  TEST_ASSERT_EQUAL(320, width);
+  TEST_ASSERT_EQUAL(240, height);
+  TEST_ASSERT_TRUE(view[16 * (width / 8) + (319 - 10) / 8] & (0x80 >> ((319 - 10) % 8)));
+
+  // The OLED as u8g2 sends it: pages of 8 rows, LSB on top
+  uint8_t tiles[OLED_WIDTH * OLED_HEIGHT / 8] = { 0 };
+  tiles[(9 / 8) * OLED_WIDTH + 5] |= 1 << (9 % 8);
+  tiles[(31 / 8) * OLED_WIDTH + 255] |= 1 << (31 % 8);
+  remoteOledSent(tiles, 800);
+  TEST_ASSERT_TRUE(client.snap(REMOTE_OLED, snap));
+  TEST_ASSERT_EQUAL(OLED_WIDTH, snap.width);
+  TEST_ASSERT_EQUAL(OLED_HEIGHT, snap.height);
+  TEST_ASSERT_TRUE(snap.ink(5, 9));
+  TEST_ASSERT_TRUE(snap.ink(255, 31));
+  TEST_ASSERT_FALSE(snap.ink(5, 8));
+  view = remoteView(snap, width, height);
+  TEST_ASSERT_EQUAL(256, width);
+  TEST_ASSERT_TRUE(view[(31 - 9) * 32 + (255 - 5) / 8] & (0x80 >> ((255 - 5) % 8)));
+
+  // Paging on from a picture of another screen
+  std::vector<uint8_t> in;
+  uint8_t out[5] = { REMOTE_EINK, 1, 0, 0, 0 };
+  SyncLink link(host, 500);
+  TEST_ASSERT_FALSE(link.request(REMOTE_SNAP, out, sizeof(out), &in));
+  TEST_ASSERT_EQUAL_STRING("bad offset", link.error.c_str());
+
+  device.stop();
+}
+
+void test_stats() {
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  RemoteClient client(host, 500);
+  std::vector<uint32_t> stats;
+  TEST_ASSERT_TRUE(client.stats(true, stats));
+  TEST_ASSERT_EQUAL(REMOTE_STAT_COUNT, stats.size());
+
+  TEST_ASSERT_TRUE(client.keys(REMOTE_CHARS, "x"));
+  waitForKeys(device, 1);
+  uint8_t tiles[OLED_WIDTH * OLED_HEIGHT / 8] = { 0 };
+  remoteOledSent(tiles, 500);
+  remoteOledSent(tiles, 700);
+  remoteEinkRefreshed(400000, false);
+  remoteEinkRefreshed(90000, true);
+
+  CurrentAppState = TASKS;
+  TEST_ASSERT_TRUE(client.stats(true, stats));
+  CurrentAppState = HOME;
+  TEST_ASSERT_EQUAL(TASKS, stats[REMOTE_APP]);
+  TEST_ASSERT_EQUAL(0, stats[REMOTE_KEYS_WAITING]);
+  TEST_ASSERT_EQUAL(1, stats[REMOTE_KEYS_TAKEN]);
+  TEST_ASSERT_TRUE(stats[REMOTE_LOOPS] > 0);
+  TEST_ASSERT_TRUE(stats[REMOTE_LOOP_MAX_US] <= stats[REMOTE_LOOP_US]);
+  TEST_ASSERT_EQUAL(2, stats[REMOTE_OLED_FRAMES]);
+  TEST_ASSERT_EQUAL(1200, stats[REMOTE_OLED_US]);
+  TEST_ASSERT_EQUAL(2, stats[REMOTE_EINK_REFRESHES]);
+  TEST_ASSERT_EQUAL(1, stats[REMOTE_EINK_PARTIAL]);
+  TEST_ASSERT_EQUAL(490000, stats[REMOTE_EINK_US]);
+  TEST_ASSERT_EQUAL(400000, stats[REMOTE_EINK_MAX_US]);
+  TEST_ASSERT_TRUE(stats[REMOTE_KEY_TO_OLED_US] > 0);
+  TEST_ASSERT_TRUE(stats[REMOTE_KEY_TO_EINK_US] >= stats[REMOTE_KEY_TO_OLED_US]);
+
+  // Restarted by the read
+  TEST_ASSERT_TRUE(client.stats(false, stats));
+  TEST_ASSERT_EQUAL(0, stats[REMOTE_KEYS_TAKEN]);
+  TEST_ASSERT_EQUAL(0, stats[REMOTE_EINK_REFRESHES]);
+
+  device.stop();
+}
+
+void test_script() {
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  RemoteClient client(host, 500);
+  size_t before = device.taken().size();
+
+  std::istringstream script(
+    "# open the tasks app\n"
+    "type tasks\\r\n"
+    "key 20 21\n"
+    "wait 20\n"
+    "snap oled test_remote_oled.pbm\n"
+    "stats reset\n");
+  std::ostringstream out;
+  TEST_ASSERT_TRUE(runScript(client, script, out));
+  std::vector<int> keys = device.taken();
+  TEST_ASSERT_EQUAL(before + 8, keys.size());
+  TEST_ASSERT_EQUAL(13, keys[before + 5]);
+  TEST_ASSERT_EQUAL(0x100 | 21, keys[before + 7]);
+  TEST_ASSERT_TRUE(out.str().find("keys_taken 8\n") != std::string::npos);
+
+  std::ifstream pbm("test_remote_oled.pbm", std::ios::binary);
+  std::string header;
+  std::getline(pbm, header);
+  TEST_ASSERT_EQUAL_STRING("P4", header.c_str());
+  std::getline(pbm, header);
+  TEST_ASSERT_EQUAL_STRING("256 32", header.c_str());
+  std::string rows((std::istreambuf_iterator<char>(pbm)), std::istreambuf_iterator<char>());
+  TEST_ASSERT_EQUAL(256 * 32 / 8, rows.size());
+  std::remove("test_remote_oled.pbm");
+
+  // Mistakes stop the script
+  std::istringstream bad("type ok\nkey 99\ntype never\n");
+  TEST_ASSERT_FALSE(runScript(client, bad, out));
+  TEST_ASSERT_EQUAL(before + 10, waitForKeys(device, before + 10).size());
+
+  device.stop();
+}
+
+// A frame of its own, to pick the seq. The reply's type, 0 without one.
+static uint8_t rawRequest(FdSyncPort& host, uint8_t type, uint8_t seq, const std::string& payload) {
+  uint8_t frame[SYNC_FRAME_MAX];
+  host.write(frame, syncFrame(type, seq, (const uint8_t*)payload.data(), (uint16_t)payload.size(), frame));
+  SyncParser parser;
+  while (host.wait(500)) {
+    uint8_t buf[256];
+    size_t n = host.read(buf, sizeof(buf));
+    for (size_t i = 0; i < n; i++) {
+      if (parser.feed(buf[i]) && parser.seq() == seq) return parser.type();
+    }
+  }
+  return 0;
+}
+
+// Two runs of a one line script, counting seq from the same place. HELLO
+// keeps the second one's keys from being taken for a resend of the first's.
+void test_runs_start_fresh() {
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  size_t before = device.taken().size();
+  std::string abc = std::string(1, (char)REMOTE_CHARS) + "abc";
+
+  TEST_ASSERT_EQUAL(REMOTE_HELLO | SYNC_REPLY, rawRequest(host, REMOTE_HELLO, 6, ""));
+  TEST_ASSERT_EQUAL(REMOTE_KEYS | SYNC_REPLY, rawRequest(host, REMOTE_KEYS, 7, abc));
+  TEST_ASSERT_EQUAL(REMOTE_KEYS | SYNC_REPLY, rawRequest(host, REMOTE_KEYS, 7, abc));    // A resend
+  TEST_ASSERT_EQUAL(before + 3, waitForKeys(device, before + 3).size());
+
+  TEST_ASSERT_EQUAL(REMOTE_HELLO | SYNC_REPLY, rawRequest(host, REMOTE_HELLO, 6, ""));
+  TEST_ASSERT_EQUAL(REMOTE_KEYS | SYNC_REPLY, rawRequest(host, REMOTE_KEYS, 7, abc));
+  TEST_ASSERT_EQUAL(before + 6, waitForKeys(device, before + 6).size());
+
+  // Every script run opens with one
+  RemoteClient client(host, 500);
+  std::istringstream script("type abc\n");
+  std::ostringstream out;
+  TEST_ASSERT_TRUE(runScript(client, script, out));
+  TEST_ASSERT_EQUAL(before + 9, waitForKeys(device, before + 9).size());
+
+  device.stop();
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  noSD = true;   // Remote control works without a card
+  UNITY_BEGIN();
+  RUN_TEST(test_pack_round_trip);
+  RUN_TEST(test_keys_arrive_in_order);
+  RUN_TEST(test_snapshots);
+  RUN_TEST(test_stats);
+  RUN_TEST(test_script);
+  RUN_TEST(test_runs_start_fresh);
+  return UNITY_END();
+}
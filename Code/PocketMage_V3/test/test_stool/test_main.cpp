@@ -1,9 +1,10 @@
 #include <unity.h>
 #define NATIVE_TEST
 #include "../include/globals.h"
+#include <sstream>
 
 // Define all global variables required by STOOL.cpp
-std::vector<std::vector<String>> tasks;
+std::vector<Task> tasks;
 bool SAVE_POWER = false;
 int POWER_SAVE_FREQ = 40;
 bool SDActive = false;
@@ -24,7 +25,7 @@ String currentLine = "";
 String currentWord = "";
 
 // STOOL-specific variables - declare as extern to use definitions from STOOL.cpp
-extern std::vector<std::vector<String>> stoolEntries;
+extern std::vector<StoolEntry> stoolEntries;
 extern StoolState CurrentStoolState;
 extern uint8_t selectedStoolEntry;
 extern String newStoolNote;
@@ -89,6 +90,53 @@ void appendToFile(const String& path, const String& content) {
   f.close();
 }
 
+File sysfsOpen(const String& path, const char* mode) {
+  return SD_MMC.open(path, mode);
+}
+
+bool sysfsWriteRecords(const String& path, size_t count, std::function<String(size_t)> record) {
+  String tmpPath = path + ".tmp";
+  std::ofstream f(tmpPath, std::ios::trunc);
+  for (size_t i = 0; i < count; i++) f << record(i) << "\n";
+  f.close();
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// Same as sysfsFunc.cpp, on the test folder
+bool sysfsUpgradeRecords(const String& path) {
+  std::vector<String> lines;
+  File file = sysfsOpen(path, "r");
+  if (file) {
+    if (hasRecordHeader(file)) {
+      file.close();
+      return true;
+    }
+    RecordReader<File> reader(file);
+    while (reader.nextLine()) lines.push_back(escapeLegacyLine<String>(reader.line));
+    file.close();
+  }
+  return sysfsWriteRecords(path, lines.size() + 1, [&lines](size_t i) {
+    return i == 0 ? String(RECORD_HEADER) : lines[i - 1];
+  });
+}
+
+bool sysfsRename(const String& pathFrom, const String& pathTo) {
+  return std::rename(pathFrom.c_str(), pathTo.c_str()) == 0;
+}
+
+String readWholeFile(const String& path) {
+  std::ifstream f(path);
+  std::stringstream ss;
+  ss << f.rdbuf();
+  return String(ss.str());
+}
+
+void delStoolFiles() {
+  delFile(STOOL_FILE);
+  delFile(STOOL_DAYS_FILE);
+  delFile(STOOL_WEEKS_FILE);
+}
+
 // Include only the core STOOL functions (not display functions)
 #include "../src/STOOL.cpp"
 
@@ -98,7 +146,7 @@ void test_e2e_user_stool_flow() {
   
   // === SETUP: Clean slate ===
   stoolEntries.clear();
-  delFile(STOOL_FILE);
+  delStoolFiles();
   STOOL_INIT();
   
   // === USER STORY 1: Add multiple stool entries ===
@@ -107,20 +155,20 @@ void test_e2e_user_stool_flow() {
   // Add first entry: Type 4 (normal)
   addStoolEntry(4, "Normal morning");
   TEST_ASSERT_EQUAL(1, stoolEntries.size());
-  TEST_ASSERT_EQUAL_STRING("4", stoolEntries[0][0].c_str());
-  TEST_ASSERT_EQUAL_STRING("Normal morning", stoolEntries[0][2].c_str());
+  TEST_ASSERT_EQUAL(4, stoolEntries[0].type);
+  TEST_ASSERT_EQUAL_STRING("Normal morning", stoolEntries[0].note.c_str());
   
   // Add second entry: Type 7 (diarrhea) - should be newer and appear first due to sorting
   addStoolEntry(7, "After spicy food");
   TEST_ASSERT_EQUAL(2, stoolEntries.size());
   // Verify entries are sorted by timestamp (most recent first)
-  TEST_ASSERT_EQUAL_STRING("7", stoolEntries[0][0].c_str()); // Most recent
-  TEST_ASSERT_EQUAL_STRING("4", stoolEntries[1][0].c_str()); // Older entry
+  TEST_ASSERT_EQUAL(7, stoolEntries[0].type); // Most recent
+  TEST_ASSERT_EQUAL(4, stoolEntries[1].type); // Older entry
   
   // Add third entry: Type 1 (constipated)
   addStoolEntry(1, "Hard to pass");
   TEST_ASSERT_EQUAL(3, stoolEntries.size());
-  TEST_ASSERT_EQUAL_STRING("1", stoolEntries[0][0].c_str()); // Most recent
+  TEST_ASSERT_EQUAL(1, stoolEntries[0].type); // Most recent
   
   // === USER STORY 2: Test invalid stool type ===
   std::cout << "Testing invalid stool type..." << std::endl;
@@ -157,7 +205,7 @@ void test_e2e_user_stool_flow() {
   std::cout << "Testing file persistence..." << std::endl;
   
   // Save current entries for comparison
-  std::vector<std::vector<String>> entriesBeforeRestart = stoolEntries;
+  std::vector<StoolEntry> entriesBeforeRestart = stoolEntries;
   
   // Simulate app restart
   stoolEntries.clear();
@@ -169,9 +217,9 @@ void test_e2e_user_stool_flow() {
   // Verify all data persisted correctly
   TEST_ASSERT_EQUAL(entriesBeforeRestart.size(), stoolEntries.size());
   for (size_t i = 0; i < entriesBeforeRestart.size(); i++) {
-    TEST_ASSERT_EQUAL_STRING(entriesBeforeRestart[i][0].c_str(), stoolEntries[i][0].c_str());
-    TEST_ASSERT_EQUAL_STRING(entriesBeforeRestart[i][1].c_str(), stoolEntries[i][1].c_str());
-    TEST_ASSERT_EQUAL_STRING(entriesBeforeRestart[i][2].c_str(), stoolEntries[i][2].c_str());
+    TEST_ASSERT_EQUAL(entriesBeforeRestart[i].type, stoolEntries[i].type);
+    TEST_ASSERT_TRUE(entriesBeforeRestart[i].time == stoolEntries[i].time);
+    TEST_ASSERT_EQUAL_STRING(entriesBeforeRestart[i].note.c_str(), stoolEntries[i].note.c_str());
   }
   
   // === USER STORY 6: Delete entries ===
@@ -186,7 +234,7 @@ void test_e2e_user_stool_flow() {
   // Verify the middle entry was removed
   bool foundDeletedEntry = false;
   for (const auto& entry : stoolEntries) {
-    if (entry[0] == "7" && entry[2] == "After spicy food") {
+    if (entry.type == 7 && entry.note == "After spicy food") {
       foundDeletedEntry = true;
       break;
     }
@@ -215,7 +263,7 @@ void test_e2e_user_stool_flow() {
   resetTimingVars();
   processKB_STOOL();
   TEST_ASSERT_EQUAL(beforeKBCount + 1, stoolEntries.size());
-  TEST_ASSERT_EQUAL_STRING("5", stoolEntries[0][0].c_str()); // Should be most recent
+  TEST_ASSERT_EQUAL(5, stoolEntries[0].type); // Should be most recent
   
   // Test selecting entry for viewing (pressing 'a' for first entry)
   simulateKeyPress('a');
@@ -261,7 +309,7 @@ void test_e2e_user_stool_flow() {
   TEST_ASSERT_EQUAL(STOOL1, CurrentStoolState);
   
   // Verify the note was updated
-  TEST_ASSERT_EQUAL_STRING("Test", stoolEntries[selectedStoolEntry][2].c_str());
+  TEST_ASSERT_EQUAL_STRING("Test", stoolEntries[selectedStoolEntry].note.c_str());
   
   // Test deleting via keyboard
   simulateKeyPress('d'); // Delete
@@ -288,7 +336,7 @@ void test_e2e_user_stool_flow() {
   
   // Clear for comprehensive type testing
   stoolEntries.clear();
-  delFile(STOOL_FILE);
+  delStoolFiles();
   
   for (int type = 1; type <= 7; type++) {
     String note = "Type " + String(type) + " test";
@@ -298,7 +346,7 @@ void test_e2e_user_stool_flow() {
     // Find the entry (it might not be at index 0 due to sorting)
     bool found = false;
     for (const auto& entry : stoolEntries) {
-      if (entry[0] == String(type) && entry[2] == note) {
+      if (entry.type == type && entry.note == note) {
         found = true;
         break;
       }
@@ -307,12 +355,160 @@ void test_e2e_user_stool_flow() {
   }
   
   // === CLEANUP ===
-  delFile(STOOL_FILE);
+  delStoolFiles();
   stoolEntries.clear();
   
   std::cout << "=== BLACK-BOX E2E: User Stool Flow PASSED! ===" << std::endl;
 }
 
+// Rollups follow the log through adds, edits and deletes, and match a rebuild
+void test_stool_rollups() {
+  delStoolFiles();
+
+  // History written straight to the log (e.g. over USB), no rollups yet
+  appendToFile(STOOL_FILE, RECORD_HEADER);
+  appendToFile(STOOL_FILE, "4|20241201080000|Old");          // Sun, week of 12/01
+  appendToFile(STOOL_FILE, "3|20250105070000|");             // Sun, week of 01/05
+  appendToFile(STOOL_FILE, "4|20250110073000|");
+  appendToFile(STOOL_FILE, "4|20250112090000|");             // Sun, week of 01/12
+  appendToFile(STOOL_FILE, "6|20250114211500|Spicy \\| hot");
+  appendToFile(STOOL_FILE, "bad line");
+  for (int i = 0; i < 6; i++) {
+    appendToFile(STOOL_FILE, "5|2025011508" + String(10 + i) + "00|");
+  }
+
+  // Loading notices the missing rollups and builds them from the log
+  STOOL_INIT();
+  TEST_ASSERT_EQUAL(STOOL_RECENT, stoolEntries.size());
+  TEST_ASSERT_TRUE(stoolEntries[0].time == 20250115081500ULL);
+  TEST_ASSERT_EQUAL_STRING("Spicy | hot", stoolEntries[6].note.c_str());
+
+  std::vector<StoolRollup> days, weeks;
+  readRollupTail(STOOL_DAYS_FILE, 100, days);
+  readRollupTail(STOOL_WEEKS_FILE, 100, weeks);
+  TEST_ASSERT_EQUAL(6, days.size());
+  TEST_ASSERT_EQUAL_UINT32(20250115, days.back().key);
+  TEST_ASSERT_EQUAL(6, days.back().counts[4]);
+  TEST_ASSERT_EQUAL(3, weeks.size());
+  TEST_ASSERT_EQUAL_UINT32(20241201, weeks[0].key);
+  TEST_ASSERT_EQUAL_UINT32(20250105, weeks[1].key);
+  TEST_ASSERT_EQUAL(1, weeks[1].counts[2]);
+  TEST_ASSERT_EQUAL(1, weeks[1].counts[3]);
+  TEST_ASSERT_EQUAL_UINT32(20250112, weeks[2].key);
+  TEST_ASSERT_EQUAL(6, weeks[2].counts[4]);
+  TEST_ASSERT_EQUAL(1, weeks[2].counts[5]);
+
+  // Adding to today rewrites today's record in place, nothing is appended
+  size_t daysSize = readWholeFile(STOOL_DAYS_FILE).length();
+  addStoolEntry(2, "Added");
+  TEST_ASSERT_EQUAL(STOOL_RECENT, stoolEntries.size());
+  TEST_ASSERT_EQUAL(2, stoolEntries[0].type);
+  TEST_ASSERT_EQUAL(daysSize, readWholeFile(STOOL_DAYS_FILE).length());
+  readRollupTail(STOOL_DAYS_FILE, 1, days);
+  TEST_ASSERT_EQUAL(1, days[0].counts[1]);
+
+  // Edit and delete stream the log, counts change only for the delete
+  editStoolNote(0, "Edited | note");
+  deleteStoolEntry(1);
+  readRollupTail(STOOL_DAYS_FILE, 1, days);
+  TEST_ASSERT_EQUAL(1, days[0].counts[1]);
+  TEST_ASSERT_EQUAL(5, days[0].counts[4]);
+
+  // Still what a full rebuild of the log gives
+  String daysIncremental = readWholeFile(STOOL_DAYS_FILE);
+  String weeksIncremental = readWholeFile(STOOL_WEEKS_FILE);
+  char header[13];
+  snprintf(header, sizeof(header), "#%010lu\n", (unsigned long)stoolLogBytes());
+  TEST_ASSERT_EQUAL_STRING(header, daysIncremental.substring(0, 12).c_str());
+  rebuildStoolRollups();
+  TEST_ASSERT_EQUAL_STRING(daysIncremental.c_str(), readWholeFile(STOOL_DAYS_FILE).c_str());
+  TEST_ASSERT_EQUAL_STRING(weeksIncremental.c_str(), readWholeFile(STOOL_WEEKS_FILE).c_str());
+
+  // A log changed behind the rollups' back is caught by the header
+  appendToFile(STOOL_FILE, "1|20250115235900|");
+  addStoolEntry(7, "");
+  readRollupTail(STOOL_DAYS_FILE, 1, days);
+  TEST_ASSERT_EQUAL(1, days[0].counts[0]);
+  TEST_ASSERT_EQUAL(1, days[0].counts[6]);
+
+  // Trends for 01/15: 11 entries in the last 7 days, 12 in 30
+  StoolTrends trends;
+  computeStoolTrends(20250115, trends);
+  TEST_ASSERT_EQUAL(5, trends.typeCounts[4]);
+  TEST_ASSERT_EQUAL(2, trends.typeCounts[3]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 11 / 7.0f, trends.perDay7);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 12 / 30.0f, trends.perDay30);
+  TEST_ASSERT_EQUAL_UINT32(20250112, trends.weekStart[STOOL_TREND_WEEKS - 1]);
+  TEST_ASSERT_EQUAL_UINT32(20241124, trends.weekStart[0]);
+  TEST_ASSERT_EQUAL(10, trends.weekCount[STOOL_TREND_WEEKS - 1]);
+  TEST_ASSERT_EQUAL(2, trends.weekCount[STOOL_TREND_WEEKS - 2]);
+  TEST_ASSERT_EQUAL(1, trends.weekCount[1]);
+  TEST_ASSERT_EQUAL(0, trends.weekCount[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 12 / 28.0f, trends.weekRolling[STOOL_TREND_WEEKS - 1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1 / 28.0f, trends.weekRolling[1]);
+
+  delStoolFiles();
+}
+
+static int findNote(const String& note) {
+  for (size_t i = 0; i < stoolEntries.size(); i++) {
+    if (stoolEntries[i].note == note) return i;
+  }
+  return -1;
+}
+
+// A log from before escaping reads verbatim, and edits and adds upgrade it
+// without changing its notes. Notes past RECORD_LINE_MAX are never cut.
+void test_stool_legacy_log() {
+  String longNote = "";
+  for (int i = 0; i < 60; i++) longNote += "long note ";
+  longNote += "end";
+
+  delStoolFiles();
+  appendToFile(STOOL_FILE, "3|20250110080000|path C:\\new\\docs");
+  appendToFile(STOOL_FILE, "4|20250111080000|" + longNote);
+  appendToFile(STOOL_FILE, "5|20250112080000|plain");
+
+  STOOL_INIT();
+  TEST_ASSERT_EQUAL(3, stoolEntries.size());
+  TEST_ASSERT_TRUE(findNote("path C:\\new\\docs") != -1);
+  TEST_ASSERT_TRUE(findNote(longNote) != -1);
+
+  // Editing rewrites the log under the header, the other notes read the same
+  editStoolNote(findNote("plain"), "two\nlines | and C:\\");
+  String log = readWholeFile(STOOL_FILE);
+  TEST_ASSERT_TRUE(log.startsWith(String(RECORD_HEADER) + "\n"));
+  stoolEntries.clear();
+  updateStoolArray();
+  TEST_ASSERT_EQUAL(3, stoolEntries.size());
+  TEST_ASSERT_TRUE(findNote("path C:\\new\\docs") != -1);
+  TEST_ASSERT_TRUE(findNote(longNote) != -1);
+  TEST_ASSERT_TRUE(findNote("two\nlines | and C:\\") != -1);
+
+  // Deleting the long note leaves the rest alone
+  deleteStoolEntry(findNote(longNote));
+  TEST_ASSERT_EQUAL(2, stoolEntries.size());
+  TEST_ASSERT_TRUE(findNote("path C:\\new\\docs") != -1);
+
+  // Adding to an older log upgrades it first
+  delStoolFiles();
+  appendToFile(STOOL_FILE, "3|20250110080000|path C:\\new\\docs");
+  addStoolEntry(2, "a|b");
+  TEST_ASSERT_TRUE(readWholeFile(STOOL_FILE).startsWith(String(RECORD_HEADER) + "\n"));
+  stoolEntries.clear();
+  updateStoolArray();
+  TEST_ASSERT_EQUAL(2, stoolEntries.size());
+  TEST_ASSERT_TRUE(findNote("path C:\\new\\docs") != -1);
+  TEST_ASSERT_TRUE(findNote("a|b") != -1);
+
+  // The rollups were rebuilt for the upgraded log
+  std::vector<StoolRollup> days;
+  readRollupTail(STOOL_DAYS_FILE, 100, days);
+  TEST_ASSERT_EQUAL(2, days.size());
+
+  delStoolFiles();
+}
+
 // Unity test runner
 void setUp(void) {
   // Reset state before each test
@@ -327,7 +523,7 @@ void setUp(void) {
 
 void tearDown(void) {
   // Clean up after each test
-  delFile(STOOL_FILE);
+  delStoolFiles();
   stoolEntries.clear();
 }
 
@@ -336,6 +532,8 @@ int main(int argc, char **argv) {
   
   // Single comprehensive e2e test
   RUN_TEST(test_e2e_user_stool_flow);
+  RUN_TEST(test_stool_rollups);
+  RUN_TEST(test_stool_legacy_log);
   
   return UNITY_END();
 } 
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include <unity.h>
+#define NATIVE_TEST
+#include "../include/globals.h"
+#include "../nativeStubs.h"
+#include <atomic>
+#include <stdlib.h>
+#define PMSYNC_NO_MAIN
+#include "../tools/pmsync/pmsync.cpp"
+
+static std::atomic<long long> clockSkip(0);
+int millis() {
+  using namespace std::chrono;
+  return (int)(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count() + clockSkip);
+}
+unsigned long micros() {
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+String editingFile = "";
+AppState CurrentAppState = HOME;
+static int reconcileRequests = 0;
+void reconcileRequest() { reconcileRequests++; }
+
+#include "../src/notesFunc.cpp"
+
+// The simulated device's card is a folder
+#define SYNC_CARD "test_sync_card"
+#define SYNC_HOST "test_sync_host"
+MockSD_MMC SD_MMC;
+struct CardSD {
+  File open(const String& path, const char* mode) { return SD_MMC.open(SYNC_CARD + path, mode); }
+  bool exists(const String& path) { return SD_MMC.exists(SYNC_CARD + path); }
+  bool remove(const String& path) { return std::remove((SYNC_CARD + path).c_str()) == 0; }
+  bool rename(const String& from, const String& to) {
+    return std::rename((SYNC_CARD + from).c_str(), (SYNC_CARD + to).c_str()) == 0;
+  }
+};
+static CardSD card;
+#define SD_MMC card
+#include "../src/syncFunc.cpp"
+#undef SD_MMC
+#include "../src/remoteFunc.cpp"
+
+// The device prints debug lines on the same port
+class ChattyPort : public FdSyncPort {
+public:
+  explicit ChattyPort(int fd) : FdSyncPort(fd) {}
+  bool write(const uint8_t* src, size_t len) {
+    if (++writes % 3 == 0) {
+      const char* line = "SYSFS: flushed /sys/tasks.txt\r\n";
+      FdSyncPort::write((const uint8_t*)line, strlen(line));
+    }
+    return FdSyncPort::write(src, len);
+  }
+  int writes = 0;
+};
+
+// A pty pair: the simulated device on the master side, running loop()'s
+// syncPoll() in a thread, the host on the slave side like on a real tty
+struct SimDevice {
+  int master = -1;
+  int slave = -1;
+  ChattyPort* port = nullptr;
+  std::atomic<bool> running;
+  std::thread loop;
+
+  bool start() {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return false;
+    slave = FdSyncPort::openTty(ptsname(master));
+    if (slave < 0) return false;
+    port = new ChattyPort(master);
+    syncBegin(port);
+    running = true;
+    loop = std::thread([this]() {
+      while (running) {
+        syncPoll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    return true;
+  }
+
+  void stop() {
+    running = false;
+    if (loop.joinable()) loop.join();
+    close(slave);
+    close(master);
+    delete port;
+  }
+};
+
+static void writeText(const std::string& path, const std::string& text) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << text;
+}
+
+static std::string readText(const std::string& path) {
+  std::string text;
+  if (!readWhole(path, text)) return "<missing>";
+  return text;
+}
+
+// Journal-like text: dated lines of words
+static std::string journal(int lines, uint32_t seed) {
+  static const char* words[] = { "walked", "the", "dog", "wrote", "notes", "coffee", "rain", "meeting", "read", "slept" };
+  std::string text;
+  for (int i = 0; i < lines; i++) {
+    text += "2025-" + std::to_string(1 + i % 12) + "-" + std::to_string(1 + i % 28) + ":";
+    for (int w = 0; w < 8; w++) {
+      seed = seed * 1103515245 + 12345;
+      text += " ";
+      text += words[(seed >> 16) % 10];
+    }
+    text += "\n";
+  }
+  return text;
+}
+
+static std::vector<SyncSig> sigsOf(const std::string& text) {
+  std::vector<SyncSig> sigs;
+  for (size_t at = 0; at < text.size(); at += SYNC_BLOCK) {
+    uint32_t len = (uint32_t)std::min<size_t>(SYNC_BLOCK, text.size() - at);
+    const uint8_t* data = (const uint8_t*)text.data() + at;
+    sigs.push_back({ syncWeak(data, len), syncStrong(data, len), len });
+  }
+  return sigs;
+}
+
+// What the device builds from old and ops
+static std::string applyOps(const std::string& old, const std::string& text, const std::vector<SyncOp>& ops) {
+  std::string out;
+  for (const SyncOp& op : ops) {
+    if (op.count > 0) out += old.substr((size_t)op.block * SYNC_BLOCK, (size_t)op.count * SYNC_BLOCK);
+    else out += text.substr(op.offset, op.len);
+  }
+  return out;
+}
+
+static size_t dataBytes(const std::vector<SyncOp>& ops) {
+  size_t bytes = 0;
+  for (const SyncOp& op : ops) bytes += op.count == 0 ? op.len : 0;
+  return bytes;
+}
+
+void test_rolling_matches_direct() {
+  std::string text = journal(100, 1);
+  const uint8_t* data = (const uint8_t*)text.data();
+  SyncRolling roll;
+  roll.reset(data, SYNC_BLOCK);
+  for (size_t pos = 0; pos + SYNC_BLOCK < text.size(); pos++) {
+    TEST_ASSERT_EQUAL(syncWeak(data + pos, SYNC_BLOCK), roll.value());
+    roll.roll(data[pos], data[pos + SYNC_BLOCK]);
+  }
+}
+
+void test_delta() {
+  std::string old = journal(400, 2);
+
+  // Unchanged: copies only
+  std::vector<SyncSig> sigs = sigsOf(old);
+  std::vector<SyncOp> ops = syncDelta(sigs, old);
+  TEST_ASSERT_TRUE(syncUnchanged(ops, sigs));
+  TEST_ASSERT_EQUAL(0, dataBytes(ops));
+
+  // A line typed in the middle, one deleted further on, more at the end
+  std::string text = old;
+  text.insert(5003, "2025-6-6: a line typed in the middle\n");
+  text.erase(12000, 100);
+  text += "2025-7-7: and one more at the end\n";
+  ops = syncDelta(sigs, text);
+  TEST_ASSERT_FALSE(syncUnchanged(ops, sigs));
+  TEST_ASSERT_TRUE(applyOps(old, text, ops) == text);
+  TEST_ASSERT_TRUE(dataBytes(ops) < 4 * SYNC_BLOCK);
+  printf("Delta of a %u byte note with three edits: %u bytes of data, %u ops\n", (unsigned)text.size(),
+         (unsigned)dataBytes(ops), (unsigned)ops.size());
+
+  // Nothing to start from
+  ops = syncDelta(std::vector<SyncSig>(), text);
+  TEST_ASSERT_EQUAL(text.size(), dataBytes(ops));
+  TEST_ASSERT_TRUE(applyOps(old, text, ops) == text);
+
+  // Shorter than a block
+  std::string small = "short note\n";
+  ops = syncDelta(sigsOf(small), small);
+  TEST_ASSERT_TRUE(syncUnchanged(ops, sigsOf(small)));
+}
+
+void test_parser_skips_noise() {
+  uint8_t stream[4 * SYNC_FRAME_MAX];
+  size_t len = 0;
+  const char* noise = "boot: SD mounted\r\n";
+  memcpy(stream, noise, strlen(noise));
+  len += strlen(noise);
+  len += syncFrame(SYNC_DATA, 1, (const uint8_t*)"abc", 3, stream + len);
+  size_t damaged = len;
+  len += syncFrame(SYNC_DATA, 2, (const uint8_t*)"def", 3, stream + len);
+  stream[damaged + SYNC_HEADER] ^= 0x01;
+  stream[len++] = 0xA5;
+  len += syncFrame(SYNC_END, 3, nullptr, 0, stream + len);
+
+  SyncParser parser;
+  std::vector<uint8_t> seqs;
+  for (size_t i = 0; i < len; i++) {
+    if (parser.feed(stream[i])) seqs.push_back(parser.seq());
+  }
+  TEST_ASSERT_EQUAL(2, seqs.size());
+  TEST_ASSERT_EQUAL(1, seqs[0]);
+  TEST_ASSERT_EQUAL(3, seqs[1]);
+}
+
+void test_push_over_pty() {
+  system("rm -rf " SYNC_CARD " " SYNC_HOST " && mkdir -p " SYNC_CARD " " SYNC_HOST);
+  std::string journalOld = journal(1500, 3);
+  std::string journalNew = journalOld;
+  journalNew.insert(journalNew.size() / 2, "2025-8-8: edited on the laptop\n");
+  journalNew += "2025-9-9: and appended\n";
+  writeText(SYNC_CARD "/journal.txt", journalOld);
+  writeText(SYNC_CARD "/same.txt", "Same on both sides\n");
+  writeText(SYNC_HOST "/journal.txt", journalNew);
+  writeText(SYNC_HOST "/same.txt", "Same on both sides\n");
+  writeText(SYNC_HOST "/new.txt", "Written on the laptop\n");
+  writeText(SYNC_HOST "/ignored.md", "Not a note\n");
+
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  reconcileRequests = 0;
+
+  SyncClient client(host, 500);
+  TEST_ASSERT_TRUE(syncFolder(client, SYNC_HOST, "/", false));
+  TEST_ASSERT_EQUAL(2, client.stats.pushed);
+  TEST_ASSERT_EQUAL(1, client.stats.unchanged);
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/journal.txt") == journalNew);
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/new.txt") == "Written on the laptop\n");
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/journal.txt.tmp") == "<missing>");
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/ignored.md") == "<missing>");
+  TEST_ASSERT_EQUAL(1, reconcileRequests);
+  // The edits and the new note, not the journal
+  TEST_ASSERT_TRUE(client.stats.dataBytes < 4 * SYNC_BLOCK);
+  printf("Pushed %u bytes of notes: %u bytes of data, %u bytes over the port\n", (unsigned)client.stats.bytes,
+         (unsigned)client.stats.dataBytes, (unsigned)client.stats.wireBytes);
+
+  // Nothing touched since: the manifest skips everything
+  SyncClient again(host, 500);
+  TEST_ASSERT_TRUE(syncFolder(again, SYNC_HOST, "/", false));
+  TEST_ASSERT_EQUAL(0, again.stats.pushed + again.stats.unchanged);
+  TEST_ASSERT_EQUAL(1, reconcileRequests);
+
+  // Checking every note finds them the same on the device
+  SyncClient all(host, 500);
+  TEST_ASSERT_TRUE(syncFolder(all, SYNC_HOST, "/", true));
+  TEST_ASSERT_EQUAL(3, all.stats.unchanged);
+  TEST_ASSERT_EQUAL(0, all.stats.dataBytes);
+
+  // Notes the device won't take
+  SyncClient refused(host, 500);
+  TEST_ASSERT_TRUE(refused.hello());
+  TEST_ASSERT_EQUAL(PUSH_FAILED, refused.push("/sys/tasks.txt", "Pay rent|20250101|1|0\n"));
+  TEST_ASSERT_EQUAL_STRING("not a note", refused.error.c_str());
+  TEST_ASSERT_EQUAL(PUSH_FAILED, refused.push("/../escape.txt", "x"));
+  editingFile = "/journal.txt";
+  CurrentAppState = TXT;
+  TEST_ASSERT_EQUAL(PUSH_FAILED, refused.push("/journal.txt", "typed over\n"));
+  TEST_ASSERT_EQUAL_STRING("open in TXT", refused.error.c_str());
+  CurrentAppState = HOME;
+  editingFile = "";
+  TEST_ASSERT_TRUE(refused.bye());
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/journal.txt") == journalNew);
+
+  device.stop();
+  system("rm -rf " SYNC_CARD " " SYNC_HOST);
+}
+
+// Raw frames, to lose replies and go quiet on purpose
+static bool rawRequest(FdSyncPort& host, uint8_t type, uint8_t seq, const std::string& payload, uint8_t& replyType) {
+  uint8_t frame[SYNC_FRAME_MAX];
+  size_t len = syncFrame(type, seq, (const uint8_t*)payload.data(), (uint16_t)payload.size(), frame);
+  host.write(frame, len);
+  SyncParser parser;
+  while (host.wait(500)) {
+    uint8_t buf[256];
+    size_t n = host.read(buf, sizeof(buf));
+    for (size_t i = 0; i < n; i++) {
+      if (parser.feed(buf[i]) && parser.seq() == seq) {
+        replyType = parser.type();
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void test_repeats_and_dropped_sessions() {
+  system("rm -rf " SYNC_CARD " && mkdir -p " SYNC_CARD);
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  uint8_t type;
+
+  std::string hello(2, '\0');
+  syncPut16((uint8_t*)&hello[0], SYNC_VERSION);
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_HELLO, 1, hello, type));
+  TEST_ASSERT_EQUAL(SYNC_HELLO | SYNC_REPLY, type);
+
+  // "abc" in, with the DATA sent twice as if its reply got lost
+  std::string begin(12, '\0');
+  syncPut32((uint8_t*)&begin[0], 3);
+  syncPut64((uint8_t*)&begin[4], syncHash64((const uint8_t*)"abc", 3));
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_BEGIN, 2, begin + "/repeat.txt", type));
+  TEST_ASSERT_EQUAL(SYNC_BEGIN | SYNC_REPLY, type);
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_DATA, 3, "abc", type));
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_DATA, 3, "abc", type));
+  TEST_ASSERT_EQUAL(SYNC_DATA | SYNC_REPLY, type);
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_END, 4, "", type));
+  TEST_ASSERT_EQUAL(SYNC_END | SYNC_REPLY, type);
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/repeat.txt") == "abc");
+
+  // A host that goes away mid-patch leaves nothing behind
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_BEGIN, 5, begin + "/dropped.txt", type));
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_DATA, 6, "ab", type));
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/dropped.txt.tmp") != "<missing>");
+  clockSkip += SYNC_SESSION_MS;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/dropped.txt.tmp") == "<missing>");
+  TEST_ASSERT_TRUE(readText(SYNC_CARD "/dropped.txt") == "<missing>");
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_DATA, 7, "c", type));
+  TEST_ASSERT_EQUAL(SYNC_ERR, type);
+
+  // No card while USB mass storage has it
+  mscEnabled = true;
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_HELLO, 8, hello, type));
+  TEST_ASSERT_EQUAL(SYNC_ERR, type);
+  mscEnabled = false;
+
+  device.stop();
+  system("rm -rf " SYNC_CARD);
+}
+
+// A tool run after a dropped session may count from the seq the last one
+// ended on, it gets a real answer and not the old reply
+void test_new_run_not_taken_for_repeat() {
+  system("rm -rf " SYNC_CARD " && mkdir -p " SYNC_CARD);
+  SimDevice device;
+  TEST_ASSERT_TRUE(device.start());
+  FdSyncPort host(device.slave);
+  uint8_t type;
+
+  std::string hello(2, '\0');
+  syncPut16((uint8_t*)&hello[0], SYNC_VERSION);
+  std::string sig(4, '\0');
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_HELLO, 1, hello, type));
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_SIG, 2, sig + "/none.txt", type));
+  TEST_ASSERT_EQUAL(SYNC_SIG | SYNC_REPLY, type);
+  clockSkip += SYNC_SESSION_MS;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_SIG, 2, sig + "/none.txt", type));
+  TEST_ASSERT_EQUAL(SYNC_ERR, type);
+
+  // A HELLO with the seq of the last request is answered too
+  TEST_ASSERT_TRUE(rawRequest(host, SYNC_HELLO, 2, hello, type));
+  TEST_ASSERT_EQUAL(SYNC_HELLO | SYNC_REPLY, type);
+
+  device.stop();
+  system("rm -rf " SYNC_CARD);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rolling_matches_direct);
+  RUN_TEST(test_delta);
+  RUN_TEST(test_parser_skips_noise);
+  RUN_TEST(test_push_over_pty);
+  RUN_TEST(test_repeats_and_dropped_sessions);
+  RUN_TEST(test_new_run_not_taken_for_repeat);
+  return UNITY_END();
+}
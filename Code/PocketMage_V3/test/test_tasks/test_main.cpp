@@ -7,7 +7,7 @@
 // We'll include TASKS.cpp but skip the einkHandler_TASKS function
 
 // Define all global variables required by TASKS.cpp
-std::vector<std::vector<String>> tasks;
+std::vector<Task> tasks;
 bool SAVE_POWER = false;
 int POWER_SAVE_FREQ = 40;
 bool SDActive = false;
@@ -39,6 +39,20 @@ MockSD_MMC SD_MMC;
 MockDisplay display;
 MockU8g2 u8g2;
 
+// Mock RTC, "today" can be moved by the tests
+struct DateTime {
+  int _year, _month, _day;
+  DateTime(int y, int m, int d) : _year(y), _month(m), _day(d) {}
+  int year() const { return _year; }
+  int month() const { return _month; }
+  int day() const { return _day; }
+};
+struct MockRTC {
+  int year = 2025, month = 1, day = 15;
+  DateTime now() { return DateTime(year, month, day); }
+};
+MockRTC rtc;
+
 // Mock function implementations
 void setCpuFrequencyMhz(int freq) {}
 void delay(int ms) {}
@@ -87,6 +101,26 @@ void appendToFile(const String& path, const String& content) {
   f.close();
 }
 
+File sysfsOpen(const String& path, const char* mode) {
+  return SD_MMC.open(path, mode);
+}
+
+// Every write bumps the generation, like the flash store does
+uint32_t tasksFileGeneration = 1;
+
+uint32_t sysfsGeneration(const String& path) {
+  return tasksFileGeneration;
+}
+
+bool sysfsWriteRecords(const String& path, size_t count, std::function<String(size_t)> record) {
+  String tmpPath = path + ".tmp";
+  std::ofstream f(tmpPath, std::ios::trunc);
+  for (size_t i = 0; i < count; i++) f << record(i) << "\n";
+  f.close();
+  tasksFileGeneration++;
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
 // Include only the core TASKS functions (not display functions)
 #include "../src/TASKS.cpp"
 
@@ -119,7 +153,7 @@ void test_e2e_user_tasks_flow() {
   
   // Verify first task exists
   TEST_ASSERT_EQUAL(1, tasks.size());
-  TEST_ASSERT_EQUAL_STRING("Buy milk", tasks[0][0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Buy milk", tasks[0].name.c_str());
   
   // Create second task: "Doctor appointment" due 2025-01-15 (earlier date)
   simulateKeyPress('n');
@@ -138,8 +172,8 @@ void test_e2e_user_tasks_flow() {
   
   // Verify tasks are auto-sorted by due date
   TEST_ASSERT_EQUAL(2, tasks.size());
-  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0][0].c_str()); // Earlier date first
-  TEST_ASSERT_EQUAL_STRING("Buy milk", tasks[1][0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0].name.c_str()); // Earlier date first
+  TEST_ASSERT_EQUAL_STRING("Buy milk", tasks[1].name.c_str());
   
   // Create third task: "Pay rent" due 2025-01-25
   simulateKeyPress('n');
@@ -158,9 +192,9 @@ void test_e2e_user_tasks_flow() {
   
   // Verify all three tasks in correct order
   TEST_ASSERT_EQUAL(3, tasks.size());
-  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0][0].c_str()); // 01/15
-  TEST_ASSERT_EQUAL_STRING("Buy milk", tasks[1][0].c_str());           // 01/20
-  TEST_ASSERT_EQUAL_STRING("Pay rent", tasks[2][0].c_str());           // 01/25
+  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0].name.c_str()); // 01/15
+  TEST_ASSERT_EQUAL_STRING("Buy milk", tasks[1].name.c_str());           // 01/20
+  TEST_ASSERT_EQUAL_STRING("Pay rent", tasks[2].name.c_str());           // 01/25
   
   // === USER STORY 2: Handle invalid input gracefully ===
   std::cout << "Testing invalid input handling..." << std::endl;
@@ -191,7 +225,7 @@ void test_e2e_user_tasks_flow() {
   
   // Now should have 4 tasks
   TEST_ASSERT_EQUAL(4, tasks.size());
-  TEST_ASSERT_EQUAL_STRING("Invalid task", tasks[3][0].c_str()); // Last in sort order
+  TEST_ASSERT_EQUAL_STRING("Invalid task", tasks[3].name.c_str()); // Last in sort order
   
   // === USER STORY 3: Delete tasks ===
   std::cout << "Testing task deletion..." << std::endl;
@@ -207,14 +241,14 @@ void test_e2e_user_tasks_flow() {
   
   // Verify "Buy milk" is gone
   TEST_ASSERT_EQUAL(3, tasks.size());
-  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0][0].c_str());
-  TEST_ASSERT_EQUAL_STRING("Pay rent", tasks[1][0].c_str());
-  TEST_ASSERT_EQUAL_STRING("Invalid task", tasks[2][0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Pay rent", tasks[1].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Invalid task", tasks[2].name.c_str());
   
   // Verify "Buy milk" is not in any task
   bool buyMilkFound = false;
   for (const auto& task : tasks) {
-    if (task[0] == "Buy milk") {
+    if (task.name == "Buy milk") {
       buyMilkFound = true;
       break;
     }
@@ -225,20 +259,21 @@ void test_e2e_user_tasks_flow() {
   std::cout << "Testing file persistence..." << std::endl;
   
   // Save current tasks for comparison
-  std::vector<std::vector<String>> tasksBeforeRestart = tasks;
+  std::vector<Task> tasksBeforeRestart = tasks;
   
   // Simulate app restart
   tasks.clear();
   TEST_ASSERT_EQUAL(0, tasks.size()); // Confirm memory is cleared
   
-  // Reload from file
+  // Reload from file, the file changed as far as the app can tell
+  tasksFileGeneration++;
   updateTaskArray();
   
   // Verify all data persisted correctly
   TEST_ASSERT_EQUAL(tasksBeforeRestart.size(), tasks.size());
   for (size_t i = 0; i < tasksBeforeRestart.size(); i++) {
-    TEST_ASSERT_EQUAL_STRING(tasksBeforeRestart[i][0].c_str(), tasks[i][0].c_str());
-    TEST_ASSERT_EQUAL_STRING(tasksBeforeRestart[i][1].c_str(), tasks[i][1].c_str());
+    TEST_ASSERT_EQUAL_STRING(tasksBeforeRestart[i].name.c_str(), tasks[i].name.c_str());
+    TEST_ASSERT_EQUAL_UINT32(tasksBeforeRestart[i].due, tasks[i].due);
   }
   
   // === USER STORY 5: Navigation flow ===
@@ -259,7 +294,7 @@ void test_e2e_user_tasks_flow() {
   
   // Tasks should still be there
   TEST_ASSERT_EQUAL(3, tasks.size());
-  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0][0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Doctor appointment", tasks[0].name.c_str());
   
   // === USER STORY 6: Date formatting works ===
   std::cout << "Testing date display formatting..." << std::endl;
@@ -278,6 +313,188 @@ void test_e2e_user_tasks_flow() {
   std::cout << "=== BLACK-BOX E2E: User Tasks Flow PASSED! ===" << std::endl;
 }
 
+// Tasks stay sorted in RAM, the file is only read again when it changes
+void test_task_buckets_and_cache() {
+  std::ofstream f(TASKS_FILE, std::ios::trunc);
+  f << "Later|20250301|0|0\n"
+       "Old|20250110|0|0\n"
+       "Today|20250115|0|0\n"
+       "Week|20250118|0|0\n"
+       "Tomorrow|20250116|1|1\n"
+       "broken line\n";
+  f.close();
+  tasksFileGeneration++;
+  updateTaskArray();
+
+  TEST_ASSERT_EQUAL(5, tasks.size());
+  TEST_ASSERT_EQUAL_STRING("Old", tasks[0].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("Later", tasks[4].name.c_str());
+  TEST_ASSERT_EQUAL_UINT32(20250116, tasks[2].due);
+  TEST_ASSERT_EQUAL(1, tasks[2].priority);
+  TEST_ASSERT_TRUE(tasks[2].completed);
+
+  // rtc is 2025-01-15: Old | Today | Tomorrow, Week | Later
+  TEST_ASSERT_EQUAL(0, taskBucketStart[TASKS_OVERDUE]);
+  TEST_ASSERT_EQUAL(1, taskBucketStart[TASKS_TODAY]);
+  TEST_ASSERT_EQUAL(2, taskBucketStart[TASKS_THIS_WEEK]);
+  TEST_ASSERT_EQUAL(4, taskBucketStart[TASKS_LATER]);
+  TEST_ASSERT_EQUAL(5, taskBucketStart[TASK_BUCKETS]);
+
+  // Sorted insert lands after tasks due the same day, buckets follow
+  addTask("Also today", "20250115", "0", "0");
+  TEST_ASSERT_EQUAL_STRING("Also today", tasks[2].name.c_str());
+  TEST_ASSERT_EQUAL(3, taskBucketStart[TASKS_THIS_WEEK]);
+
+  // Our own write doesn't cause a re-read, the list in RAM is current
+  tasks[0].name = "in memory";
+  updateTaskArray();
+  TEST_ASSERT_EQUAL_STRING("in memory", tasks[0].name.c_str());
+
+  // A new day moves the buckets without touching the file
+  rtc.day = 18;
+  updateTaskArray();
+  TEST_ASSERT_EQUAL(4, taskBucketStart[TASKS_TODAY]);
+  TEST_ASSERT_EQUAL(5, taskBucketStart[TASKS_LATER]);
+  rtc.day = 15;
+
+  // A changed generation (sync from the card) re-reads it
+  tasksFileGeneration++;
+  updateTaskArray();
+  TEST_ASSERT_EQUAL_STRING("Old", tasks[0].name.c_str());
+  TEST_ASSERT_EQUAL(6, tasks.size());
+
+  std::ifstream saved(TASKS_FILE);
+  std::string line;
+  std::getline(saved, line);
+  TEST_ASSERT_EQUAL_STRING(RECORD_HEADER, line.c_str());
+  std::getline(saved, line);
+  TEST_ASSERT_EQUAL_STRING("Old|20250110|0|0", line.c_str());
+}
+
+// Loads a task list and splits it on the given day
+static void bucketsOn(int year, int month, int day, const std::vector<uint32_t>& dues) {
+  rtc.year = year;
+  rtc.month = month;
+  rtc.day = day;
+  tasks.clear();
+  for (uint32_t due : dues) {
+    Task task;
+    task.name = String(due);
+    task.due = due;
+    task.priority = 0;
+    task.completed = false;
+    tasks.push_back(task);
+  }
+  updateTaskBuckets();
+}
+
+static int bucketSize(uint8_t bucket) {
+  return taskBucketStart[bucket + 1] - taskBucketStart[bucket];
+}
+
+// Yesterday is overdue, today stays today until the date rolls over
+void test_task_buckets_midnight() {
+  std::vector<uint32_t> dues = { 20241231, 20250101, 20250102 };
+
+  bucketsOn(2024, 12, 31, dues);
+  TEST_ASSERT_EQUAL(0, bucketSize(TASKS_OVERDUE));
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_TODAY));
+  TEST_ASSERT_EQUAL(2, bucketSize(TASKS_THIS_WEEK));
+
+  // Past midnight, across a year end: yesterday's task is overdue
+  bucketsOn(2025, 1, 1, dues);
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_OVERDUE));
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_TODAY));
+  TEST_ASSERT_EQUAL_UINT32(20250101, tasks[taskBucketStart[TASKS_TODAY]].due);
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_THIS_WEEK));
+
+  // The cached list notices the new day on its own
+  std::ofstream f(TASKS_FILE, std::ios::trunc);
+  f << "A|20250101|0|0\nB|20250102|0|0\n";
+  f.close();
+  tasksFileGeneration++;
+  rtc.day = 1;
+  updateTaskArray();
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_TODAY));
+  rtc.day = 2;
+  updateTaskArray();
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_OVERDUE));
+  TEST_ASSERT_EQUAL_STRING("B", tasks[taskBucketStart[TASKS_TODAY]].name.c_str());
+}
+
+// Weeks start on Sunday: this week runs from tomorrow through Saturday
+void test_task_buckets_week_start() {
+  // 2025-01-18 is a Saturday, 2025-01-19 a Sunday
+  std::vector<uint32_t> dues = { 20250118, 20250119, 20250125, 20250126 };
+
+  bucketsOn(2025, 1, 18, dues);
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_TODAY));
+  TEST_ASSERT_EQUAL(0, bucketSize(TASKS_THIS_WEEK));
+  TEST_ASSERT_EQUAL(3, bucketSize(TASKS_LATER));
+
+  bucketsOn(2025, 1, 19, dues);
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_OVERDUE));
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_TODAY));
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_THIS_WEEK));
+  TEST_ASSERT_EQUAL_UINT32(20250125, tasks[taskBucketStart[TASKS_THIS_WEEK]].due);
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_LATER));
+
+  // Midweek the week still ends on Saturday, not seven days out
+  bucketsOn(2025, 1, 22, { 20250123, 20250125, 20250126, 20250129 });
+  TEST_ASSERT_EQUAL(2, bucketSize(TASKS_THIS_WEEK));
+  TEST_ASSERT_EQUAL(2, bucketSize(TASKS_LATER));
+  TEST_ASSERT_EQUAL(TASKS_THIS_WEEK, taskBucketOf(1));
+  TEST_ASSERT_EQUAL(TASKS_LATER, taskBucketOf(2));
+}
+
+// Past dates are overdue however old, tasks with no readable date never are
+void test_task_buckets_overdue() {
+  std::ofstream f(TASKS_FILE, std::ios::trunc);
+  f << "No date||0|0\n"
+       "Ancient|19991231|0|0\n"
+       "Yesterday|20250114|0|0\n"
+       "Today|20250115|0|0\n";
+  f.close();
+  tasksFileGeneration++;
+  rtc.year = 2025;
+  rtc.month = 1;
+  rtc.day = 15;
+  updateTaskArray();
+
+  TEST_ASSERT_EQUAL(2, bucketSize(TASKS_OVERDUE));
+  TEST_ASSERT_EQUAL_STRING("Ancient", tasks[0].name.c_str());
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_TODAY));
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_LATER));
+  TEST_ASSERT_EQUAL_STRING("No date", tasks[3].name.c_str());
+
+  // A dated task added later still lands before the undated one
+  addTask("Tomorrow", "20250116", "0", "0");
+  TEST_ASSERT_EQUAL_STRING("Tomorrow", tasks[3].name.c_str());
+  TEST_ASSERT_EQUAL(1, bucketSize(TASKS_THIS_WEEK));
+}
+
+// Headings for non-empty buckets only, never a heading without a task
+void test_task_group_layout() {
+  bucketsOn(2025, 1, 15, { 20250110, 20250111, 20250301 });
+  TaskRow rows[7];
+  TEST_ASSERT_EQUAL(5, layoutTaskGroups(rows, 7));
+  TEST_ASSERT_EQUAL(TASKS_OVERDUE, rows[0].bucket);
+  TEST_ASSERT_EQUAL(-1, rows[0].task);
+  TEST_ASSERT_EQUAL(0, rows[1].task);
+  TEST_ASSERT_EQUAL(1, rows[2].task);
+  TEST_ASSERT_EQUAL(TASKS_LATER, rows[3].bucket);
+  TEST_ASSERT_EQUAL(-1, rows[3].task);
+  TEST_ASSERT_EQUAL(2, rows[4].task);
+  TEST_ASSERT_EQUAL_STRING("Later", taskBucketNames[rows[3].bucket]);
+
+  // Out of room after the overdue tasks, the later heading is dropped
+  TEST_ASSERT_EQUAL(3, layoutTaskGroups(rows, 4));
+  TEST_ASSERT_EQUAL(1, rows[2].task);
+
+  bucketsOn(2025, 1, 15, {});
+  TEST_ASSERT_EQUAL(0, layoutTaskGroups(rows, 7));
+}
+
 // Unity test runner
 void setUp(void) {
   // Reset state before each test
@@ -299,6 +516,11 @@ int main(int argc, char **argv) {
   
   // Single comprehensive e2e test
   RUN_TEST(test_e2e_user_tasks_flow);
+  RUN_TEST(test_task_buckets_and_cache);
+  RUN_TEST(test_task_buckets_midnight);
+  RUN_TEST(test_task_buckets_week_start);
+  RUN_TEST(test_task_buckets_overdue);
+  RUN_TEST(test_task_group_layout);
   
   return UNITY_END();
 } 
\ No newline at end of file
@@ -0,0 +1,396 @@
+// DICTIONARY COMPILER
+// Builds the image the Lexicon searches (see include/dictFormat.h) from the
+// /dict/<Letter>.txt files on the SD card. Runs on the host:
+//   g++ -std=c++17 -O2 -Iinclude tools/dictc/dictc.cpp -o dictc
+//   ./dictc /Volumes/POCKETMAGE/dict/dict.pmd /Volumes/POCKETMAGE/dict/*.txt
+// The text files stay on the card, the Lexicon falls back to them when the
+// image is missing.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "../../include/dictFormat.h"
+
+struct DictSource {
+  std::string head;
+  std::string def;
+};
+
+class DictBuilder {
+public:
+  // Takes one line of a dictionary text file, false if it has no headword
+  bool addLine(std::string line) {
+    trim(line);
+    size_t headLen = dictHeadLength(line.data(), line.size());
+    if (headLen == 0 || headLen > 255) return false;
+
+    DictSource entry;
+    entry.head = line.substr(0, headLen);
+    entry.def  = line.substr(headLen);
+    trim(entry.def);
+    if (entry.def.size() > 0xFFFF) entry.def.resize(0xFFFF);
+    entries.push_back(entry);
+    return true;
+  }
+
+  bool addFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) addLine(line);
+    return true;
+  }
+
+  size_t size() const { return entries.size(); }
+
+  // The whole image
+  std::vector<uint8_t> build() {
+    // Senses of one headword keep their order in the text
+    std::stable_sort(entries.begin(), entries.end(), [](const DictSource& a, const DictSource& b) {
+      return dictCompare(a.head.data(), a.head.size(), b.head.data(), b.head.size()) < 0;
+    });
+
+    std::vector<uint8_t> out(sizeof(DictHeader), 0);
+    DictSection sections[DICT_SECTIONS] = {};
+
+    // ENTRIES
+    std::vector<uint32_t> offsets;
+    sections[DICT_SEC_ENTRIES].offset = out.size();
+    for (size_t i = 0; i < entries.size(); i++) {
+      offsets.push_back(out.size() - sections[DICT_SEC_ENTRIES].offset);
+      out.push_back((uint8_t)entries[i].head.size());
+      out.insert(out.end(), entries[i].head.begin(), entries[i].head.end());
+      put16(out, entries[i].def.size());
+      out.insert(out.end(), entries[i].def.begin(), entries[i].def.end());
+    }
+    endSection(out, sections[DICT_SEC_ENTRIES]);
+
+    // OFFSETS
+    sections[DICT_SEC_OFFSETS].offset = out.size();
+    for (size_t i = 0; i < offsets.size(); i++) put32(out, offsets[i]);
+    endSection(out, sections[DICT_SEC_OFFSETS]);
+
+    // SPARSE
+    sections[DICT_SEC_SPARSE].offset = out.size();
+    for (size_t i = 0; i < entries.size(); i += DICT_SPARSE_STRIDE) {
+      char key[DICT_SPARSE_KEY] = {};
+      for (size_t k = 0; k < DICT_SPARSE_KEY && k < entries[i].head.size(); k++) key[k] = dictFold(entries[i].head[k]);
+      out.insert(out.end(), key, key + DICT_SPARSE_KEY);
+      put32(out, i);
+    }
+    endSection(out, sections[DICT_SEC_SPARSE]);
+
+    // TRIE
+    sections[DICT_SEC_TRIE].offset = out.size();
+    buildTrie(out, offsets);
+    endSection(out, sections[DICT_SEC_TRIE]);
+
+    // FUZZY, from the words the trie collected
+    sections[DICT_SEC_FUZZY].offset = out.size();
+    buildFuzzy(out);
+    endSection(out, sections[DICT_SEC_FUZZY]);
+
+    // TERMS and POSTINGS
+    std::vector<uint8_t> postings;
+    sections[DICT_SEC_TERMS].offset = out.size();
+    buildTerms(out, postings);
+    endSection(out, sections[DICT_SEC_TERMS]);
+    sections[DICT_SEC_POSTINGS].offset = out.size();
+    out.insert(out.end(), postings.begin(), postings.end());
+    endSection(out, sections[DICT_SEC_POSTINGS]);
+
+    // Header last, now that the sections are known
+    std::vector<uint8_t> header;
+    header.insert(header.end(), DICT_MAGIC, DICT_MAGIC + 4);
+    put16(header, DICT_VERSION);
+    put16(header, DICT_SPARSE_STRIDE);
+    put32(header, entries.size());
+    put32(header, checksum(out));
+    for (int s = 0; s < DICT_SECTIONS; s++) {
+      put32(header, sections[s].offset);
+      put32(header, sections[s].size);
+    }
+    std::copy(header.begin(), header.end(), out.begin());
+    return out;
+  }
+
+private:
+  struct TrieWord {
+    std::string word;         // Folded
+    uint32_t    record;       // First sense, its offset once ENTRIES is written
+    uint32_t    senses;
+  };
+
+  struct TrieNode {
+    std::string           label;
+    std::vector<uint32_t> top;        // Indexes into words, best first
+    std::vector<size_t>   children;
+    uint32_t              offset;
+  };
+
+  std::vector<DictSource> entries;
+  std::vector<TrieWord>   words;
+  std::vector<TrieNode>   nodes;
+
+  bool ranksBefore(uint32_t a, uint32_t b) const {
+    if (words[a].senses != words[b].senses) return words[a].senses > words[b].senses;
+    if (words[a].word.size() != words[b].word.size()) return words[a].word.size() < words[b].word.size();
+    return words[a].record < words[b].record;
+  }
+
+  // Node for words[lo, hi), which share their first depth bytes. Nodes are
+  // added in pre-order, so every subtree ends up contiguous.
+  size_t buildNode(size_t lo, size_t hi, size_t depth) {
+    size_t index = nodes.size();
+    nodes.push_back(TrieNode());
+
+    // Sorted, so the first and last word tell if the whole range shares a byte
+    size_t p = depth;
+    while (words[lo].word.size() > p && words[lo].word[p] == words[hi - 1].word[p] && p - depth < 255) p++;
+    nodes[index].label = words[lo].word.substr(depth, p - depth);
+
+    std::vector<uint32_t> candidates;
+    size_t i = lo;
+    if (words[lo].word.size() == p) candidates.push_back(i++);
+    while (i < hi) {
+      size_t j = i;
+      while (j < hi && words[j].word[p] == words[i].word[p]) j++;
+      size_t child = buildNode(i, j, p);
+      nodes[index].children.push_back(child);
+      candidates.insert(candidates.end(), nodes[child].top.begin(), nodes[child].top.end());
+      i = j;
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return ranksBefore(a, b); });
+    if (candidates.size() > DICT_TRIE_TOP) candidates.resize(DICT_TRIE_TOP);
+    nodes[index].top = candidates;
+    return index;
+  }
+
+  void buildTrie(std::vector<uint8_t>& out, const std::vector<uint32_t>& offsets) {
+    // Distinct words with their first sense and number of senses
+    std::map<std::string, size_t> seen;
+    words.clear();
+    nodes.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+      size_t len = dictWordLength(entries[i].head.data(), entries[i].head.size());
+      if (len == 0) continue;
+      std::string word = entries[i].head.substr(0, len);
+      for (size_t k = 0; k < word.size(); k++) word[k] = dictFold(word[k]);
+
+      std::map<std::string, size_t>::iterator it = seen.find(word);
+      if (it != seen.end()) {
+        words[it->second].senses++;
+        continue;
+      }
+      seen[word] = words.size();
+      TrieWord entry = { word, (uint32_t)i, 1 };
+      words.push_back(entry);
+    }
+    if (words.empty()) return;
+    std::sort(words.begin(), words.end(), [](const TrieWord& a, const TrieWord& b) { return a.word < b.word; });
+    buildNode(0, words.size(), 0);
+
+    uint32_t offset = 0;
+    for (size_t n = 0; n < nodes.size(); n++) {
+      nodes[n].offset = offset;
+      offset += 1 + nodes[n].label.size() + 1 + 4 * nodes[n].top.size() + 2 + 4 * nodes[n].children.size();
+    }
+    if (offset >= (1u << 24)) {
+      std::cerr << "Trie too large, completions left out" << std::endl;
+      return;
+    }
+
+    for (size_t n = 0; n < nodes.size(); n++) {
+      const TrieNode& node = nodes[n];
+      out.push_back(node.label.size());
+      out.insert(out.end(), node.label.begin(), node.label.end());
+      out.push_back(node.top.size());
+      for (size_t t = 0; t < node.top.size(); t++) put32(out, offsets[words[node.top[t]].record]);
+      put16(out, node.children.size());
+      for (size_t c = 0; c < node.children.size(); c++) {
+        out.push_back(nodes[node.children[c]].label[0]);
+        put24(out, nodes[node.children[c]].offset);
+      }
+    }
+  }
+
+  // Every word's delete keys, hashed into buckets of about DICT_FUZZY_BUCKET
+  // postings. Words is in folded order, so every bucket is too.
+  void buildFuzzy(std::vector<uint8_t>& out) {
+    if (words.empty()) return;
+    if (entries.size() >= (1u << 24)) {
+      std::cerr << "Too many definitions, fuzzy index left out" << std::endl;
+      return;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> keys;    // Hash, record
+    for (size_t w = 0; w < words.size(); w++) {
+      std::set<std::string> seen;
+      dictForEachDelete(words[w].word.data(), words[w].word.size(), [&](const char* key, size_t len, int) {
+        if (seen.insert(std::string(key, len)).second) keys.push_back(std::make_pair(dictHash(key, len), words[w].record));
+      });
+    }
+
+    uint32_t bucketCount = 1;
+    while (bucketCount * DICT_FUZZY_BUCKET < keys.size()) bucketCount <<= 1;
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    for (size_t k = 0; k < keys.size(); k++) {
+      buckets[keys[k].first & (bucketCount - 1)].push_back((keys[k].first & 0xFF000000u) | keys[k].second);
+    }
+
+    put32(out, bucketCount);
+    uint32_t start = 0;
+    for (uint32_t b = 0; b < bucketCount; b++) {
+      put32(out, start);
+      start += buckets[b].size();
+    }
+    put32(out, start);
+    for (uint32_t b = 0; b < bucketCount; b++) {
+      for (size_t p = 0; p < buckets[b].size(); p++) put32(out, buckets[b][p]);
+    }
+  }
+
+  // Inverted index of the definitions, weighted with BM25
+  void buildTerms(std::vector<uint8_t>& out, std::vector<uint8_t>& postings) {
+    std::map<std::string, std::vector<std::pair<uint32_t, uint32_t>>> terms;   // Term, (record, uses)
+    std::vector<uint32_t> lengths(entries.size(), 0);
+    double total = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+      std::map<std::string, uint32_t> uses;
+      const std::string& def = entries[i].def;
+      char term[DICT_TERM_MAX];
+      size_t pos = 0, len;
+      while ((len = dictNextTerm(def.data(), def.size(), pos, term)) > 0) {
+        uses[std::string(term, len)]++;
+        lengths[i]++;
+      }
+      total += lengths[i];
+      for (std::map<std::string, uint32_t>::iterator it = uses.begin(); it != uses.end(); ++it) {
+        terms[it->first].push_back(std::make_pair((uint32_t)i, it->second));
+      }
+    }
+    if (terms.empty()) return;
+
+    // Scores first, to scale them all by the best one
+    const double k1 = 1.2, b = 0.75;
+    double average = total / entries.size();
+    std::vector<std::vector<double>> scores;
+    double best = 0;
+    for (std::map<std::string, std::vector<std::pair<uint32_t, uint32_t>>>::iterator it = terms.begin(); it != terms.end(); ++it) {
+      double count = it->second.size();
+      double idf = std::log(1 + (entries.size() - count + 0.5) / (count + 0.5));
+      scores.push_back(std::vector<double>());
+      for (size_t p = 0; p < it->second.size(); p++) {
+        double uses = it->second[p].second;
+        double score = idf * uses * (k1 + 1) / (uses + k1 * (1 - b + b * lengths[it->second[p].first] / average));
+        scores.back().push_back(score);
+        if (score > best) best = score;
+      }
+    }
+
+    put32(out, terms.size());
+    size_t table = out.size();
+    out.resize(out.size() + 4 * terms.size());
+    size_t t = 0;
+    for (std::map<std::string, std::vector<std::pair<uint32_t, uint32_t>>>::iterator it = terms.begin(); it != terms.end(); ++it, t++) {
+      uint32_t at = out.size() - (table - 4);
+      for (int k = 0; k < 4; k++) out[table + 4 * t + k] = (at >> (8 * k)) & 0xFF;
+
+      size_t start = postings.size();
+      uint32_t previous = 0;
+      for (size_t p = 0; p < it->second.size(); p++) {
+        putVarint(postings, it->second[p].first - previous);
+        previous = it->second[p].first;
+        long weight = std::lround(scores[t][p] * 255 / best);
+        postings.push_back((uint8_t)std::max(1L, std::min(255L, weight)));
+      }
+
+      out.push_back(it->first.size());
+      out.insert(out.end(), it->first.begin(), it->first.end());
+      put32(out, it->second.size());
+      put32(out, start);
+      put32(out, postings.size() - start);
+    }
+  }
+
+  static uint32_t checksum(const std::vector<uint8_t>& image) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = sizeof(DictHeader); i < image.size(); i++) hash = (hash ^ image[i]) * 16777619u;
+    return hash;
+  }
+
+  static void trim(std::string& s) {
+    const char* space = " \t\r\n\f\v";
+    size_t start = s.find_first_not_of(space);
+    if (start == std::string::npos) {
+      s.clear();
+      return;
+    }
+    s = s.substr(start, s.find_last_not_of(space) - start + 1);
+  }
+
+  static void put16(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+  }
+
+  static void put24(std::vector<uint8_t>& out, uint32_t v) {
+    put16(out, v & 0xFFFF);
+    out.push_back((v >> 16) & 0xFF);
+  }
+
+  static void put32(std::vector<uint8_t>& out, uint32_t v) {
+    put16(out, v & 0xFFFF);
+    put16(out, v >> 16);
+  }
+
+  static void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+      out.push_back((v & 0x7F) | 0x80);
+      v >>= 7;
+    }
+    out.push_back(v);
+  }
+
+  static void endSection(std::vector<uint8_t>& out, DictSection& section) {
+    section.size = out.size() - section.offset;
+    while (out.size() % 4) out.push_back(0);
+  }
+};
+
+inline bool dictWriteImage(const std::string& path, const std::vector<uint8_t>& image) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write((const char*)image.data(), image.size());
+  return out.good();
+}
+
+#ifndef DICTC_NO_MAIN
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: dictc <out.pmd> <dict.txt>..." << std::endl;
+    return 2;
+  }
+
+  DictBuilder builder;
+  for (int i = 2; i < argc; i++) {
+    if (!builder.addFile(argv[i])) {
+      std::cerr << "Can't read " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<uint8_t> image = builder.build();
+  if (!dictWriteImage(argv[1], image)) {
+    std::cerr << "Can't write " << argv[1] << std::endl;
+    return 1;
+  }
+  std::cout << builder.size() << " definitions, " << image.size() << " bytes" << std::endl;
+  return 0;
+}
+#endif
@@ -0,0 +1,309 @@
+// REMOTE CONTROL
+// Drives the device over its USB serial port for UI timing runs: types keys,
+// saves what the screens show and reads the firmware's counters (see
+// include/remoteProto.h). Runs on the host:
+//   g++ -std=c++17 -O2 -Iinclude tools/pmremote/pmremote.cpp -o pmremote
+//   ./pmremote /dev/ttyACM0 run.txt
+// The script, from the file or stdin, has one command a line:
+//   type <text>              Keys as characters, \r enter, \b backspace,
+//                            \t tab, \\ and \xNN for any other
+//   key <n> [n...]           Keys by number, row * 10 + column
+//   wait <ms>
+//   snap eink|oled <file>    The screen as the user sees it, as a PBM
+//   stats [reset]            Prints the counters, then restarts them
+// Blank lines and lines starting with # are skipped.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../include/remoteProto.h"
+
+// A screen as the panel has it, see REMOTE_SNAP
+struct RemoteSnap {
+  uint8_t  screen = REMOTE_EINK;
+  uint8_t  rotation = 0;
+  uint16_t width = 0;
+  uint16_t height = 0;
+  uint32_t frame = 0;
+  std::vector<uint8_t> rows;
+
+  bool ink(int x, int y) const {
+    return rows[(size_t)y * ((width + 7) / 8) + x / 8] & (0x80 >> (x % 8));
+  }
+};
+
+// Turns snap the way the firmware draws on it, like Adafruit GFX does, into
+// rows of the same format
+std::vector<uint8_t> remoteView(const RemoteSnap& snap, int& width, int& height) {
+  bool turned = snap.rotation & 1;
+  width  = turned ? snap.height : snap.width;
+  height = turned ? snap.width : snap.height;
+  int stride = (width + 7) / 8;
+  std::vector<uint8_t> view((size_t)stride * height, 0);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int px = x, py = y;
+      switch (snap.rotation & 3) {
+        case 1: px = snap.width - 1 - y; py = x;                  break;
+        case 2: px = snap.width - 1 - x; py = snap.height - 1 - y; break;
+        case 3: px = y;                  py = snap.height - 1 - x; break;
+      }
+      if (snap.ink(px, py)) view[(size_t)y * stride + x / 8] |= 0x80 >> (x % 8);
+    }
+  }
+  return view;
+}
+
+// Binary PBM: 1 is black, so the OLED's lit pixels come out black too
+bool writePbm(const std::string& path, int width, int height, const std::vector<uint8_t>& rows) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+  out << "P4\n" << width << " " << height << "\n";
+  out.write((const char*)rows.data(), rows.size());
+  return out.good();
+}
+
+// CLIENT
+class RemoteClient {
+public:
+  explicit RemoteClient(FdSyncPort& port, int timeoutMs = 1000) : link(port, timeoutMs) {}
+
+  // Starts a run, so the device doesn't answer its first request from the
+  // last run's reply
+  bool hello() {
+    return request(REMOTE_HELLO, nullptr, 0, nullptr);
+  }
+
+  // Sends all of keys, waiting for the device to make room for them
+  bool keys(uint8_t kind, const std::string& keys) {
+    size_t sent = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (sent < keys.size()) {
+      size_t n = std::min(keys.size() - sent, (size_t)SYNC_PAYLOAD_MAX - 1);
+      std::vector<uint8_t> out(n + 1);
+      out[0] = kind;
+      memcpy(&out[1], keys.data() + sent, n);
+      std::vector<uint8_t> in;
+      if (!request(REMOTE_KEYS, out.data(), out.size(), &in)) return false;
+      if (in.size() < 4) {
+        error = "bad KEYS reply";
+        return false;
+      }
+      uint16_t taken = syncGet16(in.data());
+      sent += taken;
+      if (taken > 0) {
+        start = std::chrono::steady_clock::now();
+        continue;
+      }
+      if (std::chrono::steady_clock::now() - start > std::chrono::seconds(5)) {
+        error = "device isn't taking keys";
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+  }
+
+  bool snap(uint8_t screen, RemoteSnap& snap) {
+    std::vector<uint8_t> packed;
+    uint32_t total = 1;
+    while (packed.size() < total) {
+      uint8_t out[5];
+      out[0] = screen;
+      syncPut32(out + 1, (uint32_t)packed.size());
+      std::vector<uint8_t> in;
+      if (!request(REMOTE_SNAP, out, sizeof(out), &in)) return false;
+      if (in.size() < REMOTE_SNAP_HEADER || syncGet32(&in[14]) != packed.size()) {
+        error = "bad SNAP reply";
+        return false;
+      }
+      snap.screen   = in[0];
+      snap.rotation = in[1];
+      snap.width    = syncGet16(&in[2]);
+      snap.height   = syncGet16(&in[4]);
+      snap.frame    = syncGet32(&in[6]);
+      total         = syncGet32(&in[10]);
+      if (in.size() == REMOTE_SNAP_HEADER && packed.size() < total) {
+        error = "device stopped short sending the screen";
+        return false;
+      }
+      packed.insert(packed.end(), in.begin() + REMOTE_SNAP_HEADER, in.end());
+    }
+
+    snap.rows.assign((size_t)((snap.width + 7) / 8) * snap.height, 0);
+    if (!remoteUnpack(packed.data(), packed.size(), snap.rows.data(), snap.rows.size())) {
+      error = "screen doesn't unpack";
+      return false;
+    }
+    return true;
+  }
+
+  // The counters by RemoteStat, restarted after this read if reset
+  bool stats(bool reset, std::vector<uint32_t>& values) {
+    uint8_t out = reset ? 1 : 0;
+    std::vector<uint8_t> in;
+    if (!request(REMOTE_STATS, &out, 1, &in)) return false;
+    if (in.empty() || in.size() < 1 + (size_t)in[0] * 4) {
+      error = "bad STATS reply";
+      return false;
+    }
+    values.clear();
+    for (uint8_t i = 0; i < in[0]; i++) values.push_back(syncGet32(&in[1 + i * 4]));
+    return true;
+  }
+
+  std::string error;
+
+private:
+  bool request(uint8_t type, const uint8_t* payload, size_t len, std::vector<uint8_t>* reply) {
+    bool ok = link.request(type, payload, len, reply);
+    if (!ok) error = link.error;
+    return ok;
+  }
+
+  SyncLink link;
+};
+
+// SCRIPTS
+// The characters of a type command, false on a bad escape
+static bool unescape(const std::string& text, std::string& keys) {
+  keys.clear();
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] != '\\') {
+      keys += text[i];
+      continue;
+    }
+    if (++i >= text.size()) return false;
+    switch (text[i]) {
+      case 'r':  keys += '\r'; break;
+      case 'n':  keys += '\r'; break;        // Enter is 13 on the device
+      case 'b':  keys += '\b'; break;
+      case 't':  keys += '\t'; break;
+      case '\\': keys += '\\'; break;
+      case 'x':
+        if (i + 2 >= text.size() || !isxdigit((unsigned char)text[i + 1]) || !isxdigit((unsigned char)text[i + 2])) return false;
+        keys += (char)std::stoi(text.substr(i + 1, 2), nullptr, 16);
+        i += 2;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+// Runs script, printing stats to out and problems to std::cerr. Stops at the
+// first command that fails.
+bool runScript(RemoteClient& client, std::istream& script, std::ostream& out) {
+  if (!client.hello()) {
+    std::cerr << "Device didn't answer: " << client.error << std::endl;
+    return false;
+  }
+
+  std::string line;
+  int number = 0;
+  while (std::getline(script, line)) {
+    number++;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    std::istringstream words(line);
+    std::string command;
+    if (!(words >> command) || command[0] == '#') continue;
+
+    bool ok = true;
+    std::string problem;
+    if (command == "type") {
+      size_t at = line.find("type") + 5;     // Everything after one space
+      std::string text = at < line.size() ? line.substr(at) : "";
+      std::string keys;
+      if (!unescape(text, keys)) problem = "bad escape";
+      else ok = client.keys(REMOTE_CHARS, keys);
+    }
+    else if (command == "key") {
+      std::string keys;
+      int key;
+      while (words >> key) {
+        if (key < 0 || key >= 40) break;
+        keys += (char)key;
+      }
+      if (keys.empty() || !words.eof()) problem = "keys are 0 to 39";
+      else ok = client.keys(REMOTE_MATRIX, keys);
+    }
+    else if (command == "wait") {
+      int ms;
+      if (!(words >> ms) || ms < 0) problem = "wait needs milliseconds";
+      else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+    else if (command == "snap") {
+      std::string screen, path;
+      words >> screen >> path;
+      if ((screen != "eink" && screen != "oled") || path.empty()) problem = "snap eink|oled <file>";
+      else {
+        RemoteSnap snap;
+        ok = client.snap(screen == "eink" ? REMOTE_EINK : REMOTE_OLED, snap);
+        if (ok) {
+          int width, height;
+          std::vector<uint8_t> view = remoteView(snap, width, height);
+          if (!writePbm(path, width, height, view)) problem = "can't write " + path;
+        }
+      }
+    }
+    else if (command == "stats") {
+      std::string reset;
+      words >> reset;
+      std::vector<uint32_t> values;
+      ok = client.stats(reset == "reset", values);
+      for (size_t i = 0; ok && i < values.size(); i++) {
+        out << remoteStatName((uint8_t)i) << " " << values[i] << std::endl;
+      }
+    }
+    else {
+      problem = "unknown command " + command;
+    }
+
+    if (!ok) problem = client.error;
+    if (!problem.empty()) {
+      std::cerr << "line " << number << ": " << problem << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifndef PMREMOTE_NO_MAIN
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: pmremote <port> [script, default stdin]" << std::endl;
+    return 1;
+  }
+
+  int fd = FdSyncPort::openTty(argv[1]);
+  if (fd < 0) {
+    std::cerr << "Can't open " << argv[1] << std::endl;
+    return 1;
+  }
+  FdSyncPort port(fd);
+  RemoteClient client(port);
+
+  bool ok;
+  if (argc > 2) {
+    std::ifstream script(argv[2]);
+    if (!script) {
+      std::cerr << "Can't open " << argv[2] << std::endl;
+      close(fd);
+      return 1;
+    }
+    ok = runScript(client, script, std::cout);
+  }
+  else {
+    ok = runScript(client, std::cin, std::cout);
+  }
+  close(fd);
+  return ok ? 0 : 1;
+}
+#endif
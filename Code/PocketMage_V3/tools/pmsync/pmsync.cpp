@@ -0,0 +1,360 @@
+// NOTE SYNC
+// Pushes the notes in a folder to the device over its USB serial port while
+// it keeps running, sending only the parts that changed (see
+// include/syncProto.h). Runs on the host:
+//   g++ -std=c++17 -O2 -Iinclude tools/pmsync/pmsync.cpp -o pmsync
+//   ./pmsync /dev/ttyACM0 ~/notes
+// Notes pushed before and not touched since are skipped, their size and time
+// are kept in <folder>/.pmsync. --all checks every note against the device.
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "../../include/syncProto.h"
+
+struct SyncSig {
+  uint32_t weak;
+  uint32_t strong;
+  uint32_t len;          // SYNC_BLOCK, less for the last block of the file
+};
+
+// COPY of count blocks of the device's copy, or DATA: len bytes of ours from offset
+struct SyncOp {
+  uint32_t block;
+  uint16_t count;        // 0 for DATA
+  size_t   offset;
+  size_t   len;
+};
+
+// DELTA
+// Finds the device's blocks anywhere in data. Full blocks are looked up by
+// weak checksum at every byte, rolling it along, and confirmed by the strong
+// one. The short last block can only match at the very end.
+std::vector<SyncOp> syncDelta(const std::vector<SyncSig>& sigs, const std::string& text) {
+  const uint8_t* data = (const uint8_t*)text.data();
+  size_t size = text.size();
+  std::unordered_map<uint32_t, std::vector<uint32_t>> blocks;
+  for (uint32_t i = 0; i < sigs.size(); i++) {
+    if (sigs[i].len == SYNC_BLOCK) blocks[sigs[i].weak].push_back(i);
+  }
+
+  std::vector<SyncOp> ops;
+  size_t literal = 0;    // Start of the bytes not sent yet
+  auto addData = [&](size_t end) {
+    while (literal < end) {
+      size_t n = std::min(end - literal, (size_t)SYNC_PAYLOAD_MAX);
+      ops.push_back({ 0, 0, literal, n });
+      literal += n;
+    }
+  };
+  auto nextBlock = [&]() -> int64_t {
+    return !ops.empty() && ops.back().count > 0 ? ops.back().block + ops.back().count : -1;
+  };
+  auto addCopy = [&](uint32_t block) {
+    if (nextBlock() == block && ops.back().count < SYNC_COPY_MAX) ops.back().count++;
+    else ops.push_back({ block, 1, 0, 0 });
+  };
+
+  SyncRolling roll;
+  bool rolling = false;
+  size_t pos = 0;
+  while (pos + SYNC_BLOCK <= size) {
+    if (!rolling) roll.reset(data + pos, SYNC_BLOCK);
+    rolling = true;
+
+    int64_t match = -1;
+    auto hit = blocks.find(roll.value());
+    if (hit != blocks.end()) {
+      uint32_t strong = syncStrong(data + pos, SYNC_BLOCK);
+      for (uint32_t block : hit->second) {
+        if (sigs[block].strong != strong) continue;
+        match = block;
+        if (block == nextBlock()) break;    // Carries on a run, one COPY
+      }
+    }
+    if (match >= 0) {
+      addData(pos);
+      addCopy((uint32_t)match);
+      pos += SYNC_BLOCK;
+      literal = pos;
+      rolling = false;
+      continue;
+    }
+    if (pos + SYNC_BLOCK < size) roll.roll(data[pos], data[pos + SYNC_BLOCK]);
+    pos++;
+  }
+
+  if (!sigs.empty() && sigs.back().len < SYNC_BLOCK && size >= sigs.back().len) {
+    const SyncSig& tail = sigs.back();
+    size_t at = size - tail.len;
+    if (at >= literal && syncWeak(data + at, tail.len) == tail.weak && syncStrong(data + at, tail.len) == tail.strong) {
+      addData(at);
+      addCopy((uint32_t)sigs.size() - 1);
+      literal = size;
+    }
+  }
+  addData(size);
+  return ops;
+}
+
+// True if ops only copy the device's blocks, in order
+bool syncUnchanged(const std::vector<SyncOp>& ops, const std::vector<SyncSig>& sigs) {
+  uint32_t next = 0;
+  for (const SyncOp& op : ops) {
+    if (op.count == 0 || op.block != next) return false;
+    next += op.count;
+  }
+  return next == sigs.size();
+}
+
+// CLIENT
+struct SyncStats {
+  size_t pushed = 0;
+  size_t unchanged = 0;
+  size_t failed = 0;
+  size_t bytes = 0;          // Size of the notes looked at
+  size_t dataBytes = 0;      // Sent as DATA
+  size_t wireBytes = 0;      // Frames sent and received
+  size_t resends = 0;
+};
+
+enum PushResult { PUSH_FAILED, PUSH_DONE, PUSH_UNCHANGED };
+
+class SyncClient {
+public:
+  explicit SyncClient(FdSyncPort& port, int timeoutMs = 1000) : link(port, timeoutMs) {}
+
+  bool hello() {
+    uint8_t out[2];
+    syncPut16(out, SYNC_VERSION);
+    std::vector<uint8_t> in;
+    if (!request(SYNC_HELLO, out, sizeof(out), &in)) return false;
+    if (in.size() < 6 || syncGet16(in.data()) != SYNC_VERSION || syncGet16(in.data() + 2) != SYNC_BLOCK) {
+      error = "device speaks another version";
+      return false;
+    }
+    return true;
+  }
+
+  bool bye() {
+    return request(SYNC_BYE, nullptr, 0, nullptr);
+  }
+
+  // The device's checksums of path. size is SYNC_MISSING if it has no such note.
+  bool signatures(const std::string& path, uint32_t& size, std::vector<SyncSig>& sigs) {
+    sigs.clear();
+    size = 0;
+    uint32_t blocks = 1;
+    while (sigs.size() < blocks) {
+      std::vector<uint8_t> out(4);
+      syncPut32(out.data(), (uint32_t)sigs.size());
+      out.insert(out.end(), path.begin(), path.end());
+      std::vector<uint8_t> in;
+      if (!request(SYNC_SIG, out.data(), out.size(), &in)) return false;
+      if (in.size() < 10 || syncGet32(in.data() + 4) != sigs.size()) {
+        error = "bad SIG reply";
+        return false;
+      }
+
+      size = syncGet32(in.data());
+      if (size == SYNC_MISSING) return true;
+      blocks = (size + SYNC_BLOCK - 1) / SYNC_BLOCK;
+      uint16_t count = syncGet16(in.data() + 8);
+      if (count == 0 && sigs.size() < blocks) {
+        error = "device stopped short reading " + path;
+        return false;
+      }
+      for (uint16_t i = 0; i < count && 18 + (size_t)i * 8 <= in.size(); i++) {
+        uint32_t start = (uint32_t)sigs.size() * SYNC_BLOCK;
+        sigs.push_back({ syncGet32(&in[10 + i * 8]), syncGet32(&in[14 + i * 8]), std::min<uint32_t>(SYNC_BLOCK, size - start) });
+      }
+    }
+    return true;
+  }
+
+  PushResult push(const std::string& path, const std::string& text) {
+    uint32_t oldSize;
+    std::vector<SyncSig> sigs;
+    if (!signatures(path, oldSize, sigs)) return PUSH_FAILED;
+
+    std::vector<SyncOp> ops = syncDelta(sigs, text);
+    if (oldSize == text.size() && syncUnchanged(ops, sigs)) return PUSH_UNCHANGED;
+    if (sendPatch(path, text, ops)) return PUSH_DONE;
+
+    // The note changed on the device after its checksums were read, send it whole
+    if (error != "check failed") return PUSH_FAILED;
+    std::vector<SyncOp> whole = syncDelta(std::vector<SyncSig>(), text);
+    return sendPatch(path, text, whole) ? PUSH_DONE : PUSH_FAILED;
+  }
+
+  std::string error;
+  SyncStats stats;
+
+private:
+  bool sendPatch(const std::string& path, const std::string& text, const std::vector<SyncOp>& ops) {
+    std::vector<uint8_t> out(12);
+    syncPut32(out.data(), (uint32_t)text.size());
+    syncPut64(out.data() + 4, syncHash64((const uint8_t*)text.data(), text.size()));
+    out.insert(out.end(), path.begin(), path.end());
+    if (!request(SYNC_BEGIN, out.data(), out.size(), nullptr)) return false;
+
+    for (const SyncOp& op : ops) {
+      if (op.count > 0) {
+        uint8_t copy[6];
+        syncPut32(copy, op.block);
+        syncPut16(copy + 4, op.count);
+        if (!request(SYNC_COPY, copy, sizeof(copy), nullptr)) return false;
+      }
+      else {
+        if (!request(SYNC_DATA, (const uint8_t*)text.data() + op.offset, op.len, nullptr)) return false;
+        stats.dataBytes += op.len;
+      }
+    }
+    return request(SYNC_END, nullptr, 0, nullptr);
+  }
+
+  bool request(uint8_t type, const uint8_t* payload, size_t len, std::vector<uint8_t>* reply) {
+    bool ok = link.request(type, payload, len, reply);
+    if (!ok) error = link.error;
+    stats.wireBytes = link.wireBytes;
+    stats.resends = link.resends;
+    return ok;
+  }
+
+  SyncLink link;
+};
+
+// MANIFEST
+// Size and mtime of every note as it was pushed, one "mtime size name" a line
+typedef std::map<std::string, std::pair<long long, long long>> SyncManifest;
+
+SyncManifest loadManifest(const std::string& path) {
+  SyncManifest manifest;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    long long mtime, size;
+    std::string name;
+    if (!(fields >> mtime >> size)) continue;
+    fields.get();
+    std::getline(fields, name);
+    if (!name.empty()) manifest[name] = std::make_pair(mtime, size);
+  }
+  return manifest;
+}
+
+bool saveManifest(const std::string& path, const SyncManifest& manifest) {
+  std::ofstream out(path, std::ios::trunc);
+  for (const auto& entry : manifest) out << entry.second.first << " " << entry.second.second << " " << entry.first << "\n";
+  return (bool)out;
+}
+
+static bool isNote(const std::string& name) {
+  if (name.size() < 5 || name[0] == '.') return false;
+  std::string ext = name.substr(name.size() - 4);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".txt";
+}
+
+static bool readWhole(const std::string& path, std::string& text) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  std::ostringstream buf;
+  buf << in.rdbuf();
+  text = buf.str();
+  return true;
+}
+
+// Pushes the notes in folder to deviceFolder, skipping those in the manifest
+// unless all. Prints a line per note pushed.
+bool syncFolder(SyncClient& client, const std::string& folder, std::string deviceFolder, bool all) {
+  if (deviceFolder.empty() || deviceFolder.back() != '/') deviceFolder += '/';
+  std::string manifestPath = folder + "/.pmsync";
+  SyncManifest manifest = loadManifest(manifestPath);
+
+  DIR* dir = opendir(folder.c_str());
+  if (!dir) {
+    std::cerr << "Can't open " << folder << std::endl;
+    return false;
+  }
+  std::vector<std::string> names;
+  while (dirent* entry = readdir(dir)) {
+    if (isNote(entry->d_name)) names.push_back(entry->d_name);
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+
+  if (!client.hello()) {
+    std::cerr << "Device didn't answer: " << client.error << std::endl;
+    return false;
+  }
+  for (const std::string& name : names) {
+    std::string local = folder + "/" + name;
+    struct stat st;
+    if (stat(local.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+    auto stamp = std::make_pair((long long)st.st_mtime, (long long)st.st_size);
+    auto known = manifest.find(name);
+    if (!all && known != manifest.end() && known->second == stamp) continue;
+
+    std::string text;
+    if (!readWhole(local, text)) continue;
+    client.stats.bytes += text.size();
+    size_t dataBefore = client.stats.dataBytes;
+    switch (client.push(deviceFolder + name, text)) {
+      case PUSH_DONE:
+        client.stats.pushed++;
+        manifest[name] = stamp;
+        std::cout << name << ": sent " << client.stats.dataBytes - dataBefore << " of " << text.size() << " bytes" << std::endl;
+        break;
+      case PUSH_UNCHANGED:
+        client.stats.unchanged++;
+        manifest[name] = stamp;
+        break;
+      case PUSH_FAILED:
+        client.stats.failed++;
+        std::cerr << name << ": " << client.error << std::endl;
+        break;
+    }
+  }
+  client.bye();
+  saveManifest(manifestPath, manifest);
+  return client.stats.failed == 0;
+}
+
+#ifndef PMSYNC_NO_MAIN
+int main(int argc, char** argv) {
+  bool all = false;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--all") all = true;
+    else args.push_back(argv[i]);
+  }
+  if (args.size() < 2) {
+    std::cerr << "Usage: pmsync [--all] <port> <folder> [device folder, default /]" << std::endl;
+    return 1;
+  }
+
+  int fd = FdSyncPort::openTty(args[0].c_str());
+  if (fd < 0) {
+    std::cerr << "Can't open " << args[0] << std::endl;
+    return 1;
+  }
+  FdSyncPort port(fd);
+  SyncClient client(port);
+  bool ok = syncFolder(client, args[1], args.size() > 2 ? args[2] : "/", all);
+  close(fd);
+
+  const SyncStats& stats = client.stats;
+  std::cout << stats.pushed << " pushed, " << stats.unchanged << " unchanged, " << stats.failed << " failed. "
+            << stats.wireBytes << " bytes over the port for " << stats.bytes << " bytes of notes" << std::endl;
+  return ok ? 0 : 1;
+}
+#endif